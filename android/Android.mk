@@ -125,6 +125,7 @@ LOCAL_CFLAGS := $(common_cflags) -Wno-unused -Wno-missing-braces \
   	-DSQLITE_ENABLE_STAT4 \
   	-DSQLITE_ENABLE_EXPLAIN_COMMENTS \
 	-DSQLITE_ENABLE_DBSTAT_VTAB \
+	-DSQLITE_ENABLE_DBPAGE_VTAB \
 	-DOMIT_MEMLOCK \
 	-DOMIT_MEM_SECURITY \
 	-DSQLCIPHER_CRYPTO_OPENSSL \
@@ -140,3 +141,38 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := crypto-static
 LOCAL_SRC_FILES := lib/libcrypto.a
 include $(PREBUILT_STATIC_LIBRARY)
+
+# Native tests, built with WCDB_NATIVE_TESTS=1 and run by adb shell with a
+# writable directory as argument, e.g. /data/local/tmp.
+ifdef WCDB_NATIVE_TESTS
+
+LOCAL_PATH := $(root_path)/android/jni
+include $(CLEAR_VARS)
+LOCAL_MODULE := change_notifier_test
+LOCAL_CFLAGS := $(common_cflags)
+LOCAL_CPPFLAGS := $(commom_cppflags)
+LOCAL_SRC_FILES := test/ChangeNotifierTest.cpp ChangeNotifier.cpp
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := cursor_window_test
+LOCAL_CFLAGS := $(common_cflags)
+LOCAL_CPPFLAGS := $(commom_cppflags)
+LOCAL_SRC_FILES := test/CursorWindowTest.cpp CursorWindow.cpp Logger.c
+LOCAL_LDLIBS := -llog
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := vfs_fault_test
+LOCAL_CFLAGS := $(common_cflags)
+LOCAL_CPPFLAGS := $(commom_cppflags)
+LOCAL_C_INCLUDES := $(common_c_includes)
+LOCAL_SRC_FILES := test/VfsFaultTest.cpp
+LOCAL_LDLIBS := -llog -lz -ldl
+LOCAL_STATIC_LIBRARIES := \
+	wcdb-vfslog \
+	sqlcipher \
+	crypto-static
+include $(BUILD_EXECUTABLE)
+
+endif
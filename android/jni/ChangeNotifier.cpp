@@ -0,0 +1,238 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChangeNotifier.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace wcdb {
+
+static const char NOTIFIER_MAGIC[8] = {'W', 'C', 'D', 'B', 'N', 'T', 'F', '1'};
+
+// Futex on shared mapping, without FUTEX_PRIVATE_FLAG, works across processes.
+static inline int futexWait(uint32_t *addr, uint32_t expected, int timeoutMs)
+{
+    struct timespec timeout;
+    if (timeoutMs >= 0) {
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    }
+    return syscall(SYS_futex, addr, FUTEX_WAIT, expected,
+                   timeoutMs >= 0 ? &timeout : nullptr, nullptr, 0);
+}
+
+static inline int futexWakeAll(uint32_t *addr)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+ChangeNotifier *ChangeNotifier::open(const char *path)
+{
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return nullptr;
+
+    const size_t size = sizeof(Header) + sizeof(Slot) * SLOT_COUNT;
+
+    // Only one process initializes the file.
+    if (flock(fd, LOCK_EX) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return nullptr;
+    }
+
+    bool initialized = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size == size) {
+        Header header;
+        initialized = pread(fd, &header, sizeof(header), 0) ==
+                          (ssize_t) sizeof(header) &&
+                      memcmp(header.magic, NOTIFIER_MAGIC, 8) == 0 &&
+                      header.slotCount == SLOT_COUNT;
+    }
+    if (!initialized) {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, NOTIFIER_MAGIC, 8);
+        header.slotCount = SLOT_COUNT;
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0 ||
+            pwrite(fd, &header, sizeof(header), 0) !=
+                (ssize_t) sizeof(header)) {
+            int err = errno;
+            flock(fd, LOCK_UN);
+            close(fd);
+            errno = err;
+            return nullptr;
+        }
+    }
+
+    void *mapped =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    flock(fd, LOCK_UN);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        errno = err;
+        return nullptr;
+    }
+    return new ChangeNotifier(fd, mapped, size);
+}
+
+ChangeNotifier::ChangeNotifier(int fd, void *mapped, size_t size)
+    : mFd(fd)
+    , mSize(size)
+    , mHeader((Header *) mapped)
+    , mSlots((Slot *) ((char *) mapped + sizeof(Header)))
+    , mSeen(SLOT_COUNT, 0)
+{
+    // Changes before opened are not notified.
+    mLastSequence = __atomic_load_n(&mHeader->sequence, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < SLOT_COUNT; i++)
+        mSeen[i] = __atomic_load_n(&mSlots[i].sequence, __ATOMIC_ACQUIRE);
+}
+
+ChangeNotifier::~ChangeNotifier()
+{
+    munmap(mHeader, mSize);
+    close(mFd);
+}
+
+uint32_t ChangeNotifier::hashName(const char *name)
+{
+    // FNV-1a, 0 is reserved for free slot.
+    uint32_t hash = 2166136261u;
+    for (const char *p = name; *p; p++) {
+        hash ^= (uint8_t) *p;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+ChangeNotifier::Slot *ChangeNotifier::findSlot(const char *name, bool create)
+{
+    // Names longer than MAX_NAME_LENGTH are matched by prefix and hash.
+    uint32_t hash = hashName(name);
+    for (uint32_t probe = 0; probe < SLOT_COUNT; probe++) {
+        Slot *slot = &mSlots[(hash + probe) % SLOT_COUNT];
+        uint32_t slotHash = __atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE);
+        if (slotHash == 0) {
+            if (!create)
+                return nullptr;
+            uint32_t expected = 0;
+            if (__atomic_compare_exchange_n(&slot->hash, &expected, hash,
+                                            false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                strncpy(slot->name, name, MAX_NAME_LENGTH);
+                slot->name[MAX_NAME_LENGTH] = '\0';
+                __atomic_store_n(&slot->ready, 1, __ATOMIC_RELEASE);
+                return slot;
+            }
+            slotHash = expected;
+        }
+        if (slotHash != hash)
+            continue;
+
+        // Claimed by another process which is filling the name.
+        for (int spin = 0;
+             !__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE) && spin < 1000;
+             spin++)
+            sched_yield();
+        if (__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE) &&
+            strncmp(slot->name, name, MAX_NAME_LENGTH) == 0)
+            return slot;
+    }
+    return nullptr;
+}
+
+void ChangeNotifier::publish(const char *table)
+{
+    Mutex::Autolock lock(mLock);
+
+    Slot *slot;
+    auto it = mSlotCache.find(table);
+    if (it != mSlotCache.end()) {
+        slot = it->second;
+    } else {
+        slot = findSlot(table, true);
+        if (!slot)
+            return; // all slots are occupied
+        mSlotCache.emplace(table, slot);
+    }
+
+    // If nothing else happened in between, the change is seen by ourself.
+    uint64_t sequence =
+        __atomic_fetch_add(&slot->sequence, 1, __ATOMIC_ACQ_REL);
+    uint64_t &seen = mSeen[slot - mSlots];
+    if (seen == sequence)
+        seen = sequence + 1;
+
+    __atomic_add_fetch(&mHeader->sequence, 1, __ATOMIC_ACQ_REL);
+    if (__atomic_load_n(&mHeader->waiters, __ATOMIC_ACQUIRE) > 0)
+        futexWakeAll(&mHeader->sequence);
+}
+
+void ChangeNotifier::wakeUp()
+{
+    __atomic_add_fetch(&mHeader->sequence, 1, __ATOMIC_ACQ_REL);
+    futexWakeAll(&mHeader->sequence);
+}
+
+void ChangeNotifier::collectChanges(std::vector<std::string> &tables)
+{
+    Mutex::Autolock lock(mLock);
+    for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+        Slot *slot = &mSlots[i];
+        if (!__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE))
+            continue;
+        uint64_t sequence =
+            __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != mSeen[i]) {
+            mSeen[i] = sequence;
+            tables.emplace_back(slot->name);
+        }
+    }
+}
+
+void ChangeNotifier::waitForChanges(std::vector<std::string> &tables,
+                                    int timeoutMs)
+{
+    uint32_t sequence = __atomic_load_n(&mHeader->sequence, __ATOMIC_ACQUIRE);
+    if (sequence == mLastSequence) {
+        __atomic_add_fetch(&mHeader->waiters, 1, __ATOMIC_ACQ_REL);
+        futexWait(&mHeader->sequence, sequence, timeoutMs);
+        __atomic_sub_fetch(&mHeader->waiters, 1, __ATOMIC_ACQ_REL);
+        sequence = __atomic_load_n(&mHeader->sequence, __ATOMIC_ACQUIRE);
+    }
+    mLastSequence = sequence;
+    collectChanges(tables);
+}
+
+} // namespace wcdb
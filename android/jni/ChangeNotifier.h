@@ -0,0 +1,93 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WCDB_CHANGE_NOTIFIER_H__
+#define __WCDB_CHANGE_NOTIFIER_H__
+
+#include "Mutex.h"
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace wcdb {
+
+// Table-level change notification across processes.
+//
+// Processes opening the same database share a memory-mapped sidecar file,
+// which holds a sequence counter per table and a global sequence serving as
+// the futex word. Committing processes bump the counters and wake up the
+// waiters, which compare the counters with the values seen last time.
+class ChangeNotifier {
+    static const uint32_t SLOT_COUNT = 511;
+    static const uint32_t MAX_NAME_LENGTH = 111;
+
+    struct Header {
+        char magic[8];
+        uint32_t sequence;
+        uint32_t waiters;
+        uint32_t slotCount;
+        uint32_t reserved[11];
+    };
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t ready;
+        uint64_t sequence;
+        char name[MAX_NAME_LENGTH + 1];
+    };
+
+public:
+    // Map the sidecar file at path. Returns nullptr with errno set on failure.
+    static ChangeNotifier *open(const char *path);
+    ~ChangeNotifier();
+
+    // Notify other processes that table is changed.
+    void publish(const char *table);
+
+    // Block until tables are changed by others, or wakeUp is called, or
+    // timeoutMs (-1 for infinite) elapses. Changed tables are appended to
+    // tables. Changes published by this process are omitted.
+    void waitForChanges(std::vector<std::string> &tables, int timeoutMs);
+    void wakeUp();
+
+private:
+    ChangeNotifier(int fd, void *mapped, size_t size);
+    ChangeNotifier(const ChangeNotifier &);
+    ChangeNotifier &operator=(const ChangeNotifier &);
+
+    static uint32_t hashName(const char *name);
+    Slot *findSlot(const char *name, bool create);
+    void collectChanges(std::vector<std::string> &tables);
+
+    int mFd;
+    size_t mSize;
+    Header *mHeader;
+    Slot *mSlots;
+
+    Mutex mLock;
+    std::vector<uint64_t> mSeen;         // sequence seen by slot index
+    std::map<std::string, Slot *> mSlotCache;
+    uint32_t mLastSequence;
+};
+
+} // namespace wcdb
+
+#endif
@@ -24,21 +24,58 @@
 #include "CursorWindow.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Older NDK headers lack the memfd and sealing definitions, the values
+// are part of the stable kernel ABI.
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#endif
+#ifndef F_GET_SEALS
+#define F_GET_SEALS (1024 + 10)
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#endif
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK 0x0002
+#endif
+#ifndef F_SEAL_GROW
+#define F_SEAL_GROW 0x0004
+#endif
+#ifndef F_SEAL_WRITE
+#define F_SEAL_WRITE 0x0008
+#endif
 
 namespace wcdb {
 
-CursorWindow::CursorWindow(void *data, size_t size) : mData(data), mSize(size)
+CursorWindow::CursorWindow(void *data, size_t size, int fd, bool readOnly)
+    : mData(data), mSize(size), mFd(fd), mReadOnly(readOnly)
 {
     mHeader = static_cast<Header *>(mData);
 }
 
 CursorWindow::~CursorWindow()
 {
-    if (mData)
+    if (mFd >= 0) {
+        munmap(mData, mSize);
+        close(mFd);
+    } else if (mData)
         free(mData);
 }
 
@@ -65,8 +102,187 @@ status_t CursorWindow::create(size_t size, CursorWindow **outCursorWindow)
     }
 }
 
+static int createMemfd(const char *name)
+{
+#ifdef __NR_memfd_create
+    return (int) syscall(__NR_memfd_create, name,
+                         MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+status_t CursorWindow::createShared(const char *name,
+                                    size_t size,
+                                    CursorWindow **outCursorWindow)
+{
+    *outCursorWindow = nullptr;
+    if (size < sizeof(Header) + sizeof(RowSlotChunk))
+        return BAD_VALUE;
+
+    std::string fdName("CursorWindow: ");
+    fdName += name ? name : "<unnamed>";
+    int fd = createMemfd(fdName.c_str());
+    if (fd < 0) {
+        ALOGW("memfd_create failed: %s", strerror(errno));
+        return INVALID_OPERATION;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        ALOGE("Failed to resize shared window to %zu bytes: %s", size,
+              strerror(errno));
+        close(fd);
+        return NO_MEMORY;
+    }
+
+    void *data =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map shared window: %s", strerror(errno));
+        close(fd);
+        return NO_MEMORY;
+    }
+
+    CursorWindow *window = new CursorWindow(data, size, fd, false);
+    window->clear();
+    LOG_WINDOW("Created shared CursorWindow: fd=%d, mSize=%zu, mData=%p", fd,
+               size, data);
+    *outCursorWindow = window;
+    return OK;
+}
+
+status_t CursorWindow::createFromFd(int fd, CursorWindow **outCursorWindow)
+{
+    *outCursorWindow = nullptr;
+
+    // Without these seals the producer could still truncate the file or
+    // write to it while we read, leading to SIGBUS or torn rows.
+    static const int requiredSeals =
+        F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & requiredSeals) != requiredSeals) {
+        ALOGE("Refusing to map unsealed CursorWindow fd %d (seals=%d)", fd,
+              seals);
+        return PERMISSION_DENIED;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (size_t) st.st_size < sizeof(Header) + sizeof(RowSlotChunk) ||
+        (uint64_t) st.st_size > UINT32_MAX) {
+        return BAD_VALUE;
+    }
+    size_t size = (size_t) st.st_size;
+
+    int dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0) {
+        ALOGE("Failed to duplicate CursorWindow fd: %s", strerror(errno));
+        return NO_MEMORY;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, dupFd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map CursorWindow fd read-only: %s", strerror(errno));
+        close(dupFd);
+        return NO_MEMORY;
+    }
+
+    CursorWindow *window = new CursorWindow(data, size, dupFd, true);
+    status_t result = window->validate();
+    if (result != OK) {
+        ALOGE("Mapped CursorWindow is corrupted.");
+        delete window;
+        return result;
+    }
+    LOG_WINDOW("Mapped shared CursorWindow: numRows=%" PRIu32
+               ", numColumns=%" PRIu32 ", mSize=%zu",
+               window->mHeader->numRows, window->mHeader->numColumns, size);
+    *outCursorWindow = window;
+    return OK;
+}
+
+status_t CursorWindow::seal(int *outFd)
+{
+    if (mFd < 0)
+        return INVALID_OPERATION;
+
+    if (!mReadOnly) {
+        // F_SEAL_WRITE is refused while any shared mapping could still be
+        // made writable, so swap ours for a private read-only one at the
+        // same address first. Nothing writes it, so no page is ever copied.
+        void *data =
+            mmap(mData, mSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, mFd, 0);
+        if (data == MAP_FAILED) {
+            ALOGE("Failed to remap CursorWindow read-only: %s",
+                  strerror(errno));
+            return UNKNOWN_ERROR;
+        }
+        mReadOnly = true;
+
+        if (fcntl(mFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+                                        F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+            ALOGE("Failed to seal CursorWindow: %s", strerror(errno));
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    *outFd = mFd;
+    return OK;
+}
+
+status_t CursorWindow::validate()
+{
+    const size_t chunkEnd = mSize - sizeof(RowSlotChunk);
+    if (mHeader->freeOffset > mSize || mHeader->firstChunkOffset > chunkEnd ||
+        mHeader->firstChunkOffset < sizeof(Header) ||
+        mHeader->numColumns > mSize / sizeof(FieldSlot)) {
+        return BAD_VALUE;
+    }
+
+    const size_t fieldDirSize = mHeader->numColumns * sizeof(FieldSlot);
+    uint32_t chunkOffset = mHeader->firstChunkOffset;
+    uint32_t chunkPos = 0;
+    for (uint32_t row = 0; row < mHeader->numRows; ++row, ++chunkPos) {
+        RowSlotChunk *chunk =
+            static_cast<RowSlotChunk *>(offsetToPtr(chunkOffset));
+        if (chunkPos == ROW_SLOT_CHUNK_NUM_ROWS) {
+            chunkOffset = chunk->nextChunkOffset;
+            if (chunkOffset == 0 || chunkOffset > chunkEnd)
+                return BAD_VALUE;
+            chunk = static_cast<RowSlotChunk *>(offsetToPtr(chunkOffset));
+            chunkPos = 0;
+        }
+
+        uint32_t fieldDirOffset = chunk->slots[chunkPos].offset;
+        if (fieldDirOffset > mSize || fieldDirSize > mSize - fieldDirOffset)
+            return BAD_VALUE;
+
+        FieldSlot *fieldDir =
+            static_cast<FieldSlot *>(offsetToPtr(fieldDirOffset));
+        for (uint32_t column = 0; column < mHeader->numColumns; ++column) {
+            FieldSlot &field = fieldDir[column];
+            if (field.type != FIELD_TYPE_STRING &&
+                field.type != FIELD_TYPE_BLOB)
+                continue;
+            uint32_t offset = field.data.buffer.offset;
+            uint32_t size = field.data.buffer.size;
+            if (offset > mSize || size > mSize - offset)
+                return BAD_VALUE;
+            if (field.type == FIELD_TYPE_STRING &&
+                (size == 0 ||
+                 static_cast<char *>(offsetToPtr(offset))[size - 1] != 0))
+                return BAD_VALUE;
+        }
+    }
+    return OK;
+}
+
 status_t CursorWindow::clear()
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     mHeader->freeOffset = sizeof(Header) + sizeof(RowSlotChunk);
     mHeader->firstChunkOffset = sizeof(Header);
     mHeader->numRows = 0;
@@ -80,6 +296,9 @@ status_t CursorWindow::clear()
 
 status_t CursorWindow::setNumColumns(uint32_t numColumns)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     uint32_t cur = mHeader->numColumns;
     if ((cur > 0 || mHeader->numRows > 0) && cur != numColumns) {
         ALOGE("Trying to go from %d columns to %d", cur, numColumns);
@@ -91,6 +310,9 @@ status_t CursorWindow::setNumColumns(uint32_t numColumns)
 
 status_t CursorWindow::allocRow(RowSlot **outSlot)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     // Fill in the row slot
     RowSlot *rowSlot = allocRowSlot();
     if (rowSlot == nullptr) {
@@ -127,6 +349,9 @@ status_t CursorWindow::allocRow(RowSlot **outSlot)
 
 status_t CursorWindow::freeLastRow()
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     if (mHeader->numRows > 0) {
         mHeader->numRows--;
     }
@@ -236,6 +461,8 @@ status_t CursorWindow::putString(RowSlot *row,
 status_t CursorWindow::putBlobOrString(
     RowSlot *row, uint32_t column, const void *value, size_t size, int32_t type)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
 
     FieldSlot *fieldSlot = getFieldSlot(row, column);
     if (!fieldSlot) {
@@ -257,6 +484,9 @@ status_t CursorWindow::putBlobOrString(
 
 status_t CursorWindow::putLong(RowSlot *row, uint32_t column, int64_t value)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     FieldSlot *fieldSlot = getFieldSlot(row, column);
     if (!fieldSlot) {
         return BAD_VALUE;
@@ -269,6 +499,9 @@ status_t CursorWindow::putLong(RowSlot *row, uint32_t column, int64_t value)
 
 status_t CursorWindow::putDouble(RowSlot *row, uint32_t column, double value)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     FieldSlot *fieldSlot = getFieldSlot(row, column);
     if (!fieldSlot) {
         return BAD_VALUE;
@@ -281,6 +514,9 @@ status_t CursorWindow::putDouble(RowSlot *row, uint32_t column, double value)
 
 status_t CursorWindow::putNull(RowSlot *row, uint32_t column)
 {
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
     FieldSlot *fieldSlot = getFieldSlot(row, column);
     if (!fieldSlot) {
         return BAD_VALUE;
@@ -49,7 +49,7 @@ namespace wcdb {
  * Strings are stored in UTF-8.
 **/
 class CursorWindow {
-    CursorWindow(void *data, size_t size);
+    CursorWindow(void *data, size_t size, int fd = -1, bool readOnly = false);
 
 public:
     /* Field types. */
@@ -85,6 +85,31 @@ public:
 
     static status_t create(size_t size, CursorWindow **outCursorWindow);
 
+    /**
+     * Create a window backed by an anonymous shared memory file (memfd)
+     * instead of the heap, so that it can be handed to another process
+     * without copying. Fails with INVALID_OPERATION on kernels without
+     * memfd sealing support.
+     */
+    static status_t createShared(const char *name,
+                                 size_t size,
+                                 CursorWindow **outCursorWindow);
+
+    /**
+     * Map a sealed window published by another process read-only.
+     * The descriptor is duplicated, the caller keeps ownership of fd.
+     */
+    static status_t createFromFd(int fd, CursorWindow **outCursorWindow);
+
+    /**
+     * Make a shared window immutable and return the descriptor to be sent
+     * to the consumer. Writes fail afterwards. Sealing twice is a no-op.
+     */
+    status_t seal(int *outFd);
+
+    inline bool isShared() { return mFd >= 0; }
+    inline bool isReadOnly() { return mReadOnly; }
+
     inline size_t size() { return mSize; }
     inline size_t freeSpace() { return mSize - mHeader->freeOffset; }
     inline uint32_t getNumRows() { return mHeader->numRows; }
@@ -201,6 +226,8 @@ private:
     void *mData;
     size_t mSize;
     Header *mHeader;
+    int mFd;
+    bool mReadOnly;
 
     inline void *offsetToPtr(uint32_t offset)
     {
@@ -221,6 +248,9 @@ private:
 
     RowSlot *allocRowSlot();
 
+    // Check every offset of a mapped window stays within its size.
+    status_t validate();
+
     status_t putBlobOrString(RowSlot *row,
                              uint32_t column,
                              const void *value,
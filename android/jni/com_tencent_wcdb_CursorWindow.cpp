@@ -78,6 +78,50 @@ nativeCreate(JNIEnv *env, jclass clazz, jstring nameObj, jint cursorWindowSize)
     return (jlong)(intptr_t) window;
 }
 
+static jlong nativeCreateShared(JNIEnv *env,
+                                jclass clazz,
+                                jstring nameObj,
+                                jint cursorWindowSize)
+{
+    const char *name = env->GetStringUTFChars(nameObj, nullptr);
+    CursorWindow *window;
+    status_t status =
+        CursorWindow::createShared(name, cursorWindowSize, &window);
+    env->ReleaseStringUTFChars(nameObj, name);
+    if (status || !window) {
+        LOGE(LOG_TAG,
+             "Could not allocate shared CursorWindow of size %d due to error "
+             "%d.",
+             cursorWindowSize, status);
+        return 0;
+    }
+    return (jlong)(intptr_t) window;
+}
+
+static jlong nativeCreateFromFd(JNIEnv *env, jclass clazz, jint fd)
+{
+    CursorWindow *window;
+    status_t status = CursorWindow::createFromFd(fd, &window);
+    if (status || !window) {
+        LOGE(LOG_TAG, "Could not map CursorWindow from fd %d due to error %d.",
+             fd, status);
+        return 0;
+    }
+    return (jlong)(intptr_t) window;
+}
+
+static jint nativeSeal(JNIEnv *env, jclass clazz, jlong windowPtr)
+{
+    CursorWindow *window = (CursorWindow *) (intptr_t) windowPtr;
+    int fd;
+    status_t status = window->seal(&fd);
+    if (status) {
+        LOGE(LOG_TAG, "Could not seal CursorWindow due to error %d.", status);
+        return -1;
+    }
+    return fd;
+}
+
 static void nativeDispose(JNIEnv *env, jclass clazz, jlong windowPtr)
 {
     CursorWindow *window = (CursorWindow *) (intptr_t) windowPtr;
@@ -509,6 +553,10 @@ nativePutNull(JNIEnv *env, jclass clazz, jlong windowPtr, jint row, jint column)
 static const JNINativeMethod sMethods[] = {
     /* name, signature, funcPtr */
     {"nativeCreate", "(Ljava/lang/String;I)J", (void *) nativeCreate},
+    {"nativeCreateShared", "(Ljava/lang/String;I)J",
+     (void *) nativeCreateShared},
+    {"nativeCreateFromFd", "(I)J", (void *) nativeCreateFromFd},
+    {"nativeSeal", "(J)I", (void *) nativeSeal},
     {"nativeDispose", "(J)V", (void *) nativeDispose},
     {"nativeClear", "(J)V", (void *) nativeClear},
     {"nativeGetNumRows", "(J)I", (void *) nativeGetNumRows},
@@ -0,0 +1,120 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "WCDB.SQLiteChangeNotifier"
+
+#include <errno.h>
+#include <jni.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ChangeNotifier.h"
+#include "JNIHelp.h"
+#include "Logger.h"
+#include "ModuleLoader.h"
+#include "SQLiteCommon.h"
+
+namespace wcdb {
+
+static struct {
+    jclass clazz;
+} gStringClassInfo;
+
+static jlong nativeOpen(JNIEnv *env, jclass cls, jstring pathStr)
+{
+    const char *path = env->GetStringUTFChars(pathStr, nullptr);
+    ChangeNotifier *notifier = ChangeNotifier::open(path);
+    int err = errno;
+    if (!notifier)
+        LOGE(LOG_TAG, "Cannot open change notifier '%s': %s", path,
+             strerror(err));
+    env->ReleaseStringUTFChars(pathStr, path);
+
+    if (!notifier) {
+        jniThrowIOException(env, err);
+        return 0;
+    }
+    return (jlong)(intptr_t) notifier;
+}
+
+static void nativeClose(JNIEnv *env, jclass cls, jlong notifierPtr)
+{
+    delete (ChangeNotifier *) (intptr_t) notifierPtr;
+}
+
+static void
+nativePublish(JNIEnv *env, jclass cls, jlong notifierPtr, jstring tableStr)
+{
+    ChangeNotifier *notifier = (ChangeNotifier *) (intptr_t) notifierPtr;
+    const char *table = env->GetStringUTFChars(tableStr, nullptr);
+    notifier->publish(table);
+    env->ReleaseStringUTFChars(tableStr, table);
+}
+
+static jobjectArray nativeWaitForChanges(JNIEnv *env,
+                                         jclass cls,
+                                         jlong notifierPtr,
+                                         jint timeoutMs)
+{
+    ChangeNotifier *notifier = (ChangeNotifier *) (intptr_t) notifierPtr;
+    std::vector<std::string> tables;
+    notifier->waitForChanges(tables, timeoutMs);
+    if (tables.empty())
+        return nullptr;
+
+    jobjectArray result =
+        env->NewObjectArray(tables.size(), gStringClassInfo.clazz, nullptr);
+    if (!result)
+        return nullptr;
+    for (size_t i = 0; i < tables.size(); i++) {
+        jstring table = env->NewStringUTF(tables[i].c_str());
+        env->SetObjectArrayElement(result, i, table);
+        env->DeleteLocalRef(table);
+    }
+    return result;
+}
+
+static void nativeWakeUp(JNIEnv *env, jclass cls, jlong notifierPtr)
+{
+    ((ChangeNotifier *) (intptr_t) notifierPtr)->wakeUp();
+}
+
+static JNINativeMethod sMethods[] = {
+    {"nativeOpen", "(Ljava/lang/String;)J", (void *) nativeOpen},
+    {"nativeClose", "(J)V", (void *) nativeClose},
+    {"nativePublish", "(JLjava/lang/String;)V", (void *) nativePublish},
+    {"nativeWaitForChanges", "(JI)[Ljava/lang/String;",
+     (void *) nativeWaitForChanges},
+    {"nativeWakeUp", "(J)V", (void *) nativeWakeUp},
+};
+
+static int register_wcdb_SQLiteChangeNotifier(JavaVM *vm, JNIEnv *env)
+{
+    jclass clazz;
+    FIND_CLASS(clazz, "java/lang/String");
+    gStringClassInfo.clazz = jclass(env->NewGlobalRef(clazz));
+    env->DeleteLocalRef(clazz);
+
+    return jniRegisterNativeMethods(
+        env, "com/tencent/wcdb/database/SQLiteChangeNotifier", sMethods,
+        NELEM(sMethods));
+}
+WCDB_JNI_INIT(SQLiteChangeNotifier, register_wcdb_SQLiteChangeNotifier)
+}
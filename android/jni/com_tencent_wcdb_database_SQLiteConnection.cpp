@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <jni.h>
 #include <sqlite3.h>
+#include <sqlite3session.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -71,6 +72,10 @@ static struct {
     jmethodID notifyChange;
 } gSQLiteConnectionClassInfo;
 
+static struct {
+    jmethodID onConflict;
+} gSQLiteChangesetConflictResolverClassInfo;
+
 struct SQLiteConnection {
     // Open flags.
     // Must be kept in sync with the constants defined in SQLiteDatabase.java.
@@ -863,6 +868,170 @@ static jlong nativeExecuteForLastInsertedRowId(JNIEnv *env,
                : -1;
 }
 
+// Type tags of SQLiteBatchArguments.
+enum {
+    BATCH_TYPE_NULL = 0,
+    BATCH_TYPE_LONG = 1,
+    BATCH_TYPE_DOUBLE = 2,
+    BATCH_TYPE_STRING = 3,
+    BATCH_TYPE_BLOB = 4,
+};
+
+// Bind one packed row starting at *pos. Strings and blobs are bound in place,
+// the buffer outlives every step of the batch. Returns SQLITE_OK, the bind
+// error, or SQLITE_CORRUPT when the buffer is malformed.
+static int bindBatchRow(sqlite3_stmt *statement,
+                        int numColumns,
+                        const uint8_t *buffer,
+                        size_t length,
+                        size_t *pos)
+{
+    size_t p = *pos;
+    for (int i = 1; i <= numColumns; i++) {
+        if (p >= length)
+            return SQLITE_CORRUPT;
+
+        int err;
+        uint8_t type = buffer[p++];
+        switch (type) {
+            case BATCH_TYPE_NULL:
+                err = sqlite3_bind_null(statement, i);
+                break;
+            case BATCH_TYPE_LONG: {
+                int64_t value;
+                if (length - p < sizeof(value))
+                    return SQLITE_CORRUPT;
+                memcpy(&value, buffer + p, sizeof(value));
+                p += sizeof(value);
+                err = sqlite3_bind_int64(statement, i, value);
+            } break;
+            case BATCH_TYPE_DOUBLE: {
+                double value;
+                if (length - p < sizeof(value))
+                    return SQLITE_CORRUPT;
+                memcpy(&value, buffer + p, sizeof(value));
+                p += sizeof(value);
+                err = sqlite3_bind_double(statement, i, value);
+            } break;
+            case BATCH_TYPE_STRING:
+            case BATCH_TYPE_BLOB: {
+                int32_t size;
+                if (length - p < sizeof(size))
+                    return SQLITE_CORRUPT;
+                memcpy(&size, buffer + p, sizeof(size));
+                p += sizeof(size);
+                if (size < 0 || length - p < (size_t) size)
+                    return SQLITE_CORRUPT;
+                const char *value = (const char *) buffer + p;
+                p += size;
+                if (type == BATCH_TYPE_STRING)
+                    err = sqlite3_bind_text(statement, i, value, size,
+                                            SQLITE_STATIC);
+                else
+                    err = sqlite3_bind_blob(statement, i, value, size,
+                                            SQLITE_STATIC);
+            } break;
+            default:
+                return SQLITE_CORRUPT;
+        }
+        if (err != SQLITE_OK)
+            return err;
+    }
+    *pos = p;
+    return SQLITE_OK;
+}
+
+// Execute the statement once per packed row of bind arguments. results, if
+// not null, receives the last inserted row ID (or -1 if no row was inserted)
+// or the changed row count of each row. Stops at and throws the first error,
+// returning the number of rows that were executed successfully.
+static jint nativeExecuteBatch(JNIEnv *env,
+                               jclass clazz,
+                               jlong connectionPtr,
+                               jlong statementPtr,
+                               jobject bufferObj,
+                               jint length,
+                               jint numRows,
+                               jboolean returnRowIds,
+                               jlongArray resultsArr)
+{
+    SQLiteConnection *conn = (SQLiteConnection *) (intptr_t) connectionPtr;
+    sqlite3_stmt *stmt = (sqlite3_stmt *) (intptr_t) statementPtr;
+
+    const uint8_t *buffer =
+        static_cast<const uint8_t *>(env->GetDirectBufferAddress(bufferObj));
+    if (!buffer && length > 0) {
+        throw_sqlite3_exception(env,
+                                "Batch arguments must be a direct buffer.");
+        return 0;
+    }
+    if (length < 0 || length > env->GetDirectBufferCapacity(bufferObj) ||
+        (resultsArr && env->GetArrayLength(resultsArr) < numRows)) {
+        throw_sqlite3_exception(env, "Invalid batch arguments.");
+        return 0;
+    }
+
+    int numColumns = sqlite3_bind_parameter_count(stmt);
+    std::vector<jlong> results;
+    if (resultsArr)
+        results.reserve(numRows);
+
+    size_t pos = 0;
+    jint row;
+    for (row = 0; row < numRows; row++) {
+        int err = sqlite3_reset(stmt);
+        if (err == SQLITE_OK)
+            err = bindBatchRow(stmt, numColumns, buffer, length, &pos);
+        if (err == SQLITE_CORRUPT) {
+            throw_sqlite3_exception_format(
+                env, nullptr, "Malformed batch arguments at row %d.", row);
+            break;
+        }
+        if (err != SQLITE_OK) {
+            throw_sqlite3_exception_format(
+                env, conn->db, "Failed to bind batch row %d.", row);
+            break;
+        }
+
+        do {
+            err = sqlite3_step(stmt);
+        } while (err == SQLITE_ROW);
+        if (err != SQLITE_DONE) {
+            throw_sqlite3_exception_format(
+                env, conn->db, "Failed to execute batch row %d.", row);
+            break;
+        }
+
+        // Rows outside a transaction commit one by one, notify each of them.
+        emitUpdateNotifications(env, conn);
+        if (env->ExceptionCheck())
+            break;
+
+        if (resultsArr) {
+            int changes = sqlite3_changes(conn->db);
+            if (returnRowIds)
+                results.push_back(
+                    changes > 0 ? sqlite3_last_insert_rowid(conn->db) : -1);
+            else
+                results.push_back(changes);
+        }
+    }
+
+    // Arguments were bound without copying, drop them before the buffer can
+    // be released or reused by Java.
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (row == numRows && pos != (size_t) length && !env->ExceptionCheck()) {
+        throw_sqlite3_exception(
+            env, "Batch arguments do not match the parameter count.");
+    }
+
+    if (resultsArr && !results.empty())
+        env->SetLongArrayRegion(resultsArr, 0, results.size(), results.data());
+    return row;
+}
+
 static int executeOneRowQuery(JNIEnv *env,
                               SQLiteConnection *connection,
                               sqlite3_stmt *statement)
@@ -1134,6 +1303,195 @@ static jlong nativeExecuteForCursorWindow(JNIEnv *env,
     return result;
 }
 
+// Column types of SQLiteColumnarResult.
+enum {
+    COLUMNAR_TYPE_LONG = 1,
+    COLUMNAR_TYPE_DOUBLE = 2,
+    COLUMNAR_TYPE_STRING = 3,
+    COLUMNAR_TYPE_BLOB = 4,
+};
+
+struct ColumnarBuffer {
+    int type;
+    std::vector<int64_t> longs;
+    std::vector<double> doubles;
+    std::vector<jbyte> bytes;
+    std::vector<jint> offsets;
+    std::vector<jbyte> nulls;
+};
+
+static bool appendColumnar(ColumnarBuffer &column,
+                           sqlite3_stmt *statement,
+                           int index,
+                           int row)
+{
+    if ((row & 7) == 0)
+        column.nulls.push_back(0);
+    bool isNull = sqlite3_column_type(statement, index) == SQLITE_NULL;
+    if (isNull)
+        column.nulls.back() |= (jbyte)(1 << (row & 7));
+
+    switch (column.type) {
+        case COLUMNAR_TYPE_LONG:
+            column.longs.push_back(sqlite3_column_int64(statement, index));
+            break;
+        case COLUMNAR_TYPE_DOUBLE:
+            column.doubles.push_back(sqlite3_column_double(statement, index));
+            break;
+        default: {
+            const void *value =
+                column.type == COLUMNAR_TYPE_STRING
+                    ? (const void *) sqlite3_column_text(statement, index)
+                    : sqlite3_column_blob(statement, index);
+            int size = value ? sqlite3_column_bytes(statement, index) : 0;
+            if (column.bytes.size() + size > INT32_MAX)
+                return false;
+            const jbyte *p = static_cast<const jbyte *>(value);
+            column.bytes.insert(column.bytes.end(), p, p + size);
+            column.offsets.push_back((jint) column.bytes.size());
+        } break;
+    }
+    return true;
+}
+
+static jobject newColumnarArray(JNIEnv *env, const ColumnarBuffer &column)
+{
+    switch (column.type) {
+        case COLUMNAR_TYPE_LONG: {
+            jlongArray arr = env->NewLongArray(column.longs.size());
+            if (arr)
+                env->SetLongArrayRegion(arr, 0, column.longs.size(),
+                                        (const jlong *) column.longs.data());
+            return arr;
+        }
+        case COLUMNAR_TYPE_DOUBLE: {
+            jdoubleArray arr = env->NewDoubleArray(column.doubles.size());
+            if (arr)
+                env->SetDoubleArrayRegion(arr, 0, column.doubles.size(),
+                                          column.doubles.data());
+            return arr;
+        }
+        default: {
+            jbyteArray arr = env->NewByteArray(column.bytes.size());
+            if (arr)
+                env->SetByteArrayRegion(arr, 0, column.bytes.size(),
+                                        column.bytes.data());
+            return arr;
+        }
+    }
+}
+
+// Execute a query and collect its columns into per-column Java arrays in one
+// pass, see SQLiteColumnarResult for the layout. Returns an Object[] holding
+// values, offsets and null bitmap of each column, or null with an exception
+// pending.
+static jobjectArray nativeExecuteForColumns(JNIEnv *env,
+                                            jclass clazz,
+                                            jlong connectionPtr,
+                                            jlong statementPtr,
+                                            jintArray typesArr,
+                                            jint maxRows)
+{
+    SQLiteConnection *conn = (SQLiteConnection *) (intptr_t) connectionPtr;
+    sqlite3_stmt *stmt = (sqlite3_stmt *) (intptr_t) statementPtr;
+
+    int numColumns = env->GetArrayLength(typesArr);
+    std::vector<ColumnarBuffer> columns(numColumns);
+    {
+        std::vector<jint> types(numColumns);
+        env->GetIntArrayRegion(typesArr, 0, numColumns, types.data());
+        for (int i = 0; i < numColumns; i++) {
+            if (types[i] < COLUMNAR_TYPE_LONG ||
+                types[i] > COLUMNAR_TYPE_BLOB) {
+                throw_sqlite3_exception_format(
+                    env, nullptr, "Unknown columnar type %d of column %d.",
+                    types[i], i);
+                return nullptr;
+            }
+            columns[i].type = types[i];
+            if (types[i] >= COLUMNAR_TYPE_STRING)
+                columns[i].offsets.push_back(0);
+        }
+    }
+
+    bool gotException = false;
+    int numRows = 0;
+    while (maxRows <= 0 || numRows < maxRows) {
+        int err = sqlite3_step(stmt);
+        if (err == SQLITE_DONE)
+            break;
+        if (err != SQLITE_ROW) {
+            throw_sqlite3_exception(env, conn->db);
+            gotException = true;
+            break;
+        }
+
+        // Checked on the first row, as for cursor windows, since the schema
+        // may have been changed by another connection until now.
+        if (numRows == 0 && sqlite3_column_count(stmt) != numColumns) {
+            throw_sqlite3_exception_format(
+                env, nullptr, "Query returns %d columns but %d types given.",
+                sqlite3_column_count(stmt), numColumns);
+            gotException = true;
+            break;
+        }
+
+        for (int i = 0; i < numColumns; i++) {
+            if (!appendColumnar(columns[i], stmt, i, numRows)) {
+                throw_sqlite3_exception_format(
+                    env, nullptr, "Column %d exceeds 2GB at row %d.", i,
+                    numRows);
+                gotException = true;
+                break;
+            }
+        }
+        if (gotException)
+            break;
+        numRows++;
+    }
+    sqlite3_reset(stmt);
+    if (gotException)
+        return nullptr;
+
+    emitUpdateNotifications(env, conn);
+
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jobjectArray result =
+        objectClass ? env->NewObjectArray(numColumns * 3, objectClass, nullptr)
+                    : nullptr;
+    if (!result)
+        return nullptr;
+
+    for (int i = 0; i < numColumns; i++) {
+        const ColumnarBuffer &column = columns[i];
+
+        jobject values = newColumnarArray(env, column);
+        if (!values)
+            return nullptr;
+        env->SetObjectArrayElement(result, i * 3, values);
+        env->DeleteLocalRef(values);
+
+        if (!column.offsets.empty()) {
+            jintArray offsets = env->NewIntArray(column.offsets.size());
+            if (!offsets)
+                return nullptr;
+            env->SetIntArrayRegion(offsets, 0, column.offsets.size(),
+                                   column.offsets.data());
+            env->SetObjectArrayElement(result, i * 3 + 1, offsets);
+            env->DeleteLocalRef(offsets);
+        }
+
+        jbyteArray nulls = env->NewByteArray(column.nulls.size());
+        if (!nulls)
+            return nullptr;
+        env->SetByteArrayRegion(nulls, 0, column.nulls.size(),
+                                column.nulls.data());
+        env->SetObjectArrayElement(result, i * 3 + 2, nulls);
+        env->DeleteLocalRef(nulls);
+    }
+    return result;
+}
+
 static jlong
 nativeGetDbLookaside(JNIEnv *env, jobject clazz, jlong connectionPtr)
 {
@@ -1233,6 +1591,170 @@ static jlong nativeSQLiteHandle(JNIEnv *env,
     }
 }
 
+// Attach a session to the main database of the connection, recording
+// changes of the given tables, or of all tables if tablesArr is null.
+static jlong nativeSessionCreate(JNIEnv *env,
+                                 jclass clazz,
+                                 jlong connectionPtr,
+                                 jobjectArray tablesArr)
+{
+    SQLiteConnection *conn = (SQLiteConnection *) (intptr_t) connectionPtr;
+
+    sqlite3_session *session = nullptr;
+    int err = sqlite3session_create(conn->db, "main", &session);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, conn->db, "Failed to create session.");
+        return 0;
+    }
+
+    jsize numTables = tablesArr ? env->GetArrayLength(tablesArr) : 0;
+    if (!tablesArr)
+        err = sqlite3session_attach(session, nullptr);
+    for (jsize i = 0; i < numTables && err == SQLITE_OK; i++) {
+        jstring tableStr = (jstring) env->GetObjectArrayElement(tablesArr, i);
+        const char *table = env->GetStringUTFChars(tableStr, nullptr);
+        err = sqlite3session_attach(session, table);
+        env->ReleaseStringUTFChars(tableStr, table);
+        env->DeleteLocalRef(tableStr);
+    }
+    if (err != SQLITE_OK) {
+        sqlite3session_delete(session);
+        throw_sqlite3_exception_errcode(env, err,
+                                        "Failed to attach table to session.");
+        return 0;
+    }
+    return (jlong) (intptr_t) session;
+}
+
+// Return the changes recorded so far as a changeset or patchset, or null if
+// nothing was recorded.
+static jbyteArray nativeSessionChangeset(JNIEnv *env,
+                                         jclass clazz,
+                                         jlong sessionPtr,
+                                         jboolean patchset)
+{
+    sqlite3_session *session = (sqlite3_session *) (intptr_t) sessionPtr;
+
+    int size = 0;
+    void *data = nullptr;
+    int err = patchset ? sqlite3session_patchset(session, &size, &data)
+                       : sqlite3session_changeset(session, &size, &data);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, "Failed to get changeset.");
+        return nullptr;
+    }
+
+    jbyteArray result = nullptr;
+    if (size > 0) {
+        result = env->NewByteArray(size);
+        if (result)
+            env->SetByteArrayRegion(result, 0, size, (const jbyte *) data);
+    }
+    sqlite3_free(data);
+    return result;
+}
+
+static void nativeSessionDelete(JNIEnv *env, jclass clazz, jlong sessionPtr)
+{
+    sqlite3session_delete((sqlite3_session *) (intptr_t) sessionPtr);
+}
+
+struct ChangesetApplyContext {
+    JNIEnv *env;
+    jobject resolverObj;
+};
+
+static int sqliteChangesetConflictCallback(void *ctx,
+                                           int conflict,
+                                           sqlite3_changeset_iter *iter)
+{
+    ChangesetApplyContext *context = (ChangesetApplyContext *) ctx;
+    if (!context->resolverObj)
+        return SQLITE_CHANGESET_ABORT;
+
+    JNIEnv *env = context->env;
+    if (env->ExceptionCheck())
+        return SQLITE_CHANGESET_ABORT;
+
+    const char *table = nullptr;
+    int numColumns, op;
+    sqlite3changeset_op(iter, &table, &numColumns, &op, nullptr);
+
+    // Must be kept in sync with SQLiteChangesetConflictResolver.java.
+    jint type;
+    switch (conflict) {
+        case SQLITE_CHANGESET_DATA:
+            type = 1;
+            break;
+        case SQLITE_CHANGESET_NOTFOUND:
+            type = 2;
+            break;
+        case SQLITE_CHANGESET_CONFLICT:
+            type = 3;
+            break;
+        case SQLITE_CHANGESET_CONSTRAINT:
+            type = 4;
+            break;
+        default:
+            type = 5;
+            break;
+    }
+
+    jstring tableStr = env->NewStringUTF(table ? table : "");
+    if (!tableStr)
+        return SQLITE_CHANGESET_ABORT;
+    jint result = env->CallIntMethod(
+        context->resolverObj,
+        gSQLiteChangesetConflictResolverClassInfo.onConflict, type, tableStr);
+    env->DeleteLocalRef(tableStr);
+    if (env->ExceptionCheck())
+        return SQLITE_CHANGESET_ABORT;
+
+    switch (result) {
+        case 0:
+            return SQLITE_CHANGESET_OMIT;
+        case 1:
+            // Replace is only allowed for data and conflict conflicts.
+            if (conflict == SQLITE_CHANGESET_DATA ||
+                conflict == SQLITE_CHANGESET_CONFLICT)
+                return SQLITE_CHANGESET_REPLACE;
+            return SQLITE_CHANGESET_ABORT;
+        default:
+            return SQLITE_CHANGESET_ABORT;
+    }
+}
+
+// Apply a changeset or patchset to the main database of the connection.
+// Conflicts are resolved by resolverObj, or abort the whole apply if it is
+// null. All changes are rolled back on failure.
+static void nativeApplyChangeset(JNIEnv *env,
+                                 jclass clazz,
+                                 jlong connectionPtr,
+                                 jbyteArray changesetArr,
+                                 jobject resolverObj)
+{
+    SQLiteConnection *conn = (SQLiteConnection *) (intptr_t) connectionPtr;
+
+    jsize size = env->GetArrayLength(changesetArr);
+    jbyte *changeset = env->GetByteArrayElements(changesetArr, nullptr);
+    if (!changeset)
+        return;
+
+    ChangesetApplyContext context = {env, resolverObj};
+    int err = sqlite3changeset_apply(conn->db, size, changeset, nullptr,
+                                     sqliteChangesetConflictCallback, &context);
+    env->ReleaseByteArrayElements(changesetArr, changeset, JNI_ABORT);
+
+    // Exception thrown by the resolver takes precedence.
+    if (env->ExceptionCheck())
+        return;
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, conn->db, "Failed to apply changeset.");
+        return;
+    }
+    emitUpdateNotifications(env, conn);
+}
+
 static void nativeSetUpdateNotification(JNIEnv *env,
                                         jclass cls,
                                         jlong connectionPtr,
@@ -1292,6 +1814,10 @@ static JNINativeMethod sMethods[] = {
      (void *) nativeExecuteForChangedRowCount},
     {"nativeExecuteForLastInsertedRowId", "(JJ)J",
      (void *) nativeExecuteForLastInsertedRowId},
+    {"nativeExecuteBatch", "(JJLjava/nio/ByteBuffer;IIZ[J)I",
+     (void *) nativeExecuteBatch},
+    {"nativeExecuteForColumns", "(JJ[II)[Ljava/lang/Object;",
+     (void *) nativeExecuteForColumns},
     {"nativeExecuteForCursorWindow", "(JJJIIZ)J",
      (void *) nativeExecuteForCursorWindow},
     {"nativeGetDbLookaside", "(J)I", (void *) nativeGetDbLookaside},
@@ -1303,6 +1829,13 @@ static JNINativeMethod sMethods[] = {
     {"nativeSQLiteHandle", "(JZ)J", (void *) nativeSQLiteHandle},
     {"nativeSetUpdateNotification", "(JZZ)V",
      (void *) nativeSetUpdateNotification},
+    {"nativeSessionCreate", "(J[Ljava/lang/String;)J",
+     (void *) nativeSessionCreate},
+    {"nativeSessionChangeset", "(JZ)[B", (void *) nativeSessionChangeset},
+    {"nativeSessionDelete", "(J)V", (void *) nativeSessionDelete},
+    {"nativeApplyChangeset",
+     "(J[BLcom/tencent/wcdb/database/SQLiteChangesetConflictResolver;)V",
+     (void *) nativeApplyChangeset},
 };
 
 static int register_wcdb_SQLiteConnection(JavaVM *vm, JNIEnv *env)
@@ -1323,6 +1856,12 @@ static int register_wcdb_SQLiteConnection(JavaVM *vm, JNIEnv *env)
     gStringClassInfo.clazz = jclass(env->NewGlobalRef(clazz));
     env->DeleteLocalRef(clazz);
 
+    FIND_CLASS(clazz,
+               "com/tencent/wcdb/database/SQLiteChangesetConflictResolver");
+    GET_METHOD_ID(gSQLiteChangesetConflictResolverClassInfo.onConflict, clazz,
+                  "onConflict", "(ILjava/lang/String;)I");
+    env->DeleteLocalRef(clazz);
+
     FIND_CLASS(clazz, "com/tencent/wcdb/database/SQLiteConnection");
     GET_METHOD_ID(gSQLiteConnectionClassInfo.notifyCheckpoint, clazz,
                   "notifyCheckpoint", "(Ljava/lang/String;I)V");
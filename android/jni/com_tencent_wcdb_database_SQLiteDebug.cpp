@@ -27,6 +27,7 @@
 #include "Logger.h"
 #include "ModuleLoader.h"
 #include "SQLiteCommon.h"
+#include <vfscksum.h>
 #include <vfslog.h>
 
 namespace wcdb {
@@ -315,6 +316,180 @@ static void nativeGetIOTraceStats(JNIEnv *env,
     sqlite3_finalize(stmt);
 }
 
+// Resolve the tables or indexes owning corrupted pages through dbstat.
+// Verification is disabled meanwhile, so that dbstat can walk through
+// the corrupted pages as far as possible.
+static void resolveCorruptedPageOwners(JNIEnv *env,
+                                       sqlite3 *db,
+                                       const char *dbName,
+                                       const VCksumStat &stats,
+                                       jobjectArray ownerArr)
+{
+    char *sql = sqlite3_mprintf(
+        "SELECT pageno, name FROM dbstat(%Q) WHERE pageno IN (", dbName);
+    for (int i = 0; sql && i < stats.nCorruptedPages; i++) {
+        sql = sqlite3_mprintf("%z%s%u", sql, i ? "," : "",
+                              stats.corruptedPages[i]);
+    }
+    if (sql)
+        sql = sqlite3_mprintf("%z);", sql);
+    if (!sql)
+        return;
+
+    vcksumSetVerify(db, dbName, VCKSUM_VERIFY_OFF);
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        // Stop on error, since b-trees after the corrupted page are unreachable.
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            uint32_t pageno = (uint32_t) sqlite3_column_int64(stmt, 0);
+            const char *name = (const char *) sqlite3_column_text(stmt, 1);
+            for (int i = 0; name && i < stats.nCorruptedPages; i++) {
+                if (stats.corruptedPages[i] != pageno)
+                    continue;
+                jstring jstr = env->NewStringUTF(name);
+                env->SetObjectArrayElement(ownerArr, i, jstr);
+                env->DeleteLocalRef(jstr);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    vcksumSetVerify(db, dbName, stats.verify);
+    sqlite3_free(sql);
+}
+
+static void nativeGetChecksumStats(JNIEnv *env,
+                                   jclass cls,
+                                   jlong connectionPtr,
+                                   jobject statsList)
+{
+    struct {
+        jfieldID dbName;
+        jfieldID path;
+        jfieldID verifiedPages;
+        jfieldID mismatchedPages;
+        jfieldID mismatchedFrames;
+        jfieldID unknownPages;
+        jfieldID corruptedPages;
+        jfieldID corruptedPageOwners;
+    } fieldsStats;
+
+    // Gather information from Java.
+    jclass clsArrayList = env->FindClass("java/util/ArrayList");
+    if (!clsArrayList)
+        return;
+    jmethodID midArrayListAdd =
+        env->GetMethodID(clsArrayList, "add", "(Ljava/lang/Object;)Z");
+    if (!midArrayListAdd)
+        return;
+    jclass clsString = env->FindClass("java/lang/String");
+    if (!clsString)
+        return;
+
+    jclass clsChecksumStats =
+        env->FindClass("com/tencent/wcdb/database/SQLiteDebug$ChecksumStats");
+    if (!clsChecksumStats)
+        return;
+    jmethodID midChecksumStatsCtor =
+        env->GetMethodID(clsChecksumStats, "<init>", "()V");
+    if (!midChecksumStatsCtor)
+        return;
+
+#define GET_FID(var, cls, name, sig)                                           \
+    do {                                                                       \
+        (var).name = env->GetFieldID((cls), #name, (sig));                     \
+        if (!(var).name)                                                       \
+            return;                                                            \
+    } while (0)
+
+    GET_FID(fieldsStats, clsChecksumStats, dbName, "Ljava/lang/String;");
+    GET_FID(fieldsStats, clsChecksumStats, path, "Ljava/lang/String;");
+    GET_FID(fieldsStats, clsChecksumStats, verifiedPages, "J");
+    GET_FID(fieldsStats, clsChecksumStats, mismatchedPages, "J");
+    GET_FID(fieldsStats, clsChecksumStats, mismatchedFrames, "J");
+    GET_FID(fieldsStats, clsChecksumStats, unknownPages, "J");
+    GET_FID(fieldsStats, clsChecksumStats, corruptedPages, "[I");
+    GET_FID(fieldsStats, clsChecksumStats, corruptedPageOwners,
+            "[Ljava/lang/String;");
+
+#undef GET_FID
+
+    // List all attached databases.
+    sqlite3 *db = (sqlite3 *) (intptr_t) connectionPtr;
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, "PRAGMA database_list;", -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        // Failed to compile PRAGMA database_list; probably caused by database corruption.
+        // Use hardcoded name and path for main database.
+        const char *path = sqlite3_db_filename(db, "main");
+        if (!path)
+            path = "";
+
+        char sql[256];
+        sqlite3_snprintf(sizeof(sql), sql,
+                         "SELECT 0 as seq, 'main' as name, %Q as file;", path);
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+        if (rc != SQLITE_OK) {
+            throw_sqlite3_exception(env, db, "Cannot get checksum stats.");
+            return;
+        }
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *dbName = (const char *) sqlite3_column_text(stmt, 1);
+        const char *dbPath = (const char *) sqlite3_column_text(stmt, 2);
+
+        // Skip databases not opened with vfscksum.
+        VCksumStat stats;
+        if (vcksumGetStats(db, dbName, &stats) != SQLITE_OK)
+            continue;
+
+        jobject statsObj =
+            env->NewObject(clsChecksumStats, midChecksumStatsCtor);
+        if (!statsObj) {
+            sqlite3_finalize(stmt);
+            return;
+        }
+
+        jstring jstr = env->NewStringUTF(dbName);
+        env->SetObjectField(statsObj, fieldsStats.dbName, jstr);
+        env->DeleteLocalRef(jstr);
+        jstr = env->NewStringUTF(dbPath);
+        env->SetObjectField(statsObj, fieldsStats.path, jstr);
+        env->DeleteLocalRef(jstr);
+        env->SetLongField(statsObj, fieldsStats.verifiedPages,
+                          stats.verifiedPages);
+        env->SetLongField(statsObj, fieldsStats.mismatchedPages,
+                          stats.mismatchedPages);
+        env->SetLongField(statsObj, fieldsStats.mismatchedFrames,
+                          stats.mismatchedFrames);
+        env->SetLongField(statsObj, fieldsStats.unknownPages,
+                          stats.unknownPages);
+
+        jintArray pageArr = env->NewIntArray(stats.nCorruptedPages);
+        jobjectArray ownerArr =
+            env->NewObjectArray(stats.nCorruptedPages, clsString, nullptr);
+        if (!pageArr || !ownerArr) {
+            sqlite3_finalize(stmt);
+            return;
+        }
+        jint pages[VCKSUM_MAX_CORRUPTED_PAGES];
+        for (int i = 0; i < stats.nCorruptedPages; i++)
+            pages[i] = (jint) stats.corruptedPages[i];
+        env->SetIntArrayRegion(pageArr, 0, stats.nCorruptedPages, pages);
+        if (stats.nCorruptedPages > 0)
+            resolveCorruptedPageOwners(env, db, dbName, stats, ownerArr);
+        env->SetObjectField(statsObj, fieldsStats.corruptedPages, pageArr);
+        env->SetObjectField(statsObj, fieldsStats.corruptedPageOwners,
+                            ownerArr);
+        env->DeleteLocalRef(pageArr);
+        env->DeleteLocalRef(ownerArr);
+
+        env->CallBooleanMethod(statsList, midArrayListAdd, statsObj);
+        env->DeleteLocalRef(statsObj);
+    }
+    sqlite3_finalize(stmt);
+}
+
 /*
      * JNI registration.
      */
@@ -327,6 +502,8 @@ static JNINativeMethod gMethods[] = {
     {"nativeSetIOTraceFlags", "(I)V", (void *) nativeSetIOTraceFlags},
     {"nativeGetIOTraceStats", "(JLjava/util/ArrayList;)V",
      (void *) nativeGetIOTraceStats},
+    {"nativeGetChecksumStats", "(JLjava/util/ArrayList;)V",
+     (void *) nativeGetChecksumStats},
 };
 
 static int register_wcdb_SQLiteDebug(JavaVM *vm, JNIEnv *env)
@@ -33,6 +33,8 @@ extern "C" {
     int sqlcipher_set_default_kdf_algorithm(int algorithm);
     void sqlcipher_set_mem_security(int);
     int sqlite3_register_vfslog(const char *);
+    int sqlite3_register_vfscksum(const char *);
+    int sqlite3_register_vfsfault(const char *);
 }
 extern volatile uint32_t vlogDefaultLogFlags;
 
@@ -136,6 +138,12 @@ static void sqliteInitialize()
     // Register vfslog VFS.
     sqlite3_register_vfslog(nullptr);
 
+    // Register vfscksum VFS.
+    sqlite3_register_vfscksum(nullptr);
+
+    // Register vfsfault VFS, which is used only when opened by name.
+    sqlite3_register_vfsfault(nullptr);
+
     // Initialize SQLite.
     sqlite3_initialize();
 
@@ -0,0 +1,174 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cross-process test of ChangeNotifier. A forked child publishes, and the
+// parent blocked in waitForChanges should wake up with the tables published.
+//
+// Usage: change_notifier_test [directory]
+
+#include "../ChangeNotifier.h"
+#include "NativeTest.h"
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace wcdb;
+
+static std::string sPath;
+
+static void collectUntil(ChangeNotifier *notifier,
+                         std::set<std::string> &tables,
+                         size_t count,
+                         int timeoutMs)
+{
+    int64_t deadline = nowMs() + timeoutMs;
+    while (tables.size() < count && nowMs() < deadline) {
+        std::vector<std::string> changed;
+        notifier->waitForChanges(changed, (int) (deadline - nowMs()));
+        tables.insert(changed.begin(), changed.end());
+    }
+}
+
+// Child opens its own mapping, as another process does.
+static pid_t forkPublisher(const std::vector<const char *> &tables,
+                           int delayMs,
+                           bool wakeUpOnly)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    if (!notifier)
+        _exit(2);
+    usleep(delayMs * 1000);
+    if (wakeUpOnly)
+        notifier->wakeUp();
+    for (const char *table : tables)
+        notifier->publish(table);
+    delete notifier;
+    _exit(0);
+}
+
+static bool waitChild(pid_t pid)
+{
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0;
+}
+
+TEST_CASE(deliverTablesOfOtherProcess)
+{
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    CHECK(notifier != nullptr);
+
+    // The waiter is blocked before the child publishes.
+    pid_t pid = forkPublisher({"message", "contact", "message"}, 200, false);
+    int64_t begin = nowMs();
+    std::set<std::string> tables;
+    collectUntil(notifier, tables, 2, 5000);
+    int64_t elapsed = nowMs() - begin;
+    CHECK(waitChild(pid));
+
+    CHECK(tables == std::set<std::string>({"message", "contact"}));
+    CHECK(elapsed < 5000);
+
+    // Nothing more is delivered for the same changes.
+    std::vector<std::string> changed;
+    notifier->waitForChanges(changed, 100);
+    CHECK(changed.empty());
+    delete notifier;
+}
+
+TEST_CASE(omitChangesOfItself)
+{
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    CHECK(notifier != nullptr);
+
+    notifier->publish("own");
+    std::vector<std::string> changed;
+    notifier->waitForChanges(changed, 100);
+    CHECK(changed.empty());
+
+    // Changes of others are still delivered after it.
+    pid_t pid = forkPublisher({"own", "other"}, 0, false);
+    CHECK(waitChild(pid));
+    std::set<std::string> tables;
+    collectUntil(notifier, tables, 2, 1000);
+    CHECK(tables == std::set<std::string>({"own", "other"}));
+    delete notifier;
+}
+
+TEST_CASE(ignoreChangesBeforeOpened)
+{
+    pid_t pid = forkPublisher({"before"}, 0, false);
+    CHECK(waitChild(pid));
+
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    CHECK(notifier != nullptr);
+    std::vector<std::string> changed;
+    notifier->waitForChanges(changed, 100);
+    CHECK(changed.empty());
+    delete notifier;
+}
+
+TEST_CASE(wakeUpWithoutChanges)
+{
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    CHECK(notifier != nullptr);
+
+    pid_t pid = forkPublisher({}, 200, true);
+    int64_t begin = nowMs();
+    std::vector<std::string> changed;
+    notifier->waitForChanges(changed, 5000);
+    int64_t elapsed = nowMs() - begin;
+    CHECK(waitChild(pid));
+
+    CHECK(changed.empty());
+    CHECK(elapsed < 5000);
+    delete notifier;
+}
+
+TEST_CASE(reinitializeCorruptedFile)
+{
+    FILE *file = fopen(sPath.c_str(), "w");
+    CHECK(file != nullptr);
+    fputs("garbage", file);
+    fclose(file);
+
+    ChangeNotifier *notifier = ChangeNotifier::open(sPath.c_str());
+    CHECK(notifier != nullptr);
+    pid_t pid = forkPublisher({"fresh"}, 0, false);
+    CHECK(waitChild(pid));
+    std::set<std::string> tables;
+    collectUntil(notifier, tables, 1, 1000);
+    CHECK(tables == std::set<std::string>({"fresh"}));
+    delete notifier;
+}
+
+int main(int argc, char **argv)
+{
+    sPath = std::string(argc > 1 ? argv[1] : ".") + "/change_notifier_test-notify";
+    unlink(sPath.c_str());
+    int failures = runTestCases();
+    unlink(sPath.c_str());
+    return failures == 0 ? 0 : 1;
+}
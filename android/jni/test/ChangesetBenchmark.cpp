@@ -0,0 +1,278 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark of syncing the updated rows of a database into its replica, by
+// applying the changeset captured by session, against querying the rows of a
+// newer version and upserting them. Each prints the size of the delta it
+// transfers and the time it takes. Session isn't compiled in the sqlcipher of
+// the iOS and macOS frameworks, so it's built on host by Makefile in this
+// directory instead.
+//
+// Usage: core_changeset_benchmark [directory] [rows] [writes]
+
+#include <WCDB/database.hpp>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace WCDB;
+
+static const char *kTable = "benchmark";
+static const int kValueLength = 100;
+
+enum class Sync {
+    Apply,
+    Upsert,
+};
+
+static std::string databasePath(const std::string &directory,
+                                const char *name)
+{
+    std::string path = directory + "/core_changeset_benchmark-" + name;
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+        unlink((path + suffix).c_str());
+        unlink((path + "-replica" + suffix).c_str());
+    }
+    return path;
+}
+
+static std::vector<unsigned char> randomValue(std::mt19937 &random)
+{
+    std::vector<unsigned char> value(kValueLength);
+    for (unsigned char &byte : value) {
+        byte = (unsigned char) random();
+    }
+    return value;
+}
+
+// Rows of version 0 are written to [keys], some of which are updated to
+// version 1 later.
+static bool writeRows(Database &database,
+                      const std::vector<int64_t> &keys,
+                      int64_t version,
+                      std::mt19937 &random,
+                      Error &error)
+{
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert(kTable,
+                    {Column("key"), Column("value"), Column("version")},
+                    Conflict::Replace)
+            .values({Expr::BindParameter, Expr::BindParameter,
+                     Expr::BindParameter});
+    return database.runTransaction(
+        [&](Error &error) -> bool {
+            RecyclableStatement statement = database.prepare(s_insert, error);
+            if (!statement) {
+                return false;
+            }
+            for (int64_t key : keys) {
+                std::vector<unsigned char> value = randomValue(random);
+                statement->reset();
+                statement->bind<ColumnType::Integer64>(key, 1);
+                statement->bind<ColumnType::BLOB>(value.data(),
+                                                  (int) value.size(), 2);
+                statement->bind<ColumnType::Integer64>(version, 3);
+                statement->step();
+                if (!statement->isOK()) {
+                    error = statement->getError();
+                    return false;
+                }
+            }
+            return true;
+        },
+        nullptr, error);
+}
+
+// Return the number of rows synced, or -1 on error
+static int64_t upsert(Database &database,
+                      Database &replica,
+                      size_t &delta,
+                      Error &error)
+{
+    RecyclableStatement select = database.prepare(
+        StatementSelect()
+            .select({ColumnResult(Column("key")), ColumnResult(Column("value")),
+                     ColumnResult(Column("version"))})
+            .from(kTable)
+            .where(Expr(Column("version")) > 0),
+        error);
+    if (!select) {
+        return -1;
+    }
+    int64_t count = 0;
+    bool result = replica.runTransaction(
+        [&](Error &error) -> bool {
+            RecyclableStatement upsert = replica.prepare(
+                StatementInsert()
+                    .insert(kTable,
+                            {Column("key"), Column("value"), Column("version")},
+                            Conflict::Replace)
+                    .values({Expr::BindParameter, Expr::BindParameter,
+                             Expr::BindParameter}),
+                error);
+            if (!upsert) {
+                return false;
+            }
+            while (select->step()) {
+                int size = 0;
+                const void *value = select->getValue<ColumnType::BLOB>(1, size);
+                upsert->reset();
+                upsert->bind<ColumnType::Integer64>(
+                    select->getValue<ColumnType::Integer64>(0), 1);
+                upsert->bind<ColumnType::BLOB>(value, size, 2);
+                upsert->bind<ColumnType::Integer64>(
+                    select->getValue<ColumnType::Integer64>(2), 3);
+                upsert->step();
+                if (!upsert->isOK()) {
+                    error = upsert->getError();
+                    return false;
+                }
+                //Key and version are counted as 8 bytes each
+                delta += size + 2 * sizeof(int64_t);
+                ++count;
+            }
+            if (!select->isOK()) {
+                error = select->getError();
+                return false;
+            }
+            return true;
+        },
+        nullptr, error);
+    return result ? count : -1;
+}
+
+static int64_t countSynced(Database &replica, Error &error)
+{
+    RecyclableStatement statement = replica.prepare(
+        StatementSelect()
+            .select({ColumnResult(Expr(Column::Any).count())})
+            .from(kTable)
+            .where(Expr(Column("version")) > 0),
+        error);
+    if (!statement || !statement->step()) {
+        return -1;
+    }
+    return statement->getValue<ColumnType::Integer64>(0);
+}
+
+static bool run(const std::string &directory, Sync sync, int rows, int writes)
+{
+    const char *name = sync == Sync::Apply ? "Changeset_Apply"
+                                           : "Changeset_Upsert";
+    std::string path = databasePath(directory, name);
+    std::string replicaPath = path + "-replica";
+    std::mt19937 random(rows);
+    Error error;
+    bool result = false;
+    size_t delta = 0;
+    double cost = 0;
+    do {
+        Database database(path);
+        //Session extension only tracks tables with primary key
+        std::list<const ColumnDef> columnDefs = {
+            ColumnDef(Column("key"), ColumnType::Integer64).makePrimary(),
+            ColumnDef(Column("value"), ColumnType::BLOB),
+            ColumnDef(Column("version"), ColumnType::Integer64),
+        };
+        std::list<const ColumnIndex> columnIndexes = {
+            ColumnIndex(Column("version"))};
+        std::vector<int64_t> keys(rows);
+        for (int i = 0; i < rows; ++i) {
+            keys[i] = i;
+        }
+        if (!database.exec(StatementCreateTable().create(kTable, columnDefs),
+                           error) ||
+            !database.exec(StatementCreateIndex()
+                               .create(std::string(kTable) + "_index")
+                               .on(kTable, columnIndexes),
+                           error) ||
+            !writeRows(database, keys, 0, random, error)) {
+            break;
+        }
+
+        //Replica starts from the same content as source
+        Database::CopyOptions options = {};
+        if (!database.copyTo(replicaPath, options, nullptr, error)) {
+            break;
+        }
+        Database replica(replicaPath);
+        if (sync == Sync::Apply &&
+            !database.setSession({kTable}, false, nullptr, error)) {
+            break;
+        }
+        std::vector<int64_t> updated(writes);
+        for (int i = 0; i < writes; ++i) {
+            updated[i] = (int64_t) i * (rows / writes);
+        }
+        if (!writeRows(database, updated, 1, random, error)) {
+            break;
+        }
+
+        std::chrono::steady_clock::time_point begin =
+            std::chrono::steady_clock::now();
+        if (sync == Sync::Apply) {
+            Changeset changeset;
+            if (!database.takeChangeset(changeset, error) ||
+                !replica.applyChangeset(changeset, nullptr, error)) {
+                break;
+            }
+            delta = changeset.size();
+        } else if (upsert(database, replica, delta, error) != writes) {
+            break;
+        }
+        cost = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - begin)
+                   .count();
+        result = countSynced(replica, error) == writes;
+        database.removeSession();
+        database.close(nullptr);
+        replica.close(nullptr);
+    } while (false);
+
+    if (result) {
+        printf("%s: %d rows synced, delta %zu bytes, %.3f ms\n", name, writes,
+               delta, cost);
+    } else {
+        printf("%s: failed, %s\n", name, error.description().c_str());
+    }
+    fflush(stdout);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    std::string directory = argc > 1 ? argv[1] : ".";
+    int rows = argc > 2 ? atoi(argv[2]) : 100000;
+    int writes = argc > 3 ? atoi(argv[3]) : 1000;
+    if (rows <= 0 || writes <= 0 || writes > rows) {
+        fprintf(stderr, "Writes should be in (0, rows]\n");
+        return 1;
+    }
+    bool result = run(directory, Sync::Apply, rows, writes) &&
+                  run(directory, Sync::Upsert, rows, writes);
+    // Threads of WCDB are detached and still waiting, whose statics can't be
+    // destroyed safely.
+    _exit(result ? 0 : 1);
+}
@@ -0,0 +1,335 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the targeted repair of the core. B-trees are damaged by
+// overwriting their pages in file, and only the damaged ones should be
+// rebuilt. Standby is promoted after a refresh interrupted. It's built on
+// host by Makefile in this directory.
+//
+// Usage: core_repair_test [directory]
+
+#include "NativeTest.h"
+#include <WCDB/database.hpp>
+#include <chrono>
+#include <sqlcipher/sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+using namespace WCDB;
+
+static std::string sDirectory;
+
+static const int kPageSize = 4096;
+static const int kRows = 2000;
+
+static std::string databasePath(const char *name)
+{
+    std::string path = sDirectory + "/core_repair_test-" + name;
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+        unlink((path + suffix).c_str());
+    }
+    return path;
+}
+
+// Returns the first column of the first row, or -1 on error.
+static int64_t queryInteger(const std::string &path, const std::string &sql)
+{
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+    int64_t result = -1;
+    if (sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        result = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return result;
+}
+
+// Pages of the unlinked b-trees are leaked until VACUUM, which are told by
+// integrity check as never used.
+static bool isIntact(const std::string &path)
+{
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+    bool result = false;
+    if (sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt,
+                           nullptr) == SQLITE_OK) {
+        result = true;
+        while (result && sqlite3_step(stmt) == SQLITE_ROW) {
+            // Messages may be joined by newlines
+            std::string messages = (const char *) sqlite3_column_text(stmt, 0);
+            size_t begin = 0;
+            while (result && begin < messages.size()) {
+                size_t end = messages.find('\n', begin);
+                end = end == std::string::npos ? messages.size() : end;
+                std::string message = messages.substr(begin, end - begin);
+                begin = end + 1;
+                result = message == "ok" ||
+                         message == "*** in database main ***" ||
+                         (message.compare(0, 5, "Page ") == 0 &&
+                          message.find(" is never used") != std::string::npos);
+            }
+        }
+        result = sqlite3_finalize(stmt) == SQLITE_OK && result;
+        stmt = nullptr;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return result;
+}
+
+static int64_t rootPageOf(const std::string &path, const char *name)
+{
+    return queryInteger(path, std::string("SELECT rootpage FROM sqlite_master "
+                                          "WHERE name = '") +
+                                  name + "'");
+}
+
+// Tables [a] and [b], with an index each, span many pages.
+static bool createDatabase(const std::string &path)
+{
+    static const char *s_sql =
+        "PRAGMA page_size = 4096;"
+        "CREATE TABLE a(id INTEGER PRIMARY KEY, value TEXT);"
+        "CREATE INDEX a_value ON a(value);"
+        "CREATE TABLE b(id INTEGER PRIMARY KEY, value TEXT);"
+        "CREATE INDEX b_value ON b(value);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+        "WHERE i < 2000) "
+        "INSERT INTO a SELECT i, printf('%0200d', i) FROM n;"
+        "INSERT INTO b SELECT * FROM a;";
+    sqlite3 *db = nullptr;
+    bool result = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                  sqlite3_exec(db, s_sql, nullptr, nullptr, nullptr) ==
+                      SQLITE_OK;
+    sqlite3_close(db);
+    return result;
+}
+
+static bool damagePage(const std::string &path, int64_t page)
+{
+    FILE *file = fopen(path.c_str(), "r+b");
+    if (!file) {
+        return false;
+    }
+    char garbage[kPageSize];
+    memset(garbage, 0x5a, sizeof(garbage));
+    bool result = fseek(file, (long) (page - 1) * kPageSize, SEEK_SET) == 0 &&
+                  fwrite(garbage, 1, sizeof(garbage), file) == sizeof(garbage);
+    fclose(file);
+    return result;
+}
+
+TEST_CASE(repairRebuildsDamagedIndexOnly)
+{
+    std::string path = databasePath("index");
+    CHECK(createDatabase(path));
+    int64_t rootOfA = rootPageOf(path, "a");
+    int64_t rootOfB = rootPageOf(path, "b");
+    int64_t rootOfBValue = rootPageOf(path, "b_value");
+    CHECK(damagePage(path, rootPageOf(path, "a_value")));
+    CHECK(!isIntact(path));
+
+    {
+        Database database(path);
+        Database::RepairReport report;
+        Error error;
+        CHECK(database.repairDamaged(nullptr, 0, kPageSize, report, error));
+        CHECK(report.damagedTables.empty());
+        CHECK(report.damagedIndexes == std::list<std::string>{"a_value"});
+        CHECK(report.leaked);
+        database.close(nullptr);
+    }
+
+    CHECK(isIntact(path));
+    CHECK(queryInteger(path, "SELECT count(*) FROM a INDEXED BY a_value "
+                             "WHERE value > ''") == kRows);
+    CHECK(queryInteger(path, "SELECT count(*) FROM b") == kRows);
+    // Others are left untouched
+    CHECK(rootPageOf(path, "a") == rootOfA);
+    CHECK(rootPageOf(path, "b") == rootOfB);
+    CHECK(rootPageOf(path, "b_value") == rootOfBValue);
+}
+
+TEST_CASE(repairRestoresDamagedTableOnly)
+{
+    std::string path = databasePath("table");
+    CHECK(createDatabase(path));
+    int64_t rootOfB = rootPageOf(path, "b");
+    int64_t rootOfBValue = rootPageOf(path, "b_value");
+    int64_t leaf = queryInteger(path, "SELECT pageno FROM dbstat "
+                                      "WHERE name = 'a' AND pagetype = 'leaf' "
+                                      "ORDER BY pageno LIMIT 1 OFFSET 10");
+    CHECK(leaf > 0);
+    CHECK(damagePage(path, leaf));
+    CHECK(!isIntact(path));
+
+    Database::RepairReport report;
+    {
+        Database database(path);
+        Error error;
+        CHECK(database.repairDamaged(nullptr, 0, kPageSize, report, error));
+        CHECK(report.damagedTables == std::list<std::string>{"a"});
+        CHECK(report.damagedIndexes.empty());
+        CHECK(report.damagedPages > 0);
+        database.close(nullptr);
+    }
+
+    CHECK(isIntact(path));
+    // Rows out of the damaged page are salvaged, with the index recreated
+    int64_t rows = queryInteger(path, "SELECT count(*) FROM a");
+    CHECK(rows > 0 && rows < kRows);
+    CHECK(report.salvagedRows["a"] == rows);
+    CHECK(queryInteger(path, "SELECT count(*) FROM a INDEXED BY a_value "
+                             "WHERE value > ''") == rows);
+    CHECK(queryInteger(path, "SELECT count(*) FROM b") == kRows);
+    CHECK(rootPageOf(path, "b") == rootOfB);
+    CHECK(rootPageOf(path, "b_value") == rootOfBValue);
+}
+
+static bool copyFile(const std::string &from, const std::string &to)
+{
+    FILE *source = fopen(from.c_str(), "rb");
+    FILE *destination = source ? fopen(to.c_str(), "wb") : nullptr;
+    bool result = destination != nullptr;
+    char buffer[kPageSize];
+    size_t read = 0;
+    while (result && (read = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+        result = fwrite(buffer, 1, read, destination) == read;
+    }
+    result = result && ferror(source) == 0;
+    if (destination) {
+        result = fclose(destination) == 0 && result;
+    }
+    if (source) {
+        fclose(source);
+    }
+    return result;
+}
+
+TEST_CASE(promoteStandbyRollsBackHotJournal)
+{
+    std::string path = databasePath("standby");
+    std::string standbyPath = path + "-standby";
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+        unlink((standbyPath + suffix).c_str());
+    }
+    CHECK(createDatabase(path));
+    Database database(path);
+    database.setStandby(nullptr, 0, kPageSize, std::chrono::seconds(3600));
+    Error error;
+    CHECK(database.refreshStandby(error));
+
+    // An interrupted refresh is simulated by the files captured in the middle
+    // of a transaction, whose pages are spilled to the standby.
+    std::string scratchPath = path + "-scratch";
+    CHECK(copyFile(standbyPath, scratchPath));
+    sqlite3 *db = nullptr;
+    CHECK(sqlite3_open(scratchPath.c_str(), &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db,
+                       "PRAGMA journal_mode = DELETE;"
+                       "PRAGMA cache_size = 2;"
+                       "BEGIN IMMEDIATE;"
+                       "DELETE FROM b;",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    CHECK(copyFile(scratchPath, standbyPath));
+    CHECK(copyFile(scratchPath + "-journal", standbyPath + "-journal"));
+    sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+    unlink(scratchPath.c_str());
+
+    database.close(nullptr);
+    database.blockade();
+    CHECK(database.promoteStandby(error));
+    database.unblockade();
+    database.removeStandby();
+    database.close(nullptr);
+
+    CHECK(isIntact(path));
+    CHECK(queryInteger(path, "SELECT count(*) FROM b") == kRows);
+    CHECK(access((standbyPath + "-journal").c_str(), F_OK) != 0);
+}
+
+TEST_CASE(refreshStandbyByChangedPages)
+{
+    std::string path = databasePath("incremental");
+    std::string standbyPath = path + "-standby";
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+        unlink((standbyPath + suffix).c_str());
+    }
+    CHECK(createDatabase(path));
+    Database database(path);
+    database.setStandby(nullptr, 0, kPageSize, std::chrono::seconds(3600));
+    Error error;
+    CHECK(database.refreshStandby(error));
+    // Salt of WAL is unknown until the first commit, which is copied fully
+    CHECK(database.exec(StatementDelete().deleteFrom("b").where(
+                            Expr(Column("id")) > kRows * 3 / 4),
+                        error));
+    CHECK(database.refreshStandby(error));
+    CHECK(database.getStandbyStatistics().incrementalRefreshes == 0);
+
+    // Pages are both rewritten and appended
+    CHECK(database.exec(StatementDelete().deleteFrom("b").where(
+                            Expr(Column("id")) > kRows / 2),
+                        error));
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert("a", {Column("id"), Column("value")})
+            .values({Expr::BindParameter, Expr::BindParameter});
+    RecyclableStatement statement = database.prepare(s_insert, error);
+    CHECK(statement);
+    for (int id = kRows + 1; id <= kRows * 2; ++id) {
+        std::string value(200, 'x');
+        statement->reset();
+        statement->bind<ColumnType::Integer32>(id, 1);
+        statement->bind<ColumnType::Text>(value.c_str(), 2);
+        statement->step();
+        CHECK(statement->isOK());
+    }
+    statement = nullptr;
+    CHECK(database.refreshStandby(error));
+    CHECK(database.getStandbyStatistics().incrementalRefreshes == 1);
+    database.removeStandby();
+    database.close(nullptr);
+
+    CHECK(isIntact(standbyPath));
+    CHECK(queryInteger(standbyPath, "SELECT count(*) FROM a") == kRows * 2);
+    CHECK(queryInteger(standbyPath, "SELECT count(*) FROM b") == kRows / 2);
+}
+
+int main(int argc, char **argv)
+{
+    sDirectory = argc > 1 ? argv[1] : ".";
+    // Failures are printed by the cases, with the expected corruption errors
+    // left out.
+    Error::SetReportMethod([](const Error &) {});
+    int failures = wcdb::runTestCases();
+    fflush(stdout);
+    // Threads of WCDB are detached and still waiting, whose statics can't be
+    // destroyed safely.
+    _exit(failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,1114 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Multi-threaded stress test of the core. Threads run randomized mixes of
+// reads, writes, transactions, blockade/close, config changes and cipher
+// setup. The operations of each thread are derived from the seed, so a failed
+// run can be repeated, though the interleaving of threads can't.
+// It's built on host by Makefile in this directory, also with ThreadSanitizer.
+//
+// Usage: core_stress_test [directory] [seed]
+
+#include "NativeTest.h"
+#include <WCDB/concurrent_list.hpp>
+#include <WCDB/database.hpp>
+#include <WCDB/rwlock.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/thread_local.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <sqlcipher/sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <set>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace WCDB;
+
+static std::string sDirectory;
+static unsigned int sSeed;
+
+// A case running longer is taken as deadlocked.
+static const int kDeadlockSeconds = 120;
+static const int kThreads = 8;
+
+static void onDeadlock(int)
+{
+    static const char message[] = "Deadlock suspected, see the stuck threads\n";
+    write(STDOUT_FILENO, message, sizeof(message) - 1);
+    _exit(2);
+}
+
+static std::mt19937 randomOf(int thread)
+{
+    return std::mt19937(sSeed * 1000003u + (unsigned int) thread);
+}
+
+template <typename Worker>
+static void runThreads(int count, const Worker &worker)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+static std::string databasePath(const char *name)
+{
+    std::string path = sDirectory + "/core_stress_test-" + name;
+    for (const char *suffix : {"", "-wal", "-shm", "-journal"}) {
+        unlink((path + suffix).c_str());
+    }
+    return path;
+}
+
+TEST_CASE(concurrentListKeepsElements)
+{
+    ConcurrentList<int> list(16);
+    std::vector<std::vector<int>> pushed(kThreads), popped(kThreads);
+    runThreads(kThreads, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        for (int i = 0; i < 20000; ++i) {
+            if (random() % 2 == 0) {
+                int value = (thread << 20) | i;
+                bool front = random() % 2 == 0;
+                if (front ? list.pushFront(std::make_shared<int>(value))
+                          : list.pushBack(std::make_shared<int>(value))) {
+                    pushed[thread].push_back(value);
+                }
+            } else {
+                std::shared_ptr<int> value =
+                    random() % 2 == 0 ? list.popFront() : list.popBack();
+                if (value) {
+                    popped[thread].push_back(*value);
+                }
+            }
+        }
+    });
+    CHECK(list.size() <= list.getCapacityCap());
+
+    std::vector<int> allPushed, allPopped;
+    for (int i = 0; i < kThreads; ++i) {
+        allPushed.insert(allPushed.end(), pushed[i].begin(), pushed[i].end());
+        allPopped.insert(allPopped.end(), popped[i].begin(), popped[i].end());
+    }
+    while (std::shared_ptr<int> value = list.popFront()) {
+        allPopped.push_back(*value);
+    }
+    CHECK(list.isEmpty());
+    // Each element pushed is popped exactly once.
+    std::sort(allPushed.begin(), allPushed.end());
+    std::sort(allPopped.begin(), allPopped.end());
+    CHECK(allPushed == allPopped);
+}
+
+TEST_CASE(rwlockExcludesWriters)
+{
+    RWLock lock;
+    std::atomic<int> readers(0), writers(0), violations(0);
+    // Written under write lock and read under read lock only
+    int64_t guarded = 0;
+    std::vector<int64_t> writes(kThreads, 0);
+    runThreads(kThreads, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        for (int i = 0; i < 5000; ++i) {
+            int op = random() % 8;
+            if (op < 2) {
+                if (op == 0) {
+                    lock.lockWrite();
+                } else if (!lock.tryLockWrite()) {
+                    continue;
+                }
+                if (++writers != 1 || readers != 0 || !lock.isWriting()) {
+                    ++violations;
+                }
+                ++guarded;
+                ++writes[thread];
+                --writers;
+                lock.unlockWrite();
+            } else {
+                if (op < 6) {
+                    lock.lockRead();
+                } else if (!lock.tryLockRead()) {
+                    continue;
+                }
+                ++readers;
+                if (writers != 0 || guarded < 0) {
+                    ++violations;
+                }
+                --readers;
+                lock.unlockRead();
+            }
+        }
+    });
+    CHECK(violations == 0);
+    int64_t total = 0;
+    for (int64_t count : writes) {
+        total += count;
+    }
+    CHECK(guarded == total);
+    CHECK(!lock.isWriting() && !lock.isReading());
+}
+
+TEST_CASE(threadLocalIsIsolated)
+{
+    ThreadLocal<int> local(-1);
+    std::atomic<int> violations(0);
+    runThreads(kThreads, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        if (*local.get() != -1) {
+            ++violations;
+        }
+        for (int i = 0; i < 10000; ++i) {
+            *local.get() = thread * 100000 + i;
+            if (random() % 64 == 0) {
+                std::this_thread::yield();
+            }
+            if (*local.get() != thread * 100000 + i) {
+                ++violations;
+            }
+        }
+    });
+    CHECK(violations == 0);
+    // Values of other threads are never seen.
+    CHECK(*local.get() == -1);
+}
+
+TEST_CASE(timedQueueExpiresEachKey)
+{
+    static const int kKeys = 64;
+    TimedQueue<int> queue(0);
+    std::atomic<bool> producing(true);
+    std::set<int> queued, expired;
+    std::mutex queuedMutex;
+    std::thread consumer([&]() {
+        while (producing) {
+            queue.waitUntilExpired(
+                [&expired](const int &key) { expired.insert(key); }, false);
+            std::this_thread::yield();
+        }
+    });
+    runThreads(kThreads - 1, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        for (int i = 0; i < 5000; ++i) {
+            int key = random() % kKeys;
+            queue.reQueue(key);
+            std::lock_guard<std::mutex> lockGuard(queuedMutex);
+            queued.insert(key);
+        }
+    });
+    producing = false;
+    consumer.join();
+    // Drain the keys left by the last round, one for each call
+    bool drained = false;
+    while (!drained) {
+        drained = true;
+        queue.waitUntilExpired(
+            [&expired, &drained](const int &key) {
+                expired.insert(key);
+                drained = false;
+            },
+            false);
+    }
+    CHECK(expired == queued);
+}
+
+TEST_CASE(schedulerBoundsHoldBackOfHighWorks)
+{
+    Scheduler *scheduler = Scheduler::shared();
+    scheduler->setLatencyThreshold(std::chrono::microseconds(1),
+                                   std::chrono::milliseconds(100));
+    // The foreground keeps being slow since now
+    scheduler->observeForeground(std::chrono::milliseconds(1));
+    std::atomic<bool> done(false);
+    std::thread foreground([&]() {
+        while (!done) {
+            scheduler->observeForeground(std::chrono::milliseconds(1));
+            usleep(10000);
+        }
+    });
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    scheduler->run(Scheduler::Priority::High, [&]() {
+        for (int i = 0; i < 10; ++i) {
+            scheduler->consume(1);
+        }
+    });
+    std::chrono::steady_clock::duration cost =
+        std::chrono::steady_clock::now() - begin;
+    done = true;
+    foreground.join();
+    scheduler->setLatencyThreshold(std::chrono::microseconds(0),
+                                   std::chrono::milliseconds(100));
+    // It's held back for a while in total, rather than for each charge
+    CHECK(cost >= std::chrono::milliseconds(900));
+    CHECK(cost < std::chrono::seconds(3));
+}
+
+// Before the basic config, whose pragmas may meet the locks of other handles
+static void setBusyTimeout(Database &database)
+{
+    database.setConfig(
+        "stressBusyTimeout",
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            if (!handle->exec(
+                    StatementPragma().pragma(Pragma::BusyTimeout, 10000))) {
+                error = handle->getError();
+                return false;
+            }
+            error.reset();
+            return true;
+        },
+        (Configs::Order) Database::ConfigOrder::Trace);
+}
+
+static bool createRows(Database &database)
+{
+    Error error;
+    std::list<const ColumnDef> columnDefs = {
+        ColumnDef(Column("thread"), ColumnType::Integer64),
+        ColumnDef(Column("seq"), ColumnType::Integer64),
+        ColumnDef(Column("value"), ColumnType::BLOB),
+    };
+    std::list<const TableConstraint> constraints = {
+        TableConstraint().makePrimary(
+            std::list<const ColumnIndex>{ColumnIndex(Column("thread")),
+                                         ColumnIndex(Column("seq"))}),
+    };
+    return database.exec(
+        StatementCreateTable().create("rows", columnDefs, constraints), error);
+}
+
+static bool insertRows(Database &database,
+                       int thread,
+                       int64_t firstSeq,
+                       int count,
+                       std::mt19937 &random,
+                       Error &error)
+{
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert("rows", {Column("thread"), Column("seq"), Column("value")})
+            .values({Expr::BindParameter, Expr::BindParameter,
+                     Expr::BindParameter});
+    RecyclableStatement statement = database.prepare(s_insert, error);
+    if (!statement) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        // Values are large enough to grow WAL over the checkpoint threshold
+        std::vector<unsigned char> value(512 + random() % 4096,
+                                         (unsigned char) random());
+        statement->reset();
+        statement->bind<ColumnType::Integer64>(thread, 1);
+        statement->bind<ColumnType::Integer64>(firstSeq + i, 2);
+        statement->bind<ColumnType::BLOB>(value.data(), (int) value.size(), 3);
+        statement->step();
+        if (!statement->isOK()) {
+            error = statement->getError();
+            return false;
+        }
+    }
+    return true;
+}
+
+static int64_t countRows(Database &database, int thread, Error &error)
+{
+    StatementSelect select =
+        StatementSelect().select({ColumnResult(Expr(Column::Any).count())}).from(
+            "rows");
+    if (thread >= 0) {
+        select.where(Expr(Column("thread")) == thread);
+    }
+    RecyclableStatement statement = database.prepare(select, error);
+    if (!statement || !statement->step()) {
+        if (statement) {
+            error = statement->getError();
+        }
+        return -1;
+    }
+    return statement->getValue<ColumnType::Integer64>(0);
+}
+
+static bool checkIntegrity(Database &database)
+{
+    Error error;
+    RecyclableStatement statement = database.prepare(
+        StatementPragma().pragma(Pragma::IntegrityCheck), error);
+    return statement && statement->step() &&
+           statement->getValue<ColumnType::Text>(0) == std::string("ok");
+}
+
+// Rows written by a worker, whose sequences continue across runs.
+struct Progress {
+    int64_t nextSeq = 0;
+    int64_t committed = 0;
+};
+
+// Returns the number of failed operations, with the first error printed.
+static int runWorker(Database &database,
+                     int thread,
+                     int operations,
+                     std::mt19937 &random,
+                     Progress &progress,
+                     std::atomic<bool> &reported)
+{
+    int failures = 0;
+    for (int i = 0; i < operations; ++i) {
+        Error error;
+        bool result = true;
+        int op = random() % 20;
+        if (op < 7) {
+            result = insertRows(database, thread, progress.nextSeq, 1, random,
+                                error);
+            ++progress.nextSeq;
+            progress.committed += result ? 1 : 0;
+        } else if (op < 11) {
+            int count = 1 + random() % 8;
+            bool rollback = random() % 4 == 0;
+            int64_t firstSeq = progress.nextSeq;
+            progress.nextSeq += count;
+            bool inserted = false;
+            result = database.runTransaction(
+                [&](Error &error) -> bool {
+                    inserted = insertRows(database, thread, firstSeq, count,
+                                          random, error);
+                    return inserted && !rollback;
+                },
+                nullptr, error);
+            if (result) {
+                progress.committed += count;
+            } else if (rollback && inserted) {
+                // Rolled back on purpose
+                result = true;
+            }
+        } else if (op < 16) {
+            // Own rows are written by this thread only, so all of them,
+            // and none more, should be seen
+            int64_t count = countRows(database, thread, error);
+            result = count == progress.committed;
+            if (count >= 0 && !result) {
+                printf("Thread %d sees %lld rows of %lld committed\n", thread,
+                       (long long) count, (long long) progress.committed);
+            }
+        } else if (op < 18) {
+            result = countRows(database, -1, error) >= progress.committed;
+        } else {
+            // Handles pick the new config up when flowed out next time
+            int cacheSize = -(int) (64 + random() % 2048);
+            database.setConfig(
+                "stressCacheSize",
+                [cacheSize](std::shared_ptr<Handle> &handle,
+                            Error &error) -> bool {
+                    if (!handle->exec(StatementPragma().pragma(
+                            Pragma::CacheSize, cacheSize))) {
+                        error = handle->getError();
+                        return false;
+                    }
+                    error.reset();
+                    return true;
+                });
+        }
+        if (!result) {
+            ++failures;
+            if (!reported.exchange(true)) {
+                printf("Thread %d fails at operation %d: %s\n", thread, i,
+                       error.description().c_str());
+            }
+        }
+    }
+    return failures;
+}
+
+// Blockades, closes and purges the database until [running] is cleared.
+static void runChaos(Database &database,
+                     int thread,
+                     std::atomic<bool> &running)
+{
+    std::mt19937 random = randomOf(thread);
+    while (running) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(5 + random() % 20));
+        switch (random() % 3) {
+            case 0:
+                database.blockade();
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(random() % 5));
+                database.unblockade();
+                break;
+            case 1:
+                database.close(nullptr);
+                break;
+            default:
+                database.purgeFreeHandles();
+                break;
+        }
+    }
+}
+
+TEST_CASE(databaseKeepsWritesUnderChaos)
+{
+    Database database(databasePath("chaos"));
+    setBusyTimeout(database);
+    CHECK(createRows(database));
+
+    static const int kWorkers = kThreads - 1;
+    std::vector<Progress> progresses(kWorkers);
+    std::atomic<int> failures(0);
+    std::atomic<bool> running(true), reported(false);
+    std::thread chaos(runChaos, std::ref(database), kWorkers,
+                      std::ref(running));
+    runThreads(kWorkers, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        failures += runWorker(database, thread, 1500, random,
+                              progresses[thread], reported);
+    });
+    running = false;
+    chaos.join();
+    CHECK(failures == 0);
+
+    // No lost or phantom writes
+    for (int thread = 0; thread < kWorkers; ++thread) {
+        Error error;
+        CHECK(countRows(database, thread, error) ==
+              progresses[thread].committed);
+    }
+    CHECK(checkIntegrity(database));
+
+    // No handle is leaked by the ones flowed back
+    HandlePool::Statistics statistics = database.getHandleStatistics();
+    CHECK(statistics.aliveHandles == statistics.freeHandles);
+    database.close(nullptr);
+    CHECK(database.getHandleStatistics().aliveHandles == 0);
+    CHECK(!database.isOpened());
+}
+
+TEST_CASE(cipherSetupConcurrently)
+{
+    static const char kKey[] = "stress";
+    std::string path = databasePath("cipher");
+    {
+        Database database(path);
+        database.setCipher(kKey, sizeof(kKey));
+        setBusyTimeout(database);
+        CHECK(createRows(database));
+        database.close(nullptr);
+    }
+
+    // Each thread sets cipher up on its own database of the same path, while
+    // the others are generating handles.
+    std::vector<Progress> progresses(kThreads);
+    std::atomic<int> failures(0);
+    std::atomic<bool> reported(false);
+    runThreads(kThreads, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        for (int round = 0; round < 10; ++round) {
+            Database database(path);
+            database.setCipher(kKey, sizeof(kKey));
+            setBusyTimeout(database);
+            failures += runWorker(database, thread, 20, random,
+                                  progresses[thread], reported);
+            if (random() % 4 == 0) {
+                database.close(nullptr);
+            }
+        }
+    });
+    CHECK(failures == 0);
+
+    {
+        Database database(path);
+        database.setCipher(kKey, sizeof(kKey));
+        for (int thread = 0; thread < kThreads; ++thread) {
+            Error error;
+            CHECK(countRows(database, thread, error) ==
+                  progresses[thread].committed);
+        }
+        CHECK(checkIntegrity(database));
+        database.close(nullptr);
+    }
+
+    // It's encrypted indeed. A database of the path may still be alive in
+    // the background, so the header of file is checked instead of reading it
+    // without the key.
+    static const char kPlainHeader[] = "SQLite format 3";
+    char header[sizeof(kPlainHeader)] = {0};
+    FILE *file = fopen(path.c_str(), "rb");
+    CHECK(file != nullptr);
+    size_t read = fread(header, 1, sizeof(header), file);
+    fclose(file);
+    CHECK(read == sizeof(header));
+    CHECK(memcmp(header, kPlainHeader, sizeof(kPlainHeader)) != 0);
+}
+
+static bool waitForExistenceFilter(Database &database, uint64_t builds)
+{
+    for (int i = 0; i < 1000; ++i) {
+        // Lookups of a stale or unbuilt filter schedule its build
+        database.mayExist("keys", "key", (int64_t) -1);
+        if (database.getExistenceFilterStatistics("keys", "key").builds >=
+            builds) {
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+// Definite misses of keys never written, which are mostly told by the filter
+static int countDefiniteMisses(Database &database)
+{
+    int misses = 0;
+    for (int64_t key = 0; key < 100; ++key) {
+        misses += database.mayExist("keys", "key", -2 - key) ? 0 : 1;
+    }
+    return misses;
+}
+
+TEST_CASE(existenceFilterSeesWritesOfOthers)
+{
+    std::string path = databasePath("existence");
+    Database database(path);
+    setBusyTimeout(database);
+    Error error;
+    CHECK(database.exec(StatementCreateTable().create(
+                            "keys", std::list<const ColumnDef>{ColumnDef(
+                                        Column("key"), ColumnType::Integer64)}),
+                        error));
+    database.setExistenceFilter("keys", "key", 10000, 0.01);
+    CHECK(waitForExistenceFilter(database, 1));
+    CHECK(countDefiniteMisses(database) > 50);
+
+    // Keys are written by this process and by a connection without the TEMP
+    // triggers, as other processes do. Either one must be found once it's
+    // committed.
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert("keys", {Column("key")})
+            .values({Expr::BindParameter});
+    std::atomic<int64_t> foreignKey(0);
+    std::atomic<bool> done(false);
+    std::atomic<int> failures(0);
+    runThreads(4, [&](int thread) {
+        std::mt19937 random = randomOf(thread);
+        if (thread == 0) {
+            sqlite3 *db = nullptr;
+            bool opened = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                          sqlite3_busy_timeout(db, 10000) == SQLITE_OK;
+            for (int64_t key = 1; opened && key <= 200; ++key) {
+                std::string sql = "INSERT INTO keys VALUES(" +
+                                  std::to_string(key * 1000) + ")";
+                if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr,
+                                 nullptr) != SQLITE_OK) {
+                    ++failures;
+                    break;
+                }
+                foreignKey = key * 1000;
+                usleep(random() % 2000);
+            }
+            failures += opened ? 0 : 1;
+            sqlite3_close(db);
+            done = true;
+        } else if (thread == 1) {
+            for (int64_t key = 1; !done; ++key) {
+                Error error;
+                RecyclableStatement statement =
+                    database.prepare(s_insert, error);
+                if (!statement) {
+                    ++failures;
+                    break;
+                }
+                statement->bind<ColumnType::Integer64>(key * 1000 + 1, 1);
+                statement->step();
+                if (!statement->isOK() ||
+                    !database.mayExist("keys", "key", key * 1000 + 1)) {
+                    ++failures;
+                }
+                usleep(random() % 2000);
+            }
+        } else {
+            while (!done) {
+                int64_t key = foreignKey;
+                if (key > 0 && !database.mayExist("keys", "key", key)) {
+                    ++failures;
+                }
+            }
+        }
+    });
+    CHECK(failures == 0);
+    CHECK(database.mayExist("keys", "key", (int64_t) 200 * 1000));
+
+    // It's rebuilt by the lookups to tell the misses again
+    bool rebuilt = false;
+    for (int i = 0; i < 1000 && !rebuilt; ++i) {
+        rebuilt = countDefiniteMisses(database) > 50;
+        usleep(10000);
+    }
+    CHECK(rebuilt);
+    database.close(nullptr);
+}
+
+TEST_CASE(ftsMergeRunsUntilForegroundCommits)
+{
+    std::string path = databasePath("fts");
+    Database database(path);
+    setBusyTimeout(database);
+    Error error;
+    CHECK(database.exec(StatementCreateVirtualTable()
+                            .create("docs")
+                            .usingModule("fts4", std::list<const ModuleArgument>{
+                                                     ColumnDef(Column("body"), ColumnType::Text)}),
+                        error));
+    FTSMerger::Config config;
+    config.pagesPerStep = 1;
+    config.minSegments = 2;
+    config.pageBudget = 64;
+    CHECK(database.setFTSMerge("docs", config, error));
+
+    // Each commit leaves a segment of level 0
+    std::mt19937 random = randomOf(0);
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert("docs", {Column("body")})
+            .values({Expr::BindParameter});
+    for (int i = 0; i < 200; ++i) {
+        RecyclableStatement statement = database.prepare(s_insert, error);
+        CHECK(statement);
+        std::string body;
+        for (int word = 0; word < 20; ++word) {
+            body += "w" + std::to_string(random() % 1000) + " ";
+        }
+        statement->bind<ColumnType::Text>(body.c_str(), 1);
+        statement->step();
+        CHECK(statement->isOK());
+    }
+
+    // Commits of merging itself don't stop the run after its first step
+    FTSMerger::Statistics statistics;
+    for (int i = 0; i < 1000; ++i) {
+        statistics = database.getFTSMergeStatistics("docs");
+        if (statistics.runs > 0) {
+            break;
+        }
+        usleep(10000);
+    }
+    CHECK(statistics.runs > 0);
+    CHECK(statistics.steps > statistics.runs);
+    database.removeFTSMerge("docs");
+    database.close(nullptr);
+}
+
+TEST_CASE(writeBufferIsReadAsWritten)
+{
+    std::string path = databasePath("writeBuffer");
+    unlink((path + "-wbuf-rows").c_str());
+    Database database(path);
+    setBusyTimeout(database);
+    CHECK(createRows(database));
+    Error error;
+    WriteBuffer::Config config;
+    config.maxRows = 1000000;
+    config.maxBytes = 1 << 30;
+    config.window = std::chrono::seconds(3600);
+    config.logged = true;
+    CHECK(database.setWriteBuffer("rows", {"thread", "seq", "value"}, config,
+                                  error));
+    for (int64_t seq = 0; seq < 10; ++seq) {
+        CHECK(database.bufferInsert("rows", {(int64_t) 0, seq, "value"},
+                                    error));
+    }
+    // Pending rows are flushed by the read
+    CHECK(countRows(database, -1, error) == 10);
+
+    CHECK(database.bufferInsert("rows", {(int64_t) 0, (int64_t) 10, "value"},
+                                error));
+    // Inside a transaction, the read fails rather than misses the row
+    CHECK(database.begin(StatementTransaction::Mode::Immediate, error));
+    CHECK(countRows(database, -1, error) == -1);
+    CHECK(database.rollback(error));
+    CHECK(database.flushWriteBuffers(error));
+    CHECK(database.begin(StatementTransaction::Mode::Immediate, error));
+    CHECK(countRows(database, -1, error) == 11);
+    CHECK(database.commit(error));
+    CHECK(database.removeWriteBuffer("rows", error));
+    database.close(nullptr);
+}
+
+static int64_t countOf(Database &database, const std::string &table)
+{
+    Error error;
+    RecyclableStatement statement = database.prepare(
+        StatementSelect()
+            .select({ColumnResult(Expr(Column::Any).count())})
+            .from(table),
+        error);
+    if (!statement || !statement->step()) {
+        return -1;
+    }
+    return statement->getValue<ColumnType::Integer64>(0);
+}
+
+TEST_CASE(tieringSkipsConflictingRows)
+{
+    std::string path = databasePath("tiering");
+    std::string archivePath = databasePath("tiering-archive");
+    Database database(path);
+    setBusyTimeout(database);
+    database.setAttachment("archive", archivePath);
+    Error error;
+    std::list<const ColumnDef> columnDefs = {
+        ColumnDef(Column("id"), ColumnType::Integer64).makePrimary(),
+        ColumnDef(Column("cold"), ColumnType::Integer32),
+    };
+    CHECK(database.exec(StatementCreateTable().create("cold", columnDefs),
+                        error));
+    CHECK(database.exec(
+        StatementCreateTable().create("archive.cold", columnDefs), error));
+    static const StatementInsert s_insert =
+        StatementInsert()
+            .insert("cold", {Column("id"), Column("cold")})
+            .values({Expr::BindParameter, Expr(1)});
+    for (int64_t id = 1; id <= 100; ++id) {
+        RecyclableStatement statement = database.prepare(s_insert, error);
+        CHECK(statement);
+        statement->bind<ColumnType::Integer64>(id, 1);
+        statement->step();
+        CHECK(statement->isOK());
+    }
+    // Row 5 is archived already, e.g. by a run interrupted before eviction
+    CHECK(database.exec(StatementInsert()
+                            .insert("archive.cold", {Column("id"), Column("cold")})
+                            .values({Expr(5), Expr(1)}),
+                        error));
+
+    CHECK(database.setTiering("cold", "archive", Expr(Column("cold")) == 1, 10,
+                              error));
+    CHECK(database.runTiering(error));
+    // The conflicting row is left, while the others are moved
+    CHECK(countOf(database, "main.cold") == 1);
+    CHECK(countOf(database, "archive.cold") == 100);
+    database.removeTiering("cold");
+    database.close(nullptr);
+}
+
+TEST_CASE(memoryOfFreeHandlesIsSampledAndShrunk)
+{
+    std::string path = databasePath("memory");
+    Database database(path);
+    setBusyTimeout(database);
+    CHECK(createRows(database));
+    HandlePool::MemorySnapshot initial = database.getMemorySnapshot();
+    std::mt19937 random = randomOf(0);
+    Error error;
+    CHECK(insertRows(database, 0, 0, 500, random, error));
+    CHECK(countRows(database, -1, error) == 500);
+
+    // It's sampled now, without a budget set
+    HandlePool::MemorySnapshot before = database.getMemorySnapshot();
+    CHECK(before.total.cache > initial.total.cache);
+    int freeHandles = database.getHandleStatistics().freeHandles;
+    CHECK(freeHandles > 0);
+
+    // Shrinking is checked once the next handle flows back
+    database.setMemoryBudget(1);
+    usleep(1100000);
+    CHECK(countRows(database, -1, error) == 500);
+    HandlePool::MemorySnapshot after = database.getMemorySnapshot();
+    CHECK(after.shrinks > before.shrinks);
+    CHECK(after.total.cache < before.total.cache);
+    // Free handles are kept
+    CHECK(database.getHandleStatistics().freeHandles == freeHandles);
+    database.setMemoryBudget(0);
+    database.close(nullptr);
+}
+
+// Health check of pool is exposed, with errors recorded by hand
+class HealthProbe : public HandlePool {
+public:
+    HealthProbe(const std::string &path) : HandlePool(path, Configs()) {}
+    using HandlePool::isHealthy;
+};
+
+class ErrorProneHandle : public Handle {
+public:
+    ErrorProneHandle(const std::string &path) : Handle(path) {}
+    using Handle::recordError;
+};
+
+TEST_CASE(handlePoolForgivesSporadicSuspiciousErrors)
+{
+    std::string path = databasePath("health");
+    HealthProbe pool(path);
+    HandlePool::HealthConfig config;
+    config.maxSuspiciousErrors = 3;
+    pool.setHealthConfig(config);
+    std::shared_ptr<ErrorProneHandle> handle(new ErrorProneHandle(path));
+    std::shared_ptr<HandleWrap> handleWrap(new HandleWrap(handle, Configs()));
+
+    // One in every other use never adds up
+    for (int i = 0; i < 20; ++i) {
+        if (i % 2 == 0) {
+            handle->recordError(SQLITE_IOERR);
+        }
+        CHECK(pool.isHealthy(handleWrap));
+    }
+    // A burst of them does
+    for (int i = 0; i < config.maxSuspiciousErrors; ++i) {
+        handle->recordError(SQLITE_IOERR);
+    }
+    CHECK(!pool.isHealthy(handleWrap));
+}
+
+static bool setSchemaVersion(sqlite3 *db, int delta)
+{
+    sqlite3_stmt *stmt = nullptr;
+    int64_t version = -1;
+    if (sqlite3_prepare_v2(db, "PRAGMA schema_version", -1, &stmt, nullptr) ==
+            SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    std::string sql =
+        "PRAGMA schema_version = " + std::to_string(version + delta);
+    return version >= 0 &&
+           sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) ==
+               SQLITE_OK;
+}
+
+TEST_CASE(handlePoolReplacesHandlesFailingValidation)
+{
+    std::string path = databasePath("validation");
+    Database database(path);
+    setBusyTimeout(database);
+    HandlePool::HealthConfig config;
+    config.idleValidationInterval = 1;
+    database.setHandleHealthConfig(config);
+    CHECK(createRows(database));
+    Error error;
+    CHECK(countRows(database, -1, error) == 0);
+    int replaced = database.getHandleStatistics().replacedHandles;
+
+    // Schema is made unloadable by another connection while handles idle
+    sqlite3 *db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    sqlite3_busy_timeout(db, 10000);
+    CHECK(sqlite3_exec(db,
+                       "PRAGMA writable_schema = ON;"
+                       "INSERT INTO sqlite_master VALUES('table', 'broken', "
+                       "'broken', 0, 'CREATE TABLE broken(');",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    CHECK(setSchemaVersion(db, 1));
+    usleep(1100000);
+    countRows(database, -1, error);
+    CHECK(database.getHandleStatistics().replacedHandles > replaced);
+
+    CHECK(sqlite3_exec(db, "DELETE FROM sqlite_master WHERE name = 'broken'",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    CHECK(setSchemaVersion(db, 1));
+    sqlite3_close(db);
+    CHECK(countRows(database, -1, error) == 0);
+    database.close(nullptr);
+}
+
+TEST_CASE(storageWalkAgreesWithDbstat)
+{
+    static const char kKey[] = "storage";
+    std::string path = databasePath("storage");
+    Database database(path);
+    // Cipher reserves bytes at the end of each page
+    database.setCipher(kKey, sizeof(kKey));
+    setBusyTimeout(database);
+    CHECK(createRows(database));
+    Error error;
+    // Index of large values spills from interior cells to overflow pages
+    CHECK(database.exec(StatementCreateIndex()
+                            .create("rows_value")
+                            .on("rows", {ColumnIndex(Column("value"))}),
+                        error));
+    std::mt19937 random = randomOf(0);
+    CHECK(insertRows(database, 0, 0, 600, random, error));
+    // Freeblocks are left by the deleted cells
+    CHECK(database.exec(StatementDelete().deleteFrom("rows").where(
+                            Expr(Column("seq")) % 3 == 0),
+                        error));
+
+    Database::StorageReport report;
+    CHECK(database.analyzeStorage(report, error, 16));
+    CHECK(report.btrees.size() == 4);
+
+    // Accumulated the same way as dbstat was read
+    std::map<std::string, Database::BtreeStorage> expected;
+    RecyclableStatement statement = database.prepare(
+        StatementSelect()
+            .select({ColumnResult(Column("name")),
+                     ColumnResult(Column("pagetype")),
+                     ColumnResult(Column("ncell")),
+                     ColumnResult(Column("payload")),
+                     ColumnResult(Column("unused")),
+                     ColumnResult(Column("pageno"))})
+            .from("dbstat"),
+        error);
+    CHECK(statement);
+    std::string lastName;
+    int64_t lastPage = 0;
+    while (statement->step()) {
+        std::string name = statement->getValue<ColumnType::Text>(0);
+        std::string type = statement->getValue<ColumnType::Text>(1);
+        int64_t cells = statement->getValue<ColumnType::Integer64>(2);
+        bool isIndex = name == "rows_value" ||
+                       name.compare(0, 16, "sqlite_autoindex") == 0;
+        Database::BtreeStorage &btree = expected[name];
+        if (name != lastName) {
+            lastName = name;
+            lastPage = 0;
+        }
+        if (type == "leaf") {
+            ++btree.leafPages;
+            btree.entries += cells;
+        } else if (type == "overflow") {
+            ++btree.overflowPages;
+        } else {
+            ++btree.interiorPages;
+            btree.entries += isIndex ? cells : 0;
+        }
+        btree.payload += statement->getValue<ColumnType::Integer64>(3);
+        btree.unused += statement->getValue<ColumnType::Integer64>(4);
+        int64_t page = statement->getValue<ColumnType::Integer64>(5);
+        if (lastPage != 0 && page != lastPage + 1) {
+            ++btree.fragmentedPages;
+        }
+        lastPage = page;
+    }
+    CHECK(statement->isOK());
+    statement = nullptr;
+
+    for (const Database::BtreeStorage &btree : report.btrees) {
+        const Database::BtreeStorage &other = expected[btree.name];
+        CHECK(btree.leafPages == other.leafPages);
+        CHECK(btree.interiorPages == other.interiorPages);
+        CHECK(btree.overflowPages == other.overflowPages);
+        CHECK(btree.entries == other.entries);
+        CHECK(btree.payload == other.payload);
+        CHECK(btree.unused == other.unused);
+        CHECK(btree.fragmentedPages == other.fragmentedPages);
+    }
+    CHECK(expected["rows_value"].overflowPages > 0);
+    CHECK(expected["rows_value"].interiorPages > 0);
+    database.close(nullptr);
+}
+
+static std::string planOf(RecyclableStatement &statement)
+{
+    std::string plan;
+    while (statement->step()) {
+        const char *detail = statement->getValue<ColumnType::Text>(3);
+        plan += detail ? detail : "";
+    }
+    return plan;
+}
+
+TEST_CASE(importedStatisticsAreLoadedByAllHandles)
+{
+    std::string path = databasePath("statistics");
+    Database database(path);
+    setBusyTimeout(database);
+    Error error;
+    CHECK(database.exec(StatementCreateTable().create(
+                            "t",
+                            std::list<const ColumnDef>{
+                                ColumnDef(Column("a"), ColumnType::Integer64),
+                                ColumnDef(Column("b"), ColumnType::Integer64),
+                            }),
+                        error));
+    CHECK(database.exec(StatementCreateIndex().create("ia").on(
+                            "t", {ColumnIndex(Column("a"))}),
+                        error));
+    CHECK(database.exec(StatementCreateIndex().create("ib").on(
+                            "t", {ColumnIndex(Column("b"))}),
+                        error));
+    // The index told to be selective is used
+    auto statsOf = [](const char *selective) -> std::list<Analyzer::Stat> {
+        std::string other = strcmp(selective, "ia") == 0 ? "ib" : "ia";
+        return {{"t", "", "100000"},
+                {"t", selective, "100000 1"},
+                {"t", other, "100000 50000"}};
+    };
+    const StatementExplain explain = StatementExplain().explainQueryPlan(
+        StatementSelect()
+            .select({ColumnResult(Column::Any)})
+            .from("t")
+            .where(Expr(Column("a")) == 1 && Expr(Column("b")) == 1));
+
+    // sqlite_stat1 is created by the first import, which changes the schema
+    CHECK(database.importStatistics(statsOf("ia"), false, error));
+    RecyclableStatement inUse = database.prepare(explain, error);
+    CHECK(inUse);
+    CHECK(planOf(inUse).find("INDEX ia") != std::string::npos);
+
+    // Imported by another handle, which is free after it
+    CHECK(database.importStatistics(statsOf("ib"), false, error));
+    RecyclableStatement statement = database.prepare(explain, error);
+    CHECK(statement);
+    CHECK(planOf(statement).find("INDEX ib") != std::string::npos);
+    statement = nullptr;
+    CHECK(database.getHandleStatistics().aliveHandles == 2);
+
+    // The one in use is reused, rather than reopened
+    database.purgeFreeHandles();
+    inUse = nullptr;
+    statement = database.prepare(explain, error);
+    CHECK(statement);
+    CHECK(planOf(statement).find("INDEX ib") != std::string::npos);
+    statement = nullptr;
+    CHECK(database.getHandleStatistics().aliveHandles == 1);
+    database.close(nullptr);
+}
+
+int main(int argc, char **argv)
+{
+    sDirectory = argc > 1 ? argv[1] : ".";
+    sSeed = argc > 2 ? (unsigned int) strtoul(argv[2], nullptr, 10)
+                     : (unsigned int) time(nullptr);
+    printf("Seed: %u\n", sSeed);
+    fflush(stdout);
+
+    // Failures are printed by the cases, with the concurrency warnings of
+    // oversubscribed threads left out.
+    Error::SetReportMethod([](const Error &) {});
+    signal(SIGALRM, onDeadlock);
+    alarm(kDeadlockSeconds * (unsigned int) wcdb::nativeTestCases().size());
+    int failures = wcdb::runTestCases();
+    alarm(0);
+    fflush(stdout);
+    // Threads of WCDB are detached and still waiting, whose statics can't be
+    // destroyed safely.
+    _exit(failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,338 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cross-process test of shared CursorWindow. A forked child fills and seals a
+// window, then passes its memfd over a unix socket, as Binder does, and exits.
+// The parent maps it with createFromFd. Unsealed or tampered fds must be
+// rejected before any row is read.
+//
+// Usage: cursor_window_test [directory]
+
+#include "../CursorWindow.h"
+#include "NativeTest.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace wcdb;
+
+static std::string sDirectory;
+
+static const size_t kWindowSize = 2 * 1024 * 1024;
+// More rows than one row slot chunk holds.
+static const uint32_t kNumRows = 3000;
+static const uint32_t kNumColumns = 5;
+
+enum Tamper {
+    TamperNone,
+    TamperUnsealed,
+    TamperPartiallySealed,
+    TamperNumRows,
+    TamperFirstChunkOffset,
+    TamperStringSize,
+    TamperStringTerminator,
+};
+
+static std::string stringOfRow(uint32_t row)
+{
+    return "row " + std::to_string(row);
+}
+
+static bool fillWindow(CursorWindow *window)
+{
+    if (window->setNumColumns(kNumColumns) != OK)
+        return false;
+    for (uint32_t row = 0; row < kNumRows; ++row) {
+        CursorWindow::RowSlot *slot;
+        std::string string = stringOfRow(row);
+        uint8_t blob[4] = {(uint8_t) row, (uint8_t) (row >> 8), 0xa5, 0x5a};
+        if (window->allocRow(&slot) != OK ||
+            window->putLong(slot, 0, (int64_t) row << 32) != OK ||
+            window->putDouble(slot, 1, row / 4.0) != OK ||
+            window->putString(slot, 2, string.c_str(), string.size() + 1) !=
+                OK ||
+            window->putBlob(slot, 3, blob, sizeof(blob)) != OK ||
+            window->putNull(slot, 4) != OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void checkWindow(CursorWindow *window, bool &failed)
+{
+    CHECK(window->getNumRows() == kNumRows);
+    CHECK(window->getNumColumns() == kNumColumns);
+    for (uint32_t row = 0; row < kNumRows; ++row) {
+        CursorWindow::FieldSlot *field = window->getFieldSlot(row, 0);
+        CHECK(window->getFieldSlotType(field) ==
+              CursorWindow::FIELD_TYPE_INTEGER);
+        CHECK(window->getFieldSlotValueLong(field) == (int64_t) row << 32);
+
+        field = window->getFieldSlot(row, 1);
+        CHECK(window->getFieldSlotType(field) ==
+              CursorWindow::FIELD_TYPE_FLOAT);
+        CHECK(window->getFieldSlotValueDouble(field) == row / 4.0);
+
+        field = window->getFieldSlot(row, 2);
+        size_t size;
+        CHECK(window->getFieldSlotType(field) ==
+              CursorWindow::FIELD_TYPE_STRING);
+        CHECK(stringOfRow(row) ==
+              window->getFieldSlotValueString(field, &size));
+
+        field = window->getFieldSlot(row, 3);
+        uint8_t blob[4] = {(uint8_t) row, (uint8_t) (row >> 8), 0xa5, 0x5a};
+        CHECK(window->getFieldSlotType(field) == CursorWindow::FIELD_TYPE_BLOB);
+        CHECK(memcmp(window->getFieldSlotValueBlob(field, &size), blob,
+                     sizeof(blob)) == 0);
+
+        field = window->getFieldSlot(row, 4);
+        CHECK(window->getFieldSlotType(field) == CursorWindow::FIELD_TYPE_NULL);
+    }
+}
+
+static uint32_t readU32(const uint8_t *data, size_t offset)
+{
+    uint32_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+static void writeU32(uint8_t *data, size_t offset, uint32_t value)
+{
+    memcpy(data + offset, &value, sizeof(value));
+}
+
+// Copies a sealed window into a new memfd, damages it as asked and seals it
+// unless asked otherwise. A producer that skips seal() or lies about offsets
+// looks exactly like this to the consumer.
+static int forgeFd(int sealedFd, Tamper tamper)
+{
+    int fd = (int) syscall(__NR_memfd_create, "CursorWindow: forged",
+                           MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, kWindowSize) != 0)
+        return -1;
+    void *source =
+        mmap(nullptr, kWindowSize, PROT_READ, MAP_SHARED, sealedFd, 0);
+    void *target = mmap(nullptr, kWindowSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+    if (source == MAP_FAILED || target == MAP_FAILED)
+        return -1;
+    uint8_t *data = static_cast<uint8_t *>(target);
+    memcpy(data, source, kWindowSize);
+    munmap(source, kWindowSize);
+
+    // Header is {freeOffset, firstChunkOffset, numRows, numColumns}, and a
+    // packed FieldSlot is {int32 type, uint32 offset, uint32 size, ...}.
+    uint32_t firstChunkOffset = readU32(data, 4);
+    uint32_t fieldDirOffset = readU32(data, firstChunkOffset + 4);
+    size_t stringSlot = fieldDirOffset + 2 * 12;
+    switch (tamper) {
+        case TamperNumRows:
+            writeU32(data, 8, kNumRows * 2);
+            break;
+        case TamperFirstChunkOffset:
+            writeU32(data, 4, kWindowSize - 8);
+            break;
+        case TamperStringSize:
+            writeU32(data, stringSlot + 8, kWindowSize);
+            break;
+        case TamperStringTerminator: {
+            uint32_t offset = readU32(data, stringSlot + 4);
+            uint32_t size = readU32(data, stringSlot + 8);
+            data[offset + size - 1] = 'x';
+            break;
+        }
+        default:
+            break;
+    }
+    munmap(target, kWindowSize);
+
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+    if (tamper == TamperPartiallySealed)
+        seals = F_SEAL_SHRINK | F_SEAL_GROW;
+    if (tamper != TamperUnsealed && fcntl(fd, F_ADD_SEALS, seals) != 0)
+        return -1;
+    return fd;
+}
+
+static bool sendFd(int sock, int fd)
+{
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, 0) == 1;
+}
+
+static int receiveFd(int sock)
+{
+    char byte;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, 0) != 1)
+        return -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS)
+        return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+// Child fills and seals a window, optionally forges a damaged copy of it, and
+// passes the fd to the parent. Only the descriptor outlives the child.
+static int receiveFromProducer(Tamper tamper)
+{
+    int socks[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) != 0)
+        return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(socks[0]);
+        CursorWindow *window;
+        int fd;
+        if (CursorWindow::createShared("test", kWindowSize, &window) != OK ||
+            !fillWindow(window) || window->seal(&fd) != OK)
+            _exit(2);
+        if (tamper != TamperNone)
+            fd = forgeFd(fd, tamper);
+        if (fd < 0 || !sendFd(socks[1], fd))
+            _exit(3);
+        delete window;
+        _exit(0);
+    }
+    close(socks[1]);
+    int fd = pid > 0 ? receiveFd(socks[0]) : -1;
+    close(socks[0]);
+    int status = 0;
+    if (pid <= 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+TEST_CASE(readRowsOfOtherProcess)
+{
+    int fd = receiveFromProducer(TamperNone);
+    CHECK(fd >= 0);
+
+    CursorWindow *window;
+    CHECK(CursorWindow::createFromFd(fd, &window) == OK);
+    // The window keeps its own descriptor.
+    close(fd);
+    CHECK(window->isShared());
+    CHECK(window->isReadOnly());
+    checkWindow(window, failed);
+    delete window;
+}
+
+TEST_CASE(refuseWritesAfterSeal)
+{
+    CursorWindow *window;
+    CHECK(CursorWindow::createShared("test", kWindowSize, &window) == OK);
+    CHECK(fillWindow(window));
+    int fd;
+    CHECK(window->seal(&fd) == OK);
+    CHECK(window->isReadOnly());
+
+    CursorWindow::RowSlot *slot;
+    CHECK(window->allocRow(&slot) != OK);
+    CHECK(window->putLong(1u, 0, 0) != OK);
+    CHECK(window->getFieldSlotValueLong(window->getFieldSlot(1u, 0)) ==
+          (int64_t) 1 << 32);
+
+    // The kernel refuses the fd as well, so no other mapping can change it.
+    char byte = 0;
+    CHECK(pwrite(fd, &byte, 1, 0) < 0 && errno == EPERM);
+    CHECK(ftruncate(fd, kWindowSize / 2) < 0 && errno == EPERM);
+    CHECK(mmap(nullptr, kWindowSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+               0) == MAP_FAILED);
+    checkWindow(window, failed);
+    delete window;
+}
+
+TEST_CASE(rejectUnsealedFd)
+{
+    for (Tamper tamper : {TamperUnsealed, TamperPartiallySealed}) {
+        int fd = receiveFromProducer(tamper);
+        CHECK(fd >= 0);
+        CursorWindow *window;
+        CHECK(CursorWindow::createFromFd(fd, &window) == PERMISSION_DENIED);
+        CHECK(window == nullptr);
+        close(fd);
+    }
+
+    // A regular file can't be sealed at all.
+    std::string path = sDirectory + "/cursor_window_test-file";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    unlink(path.c_str());
+    CHECK(ftruncate(fd, kWindowSize) == 0);
+    CursorWindow *window;
+    CHECK(CursorWindow::createFromFd(fd, &window) == PERMISSION_DENIED);
+    close(fd);
+}
+
+TEST_CASE(rejectTamperedFd)
+{
+    for (Tamper tamper : {TamperNumRows, TamperFirstChunkOffset,
+                          TamperStringSize, TamperStringTerminator}) {
+        int fd = receiveFromProducer(tamper);
+        CHECK(fd >= 0);
+        CursorWindow *window;
+        CHECK(CursorWindow::createFromFd(fd, &window) == BAD_VALUE);
+        CHECK(window == nullptr);
+        close(fd);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sDirectory = argc > 1 ? argv[1] : ".";
+    return runTestCases() == 0 ? 0 : 1;
+}
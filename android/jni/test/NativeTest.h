@@ -0,0 +1,91 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WCDB_NATIVE_TEST_H__
+#define __WCDB_NATIVE_TEST_H__
+
+// Minimal harness for native tests, which are run by adb shell as standalone
+// executables. See the native tests section in Android.mk.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+namespace wcdb {
+
+struct NativeTestCase {
+    const char *name;
+    void (*run)(bool &failed);
+};
+
+inline std::vector<NativeTestCase> &nativeTestCases()
+{
+    static std::vector<NativeTestCase> sCases;
+    return sCases;
+}
+
+struct NativeTestRegistrar {
+    NativeTestRegistrar(const char *name, void (*run)(bool &failed))
+    {
+        nativeTestCases().push_back({name, run});
+    }
+};
+
+inline int64_t nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Returns the number of failed cases.
+inline int runTestCases()
+{
+    int failures = 0;
+    for (const NativeTestCase &testCase : nativeTestCases()) {
+        bool failed = false;
+        testCase.run(failed);
+        printf("[%s] %s\n", failed ? "FAILED" : "PASSED", testCase.name);
+        failures += failed ? 1 : 0;
+    }
+    printf("%d of %zu failed\n", failures, nativeTestCases().size());
+    return failures;
+}
+
+} // namespace wcdb
+
+#define TEST_CASE(name)                                                        \
+    static void name(bool &failed);                                            \
+    static wcdb::NativeTestRegistrar name##Registrar(#name, name);             \
+    static void name(bool &failed)
+
+// The case stops at the first failed check.
+#define CHECK(condition)                                                       \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,            \
+                   #condition);                                                \
+            failed = true;                                                     \
+            return;                                                            \
+        }                                                                      \
+    } while (0)
+
+#endif
@@ -0,0 +1,363 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stress test of databases on vfsfault. Transactions run while I/O errors,
+// torn writes and power loss are injected, and the database reopened
+// afterwards must pass integrity_check and hold exactly the committed
+// transactions, plus at most the one that failed while committing.
+//
+// Each transaction records the number of rows and a checksum of its table
+// in the same transaction, so that a partially applied transaction shows up
+// as a mismatch.
+//
+// Usage: vfs_fault_test [directory] [seed]
+
+#include "NativeTest.h"
+#include <sqlite3.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <vfsfault.h>
+
+using namespace wcdb;
+
+static std::string sPath;
+static uint64_t sSeed;
+
+struct Config {
+    const char *name;
+    const char *journalMode;
+    bool encrypted;
+};
+
+static const Config sConfigs[] = {
+    {"rollback", "DELETE", false},
+    {"wal", "WAL", false},
+    {"encrypted rollback", "DELETE", true},
+    {"encrypted wal", "WAL", true},
+};
+
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (uint32_t) (state >> 16);
+    }
+};
+
+static void removeDatabase()
+{
+    for (const char *suffix : {"", "-journal", "-wal", "-shm"})
+        unlink((sPath + suffix).c_str());
+}
+
+static bool exec(sqlite3 *db, const char *sql)
+{
+    return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+static bool queryInt(sqlite3 *db, const char *sql, int64_t *value)
+{
+    sqlite3_stmt *stmt = nullptr;
+    bool succeed = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) ==
+                       SQLITE_OK &&
+                   sqlite3_step(stmt) == SQLITE_ROW;
+    if (succeed)
+        *value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return succeed;
+}
+
+// Small cache and full sync, so that pages are spilled before commit and
+// every commit is durable.
+static sqlite3 *openDatabase(const Config &config)
+{
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(sPath.c_str(), &db,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                        "vfsfault") != SQLITE_OK) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    std::string sql = "PRAGMA cache_size = 16;"
+                      "PRAGMA synchronous = FULL;"
+                      "PRAGMA journal_mode = ";
+    sql += config.journalMode;
+    sql += ";CREATE TABLE IF NOT EXISTS t(id INTEGER PRIMARY KEY, k INTEGER, "
+           "v BLOB);"
+           "CREATE INDEX IF NOT EXISTS t_k ON t(k);"
+           "CREATE TABLE IF NOT EXISTS meta(seq INTEGER, rows INTEGER, "
+           "total INTEGER);"
+           "INSERT INTO meta SELECT 0, 0, 0 WHERE NOT EXISTS "
+           "(SELECT 1 FROM meta);";
+    if ((config.encrypted && sqlite3_key(db, "vfsfault", 8) != SQLITE_OK) ||
+        !exec(db, sql.c_str())) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    return db;
+}
+
+static bool runTransaction(sqlite3 *db, Random &random)
+{
+    if (!exec(db, "BEGIN IMMEDIATE"))
+        return false;
+
+    sqlite3_stmt *stmt = nullptr;
+    bool succeed =
+        sqlite3_prepare_v2(db, "INSERT INTO t(k, v) VALUES(?1, ?2)", -1,
+                           &stmt, nullptr) == SQLITE_OK;
+    std::vector<uint8_t> blob;
+    int inserts = random.next() % 40;
+    for (int i = 0; succeed && i < inserts; ++i) {
+        blob.resize(random.next() % 3000);
+        for (uint8_t &byte : blob)
+            byte = (uint8_t) random.next();
+        sqlite3_bind_int64(stmt, 1, random.next() % 1000000);
+        sqlite3_bind_blob(stmt, 2, blob.data(), (int) blob.size(),
+                          SQLITE_STATIC);
+        succeed = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    char sql[128];
+    snprintf(sql, sizeof(sql), "DELETE FROM t WHERE k %% 13 = %u",
+             random.next() % 13);
+    succeed = succeed && exec(db, sql);
+    snprintf(sql, sizeof(sql),
+             "UPDATE t SET v = substr(v, 1, %u) WHERE k %% 7 = %u",
+             random.next() % 2000, random.next() % 7);
+    succeed = succeed && exec(db, sql);
+    return succeed &&
+           exec(db, "UPDATE meta SET seq = seq + 1, "
+                    "rows = (SELECT count(*) FROM t), "
+                    "total = (SELECT total(k) + total(length(v)) FROM t)") &&
+           exec(db, "COMMIT");
+}
+
+// Rolls back whatever the failed transaction left and returns the sequence
+// seen afterwards. Faults must be cleared.
+static bool recoverTransaction(sqlite3 *db, int64_t *seq)
+{
+    if (!sqlite3_get_autocommit(db) && !exec(db, "ROLLBACK"))
+        return false;
+    return queryInt(db, "SELECT seq FROM meta", seq);
+}
+
+// Reopens the database without faults and checks it. Faults must be cleared.
+static bool verifyDatabase(const Config &config, int64_t *seq)
+{
+    sqlite3 *db = openDatabase(config);
+    if (!db) {
+        printf("%s: failed to reopen\n", config.name);
+        return false;
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    bool intact = sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt,
+                                     nullptr) == SQLITE_OK;
+    int rows = 0;
+    while (intact && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *result = (const char *) sqlite3_column_text(stmt, 0);
+        intact = ++rows == 1 && result && strcmp(result, "ok") == 0;
+        if (!intact)
+            printf("%s: %s\n", config.name, result ? result : "(null)");
+    }
+    intact = intact && rows == 1;
+    sqlite3_finalize(stmt);
+
+    int64_t consistent = 0;
+    intact = intact &&
+             queryInt(db, "SELECT count(*) = 1 FROM meta", &consistent) &&
+             consistent == 1 &&
+             queryInt(db, "SELECT rows = (SELECT count(*) FROM t) AND "
+                          "total = (SELECT total(k) + total(length(v)) "
+                          "FROM t) FROM meta",
+                      &consistent) &&
+             consistent == 1 && queryInt(db, "SELECT seq FROM meta", seq);
+    if (!intact)
+        printf("%s: %s\n", config.name, sqlite3_errmsg(db));
+    return sqlite3_close(db) == SQLITE_OK && intact;
+}
+
+// Runs transactions with the rule injected until one fails. Returns whether
+// one failed.
+static bool runUntilFailure(sqlite3 *db,
+                            const VFaultRule &rule,
+                            int transactions,
+                            Random &random,
+                            int64_t *committed)
+{
+    int id = vfaultAddRule(&rule);
+    bool failed = false;
+    for (int i = 0; i < transactions && !failed; ++i) {
+        if (runTransaction(db, random))
+            ++*committed;
+        else
+            failed = true;
+    }
+    vfaultRemoveRule(id);
+    return failed;
+}
+
+TEST_CASE(surviveIOErrors)
+{
+    for (const Config &config : sConfigs) {
+        removeDatabase();
+        vfaultSeed(sSeed);
+        Random random(sSeed);
+        sqlite3 *db = openDatabase(config);
+        CHECK(db != nullptr);
+
+        VFaultStat before, after;
+        vfaultGetStats(&before);
+        VFaultRule rule = {};
+        rule.ops = VFAULT_OP_ALL;
+        rule.files = VFAULT_FILE_ALL;
+        rule.nInject = -1;
+        rule.permille = 20;
+        rule.errorCode = SQLITE_IOERR;
+        rule.nShortWrite = -1;
+
+        int64_t committed = 0;
+        bool ambiguous = false;
+        for (int i = 0; i < 300; ++i) {
+            int id = vfaultAddRule(&rule);
+            bool succeed = runTransaction(db, random);
+            vfaultRemoveRule(id);
+            if (succeed) {
+                ++committed;
+                ambiguous = false;
+                continue;
+            }
+
+            // The connection stays usable, with the transaction either
+            // applied or not as a whole.
+            int64_t seq = -1;
+            CHECK(recoverTransaction(db, &seq));
+            CHECK(seq == committed || seq == committed + 1);
+            committed = seq;
+            ambiguous = true;
+        }
+        vfaultGetStats(&after);
+        CHECK(sqlite3_close(db) == SQLITE_OK);
+        CHECK(after.injected > before.injected);
+
+        // A commit record written before a failed sync may still be
+        // recovered once the connection is gone.
+        int64_t seq = -1;
+        CHECK(verifyDatabase(config, &seq));
+        CHECK(seq == committed || (ambiguous && seq == committed + 1));
+    }
+}
+
+TEST_CASE(surviveTornWrites)
+{
+    for (const Config &config : sConfigs) {
+        removeDatabase();
+        vfaultSeed(sSeed);
+        Random random(sSeed);
+        int64_t committed = 0;
+        int crashes = 0;
+        for (int round = 0; round < 40; ++round) {
+            sqlite3 *db = openDatabase(config);
+            CHECK(db != nullptr);
+
+            VFaultRule rule = {};
+            rule.ops = VFAULT_OP_WRITE;
+            rule.files = VFAULT_FILE_ALL;
+            rule.nSkip = random.next() % 200;
+            rule.nInject = 1;
+            rule.errorCode = SQLITE_IOERR_WRITE;
+            rule.nShortWrite = 1 + random.next() % 4095;
+            rule.crash = 1;
+            vfaultSetCrashKeep(random.next() % 1000);
+            int64_t before = committed;
+            crashes += runUntilFailure(db, rule, 20, random, &committed);
+            sqlite3_close(db);
+
+            int64_t seq = -1;
+            CHECK(verifyDatabase(config, &seq));
+            CHECK(seq >= before && seq <= committed + 1);
+            committed = seq;
+        }
+        CHECK(crashes > 0);
+    }
+}
+
+TEST_CASE(survivePowerLoss)
+{
+    for (const Config &config : sConfigs) {
+        removeDatabase();
+        vfaultSeed(sSeed);
+        Random random(sSeed);
+        int64_t committed = 0;
+        int crashes = 0;
+        for (int round = 0; round < 40; ++round) {
+            sqlite3 *db = openDatabase(config);
+            CHECK(db != nullptr);
+
+            VFaultRule rule = {};
+            rule.ops = VFAULT_OP_WRITE | VFAULT_OP_SYNC | VFAULT_OP_TRUNCATE;
+            rule.files = VFAULT_FILE_ALL;
+            rule.nSkip = random.next() % 300;
+            rule.nInject = 1;
+            rule.errorCode = SQLITE_IOERR;
+            rule.nShortWrite = -1;
+            rule.crash = 1;
+            vfaultSetCrashKeep(random.next() % 1000);
+            int64_t before = committed;
+            bool crashed = runUntilFailure(db, rule, 20, random, &committed);
+            crashes += crashed;
+            // Power loss between transactions loses nothing committed.
+            if (!crashed)
+                vfaultCrash(random.next() % 1000);
+            sqlite3_close(db);
+
+            int64_t seq = -1;
+            CHECK(verifyDatabase(config, &seq));
+            if (crashed)
+                CHECK(seq >= before && seq <= committed + 1);
+            else
+                CHECK(seq == committed);
+            committed = seq;
+        }
+        CHECK(crashes > 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sPath = std::string(argc > 1 ? argv[1] : ".") + "/vfs_fault_test.db";
+    sSeed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t) nowMs();
+    printf("seed %llu\n", (unsigned long long) sSeed);
+
+    sqlite3_register_vfsfault(nullptr);
+    int failures = runTestCases();
+    removeDatabase();
+    return failures == 0 ? 0 : 1;
+}
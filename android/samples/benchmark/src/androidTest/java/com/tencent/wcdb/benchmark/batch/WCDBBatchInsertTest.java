@@ -0,0 +1,175 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.benchmark.batch;
+
+import android.content.Context;
+import android.support.test.InstrumentationRegistry;
+import android.util.Log;
+
+import com.tencent.wcdb.DatabaseUtils;
+import com.tencent.wcdb.database.SQLiteBatchArguments;
+import com.tencent.wcdb.database.SQLiteDatabase;
+import com.tencent.wcdb.database.SQLiteGlobal;
+import com.tencent.wcdb.database.SQLiteStatement;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Test;
+
+import java.io.File;
+
+/**
+ * Compares writing rows one by one with execSQL or a compiled statement against
+ * executing the same statement from packed {@link SQLiteBatchArguments}.
+ */
+public class WCDBBatchInsertTest {
+
+    private static final String TAG = "WCDB.Benchmark";
+    private static final String DATABASE_NAME = "test.db";
+    private static final int ROW_COUNT = 20000;
+
+    private static final String INSERT_SQL =
+            "INSERT INTO message (id, user, content) VALUES (?, ?, ?);";
+    private static final String UPDATE_SQL = "UPDATE message SET content = ? WHERE id = ?;";
+
+    private SQLiteDatabase mDB;
+
+    @Before
+    public void doBefore() {
+        Log.i(TAG, "[DB BENCHMARK] | Begin | " + getClass().getSimpleName());
+        SQLiteGlobal.loadLib();
+        Context context = InstrumentationRegistry.getTargetContext();
+
+        // Remove pre-existing database.
+        File dbFile = context.getDatabasePath(DATABASE_NAME);
+        dbFile.getParentFile().mkdirs();
+        dbFile.delete();
+        new File(dbFile.getParentFile(), dbFile.getName() + "-journal").delete();
+        new File(dbFile.getParentFile(), dbFile.getName() + "-wal").delete();
+
+        mDB = SQLiteDatabase.openOrCreateDatabaseInWalMode(dbFile.getPath(), null);
+        mDB.execSQL("CREATE TABLE message (id INTEGER PRIMARY KEY, user TEXT, content TEXT);");
+        mDB.execSQL("CREATE INDEX message_user ON message (user);");
+    }
+
+    @After
+    public void doAfter() {
+        mDB.close();
+        mDB = null;
+        Log.i(TAG, "[DB BENCHMARK] | End | " + getClass().getSimpleName());
+    }
+
+    @Test
+    public void doTest() {
+        // MEASUREMENT: Insertion by execSQL in one transaction
+        long time = System.nanoTime();
+        mDB.beginTransaction();
+        for (int i = 0; i < ROW_COUNT; i++) {
+            mDB.execSQL(INSERT_SQL, new Object[] {i, "u" + i, "Test message: " + i});
+        }
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Insertion by execSQL | " + time);
+        checkRows("Test message: ");
+
+        // MEASUREMENT: Insertion by compiled statement in one transaction
+        mDB.execSQL("DELETE FROM message;");
+        time = System.nanoTime();
+        SQLiteStatement statement = mDB.compileStatement(INSERT_SQL);
+        mDB.beginTransaction();
+        for (int i = 0; i < ROW_COUNT; i++) {
+            statement.bindLong(1, i);
+            statement.bindString(2, "u" + i);
+            statement.bindString(3, "Test message: " + i);
+            statement.executeInsert();
+        }
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        statement.close();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Insertion by compiled statement | " + time);
+        checkRows("Test message: ");
+
+        // MEASUREMENT: Insertion by batch in one transaction, packing included
+        mDB.execSQL("DELETE FROM message;");
+        time = System.nanoTime();
+        SQLiteBatchArguments batchArgs = new SQLiteBatchArguments(3, ROW_COUNT * 40);
+        for (int i = 0; i < ROW_COUNT; i++) {
+            batchArgs.bindLong(i).bindString("u" + i).bindString("Test message: " + i);
+        }
+        statement = mDB.compileStatement(INSERT_SQL);
+        mDB.beginTransaction();
+        long[] rowIds = statement.executeBatchInsert(batchArgs);
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        statement.close();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Insertion by batch | " + time);
+        Assert.assertEquals(rowIds.length, ROW_COUNT);
+        Assert.assertEquals(rowIds[ROW_COUNT - 1], ROW_COUNT - 1);
+        checkRows("Test message: ");
+
+        // MEASUREMENT: Update by compiled statement in one transaction
+        time = System.nanoTime();
+        statement = mDB.compileStatement(UPDATE_SQL);
+        mDB.beginTransaction();
+        for (int i = 0; i < ROW_COUNT; i++) {
+            statement.bindString(1, "Modified message: " + i);
+            statement.bindLong(2, i);
+            statement.executeUpdateDelete();
+        }
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        statement.close();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Update by compiled statement | " + time);
+        checkRows("Modified message: ");
+
+        // MEASUREMENT: Update by batch in one transaction, packing included
+        time = System.nanoTime();
+        batchArgs.clear();
+        for (int i = 0; i < ROW_COUNT; i++) {
+            batchArgs.bindString("Again modified message: " + i).bindLong(i);
+        }
+        statement = mDB.compileStatement(UPDATE_SQL);
+        mDB.beginTransaction();
+        long[] changes = statement.executeBatchUpdateDelete(batchArgs);
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        statement.close();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Update by batch | " + time);
+        Assert.assertEquals(changes.length, ROW_COUNT);
+        Assert.assertEquals(changes[ROW_COUNT - 1], 1);
+        checkRows("Again modified message: ");
+    }
+
+    private void checkRows(String contentPrefix) {
+        Assert.assertEquals(DatabaseUtils.longForQuery(mDB,
+                "SELECT count(*) FROM message;", null), ROW_COUNT);
+        Assert.assertEquals(DatabaseUtils.stringForQuery(mDB,
+                "SELECT user || ':' || content FROM message WHERE id = ?;",
+                new String[] {"12345"}), "u12345:" + contentPrefix + "12345");
+    }
+}
@@ -0,0 +1,184 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.benchmark.columnar;
+
+import android.content.Context;
+import android.database.Cursor;
+import android.support.test.InstrumentationRegistry;
+import android.util.Log;
+
+import com.tencent.wcdb.database.SQLiteColumnarResult;
+import com.tencent.wcdb.database.SQLiteDatabase;
+import com.tencent.wcdb.database.SQLiteGlobal;
+import com.tencent.wcdb.database.SQLiteStatement;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Test;
+
+import java.io.File;
+
+/**
+ * Compares reading a whole result set through a {@link Cursor} against
+ * {@link SQLiteDatabase#rawQueryColumnar}, for all columns and for numeric columns only.
+ */
+public class WCDBColumnarQueryTest {
+
+    private static final String TAG = "WCDB.Benchmark";
+    private static final String DATABASE_NAME = "test.db";
+    private static final int ROW_COUNT = 100000;
+
+    private static final String QUERY_ALL_SQL = "SELECT id, user, content, time FROM message;";
+    private static final String QUERY_NUMERIC_SQL = "SELECT id, time FROM message;";
+
+    private SQLiteDatabase mDB;
+    private long mExpectedIdSum;
+    private long mExpectedTimeSum;
+    private long mExpectedContentLength;
+
+    @Before
+    public void doBefore() {
+        Log.i(TAG, "[DB BENCHMARK] | Begin | " + getClass().getSimpleName());
+        SQLiteGlobal.loadLib();
+        Context context = InstrumentationRegistry.getTargetContext();
+
+        // Remove pre-existing database.
+        File dbFile = context.getDatabasePath(DATABASE_NAME);
+        dbFile.getParentFile().mkdirs();
+        dbFile.delete();
+        new File(dbFile.getParentFile(), dbFile.getName() + "-journal").delete();
+        new File(dbFile.getParentFile(), dbFile.getName() + "-wal").delete();
+
+        mDB = SQLiteDatabase.openOrCreateDatabaseInWalMode(dbFile.getPath(), null);
+        mDB.execSQL("CREATE TABLE message (id INTEGER PRIMARY KEY, user TEXT, content TEXT, "
+                + "time INTEGER);");
+
+        SQLiteStatement statement = mDB.compileStatement(
+                "INSERT INTO message (id, user, content, time) VALUES (?, ?, ?, ?);");
+        mDB.beginTransaction();
+        for (int i = 0; i < ROW_COUNT; i++) {
+            String content = "Test message: " + i;
+            long time = 1500000000000L + i * 997L;
+            statement.bindLong(1, i);
+            statement.bindString(2, "u" + i);
+            statement.bindString(3, content);
+            statement.bindLong(4, time);
+            statement.executeInsert();
+            mExpectedIdSum += i;
+            mExpectedTimeSum += time;
+            mExpectedContentLength += content.length();
+        }
+        mDB.setTransactionSuccessful();
+        mDB.endTransaction();
+        statement.close();
+    }
+
+    @After
+    public void doAfter() {
+        mDB.close();
+        mDB = null;
+        Log.i(TAG, "[DB BENCHMARK] | End | " + getClass().getSimpleName());
+    }
+
+    @Test
+    public void doTest() {
+        // Warm up the page cache so that both paths read from memory.
+        queryAllByCursor();
+
+        // MEASUREMENT: Query fill by cursor
+        long time = System.nanoTime();
+        queryAllByCursor();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Query fill by cursor | " + time);
+
+        // MEASUREMENT: Query fill by columnar result
+        time = System.nanoTime();
+        SQLiteColumnarResult result = mDB.rawQueryColumnar(QUERY_ALL_SQL, null, new int[] {
+                SQLiteColumnarResult.TYPE_LONG, SQLiteColumnarResult.TYPE_STRING,
+                SQLiteColumnarResult.TYPE_STRING, SQLiteColumnarResult.TYPE_LONG}, 0, null);
+        long idSum = 0;
+        long timeSum = 0;
+        long contentLength = 0;
+        for (int row = 0; row < result.getRowCount(); row++) {
+            idSum += result.getLong(row, 0);
+            Assert.assertNotNull(result.getString(row, 1));
+            contentLength += result.getString(row, 2).length();
+            timeSum += result.getLong(row, 3);
+        }
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Query fill by columnar result | " + time);
+        Assert.assertEquals(result.getRowCount(), ROW_COUNT);
+        Assert.assertEquals(idSum, mExpectedIdSum);
+        Assert.assertEquals(timeSum, mExpectedTimeSum);
+        Assert.assertEquals(contentLength, mExpectedContentLength);
+
+        // MEASUREMENT: Numeric scan by cursor
+        time = System.nanoTime();
+        Cursor cursor = mDB.rawQuery(QUERY_NUMERIC_SQL, null);
+        idSum = 0;
+        timeSum = 0;
+        while (cursor.moveToNext()) {
+            idSum += cursor.getLong(0);
+            timeSum += cursor.getLong(1);
+        }
+        cursor.close();
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Numeric scan by cursor | " + time);
+        Assert.assertEquals(idSum, mExpectedIdSum);
+        Assert.assertEquals(timeSum, mExpectedTimeSum);
+
+        // MEASUREMENT: Numeric scan by columnar result
+        time = System.nanoTime();
+        result = mDB.rawQueryColumnar(QUERY_NUMERIC_SQL, null, new int[] {
+                SQLiteColumnarResult.TYPE_LONG, SQLiteColumnarResult.TYPE_LONG}, 0, null);
+        long[] ids = result.getLongs(0);
+        long[] times = result.getLongs(1);
+        idSum = 0;
+        timeSum = 0;
+        for (int row = 0; row < result.getRowCount(); row++) {
+            idSum += ids[row];
+            timeSum += times[row];
+        }
+        time = System.nanoTime() - time;
+        Log.i(TAG, "[DB BENCHMARK] | Numeric scan by columnar result | " + time);
+        Assert.assertEquals(idSum, mExpectedIdSum);
+        Assert.assertEquals(timeSum, mExpectedTimeSum);
+    }
+
+    private void queryAllByCursor() {
+        Cursor cursor = mDB.rawQuery(QUERY_ALL_SQL, null);
+        long idSum = 0;
+        long timeSum = 0;
+        long contentLength = 0;
+        while (cursor.moveToNext()) {
+            idSum += cursor.getLong(0);
+            Assert.assertNotNull(cursor.getString(1));
+            contentLength += cursor.getString(2).length();
+            timeSum += cursor.getLong(3);
+        }
+        cursor.close();
+        Assert.assertEquals(idSum, mExpectedIdSum);
+        Assert.assertEquals(timeSum, mExpectedTimeSum);
+        Assert.assertEquals(contentLength, mExpectedContentLength);
+    }
+}
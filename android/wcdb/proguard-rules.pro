@@ -12,6 +12,7 @@
 -keep class com.tencent.wcdb.database.SQLiteDebug$* { *; }
 -keep class com.tencent.wcdb.database.SQLiteCipherSpec { <fields>; }
 -keep interface com.tencent.wcdb.support.Log$* { *; }
+-keep interface com.tencent.wcdb.database.SQLiteChangesetConflictResolver { *; }
 
 # Keep methods used as callbacks from JNI code
 -keep class com.tencent.wcdb.repair.RepairKit { int onProgress(java.lang.String, int, long); }
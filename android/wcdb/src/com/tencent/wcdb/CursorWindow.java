@@ -19,11 +19,14 @@ package com.tencent.wcdb;
 import android.content.res.Resources;
 import android.database.CharArrayBuffer;
 import android.os.Parcel;
+import android.os.ParcelFileDescriptor;
 import android.os.Parcelable;
 
 import com.tencent.wcdb.database.SQLiteClosable;
 import com.tencent.wcdb.database.SQLiteException;
 
+import java.io.IOException;
+
 /**
  * A buffer containing multiple cursor rows.
  * <p>
@@ -73,8 +76,12 @@ public class CursorWindow extends SQLiteClosable implements Parcelable {
 
     private int mStartPos;
     private final String mName;
+    private final boolean mShared;
 
     private static native long nativeCreate(String name, int cursorWindowSize);
+    private static native long nativeCreateShared(String name, int cursorWindowSize);
+    private static native long nativeCreateFromFd(int fd);
+    private static native int nativeSeal(long windowPtr);
     private static native void nativeDispose(long windowPtr);
 
     private static native void nativeClear(long windowPtr);
@@ -108,9 +115,30 @@ public class CursorWindow extends SQLiteClosable implements Parcelable {
      * @param name The name of the cursor window, or null if none.
      */
     public CursorWindow(String name) {
+        this(name, false);
+    }
+
+    /**
+     * Creates a new empty cursor window, optionally backed by shared memory.
+     * <p>
+     * A shared window keeps its rows in a sealed memory file instead of the
+     * native heap.  Writing it to a {@link Parcel} sends only the file descriptor,
+     * and the receiving process maps the rows read-only without copying them.
+     * The window becomes read-only in this process too once it has been written
+     * to a {@link Parcel}.
+     * </p>
+     *
+     * @param name The name of the cursor window, or null if none.
+     * @param shared True to back the window with shared memory.
+     * @throws CursorWindowAllocationException if the window cannot be allocated,
+     * e.g. shared memory is requested on a kernel without memfd support.
+     */
+    public CursorWindow(String name, boolean shared) {
         mStartPos = 0;
         mName = name != null && name.length() != 0 ? name : "<unnamed>";
-        mWindowPtr = nativeCreate(mName, sCursorWindowSize);
+        mShared = shared;
+        mWindowPtr = shared ? nativeCreateShared(mName, sCursorWindowSize)
+                : nativeCreate(mName, sCursorWindowSize);
         if (mWindowPtr == 0) {
             throw new CursorWindowAllocationException("Cursor window allocation of " +
                     (sCursorWindowSize / 1024) + " kb failed. ");
@@ -136,7 +164,23 @@ public class CursorWindow extends SQLiteClosable implements Parcelable {
     }
 
     private CursorWindow(Parcel source) {
-        throw new UnsupportedOperationException();
+        mStartPos = source.readInt();
+        mName = source.readString();
+        mShared = true;
+
+        ParcelFileDescriptor fd = source.readFileDescriptor();
+        if (fd == null) {
+            throw new CursorWindowAllocationException("No shared memory in parcel.");
+        }
+        try {
+            mWindowPtr = nativeCreateFromFd(fd.getFd());
+        } finally {
+            try { fd.close(); } catch (IOException e) { /* ignore */ }
+        }
+        if (mWindowPtr == 0) {
+            throw new CursorWindowAllocationException(
+                    "Cursor window could not be created from parcel.");
+        }
     }
 
     @Override
@@ -686,11 +730,54 @@ public class CursorWindow extends SQLiteClosable implements Parcelable {
     }
 
     public int describeContents() {
-        return 0;
+        return mShared ? Parcelable.CONTENTS_FILE_DESCRIPTOR : 0;
     }
 
+    /**
+     * Writes a shared window to a {@link Parcel} by file descriptor.
+     * <p>
+     * The window is sealed first and can no longer be modified.  Windows not
+     * created as shared cannot be parceled.
+     * </p>
+     */
     public void writeToParcel(Parcel dest, int flags) {
-        throw new UnsupportedOperationException();
+        if (!mShared) {
+            throw new UnsupportedOperationException(
+                    "Only shared CursorWindow can be written to a Parcel.");
+        }
+
+        acquireReference();
+        try {
+            int fd = nativeSeal(mWindowPtr);
+            if (fd < 0) {
+                throw new SQLiteException("Failed to seal CursorWindow.");
+            }
+
+            dest.writeInt(mStartPos);
+            dest.writeString(mName);
+            // fromFd() duplicates the descriptor, the window keeps its own.
+            ParcelFileDescriptor pfd = ParcelFileDescriptor.fromFd(fd);
+            try {
+                dest.writeFileDescriptor(pfd.getFileDescriptor());
+            } finally {
+                pfd.close();
+            }
+        } catch (IOException e) {
+            throw new SQLiteException("Failed to write CursorWindow to Parcel.", e);
+        } finally {
+            releaseReference();
+        }
+
+        if ((flags & Parcelable.PARCELABLE_WRITE_RETURN_VALUE) != 0) {
+            releaseReference();
+        }
+    }
+
+    /**
+     * Returns true if this window is backed by shared memory.
+     */
+    public boolean isShared() {
+        return mShared;
     }
 
     @Override
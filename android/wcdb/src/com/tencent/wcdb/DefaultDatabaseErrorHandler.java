@@ -108,7 +108,7 @@ public final class DefaultDatabaseErrorHandler implements DatabaseErrorHandler {
     }
 
     private static final String[] SUFFIX_TO_BACKUP = new String[] {
-            "", "-journal", "-wal", ".sm", ".bak", "-vfslog", "-vfslo1"
+            "", "-journal", "-wal", ".sm", ".bak", "-vfslog", "-vfslo1", "-cksum"
     };
 
 	private void deleteDatabaseFile(String fileName) {
@@ -0,0 +1,196 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.database;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+
+/**
+ * Packed bind arguments for executing one statement many times in a single native call.
+ *
+ * <p>Values are appended row by row into a direct buffer in native byte order, each
+ * one tagged with its type. Strings are stored as UTF-8 and strings and blobs are
+ * prefixed with their length, so the native side binds them straight from the buffer
+ * without any per-value JNI call or copy.</p>
+ *
+ * <p>Every row must contain exactly {@link #getColumnCount()} values, in the order of
+ * the statement parameters. Instances are not thread-safe and can be reused after
+ * {@link #clear()}.</p>
+ *
+ * @see SQLiteStatement#executeBatchInsert(SQLiteBatchArguments)
+ * @see SQLiteStatement#executeBatchUpdateDelete(SQLiteBatchArguments)
+ */
+public final class SQLiteBatchArguments {
+
+    // Type tags, must match com_tencent_wcdb_database_SQLiteConnection.cpp
+    static final byte TYPE_NULL = 0;
+    static final byte TYPE_LONG = 1;
+    static final byte TYPE_DOUBLE = 2;
+    static final byte TYPE_STRING = 3;
+    static final byte TYPE_BLOB = 4;
+
+    private static final int DEFAULT_CAPACITY = 16 * 1024;
+    private static final Charset UTF_8 = Charset.forName("UTF-8");
+
+    private final int mColumnCount;
+    private ByteBuffer mBuffer;
+    private int mRowCount;
+    private int mColumn;
+
+    /**
+     * Create an empty batch for statements with the given number of parameters.
+     *
+     * @param columnCount number of bind parameters of the statement
+     */
+    public SQLiteBatchArguments(int columnCount) {
+        this(columnCount, DEFAULT_CAPACITY);
+    }
+
+    /**
+     * Create an empty batch with an initial buffer capacity in bytes.
+     * The buffer grows as needed.
+     */
+    public SQLiteBatchArguments(int columnCount, int initialCapacity) {
+        if (columnCount < 0)
+            throw new IllegalArgumentException("columnCount must not be negative.");
+        mColumnCount = columnCount;
+        mBuffer = ByteBuffer.allocateDirect(Math.max(initialCapacity, 64))
+                .order(ByteOrder.nativeOrder());
+    }
+
+    public int getColumnCount() {
+        return mColumnCount;
+    }
+
+    /**
+     * Returns the number of completed rows.
+     */
+    public int getRowCount() {
+        return mRowCount;
+    }
+
+    /**
+     * Discard all rows while keeping the allocated buffer.
+     */
+    public void clear() {
+        mBuffer.clear();
+        mRowCount = 0;
+        mColumn = 0;
+    }
+
+    public SQLiteBatchArguments bindNull() {
+        prepareValue(1).put(TYPE_NULL);
+        return this;
+    }
+
+    public SQLiteBatchArguments bindLong(long value) {
+        prepareValue(9).put(TYPE_LONG).putLong(value);
+        return this;
+    }
+
+    public SQLiteBatchArguments bindDouble(double value) {
+        prepareValue(9).put(TYPE_DOUBLE).putDouble(value);
+        return this;
+    }
+
+    public SQLiteBatchArguments bindString(String value) {
+        if (value == null)
+            return bindNull();
+        byte[] bytes = value.getBytes(UTF_8);
+        prepareValue(5 + bytes.length).put(TYPE_STRING).putInt(bytes.length).put(bytes);
+        return this;
+    }
+
+    public SQLiteBatchArguments bindBlob(byte[] value) {
+        if (value == null)
+            return bindNull();
+        prepareValue(5 + value.length).put(TYPE_BLOB).putInt(value.length).put(value);
+        return this;
+    }
+
+    /**
+     * Bind a value the same way {@link SQLiteConnection} binds {@code Object[]}
+     * arguments: null, {@link Number}, {@link Boolean}, byte arrays, or anything
+     * else as its string representation.
+     */
+    public SQLiteBatchArguments bind(Object value) {
+        if (value == null) {
+            return bindNull();
+        } else if (value instanceof Double || value instanceof Float) {
+            return bindDouble(((Number) value).doubleValue());
+        } else if (value instanceof Number) {
+            return bindLong(((Number) value).longValue());
+        } else if (value instanceof Boolean) {
+            return bindLong((Boolean) value ? 1 : 0);
+        } else if (value instanceof byte[]) {
+            return bindBlob((byte[]) value);
+        } else {
+            return bindString(value.toString());
+        }
+    }
+
+    /**
+     * Append a whole row of values.
+     */
+    public SQLiteBatchArguments addRow(Object... values) {
+        if (mColumn != 0)
+            throw new IllegalStateException("Previous row is not finished.");
+        if (values.length != mColumnCount)
+            throw new IllegalArgumentException("Expected " + mColumnCount
+                    + " values but " + values.length + " were provided.");
+        for (Object value : values)
+            bind(value);
+        if (mColumnCount == 0)
+            mRowCount++;
+        return this;
+    }
+
+    ByteBuffer getBuffer() {
+        if (mColumn != 0)
+            throw new IllegalStateException("The last row is not finished.");
+        return mBuffer;
+    }
+
+    int getLength() {
+        return mBuffer.position();
+    }
+
+    private ByteBuffer prepareValue(int size) {
+        if (mBuffer.remaining() < size) {
+            int capacity = mBuffer.capacity();
+            int required = mBuffer.position() + size;
+            while (capacity < required)
+                capacity *= 2;
+            ByteBuffer buffer = ByteBuffer.allocateDirect(capacity)
+                    .order(ByteOrder.nativeOrder());
+            mBuffer.flip();
+            buffer.put(mBuffer);
+            mBuffer = buffer;
+        }
+
+        if (++mColumn == mColumnCount) {
+            mColumn = 0;
+            mRowCount++;
+        }
+        return mBuffer;
+    }
+}
@@ -35,12 +35,18 @@ public interface SQLiteChangeListener {
      * It's possible that multiple threads call this method concurrently, so
      * the implementation must be thread-safe.
      *
+     * Changes committed by other processes are also delivered if enabled by
+     * {@link SQLiteDatabase#setCrossProcessNotification(boolean)}.
+     *
      * @param db        database object whose tables were changed
      * @param dbName    attached database name of the changed table, "main" for the main database
      * @param table     name of the changed table
      * @param insertIds array of rowIDs of the rows inserted, or null if rowID trace is disabled
+     *                  or rows are changed by another process
      * @param updateIds array of rowIDs of the rows updated, or null if rowID trace is disabled
+     *                  or rows are changed by another process
      * @param deleteIds array of rowIDs of the rows deleted, or null if rowID trace is disabled
+     *                  or rows are changed by another process
      */
     void onChange(SQLiteDatabase db, String dbName, String table,
             long[] insertIds, long[] updateIds, long[] deleteIds);
@@ -0,0 +1,124 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.database;
+
+import com.tencent.wcdb.support.Log;
+
+import java.io.IOException;
+
+/**
+ * Delivers table-level changes committed by other processes.
+ *
+ * <p>Processes opening the same database share a memory-mapped {@code -notify}
+ * file holding a sequence counter per table. Changes committed by this process
+ * are published to the file, and a watcher thread blocks on it and dispatches
+ * the changes of other processes to the connection pool.</p>
+ *
+ * @hide
+ */
+final class SQLiteChangeNotifier {
+    private static final String TAG = "WCDB.SQLiteChangeNotifier";
+
+    static final String SUFFIX = "-notify";
+
+    private final SQLiteConnectionPool mPool;
+    private final Thread mThread;
+    private long mNotifierPtr;
+    private volatile boolean mClosed;
+    private boolean mCloseOnExit;
+
+    private static native long nativeOpen(String path);
+    private static native void nativeClose(long notifierPtr);
+    private static native void nativePublish(long notifierPtr, String table);
+    private static native String[] nativeWaitForChanges(long notifierPtr, int timeoutMs);
+    private static native void nativeWakeUp(long notifierPtr);
+
+    static {
+        // Ensure libwcdb.so is loaded.
+        SQLiteGlobal.loadLib();
+    }
+
+    SQLiteChangeNotifier(String path, SQLiteConnectionPool pool) throws IOException {
+        mPool = pool;
+        mNotifierPtr = nativeOpen(path + SUFFIX);
+        if (mNotifierPtr == 0)
+            throw new IOException("Cannot open change notifier for " + path);
+
+        mThread = new Thread(new Runnable() {
+            @Override
+            public void run() {
+                watch();
+            }
+        }, "WCDB.ChangeNotifier");
+        mThread.setDaemon(true);
+        mThread.start();
+    }
+
+    void publish(String table) {
+        if (!mClosed)
+            nativePublish(mNotifierPtr, table);
+    }
+
+    void close() {
+        mClosed = true;
+        if (Thread.currentThread() == mThread) {
+            // Closed by listener, the watcher thread frees it on exit.
+            mCloseOnExit = true;
+            return;
+        }
+
+        nativeWakeUp(mNotifierPtr);
+        boolean interrupted = false;
+        while (mThread.isAlive()) {
+            try {
+                mThread.join();
+            } catch (InterruptedException e) {
+                interrupted = true;
+            }
+        }
+        if (interrupted)
+            Thread.currentThread().interrupt();
+
+        nativeClose(mNotifierPtr);
+        mNotifierPtr = 0;
+    }
+
+    private void watch() {
+        while (!mClosed) {
+            String[] tables = nativeWaitForChanges(mNotifierPtr, -1);
+            if (tables == null || mClosed)
+                continue;
+
+            for (String table : tables) {
+                try {
+                    mPool.dispatchChanges("main", table, null, null, null);
+                } catch (RuntimeException e) {
+                    Log.e(TAG, "Failed to dispatch changes of " + table + ": " + e.getMessage());
+                }
+            }
+        }
+
+        if (mCloseOnExit) {
+            nativeClose(mNotifierPtr);
+            mNotifierPtr = 0;
+        }
+    }
+}
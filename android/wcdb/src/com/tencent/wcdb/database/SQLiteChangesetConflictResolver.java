@@ -0,0 +1,58 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.database;
+
+/**
+ * Decides how a conflict is resolved while applying a changeset with
+ * {@link SQLiteDatabase#applyChangeset}.
+ *
+ * <p>Called on the thread applying the changeset, inside its transaction. Do not
+ * access the database from the callback.</p>
+ */
+public interface SQLiteChangesetConflictResolver {
+
+    /** The row to update or delete exists but its values do not match the change. */
+    int CONFLICT_DATA = 1;
+    /** The row to update or delete does not exist. */
+    int CONFLICT_NOTFOUND = 2;
+    /** The row to insert conflicts with an existing primary key. */
+    int CONFLICT_CONFLICT = 3;
+    /** The change violates a constraint other than the primary key. */
+    int CONFLICT_CONSTRAINT = 4;
+    /** Foreign key constraints are violated after applying the changeset. */
+    int CONFLICT_FOREIGN_KEY = 5;
+
+    /** Skip the conflicting change. */
+    int RESULT_OMIT = 0;
+    /** Overwrite the existing row, only valid for data and conflict conflicts. */
+    int RESULT_REPLACE = 1;
+    /** Roll back all changes applied so far and fail. */
+    int RESULT_ABORT = 2;
+
+    /**
+     * Resolves a conflict.
+     *
+     * @param type  The conflict type, one of the {@code CONFLICT_*} constants.
+     * @param table The table of the conflicting change.
+     * @return One of the {@code RESULT_*} constants.
+     */
+    int onConflict(int type, String table);
+}
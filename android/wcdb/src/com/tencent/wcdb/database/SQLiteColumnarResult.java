@@ -0,0 +1,177 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.tencent.wcdb.database;
+
+import java.nio.charset.Charset;
+
+/**
+ * Query results stored column by column in primitive arrays.
+ *
+ * <p>Returned by {@link SQLiteDatabase#rawQueryColumnar}. Each result column is
+ * converted once in native code to the representation requested for it and copied to
+ * Java in a single pass, so numeric columns can be processed as plain {@code long[]}
+ * or {@code double[]} without a JNI call per cell.</p>
+ *
+ * <p>Every column carries a null bitmap, where bit {@code row & 7} of byte
+ * {@code row >> 3} is set if the value is NULL. NULL values read as 0, 0.0 or empty.
+ * String and blob columns are stored as one byte array, UTF-8 for strings, with
+ * {@code rowCount + 1} offsets delimiting the values.</p>
+ */
+public final class SQLiteColumnarResult {
+
+    /** Read the column as 64-bit integers, like {@link com.tencent.wcdb.Cursor#getLong}. */
+    public static final int TYPE_LONG = 1;
+    /** Read the column as doubles, like {@link com.tencent.wcdb.Cursor#getDouble}. */
+    public static final int TYPE_DOUBLE = 2;
+    /** Read the column as UTF-8 strings. */
+    public static final int TYPE_STRING = 3;
+    /** Read the column as raw bytes. */
+    public static final int TYPE_BLOB = 4;
+
+    private static final Charset UTF_8 = Charset.forName("UTF-8");
+
+    private final int[] mTypes;
+    private final int mRowCount;
+    // For each column: values (long[], double[] or byte[]), offsets (int[] or null)
+    // and null bitmap (byte[]), as produced by nativeExecuteForColumns.
+    private final Object[] mColumns;
+
+    SQLiteColumnarResult(int[] types, int rowCount, Object[] columns) {
+        mTypes = types;
+        mRowCount = rowCount;
+        mColumns = columns;
+    }
+
+    public int getRowCount() {
+        return mRowCount;
+    }
+
+    public int getColumnCount() {
+        return mTypes.length;
+    }
+
+    public int getType(int column) {
+        return mTypes[column];
+    }
+
+    public boolean isNull(int row, int column) {
+        checkRow(row);
+        byte[] bitmap = getNullBitmap(column);
+        return (bitmap[row >> 3] & (1 << (row & 7))) != 0;
+    }
+
+    /**
+     * Returns the null bitmap of a column, see the class description for its layout.
+     * The array is shared, do not modify it.
+     */
+    public byte[] getNullBitmap(int column) {
+        return (byte[]) mColumns[column * 3 + 2];
+    }
+
+    /**
+     * Returns all values of a {@link #TYPE_LONG} column.
+     * The array is shared, do not modify it.
+     */
+    public long[] getLongs(int column) {
+        checkType(column, TYPE_LONG);
+        return (long[]) mColumns[column * 3];
+    }
+
+    /**
+     * Returns all values of a {@link #TYPE_DOUBLE} column.
+     * The array is shared, do not modify it.
+     */
+    public double[] getDoubles(int column) {
+        checkType(column, TYPE_DOUBLE);
+        return (double[]) mColumns[column * 3];
+    }
+
+    /**
+     * Returns the concatenated bytes of a {@link #TYPE_STRING} or {@link #TYPE_BLOB}
+     * column, delimited by {@link #getOffsets(int)}.
+     * The array is shared, do not modify it.
+     */
+    public byte[] getBytes(int column) {
+        checkVariableLength(column);
+        return (byte[]) mColumns[column * 3];
+    }
+
+    /**
+     * Returns the {@code rowCount + 1} offsets of a {@link #TYPE_STRING} or
+     * {@link #TYPE_BLOB} column.  Value {@code row} spans bytes
+     * {@code [offsets[row], offsets[row + 1])}.
+     * The array is shared, do not modify it.
+     */
+    public int[] getOffsets(int column) {
+        checkVariableLength(column);
+        return (int[]) mColumns[column * 3 + 1];
+    }
+
+    public long getLong(int row, int column) {
+        checkRow(row);
+        return getLongs(column)[row];
+    }
+
+    public double getDouble(int row, int column) {
+        checkRow(row);
+        return getDoubles(column)[row];
+    }
+
+    public String getString(int row, int column) {
+        checkRow(row);
+        if (mTypes[column] != TYPE_STRING)
+            throw new IllegalStateException("Column " + column + " is not a string column.");
+        if (isNull(row, column))
+            return null;
+        int[] offsets = getOffsets(column);
+        return new String(getBytes(column), offsets[row], offsets[row + 1] - offsets[row],
+                UTF_8);
+    }
+
+    public byte[] getBlob(int row, int column) {
+        checkRow(row);
+        if (isNull(row, column))
+            return null;
+        int[] offsets = getOffsets(column);
+        int length = offsets[row + 1] - offsets[row];
+        byte[] result = new byte[length];
+        System.arraycopy(getBytes(column), offsets[row], result, 0, length);
+        return result;
+    }
+
+    private void checkRow(int row) {
+        if (row < 0 || row >= mRowCount)
+            throw new IndexOutOfBoundsException("Row " + row + " out of " + mRowCount);
+    }
+
+    private void checkType(int column, int type) {
+        if (mTypes[column] != type)
+            throw new IllegalStateException("Column " + column + " has type "
+                    + mTypes[column] + ", not " + type);
+    }
+
+    private void checkVariableLength(int column) {
+        int type = mTypes[column];
+        if (type != TYPE_STRING && type != TYPE_BLOB)
+            throw new IllegalStateException("Column " + column + " is not a string or "
+                    + "blob column.");
+    }
+}
@@ -38,6 +38,7 @@ import org.json.JSONException;
 import org.json.JSONObject;
 
 import java.lang.ref.WeakReference;
+import java.nio.ByteBuffer;
 import java.text.SimpleDateFormat;
 import java.util.ArrayList;
 import java.util.Date;
@@ -158,6 +159,10 @@ public final class SQLiteConnection implements CancellationSignal.OnCancelListen
     private static native long nativeExecuteForLastInsertedRowId(long connectionPtr, long statementPtr);
     private static native long nativeExecuteForCursorWindow(long connectionPtr, long statementPtr,
             long windowPtr, int startPos, int requiredPos, boolean countAllRows);
+    private static native int nativeExecuteBatch(long connectionPtr, long statementPtr,
+            ByteBuffer buffer, int length, int numRows, boolean returnRowIds, long[] results);
+    private static native Object[] nativeExecuteForColumns(long connectionPtr,
+            long statementPtr, int[] types, int maxRows);
     private static native int nativeGetDbLookaside(long connectionPtr);
     private static native void nativeCancel(long connectionPtr);
     private static native void nativeResetCancel(long connectionPtr, boolean cancelable);
@@ -165,6 +170,11 @@ public final class SQLiteConnection implements CancellationSignal.OnCancelListen
     private static native void nativeSetWalHook(long connectionPtr);
     private static native long nativeWalCheckpoint(long connectionPtr, String dbName);
     private static native long nativeSQLiteHandle(long connectionPtr, boolean acquire);
+    private static native long nativeSessionCreate(long connectionPtr, String[] tables);
+    private static native byte[] nativeSessionChangeset(long sessionPtr, boolean patchset);
+    private static native void nativeSessionDelete(long sessionPtr);
+    private static native void nativeApplyChangeset(long connectionPtr, byte[] changeset,
+            SQLiteChangesetConflictResolver resolver);
     private static native void nativeSetUpdateNotification(long connectionPtr, boolean enabled,
             boolean notifyRowId);
 
@@ -912,6 +922,134 @@ public final class SQLiteConnection implements CancellationSignal.OnCancelListen
         }
     }
 
+    /**
+     * Executes a statement once for every row of packed bind arguments in a single
+     * native call.  Execution stops at the first row that fails.
+     *
+     * @param sql                The SQL statement to execute.
+     * @param batchArgs          The rows of arguments to bind.
+     * @param returnRowIds       True to return the row id of the last inserted row for
+     *                           each row of arguments, false to return the number of
+     *                           changed rows.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return One result per row of arguments, -1 as row id if nothing was inserted.
+     * @throws SQLiteException            if an error occurs, such as a syntax error
+     *                                    or invalid number of bind arguments.  Rows
+     *                                    before the failing one have been executed.
+     * @throws OperationCanceledException if the operation was canceled.
+     */
+    public long[] executeBatch(String sql, SQLiteBatchArguments batchArgs,
+            boolean returnRowIds, CancellationSignal cancellationSignal) {
+        if (sql == null) {
+            throw new IllegalArgumentException("sql must not be null.");
+        }
+        if (batchArgs == null) {
+            throw new IllegalArgumentException("batchArgs must not be null.");
+        }
+
+        final int numRows = batchArgs.getRowCount();
+        Operation operation = mRecentOperations.beginOperation("executeBatch", sql, null);
+        final int cookie = operation.mCookie;
+        int executedRows = 0;
+        try {
+            final PreparedStatement statement = acquirePreparedStatement(sql);
+            operation.mType = statement.mType;
+            try {
+                throwIfStatementForbidden(statement);
+                if (batchArgs.getColumnCount() != statement.mNumParameters) {
+                    throw new SQLiteBindOrColumnIndexOutOfRangeException(
+                            "Expected " + statement.mNumParameters + " bind arguments but "
+                                    + batchArgs.getColumnCount() + " were provided.");
+                }
+                applyBlockGuardPolicy(statement);
+                attachCancellationSignal(cancellationSignal);
+                try {
+                    final long[] results = new long[numRows];
+                    executedRows = nativeExecuteBatch(mConnectionPtr, statement.getPtr(),
+                            batchArgs.getBuffer(), batchArgs.getLength(), numRows,
+                            returnRowIds, results);
+                    return results;
+                } finally {
+                    detachCancellationSignal(cancellationSignal);
+                }
+            } finally {
+                releasePreparedStatement(statement);
+            }
+        } catch (RuntimeException ex) {
+            mRecentOperations.failOperation(cookie, ex);
+            throw ex;
+        } finally {
+            if (mRecentOperations.endOperationDeferLog(cookie)) {
+                mRecentOperations.logOperation(cookie,
+                        "rows=" + executedRows + "/" + numRows);
+            }
+        }
+    }
+
+    /**
+     * Executes a query and returns its result column by column in primitive arrays.
+     *
+     * @param sql                The SQL statement to execute.
+     * @param bindArgs           The arguments to bind, or null if none.
+     * @param columnTypes        How to read each result column, one of the
+     *                           {@code SQLiteColumnarResult.TYPE_*} constants.
+     * @param maxRows            Maximum number of rows to read, or 0 for all.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return The result of the query.
+     * @throws SQLiteException            if an error occurs, such as a syntax error,
+     *                                    invalid number of bind arguments or a column
+     *                                    count not matching {@code columnTypes}.
+     * @throws OperationCanceledException if the operation was canceled.
+     */
+    public SQLiteColumnarResult executeForColumns(String sql, Object[] bindArgs,
+            int[] columnTypes, int maxRows, CancellationSignal cancellationSignal) {
+        if (sql == null) {
+            throw new IllegalArgumentException("sql must not be null.");
+        }
+        if (columnTypes == null || columnTypes.length == 0) {
+            throw new IllegalArgumentException("columnTypes must not be empty.");
+        }
+
+        final int[] types = columnTypes.clone();
+        int rowCount = -1;
+        Operation operation = mRecentOperations.beginOperation("executeForColumns", sql, bindArgs);
+        final int cookie = operation.mCookie;
+        try {
+            final PreparedStatement statement = acquirePreparedStatement(sql);
+            operation.mType = statement.mType;
+            try {
+                throwIfStatementForbidden(statement);
+                bindArguments(statement, bindArgs);
+                applyBlockGuardPolicy(statement);
+                attachCancellationSignal(cancellationSignal);
+                try {
+                    final Object[] columns = nativeExecuteForColumns(mConnectionPtr,
+                            statement.getPtr(), types, maxRows);
+                    if (types[0] == SQLiteColumnarResult.TYPE_LONG) {
+                        rowCount = ((long[]) columns[0]).length;
+                    } else if (types[0] == SQLiteColumnarResult.TYPE_DOUBLE) {
+                        rowCount = ((double[]) columns[0]).length;
+                    } else {
+                        rowCount = ((int[]) columns[1]).length - 1;
+                    }
+                    return new SQLiteColumnarResult(types, rowCount, columns);
+                } finally {
+                    detachCancellationSignal(cancellationSignal);
+                }
+            } finally {
+                releasePreparedStatement(statement);
+            }
+        } catch (RuntimeException ex) {
+            mRecentOperations.failOperation(cookie, ex);
+            throw ex;
+        } finally {
+            if (mRecentOperations.endOperationDeferLog(cookie)) {
+                mRecentOperations.logOperation(cookie, "columns=" + types.length
+                        + ", rows=" + rowCount);
+            }
+        }
+    }
+
     public int executeForCursorWindow(String sql, Object[] bindArgs, CursorWindow window,
             int startPos, int requiredPos, boolean countAllRows,
             CancellationSignal cancellationSignal) {
@@ -979,6 +1117,74 @@ public final class SQLiteConnection implements CancellationSignal.OnCancelListen
         return new Pair<>(walPages, checkpointedPages);
     }
 
+    /**
+     * Runs an operation while recording its changes to the given tables.
+     *
+     * <p>Must be called inside a transaction, so that the operation and the
+     * recorded changes are committed together.</p>
+     *
+     * @param tables    The tables to record, or null for all tables.
+     * @param patchset  True to return a patchset, false to return a changeset.
+     * @param operation The operation to run on this connection.
+     * @return The recorded changes, or null if nothing was changed.
+     * @throws SQLiteException if an error occurs, such as a table without
+     *                         a primary key.
+     */
+    public byte[] captureChangeset(String[] tables, boolean patchset, Runnable operation) {
+        if (operation == null) {
+            throw new IllegalArgumentException("operation must not be null.");
+        }
+
+        Operation op = mRecentOperations.beginOperation("captureChangeset", null, null);
+        final int cookie = op.mCookie;
+        int size = 0;
+        try {
+            final long sessionPtr = nativeSessionCreate(mConnectionPtr, tables);
+            try {
+                operation.run();
+                byte[] result = nativeSessionChangeset(sessionPtr, patchset);
+                size = (result != null) ? result.length : 0;
+                return result;
+            } finally {
+                nativeSessionDelete(sessionPtr);
+            }
+        } catch (RuntimeException ex) {
+            mRecentOperations.failOperation(cookie, ex);
+            throw ex;
+        } finally {
+            if (mRecentOperations.endOperationDeferLog(cookie)) {
+                mRecentOperations.logOperation(cookie, "size=" + size);
+            }
+        }
+    }
+
+    /**
+     * Applies a changeset or patchset recorded by {@link #captureChangeset}.
+     *
+     * @param changeset The changeset or patchset to apply.
+     * @param resolver  The resolver of conflicts, or null to fail on any conflict.
+     * @throws SQLiteException if an error occurs or a conflict aborts the apply,
+     *                         in which case no change is applied.
+     */
+    public void applyChangeset(byte[] changeset, SQLiteChangesetConflictResolver resolver) {
+        if (changeset == null) {
+            throw new IllegalArgumentException("changeset must not be null.");
+        }
+
+        Operation operation = mRecentOperations.beginOperation("applyChangeset", null, null);
+        final int cookie = operation.mCookie;
+        try {
+            nativeApplyChangeset(mConnectionPtr, changeset, resolver);
+        } catch (RuntimeException ex) {
+            mRecentOperations.failOperation(cookie, ex);
+            throw ex;
+        } finally {
+            if (mRecentOperations.endOperationDeferLog(cookie)) {
+                mRecentOperations.logOperation(cookie, "size=" + changeset.length);
+            }
+        }
+    }
+
     /*package*/ PreparedStatement acquirePreparedStatement(String sql) {
         PreparedStatement statement = mPreparedStatementCache.get(sql);
         boolean skipCache = false;
@@ -32,6 +32,7 @@ import org.json.JSONException;
 import org.json.JSONObject;
 
 import java.io.Closeable;
+import java.io.IOException;
 import java.lang.ref.WeakReference;
 import java.util.ArrayList;
 import java.util.Map;
@@ -85,6 +86,7 @@ public final class SQLiteConnectionPool implements Closeable {
     // Keep reference to SQLiteDatabase which owns this connection pool.
     private final WeakReference<SQLiteDatabase> mDB;
     private volatile SQLiteChangeListener mChangeListener;
+    private volatile SQLiteChangeNotifier mChangeNotifier;
     private volatile SQLiteTrace mTraceCallback;
     private volatile SQLiteCheckpointListener mCheckpointListener;
 
@@ -245,6 +247,7 @@ public final class SQLiteConnectionPool implements Closeable {
             // when finalized because we don't know what state the connections
             // themselves will be in.  The finalizer is really just here for CloseGuard.
             // The connections will take care of themselves when their own finalizers run.
+            SQLiteChangeNotifier notifier;
             synchronized (mLock) {
                 throwIfClosedLocked();
 
@@ -252,6 +255,9 @@ public final class SQLiteConnectionPool implements Closeable {
 
                 closeAvailableConnectionsAndLogExceptionsLocked();
 
+                notifier = mChangeNotifier;
+                mChangeNotifier = null;
+
                 final int pendingCount = mAcquiredConnections.size();
                 if (pendingCount != 0) {
                     Log.i(TAG, "The connection pool for " + mConfiguration.label
@@ -262,6 +268,10 @@ public final class SQLiteConnectionPool implements Closeable {
 
                 wakeConnectionWaitersLocked();
             }
+
+            // Closed out of lock since the watcher thread may be dispatching.
+            if (notifier != null)
+                notifier.close();
         }
     }
 
@@ -1093,26 +1103,74 @@ public final class SQLiteConnectionPool implements Closeable {
     }
 
     void setChangeListener(SQLiteChangeListener listener, boolean notifyRowId) {
-        boolean notifyEnabled = (listener != null);
-        if (!notifyEnabled)
+        if (listener == null)
             notifyRowId = false;
 
         synchronized (mLock) {
-            if (mConfiguration.updateNotificationEnabled != notifyEnabled ||
-                    mConfiguration.updateNotificationRowID != notifyRowId) {
-                mConfiguration.updateNotificationEnabled = notifyEnabled;
-                mConfiguration.updateNotificationRowID = notifyRowId;
+            mChangeListener = listener;
+            updateNotificationLocked(notifyRowId);
+        }
+    }
 
-                closeExcessConnectionsAndLogExceptionsLocked();
-                reconfigureAllConnectionsLocked();
+    boolean isCrossProcessNotificationEnabled() {
+        return mChangeNotifier != null;
+    }
+
+    void setCrossProcessNotification(boolean enabled) {
+        SQLiteChangeNotifier closing = null;
+        synchronized (mLock) {
+            throwIfClosedLocked();
+
+            if (enabled == (mChangeNotifier != null))
+                return;
+
+            if (enabled) {
+                if (mConfiguration.isInMemoryDb())
+                    throw new IllegalStateException(
+                            "Cross-process notification is not supported for in-memory databases.");
+                try {
+                    mChangeNotifier = new SQLiteChangeNotifier(mConfiguration.path, this);
+                } catch (IOException e) {
+                    throw new SQLiteCantOpenDatabaseException(e.getMessage());
+                }
+            } else {
+                closing = mChangeNotifier;
+                mChangeNotifier = null;
             }
+            updateNotificationLocked(mConfiguration.updateNotificationRowID);
+        }
 
-            mChangeListener = listener;
+        if (closing != null)
+            closing.close();
+    }
+
+    // Committed changes are collected if they are listened or published.
+    private void updateNotificationLocked(boolean notifyRowId) {
+        boolean notifyEnabled = mChangeListener != null || mChangeNotifier != null;
+        if (!notifyEnabled)
+            notifyRowId = false;
+
+        if (mConfiguration.updateNotificationEnabled != notifyEnabled ||
+                mConfiguration.updateNotificationRowID != notifyRowId) {
+            mConfiguration.updateNotificationEnabled = notifyEnabled;
+            mConfiguration.updateNotificationRowID = notifyRowId;
+
+            closeExcessConnectionsAndLogExceptionsLocked();
+            reconfigureAllConnectionsLocked();
         }
     }
 
     void notifyChanges(String dbName, String table,
             long[] insertIds, long[] updateIds, long[] deleteIds) {
+        SQLiteChangeNotifier notifier = mChangeNotifier;
+        if (notifier != null && "main".equals(dbName))
+            notifier.publish(table);
+
+        dispatchChanges(dbName, table, insertIds, updateIds, deleteIds);
+    }
+
+    void dispatchChanges(String dbName, String table,
+            long[] insertIds, long[] updateIds, long[] deleteIds) {
         SQLiteDatabase db = mDB.get();
         SQLiteChangeListener listener = mChangeListener;
 
@@ -243,6 +243,20 @@ public final class SQLiteDatabase extends SQLiteClosable {
      */
     public static final int ENABLE_IO_TRACE = 0x00000100;
 
+    /**
+     * Open flag: Flag for {@link #openDatabase} to open the database with page checksums.
+     * <p/>
+     * Checksum of each page is kept in a sidecar file with "-cksum" suffix and verified
+     * whenever the page is read from disk, so that corruption is reported with the exact
+     * page number as soon as possible. Page mismatches are reported only, without failing
+     * the read. Corrupted WAL frames are never checkpointed into the database file.
+     * See {@link SQLiteDebug#getLastChecksumStats()}.
+     * <p/>
+     * Once enabled, the database should always be opened with this flag. Opening without it
+     * deletes the sidecar. This flag is ignored if {@link #ENABLE_IO_TRACE} is set.
+     */
+    public static final int ENABLE_PAGE_CHECKSUM = 0x00000200;
+
     /**
      * Open flag: Flag for {@link #openDatabase} to create the database file if it does not
      * already exist.
@@ -925,6 +939,8 @@ public final class SQLiteDatabase extends SQLiteClosable {
         deleted |= new File(file.getPath() + "-journal").delete();
         deleted |= new File(file.getPath() + "-shm").delete();
         deleted |= new File(file.getPath() + "-wal").delete();
+        deleted |= new File(file.getPath() + "-cksum").delete();
+        deleted |= new File(file.getPath() + SQLiteChangeNotifier.SUFFIX).delete();
 
         File dir = file.getParentFile();
         if (dir != null) {
@@ -999,6 +1015,11 @@ public final class SQLiteDatabase extends SQLiteClosable {
     private void openInner(byte[] password, SQLiteCipherSpec cipher, int poolSize) {
         synchronized (mLock) {
             assert mConnectionPoolLocked == null;
+            if ((mConfigurationLocked.openFlags & ENABLE_PAGE_CHECKSUM) == 0 &&
+                    !mConfigurationLocked.isInMemoryDb()) {
+                // Pages written without checksums would be reported as corrupted later.
+                new File(mConfigurationLocked.path + "-cksum").delete();
+            }
             mConnectionPoolLocked = SQLiteConnectionPool.open(this, mConfigurationLocked,
                     password, cipher, poolSize);
         }
@@ -1457,6 +1478,82 @@ public final class SQLiteDatabase extends SQLiteClosable {
         return rawQueryWithFactory(null, sql, selectionArgs, null, cancellationSignal);
     }
 
+    /**
+     * Runs the provided SQL and returns the whole result set column by column.
+     * <p>
+     * Each result column is read in native code in a single pass into primitive arrays,
+     * which suits queries reading a few numeric columns over many rows much better than
+     * a {@link Cursor}, where every cell costs a separate call.  All rows are held in
+     * memory, so bound large results with {@code maxRows} or LIMIT.
+     * </p>
+     *
+     * @param sql                the SQL query. The SQL string must not be ; terminated
+     * @param selectionArgs      You may include ?s in where clause in the query,
+     *                           which will be replaced by the values from selectionArgs.
+     * @param columnTypes        How to read each result column, one of the
+     *                           {@code SQLiteColumnarResult.TYPE_*} constants.  Must have
+     *                           one entry per result column.
+     * @param maxRows            Maximum number of rows to read, or 0 for all.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return The result of the query.
+     */
+    public SQLiteColumnarResult rawQueryColumnar(String sql, Object[] selectionArgs,
+            int[] columnTypes, int maxRows, CancellationSignal cancellationSignal) {
+        acquireReference();
+        try {
+            return getThreadSession().executeForColumns(sql, selectionArgs, columnTypes,
+                    maxRows, getThreadDefaultConnectionFlags(true /*readOnly*/),
+                    cancellationSignal);
+        } finally {
+            releaseReference();
+        }
+    }
+
+    /**
+     * Runs an operation in a transaction and returns its changes to the given tables
+     * as a changeset or patchset, which can be applied to another database with
+     * {@link #applyChangeset}.
+     * <p>
+     * Changes are recorded by the SQLite session extension, so only tables with
+     * a declared primary key are recorded.  A patchset is more compact than a
+     * changeset, but lacks the original values of updated and deleted rows and
+     * thus detects fewer conflicts.
+     * </p>
+     *
+     * @param tables    the tables to record, or null for all tables
+     * @param patchset  true to return a patchset, false to return a changeset
+     * @param operation the operation to run, it must access this database from the
+     *                  calling thread
+     * @return the recorded changes, or null if nothing was changed
+     */
+    public byte[] captureChangeset(String[] tables, boolean patchset, Runnable operation) {
+        acquireReference();
+        try {
+            return getThreadSession().captureChangeset(tables, patchset, operation,
+                    getThreadDefaultConnectionFlags(false /*readOnly*/), null);
+        } finally {
+            releaseReference();
+        }
+    }
+
+    /**
+     * Applies a changeset or patchset returned by {@link #captureChangeset}.  Either
+     * all changes are applied, or none of them if an error occurs or a conflict is
+     * resolved as {@link SQLiteChangesetConflictResolver#RESULT_ABORT}.
+     *
+     * @param changeset the changeset or patchset to apply
+     * @param resolver  the resolver of conflicts, or null to fail on any conflict
+     */
+    public void applyChangeset(byte[] changeset, SQLiteChangesetConflictResolver resolver) {
+        acquireReference();
+        try {
+            getThreadSession().applyChangeset(changeset, resolver,
+                    getThreadDefaultConnectionFlags(false /*readOnly*/));
+        } finally {
+            releaseReference();
+        }
+    }
+
     /**
      * Runs the provided SQL and returns a cursor over the result set.
      *
@@ -2360,6 +2457,39 @@ public final class SQLiteDatabase extends SQLiteClosable {
         }
     }
 
+    /**
+     * Returns whether changes are notified across processes.
+     *
+     * @return true if cross-process notification is enabled
+     * @see #setCrossProcessNotification(boolean)
+     */
+    public boolean isCrossProcessNotificationEnabled() {
+        synchronized (mLock) {
+            throwIfNotOpenLocked();
+            return mConnectionPoolLocked.isCrossProcessNotificationEnabled();
+        }
+    }
+
+    /**
+     * Enable or disable table-level change notifications across processes.
+     *
+     * <p>When enabled, tables changed by this process are published to the
+     * other processes opening the same database with it enabled, and tables
+     * changed by them are reported to the {@link SQLiteChangeListener} of this
+     * database without RowIDs. It must be enabled on both sides. Table names
+     * longer than 111 bytes are reported truncated.</p>
+     *
+     * @param enabled whether to enable cross-process notification
+     * @throws IllegalStateException if the database is in-memory
+     * @see #setChangeListener(SQLiteChangeListener, boolean)
+     */
+    public void setCrossProcessNotification(boolean enabled) {
+        synchronized (mLock) {
+            throwIfNotOpenLocked();
+            mConnectionPoolLocked.setCrossProcessNotification(enabled);
+        }
+    }
+
     /**
      * Returns the {@link SQLiteTrace} object bound to this database.
      *
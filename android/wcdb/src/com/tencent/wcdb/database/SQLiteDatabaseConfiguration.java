@@ -131,7 +131,13 @@ public final class SQLiteDatabaseConfiguration {
         synchronousMode = SQLiteDatabase.SYNCHRONOUS_FULL;
         maxSqlCacheSize = 25;
         locale = Locale.getDefault();
-        vfsName = (openFlags & SQLiteDatabase.ENABLE_IO_TRACE) != 0 ? "vfslog" : null;
+        if ((openFlags & SQLiteDatabase.ENABLE_IO_TRACE) != 0) {
+            vfsName = "vfslog";
+        } else if ((openFlags & SQLiteDatabase.ENABLE_PAGE_CHECKSUM) != 0) {
+            vfsName = "vfscksum";
+        } else {
+            vfsName = null;
+        }
     }
 
     /**
@@ -36,6 +36,7 @@ public final class SQLiteDebug {
     private static native int nativeGetLastErrorLine();
     private static native void nativeSetIOTraceFlags(int flags);
     private static native void nativeGetIOTraceStats(long connectionPtr, ArrayList<IOTraceStats> statsList);
+    private static native void nativeGetChecksumStats(long connectionPtr, ArrayList<ChecksumStats> statsList);
 
     static {
         // Ensure libwcdb.so is loaded.
@@ -164,9 +165,42 @@ public final class SQLiteDebug {
         nativeSetIOTraceFlags(flags);
     }
 
+    /**
+     * Page checksum statistics of databases opened with
+     * {@link SQLiteDatabase#ENABLE_PAGE_CHECKSUM}.
+     */
+    public static class ChecksumStats {
+        public String dbName;
+        public String path;
+        public long verifiedPages;
+        public long mismatchedPages;
+        public long mismatchedFrames;
+        // Checksums dropped on open since they may not agree with pages, e.g. after a crash.
+        public long unknownPages;
+
+        // Distinct page numbers failed verification, and the tables or indexes owning them.
+        // Owner is null if it cannot be resolved.
+        public int[] corruptedPages;
+        public String[] corruptedPageOwners;
+
+        @SuppressLint("DefaultLocale")
+        @Override
+        public String toString() {
+            StringBuilder sb = new StringBuilder();
+            sb.append(String.format("[%s | %s] verified: %d, mismatched pages: %d, mismatched frames: %d, unknown: %d",
+                    dbName, path, verifiedPages, mismatchedPages, mismatchedFrames, unknownPages));
+            for (int i = 0; i < corruptedPages.length; i++) {
+                sb.append(i == 0 ? ", corrupted: " : ", ")
+                        .append(corruptedPages[i]).append('(').append(corruptedPageOwners[i]).append(')');
+            }
+            return sb.toString();
+        }
+    }
+
 
     private static volatile int sLastErrorLine;
     private static volatile ArrayList<IOTraceStats> sLastIOTraceStats;
+    private static volatile ArrayList<ChecksumStats> sLastChecksumStats;
 
     public static int getLastErrorLine() {
         return sLastErrorLine;
@@ -176,18 +210,25 @@ public final class SQLiteDebug {
         return sLastIOTraceStats;
     }
 
+    public static ArrayList<ChecksumStats> getLastChecksumStats() {
+        return sLastChecksumStats;
+    }
+
     static void collectLastIOTraceStats(SQLiteConnection connection) {
         try {
             sLastErrorLine = nativeGetLastErrorLine();
 
             ArrayList<IOTraceStats> stats = new ArrayList<>();
+            ArrayList<ChecksumStats> checksumStats = new ArrayList<>();
             long ptr = connection.getNativeHandle(null);
             if (ptr != 0) {
                 nativeGetIOTraceStats(ptr, stats);
+                nativeGetChecksumStats(ptr, checksumStats);
                 connection.endNativeHandle(null);
             }
 
             sLastIOTraceStats = stats;
+            sLastChecksumStats = checksumStats;
         } catch (RuntimeException e) {
             Log.e(TAG, "Cannot collect I/O trace statistics: " + e.getMessage());
         }
@@ -198,13 +239,16 @@ public final class SQLiteDebug {
             sLastErrorLine = nativeGetLastErrorLine();
 
             ArrayList<IOTraceStats> stats = new ArrayList<>();
+            ArrayList<ChecksumStats> checksumStats = new ArrayList<>();
             long ptr = db.acquireNativeConnectionHandle("collectIoStat", false, false);
             if (ptr != 0) {
                 nativeGetIOTraceStats(ptr, stats);
+                nativeGetChecksumStats(ptr, checksumStats);
             }
             db.releaseNativeConnection(ptr, null);
 
             sLastIOTraceStats = stats;
+            sLastChecksumStats = checksumStats;
         } catch (RuntimeException e) {
             Log.e(TAG, "Cannot collect I/O trace statistics: " + e.getMessage());
         }
@@ -748,6 +748,76 @@ public final class SQLiteSession {
         }
     }
 
+    /**
+     * Executes a query and returns its result column by column in primitive arrays.
+     *
+     * @param sql                The SQL statement to execute.
+     * @param bindArgs           The arguments to bind, or null if none.
+     * @param columnTypes        How to read each result column, one of the
+     *                           {@code SQLiteColumnarResult.TYPE_*} constants.
+     * @param maxRows            Maximum number of rows to read, or 0 for all.
+     * @param connectionFlags    The connection flags to use if a connection must be
+     *                           acquired by this operation.  Refer to {@link SQLiteConnectionPool}.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return The result of the query.
+     * @throws SQLiteException            if an error occurs, such as a syntax error
+     *                                    or invalid number of bind arguments.
+     * @throws OperationCanceledException if the operation was canceled.
+     */
+    public SQLiteColumnarResult executeForColumns(String sql, Object[] bindArgs,
+            int[] columnTypes, int maxRows, int connectionFlags,
+            CancellationSignal cancellationSignal) {
+        if (sql == null) {
+            throw new IllegalArgumentException("sql must not be null.");
+        }
+
+        acquireConnection(sql, connectionFlags, false, cancellationSignal); // might throw
+        try {
+            return mConnection.executeForColumns(sql, bindArgs, columnTypes, maxRows,
+                    cancellationSignal); // might throw
+        } finally {
+            releaseConnection(); // might throw
+        }
+    }
+
+    /**
+     * Executes a statement once for every row of packed bind arguments.
+     *
+     * @param sql                The SQL statement to execute.
+     * @param batchArgs          The rows of arguments to bind.
+     * @param returnRowIds       True to return the last inserted row id of each row,
+     *                           false to return the number of changed rows.
+     * @param connectionFlags    The connection flags to use if a connection must be
+     *                           acquired by this operation.  Refer to {@link SQLiteConnectionPool}.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return One result per row of arguments.
+     * @throws SQLiteException            if an error occurs, such as a syntax error
+     *                                    or invalid number of bind arguments.
+     * @throws OperationCanceledException if the operation was canceled.
+     */
+    public long[] executeBatch(String sql, SQLiteBatchArguments batchArgs,
+            boolean returnRowIds, int connectionFlags, CancellationSignal cancellationSignal) {
+        if (sql == null) {
+            throw new IllegalArgumentException("sql must not be null.");
+        }
+
+        switch (DatabaseUtils.getSqlStatementType(sql)) {
+            case DatabaseUtils.STATEMENT_BEGIN:
+            case DatabaseUtils.STATEMENT_COMMIT:
+            case DatabaseUtils.STATEMENT_ABORT:
+                throw new IllegalArgumentException(
+                        "Transaction statements cannot be executed in batch.");
+        }
+
+        acquireConnection(sql, connectionFlags, false, cancellationSignal); // might throw
+        try {
+            return mConnection.executeBatch(sql, batchArgs, returnRowIds,
+                    cancellationSignal); // might throw
+        } finally {
+            releaseConnection(); // might throw
+        }
+    }
+
     /**
      * Executes a statement and populates the specified {@link CursorWindow}
      * with a range of results.  Returns the number of rows that were counted
@@ -796,6 +866,54 @@ public final class SQLiteSession {
         }
     }
 
+    /**
+     * Runs an operation in a transaction while recording its changes to the
+     * given tables, see {@link SQLiteConnection#captureChangeset}.
+     *
+     * @param tables             The tables to record, or null for all tables.
+     * @param patchset           True to return a patchset, false to return a changeset.
+     * @param operation          The operation to run, it must access the database
+     *                           from the calling thread.
+     * @param connectionFlags    The connection flags to use if a connection must be
+     *                           acquired by this operation.  Refer to {@link SQLiteConnectionPool}.
+     * @param cancellationSignal A signal to cancel the operation in progress, or null if none.
+     * @return The recorded changes, or null if nothing was changed.
+     * @throws SQLiteException            if an error occurs.
+     * @throws OperationCanceledException if the operation was canceled.
+     */
+    public byte[] captureChangeset(String[] tables, boolean patchset, Runnable operation,
+            int connectionFlags, CancellationSignal cancellationSignal) {
+        beginTransaction(TRANSACTION_MODE_IMMEDIATE, null, connectionFlags,
+                cancellationSignal); // might throw
+        try {
+            byte[] result = mConnection.captureChangeset(tables, patchset,
+                    operation); // might throw
+            setTransactionSuccessful();
+            return result;
+        } finally {
+            endTransaction(cancellationSignal); // might throw
+        }
+    }
+
+    /**
+     * Applies a changeset or patchset, see {@link SQLiteConnection#applyChangeset}.
+     *
+     * @param changeset       The changeset or patchset to apply.
+     * @param resolver        The resolver of conflicts, or null to fail on any conflict.
+     * @param connectionFlags The connection flags to use if a connection must be
+     *                        acquired by this operation.  Refer to {@link SQLiteConnectionPool}.
+     * @throws SQLiteException if an error occurs.
+     */
+    public void applyChangeset(byte[] changeset, SQLiteChangesetConflictResolver resolver,
+            int connectionFlags) {
+        acquireConnection(null, connectionFlags, false, null); // might throw
+        try {
+            mConnection.applyChangeset(changeset, resolver); // might throw
+        } finally {
+            releaseConnection(); // might throw
+        }
+    }
+
     public Pair<Integer, Integer> walCheckpoint(String dbName, int connectionFlags) {
         acquireConnection(null, connectionFlags, false, null);
         try {
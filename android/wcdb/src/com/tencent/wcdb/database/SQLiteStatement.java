@@ -134,6 +134,48 @@ public final class SQLiteStatement extends SQLiteProgram {
         }
     }
 
+    /**
+     * Execute this INSERT statement once for every row of {@code batchArgs} in a single
+     * native call, ignoring arguments bound to this statement.  Wrap the call in a
+     * transaction to avoid committing each row separately.
+     *
+     * @param batchArgs rows of bind arguments
+     * @return row ID of the inserted row for each row of arguments, or -1 if none
+     *
+     * @throws SQLException If the SQL string is invalid or a row fails.  Rows before
+     * the failing one have been executed.
+     */
+    public long[] executeBatchInsert(SQLiteBatchArguments batchArgs) {
+        return executeBatch(batchArgs, true);
+    }
+
+    /**
+     * Execute this UPDATE or DELETE statement once for every row of {@code batchArgs}
+     * in a single native call, ignoring arguments bound to this statement.
+     *
+     * @param batchArgs rows of bind arguments
+     * @return number of rows affected for each row of arguments
+     *
+     * @throws SQLException If the SQL string is invalid or a row fails.  Rows before
+     * the failing one have been executed.
+     */
+    public long[] executeBatchUpdateDelete(SQLiteBatchArguments batchArgs) {
+        return executeBatch(batchArgs, false);
+    }
+
+    private long[] executeBatch(SQLiteBatchArguments batchArgs, boolean returnRowIds) {
+        acquireReference();
+        try {
+            return getSession().executeBatch(
+                    getSql(), batchArgs, returnRowIds, getConnectionFlags(), null);
+        } catch (SQLiteDatabaseCorruptException ex) {
+            checkCorruption(ex);
+            throw ex;
+        } finally {
+            releaseReference();
+        }
+    }
+
     /**
      * Execute a statement that returns a 1 by 1 table with a numeric value.
      * For example, SELECT COUNT(*) FROM table;
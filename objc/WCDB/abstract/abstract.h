@@ -39,14 +39,19 @@
 
 #include <WCDB/statement.hpp>
 #include <WCDB/statement_alter_table.hpp>
+#include <WCDB/statement_analyze.hpp>
 #include <WCDB/statement_attach.hpp>
 #include <WCDB/statement_create_index.hpp>
 #include <WCDB/statement_create_table.hpp>
+#include <WCDB/statement_create_trigger.hpp>
+#include <WCDB/statement_create_view.hpp>
 #include <WCDB/statement_create_virtual_table.hpp>
 #include <WCDB/statement_delete.hpp>
 #include <WCDB/statement_detach.hpp>
 #include <WCDB/statement_drop_index.hpp>
 #include <WCDB/statement_drop_table.hpp>
+#include <WCDB/statement_drop_trigger.hpp>
+#include <WCDB/statement_drop_view.hpp>
 #include <WCDB/statement_explain.hpp>
 #include <WCDB/statement_insert.hpp>
 #include <WCDB/statement_pragma.hpp>
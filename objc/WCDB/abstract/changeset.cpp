@@ -0,0 +1,116 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/changeset.hpp>
+#include <sqlcipher/sqlite3.h>
+
+namespace WCDB {
+
+#ifdef SQLITE_ENABLE_SESSION
+
+ChangesetGroup::ChangesetGroup() : m_group(nullptr)
+{
+}
+
+ChangesetGroup::~ChangesetGroup()
+{
+    if (m_group) {
+        sqlite3changegroup_delete((sqlite3_changegroup *) m_group);
+    }
+}
+
+bool ChangesetGroup::add(const Changeset &changeset, Error &error)
+{
+    if (changeset.empty()) {
+        error.reset();
+        return true;
+    }
+    if (!m_group) {
+        int rc = sqlite3changegroup_new((sqlite3_changegroup **) &m_group);
+        if (rc != SQLITE_OK) {
+            m_group = nullptr;
+            Error::ReportSQLiteGlobal(rc, sqlite3_errstr(rc), &error);
+            return false;
+        }
+    }
+    int rc = sqlite3changegroup_add((sqlite3_changegroup *) m_group,
+                                    (int) changeset.size(),
+                                    (void *) changeset.data());
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLiteGlobal(rc, sqlite3_errstr(rc), &error);
+        return false;
+    }
+    error.reset();
+    return true;
+}
+
+bool ChangesetGroup::output(Changeset &changeset, Error &error)
+{
+    changeset.clear();
+    if (!m_group) {
+        error.reset();
+        return true;
+    }
+    int size = 0;
+    void *data = nullptr;
+    int rc = sqlite3changegroup_output((sqlite3_changegroup *) m_group,
+                                       &size, &data);
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLiteGlobal(rc, sqlite3_errstr(rc), &error);
+        return false;
+    }
+    changeset.assign((unsigned char *) data, (unsigned char *) data + size);
+    sqlite3_free(data);
+    error.reset();
+    return true;
+}
+
+#else //SQLITE_ENABLE_SESSION
+
+ChangesetGroup::ChangesetGroup() : m_group(nullptr)
+{
+}
+
+ChangesetGroup::~ChangesetGroup()
+{
+}
+
+bool ChangesetGroup::add(const Changeset &changeset, Error &error)
+{
+    Error::ReportSQLiteGlobal(SQLITE_MISUSE, "Session is not enabled",
+                              &error);
+    return false;
+}
+
+bool ChangesetGroup::output(Changeset &changeset, Error &error)
+{
+    Error::ReportSQLiteGlobal(SQLITE_MISUSE, "Session is not enabled",
+                              &error);
+    return false;
+}
+
+#endif //SQLITE_ENABLE_SESSION
+
+bool ChangesetGroup::isEmpty() const
+{
+    return m_group == nullptr;
+}
+
+} //namespace WCDB
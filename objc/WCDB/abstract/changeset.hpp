@@ -0,0 +1,74 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef changeset_hpp
+#define changeset_hpp
+
+#include <WCDB/error.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace WCDB {
+
+//Changeset or patchset generated by session extension
+typedef std::vector<unsigned char> Changeset;
+
+//changeset, sequence of the commit
+typedef std::function<void(const Changeset &, uint64_t)> SessionObserver;
+
+enum class ChangesetConflict : int {
+    Data = 1,
+    NotFound = 2,
+    Conflict = 3,
+    Constraint = 4,
+    ForeignKey = 5,
+};
+
+enum class ChangesetResolution : int {
+    Omit = 0,
+    Replace = 1, //only for [Data] and [Conflict]
+    Abort = 2,
+};
+
+typedef std::function<ChangesetResolution(const std::string &,
+                                          ChangesetConflict)>
+    ChangesetConflictResolver;
+
+//[ChangesetGroup] combines changesets, or patchsets, into one.
+class ChangesetGroup {
+public:
+    ChangesetGroup();
+    ~ChangesetGroup();
+
+    bool add(const Changeset &changeset, Error &error);
+    bool output(Changeset &changeset, Error &error);
+    bool isEmpty() const;
+
+protected:
+    ChangesetGroup(const ChangesetGroup &) = delete;
+    ChangesetGroup &operator=(const ChangesetGroup &) = delete;
+
+    void *m_group;
+};
+
+} //namespace WCDB
+
+#endif /* changeset_hpp */
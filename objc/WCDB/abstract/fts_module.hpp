@@ -25,6 +25,7 @@
 #include <sqlcipher/fts3_tokenizer.h>
 #include <sqlcipher/sqlite3.h>
 #include <stdlib.h>
+#include <string.h>
 
 namespace WCDB {
 
@@ -22,6 +22,7 @@
 #define fts_modules_hpp
 
 #include <WCDB/spin.hpp>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -18,8 +18,8 @@
  * limitations under the License.
  */
 
-#include <WCDB/File.hpp>
-#include <WCDB/Path.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/path.hpp>
 #ifndef COCOAPODS
 #include <WCDB/SQLiteRepairKit.h>
 #else
@@ -28,13 +28,20 @@
 #include <WCDB/handle.hpp>
 #include <WCDB/handle_statement.hpp>
 #include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/pragma.hpp>
 #include <WCDB/statement.hpp>
+#include <WCDB/statement_pragma.hpp>
 #include <WCDB/statement_transaction.hpp>
 #include <sqlcipher/sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
 namespace WCDB {
 
 const std::string Handle::backupSuffix("-backup");
+const int Handle::cancellationCheckInterval = 1000;
 
 static void GlobalLog(void *userInfo, int code, const char *message)
 {
@@ -49,12 +56,54 @@ const auto UNUSED_UNIQUE_ID = []() {
     return nullptr;
 }();
 
+const char *Handle::GetSQLiteVersion()
+{
+    return sqlite3_libversion();
+}
+
+bool Handle::IsPageVTableSupported()
+{
+    //ENABLE_DBPAGE_VTAB is missing in compile options of some versions,
+    //e.g. 3.27, so that the table is probed instead
+    static const bool s_supported = []() {
+        sqlite3 *db = nullptr;
+        sqlite3_stmt *stmt = nullptr;
+        bool supported =
+            sqlite3_open(":memory:", &db) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, "SELECT data FROM sqlite_dbpage", -1,
+                               &stmt, nullptr) == SQLITE_OK;
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return supported;
+    }();
+    return s_supported;
+}
+
+int Handle::GetCorruptCode()
+{
+    return SQLITE_CORRUPT;
+}
+
 Handle::Handle(const std::string &p)
     : m_handle(nullptr)
     , m_tag(InvalidTag)
     , path(p)
+    , m_cancellation(nullptr)
+    , m_steppingCancellation(nullptr)
+    , m_errorHistory({0, 0, SQLITE_OK})
+    , m_sortBudgeted(false)
+    , m_defaultWorkerThreads(0)
+    , m_defaultCacheSize(0)
+    , m_session(nullptr)
+    , m_sessionPatchset(false)
+    , m_sessionObserver(nullptr)
+    , m_sessionSequence(0)
     , m_performanceTrace(nullptr)
     , m_sqlTrace(nullptr)
+    , m_busyTimeout(0)
+    , m_busyHandlerReleased(false)
+    , m_busyWait(0)
+    , m_busyRetries(0)
     , m_cost(0)
     , m_aggregation(false)
 {
@@ -83,9 +132,11 @@ bool Handle::open()
 
 void Handle::close()
 {
+    endSession();
     int rc = sqlite3_close((sqlite3 *) m_handle);
     if (rc == SQLITE_OK) {
         m_handle = nullptr;
+        m_cipherKey.clear();
         m_error.reset();
         return;
     }
@@ -100,7 +151,7 @@ void Handle::setupTrace()
     if (m_sqlTrace) {
         flag |= SQLITE_TRACE_STMT;
     }
-    if (m_performanceTrace) {
+    if (m_performanceTrace || !m_statementObservers.empty()) {
         flag |= SQLITE_TRACE_PROFILE;
     }
     if (flag > 0) {
@@ -118,6 +169,12 @@ void Handle::setupTrace()
                     } break;
                     case SQLITE_TRACE_PROFILE: {
                         sqlite3_int64 *cost = (sqlite3_int64 *) X;
+                        if (!handle->m_statementObservers.empty()) {
+                            handle->observeStatement(stmt, *cost);
+                        }
+                        if (!handle->m_performanceTrace) {
+                            break;
+                        }
                         const char *sql = sqlite3_sql(stmt);
 
                         //report last trace
@@ -153,6 +210,142 @@ void Handle::setPerformanceTrace(const PerformanceTrace &trace)
     setupTrace();
 }
 
+void Handle::registerStatementObserver(const std::string &name,
+                                       const StatementObserver &observer)
+{
+    bool observed = !m_statementObservers.empty();
+    if (observer) {
+        m_statementObservers[name] = observer;
+    } else {
+        m_statementObservers.erase(name);
+    }
+    if (observed == !m_statementObservers.empty()) {
+        return;
+    }
+    m_busyWait = 0;
+    m_busyRetries = 0;
+    if (!observed) {
+        takeBusyHandler();
+    } else {
+        releaseBusyHandler();
+        m_busyHandlerReleased = false;
+    }
+    setupTrace();
+}
+
+void Handle::takeBusyHandler()
+{
+    //Keep the waiting behavior of busy_timeout while timing it
+    m_busyTimeout = 0;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2((sqlite3 *) m_handle, "PRAGMA busy_timeout", -1,
+                           &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        m_busyTimeout = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_busy_handler((sqlite3 *) m_handle, Handle::BusyHandler, this);
+    m_busyHandlerReleased = false;
+}
+
+void Handle::releaseBusyHandler()
+{
+    if (!m_busyHandlerReleased) {
+        sqlite3_busy_timeout((sqlite3 *) m_handle, m_busyTimeout);
+        m_busyHandlerReleased = true;
+    }
+}
+
+bool Handle::IsBusyTimeoutPragma(const char *sql)
+{
+    return sqlite3_strlike("pragma%busy_timeout%", sql, 0) == 0;
+}
+
+void Handle::prepareBusyHandler(const Statement &statement)
+{
+    if (m_statementObservers.empty()) {
+        return;
+    }
+    //PRAGMA busy_timeout replaces the busy handler, and reads 0 while ours
+    //is installed. So sqlite's own one runs it, and ours is taken back with
+    //the new timeout before the next statement.
+    if (IsBusyTimeoutPragma(statement.getDescription().c_str())) {
+        releaseBusyHandler();
+    } else if (m_busyHandlerReleased) {
+        takeBusyHandler();
+    }
+}
+
+int Handle::BusyHandler(void *p, int count)
+{
+    //Same schedule as the default handler of sqlite
+    static const int s_delays[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50};
+    static const int s_totals[] = {0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178};
+    static const int s_count = sizeof(s_delays) / sizeof(s_delays[0]);
+    Handle *handle = (Handle *) p;
+    ++handle->m_busyRetries;
+    int delay, prior;
+    if (count < s_count) {
+        delay = s_delays[count];
+        prior = s_totals[count];
+    } else {
+        delay = 100;
+        prior = s_totals[s_count - 1] + s_delays[s_count - 1] +
+                (count - s_count) * delay;
+    }
+    if (prior + delay > handle->m_busyTimeout) {
+        delay = handle->m_busyTimeout - prior;
+        if (delay <= 0) {
+            return 0;
+        }
+    }
+    auto before = std::chrono::steady_clock::now();
+    sqlite3_sleep(delay);
+    handle->m_busyWait += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - before)
+                              .count();
+    return 1;
+}
+
+void Handle::observeStatement(void *p, int64_t cost)
+{
+    sqlite3_stmt *stmt = (sqlite3_stmt *) p;
+    const char *sql = sqlite3_sql(stmt);
+    if (!sql) {
+        return;
+    }
+    StatementStatus status;
+    status.cost = cost;
+    status.busyWait = m_busyWait;
+    status.busyRetries = m_busyRetries;
+    m_busyWait = 0;
+    m_busyRetries = 0;
+    if (IsBusyTimeoutPragma(sql)) {
+        //Our handler may be replaced by a statement prepared earlier. It is
+        //not reported, as takeBusyHandler runs one itself.
+        m_busyHandlerReleased = true;
+        return;
+    }
+    //Counters are reset for the next execution
+    status.vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+    status.fullScanSteps =
+        sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    status.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    status.autoIndexes =
+        sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+    status.reprepares =
+        sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 1);
+    status.memory = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_MEMUSED, 0);
+#else //SQLITE_STMTSTATUS_REPREPARE
+    status.reprepares = 0;
+    status.memory = 0;
+#endif //SQLITE_STMTSTATUS_REPREPARE
+    for (const auto &iter : m_statementObservers) {
+        iter.second(sql, status);
+    }
+}
+
 bool Handle::shouldPerformanceAggregation() const
 {
     return m_aggregation;
@@ -193,6 +386,7 @@ std::shared_ptr<StatementHandle> Handle::prepare(const Statement &statement)
             &m_error);
         return nullptr;
     }
+    prepareBusyHandler(statement);
     sqlite3_stmt *stmt = nullptr;
     int rc = sqlite3_prepare_v2((sqlite3 *) m_handle,
                                 statement.getDescription().c_str(), -1, &stmt,
@@ -202,6 +396,7 @@ std::shared_ptr<StatementHandle> Handle::prepare(const Statement &statement)
         return std::shared_ptr<StatementHandle>(
             new StatementHandle(stmt, *this));
     }
+    recordError(rc);
     Error::ReportSQLite(m_tag, path, Error::HandleOperation::Prepare, rc,
                         sqlite3_extended_errcode((sqlite3 *) m_handle),
                         sqlite3_errmsg((sqlite3 *) m_handle),
@@ -211,9 +406,19 @@ std::shared_ptr<StatementHandle> Handle::prepare(const Statement &statement)
 
 bool Handle::exec(const Statement &statement)
 {
+    prepareBusyHandler(statement);
+    Scheduler *scheduler = Scheduler::shared();
+    bool observing = scheduler->shouldObserveForeground();
+    Scheduler::Time begin;
+    if (observing) {
+        begin = std::chrono::steady_clock::now();
+    }
     int rc =
         sqlite3_exec((sqlite3 *) m_handle, statement.getDescription().c_str(),
                      nullptr, nullptr, nullptr);
+    if (observing) {
+        scheduler->observeForeground(std::chrono::steady_clock::now() - begin);
+    }
     bool result = rc == SQLITE_OK;
     if (statement.getStatementType() == Statement::Type::Transaction) {
         const StatementTransaction &transaction =
@@ -238,6 +443,18 @@ bool Handle::exec(const Statement &statement)
         m_error.reset();
         return true;
     }
+    if (rc == SQLITE_INTERRUPT) {
+        Cancellation::State state = getCancellationState();
+        if (state != Cancellation::State::None) {
+            Error::ReportCore(m_tag, path, Error::CoreOperation::Exec,
+                              state == Cancellation::State::Cancelled
+                                  ? Error::CoreCode::Cancelled
+                                  : Error::CoreCode::Expired,
+                              statement.getDescription().c_str(), &m_error);
+            return false;
+        }
+    }
+    recordError(rc);
     Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
                         sqlite3_extended_errcode((sqlite3 *) m_handle),
                         sqlite3_errmsg((sqlite3 *) m_handle),
@@ -253,8 +470,16 @@ long long Handle::getLastInsertedRowID()
 bool Handle::setCipherKey(const void *data, int size)
 {
 #ifdef SQLITE_HAS_CODEC
+    //Configs are invoked again when any of them changes
+    std::vector<unsigned char> key((const unsigned char *) data,
+                                   (const unsigned char *) data + size);
+    if (key == m_cipherKey) {
+        m_error.reset();
+        return true;
+    }
     int rc = sqlite3_key((sqlite3 *) m_handle, data, size);
     if (rc == SQLITE_OK) {
+        m_cipherKey = std::move(key);
         m_error.reset();
         return true;
     }
@@ -271,26 +496,294 @@ bool Handle::setCipherKey(const void *data, int size)
 #endif //SQLITE_HAS_CODEC
 }
 
-void Handle::registerCommittedHook(const CommittedHook &onCommitted, void *info)
+void Handle::registerCommittedHook(const std::string &name,
+                                   const CommittedHook &onCommitted,
+                                   void *info)
 {
-    m_committedHookInfo.onCommitted = onCommitted;
-    m_committedHookInfo.info = info;
-    m_committedHookInfo.handle = this;
-    if (m_committedHookInfo.onCommitted) {
+    if (onCommitted) {
+        m_committedHooks[name] = {onCommitted, info};
+    } else {
+        m_committedHooks.erase(name);
+    }
+    if (!m_committedHooks.empty()) {
         sqlite3_wal_hook(
             (sqlite3 *) m_handle,
             [](void *p, sqlite3 *, const char *, int pages) -> int {
-                CommittedHookInfo *committedHookInfo = (CommittedHookInfo *) p;
-                committedHookInfo->onCommitted(committedHookInfo->handle, pages,
-                                               committedHookInfo->info);
+                Handle *handle = (Handle *) p;
+                for (const auto &iter : handle->m_committedHooks) {
+                    iter.second.onCommitted(handle, pages, iter.second.info);
+                }
                 return SQLITE_OK;
             },
-            &m_committedHookInfo);
+            this);
     } else {
         sqlite3_wal_hook((sqlite3 *) m_handle, nullptr, nullptr);
     }
 }
 
+void Handle::registerUpdatedHook(const std::string &name,
+                                 const UpdatedHook &onUpdated)
+{
+    if (onUpdated) {
+        m_updatedHooks[name] = onUpdated;
+    } else {
+        m_updatedHooks.erase(name);
+    }
+    if (!m_updatedHooks.empty()) {
+        sqlite3_update_hook(
+            (sqlite3 *) m_handle,
+            [](void *p, int operation, const char *, const char *table,
+               sqlite3_int64) {
+                Handle *handle = (Handle *) p;
+                for (const auto &iter : handle->m_updatedHooks) {
+                    iter.second(operation, table);
+                }
+            },
+            this);
+    } else {
+        sqlite3_update_hook((sqlite3 *) m_handle, nullptr, nullptr);
+    }
+}
+
+bool Handle::registerValueObserver(const std::string &function,
+                                   const ValueObserver &observer)
+{
+    int rc = sqlite3_create_function_v2(
+        (sqlite3 *) m_handle, function.c_str(), 1, SQLITE_UTF8,
+        new ValueObserver(observer),
+        [](sqlite3_context *context, int argc, sqlite3_value **argv) {
+            ValueObserver *observer =
+                (ValueObserver *) sqlite3_user_data(context);
+            sqlite3_value *value = argv[0];
+            switch (sqlite3_value_type(value)) {
+                case SQLITE_INTEGER: {
+                    int64_t integer = sqlite3_value_int64(value);
+                    (*observer)(ColumnType::Integer64, &integer,
+                                sizeof(integer));
+                } break;
+                case SQLITE_FLOAT: {
+                    double real = sqlite3_value_double(value);
+                    (*observer)(ColumnType::Float, &real, sizeof(real));
+                } break;
+                case SQLITE_TEXT: {
+                    const unsigned char *text = sqlite3_value_text(value);
+                    (*observer)(ColumnType::Text, text,
+                                sqlite3_value_bytes(value));
+                } break;
+                case SQLITE_BLOB: {
+                    const void *blob = sqlite3_value_blob(value);
+                    (*observer)(ColumnType::BLOB, blob,
+                                sqlite3_value_bytes(value));
+                } break;
+                default:
+                    (*observer)(ColumnType::Null, nullptr, 0);
+                    break;
+            }
+            sqlite3_result_null(context);
+        },
+        nullptr, nullptr,
+        [](void *p) { delete (ValueObserver *) p; });
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::CreateFunction,
+                        rc, sqlite3_extended_errcode((sqlite3 *) m_handle),
+                        sqlite3_errmsg((sqlite3 *) m_handle), &m_error);
+    return false;
+}
+
+std::atomic<uint64_t> Handle::s_commitSequence(0);
+
+#ifdef SQLITE_ENABLE_SESSION
+
+bool Handle::IsSessionSupported()
+{
+    return true;
+}
+
+bool Handle::beginSession(const std::list<std::string> &tables,
+                          bool patchset,
+                          const SessionObserver &observer)
+{
+    endSession();
+    m_sessionTables = tables;
+    m_sessionPatchset = patchset;
+    m_sessionObserver = observer;
+    if (!createSession()) {
+        return false;
+    }
+    //Commit hook is called under the write lock, so that the sequence follows the order of commits.
+    sqlite3_commit_hook((sqlite3 *) m_handle,
+                        [](void *p) -> int {
+                            Handle *handle = (Handle *) p;
+                            handle->m_sessionSequence = ++s_commitSequence;
+                            return 0;
+                        },
+                        this);
+    return true;
+}
+
+bool Handle::createSession()
+{
+    int rc = sqlite3session_create((sqlite3 *) m_handle, "main",
+                                   (sqlite3_session **) &m_session);
+    if (rc == SQLITE_OK) {
+        if (m_sessionTables.empty()) {
+            rc = sqlite3session_attach((sqlite3_session *) m_session, nullptr);
+        } else {
+            for (const std::string &table : m_sessionTables) {
+                rc = sqlite3session_attach((sqlite3_session *) m_session,
+                                           table.c_str());
+                if (rc != SQLITE_OK) {
+                    break;
+                }
+            }
+        }
+    }
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::Session, rc,
+                        sqlite3_extended_errcode((sqlite3 *) m_handle),
+                        sqlite3_errmsg((sqlite3 *) m_handle), &m_error);
+    endSession();
+    return false;
+}
+
+void Handle::endSession()
+{
+    if (m_session) {
+        sqlite3session_delete((sqlite3_session *) m_session);
+        sqlite3_commit_hook((sqlite3 *) m_handle, nullptr, nullptr);
+        m_session = nullptr;
+    }
+}
+
+bool Handle::flushSession()
+{
+    if (!m_session || isInTransaction() ||
+        sqlite3session_isempty((sqlite3_session *) m_session)) {
+        m_error.reset();
+        return true;
+    }
+    int size = 0;
+    void *data = nullptr;
+    int rc = m_sessionPatchset
+                 ? sqlite3session_patchset((sqlite3_session *) m_session,
+                                           &size, &data)
+                 : sqlite3session_changeset((sqlite3_session *) m_session,
+                                            &size, &data);
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Session, rc,
+                            sqlite3_extended_errcode((sqlite3 *) m_handle),
+                            sqlite3_errmsg((sqlite3 *) m_handle), &m_error);
+        return false;
+    }
+    if (size == 0) {
+        //Rolled back changes make an empty one, which needs no restart
+        sqlite3_free(data);
+        m_error.reset();
+        return true;
+    }
+    if (m_sessionObserver) {
+        Changeset changeset((unsigned char *) data,
+                            (unsigned char *) data + size);
+        m_sessionObserver(changeset, m_sessionSequence);
+    }
+    sqlite3_free(data);
+
+    //Session can't be reset
+    sqlite3session_delete((sqlite3_session *) m_session);
+    m_session = nullptr;
+    return createSession();
+}
+
+bool Handle::applyChangeset(const Changeset &changeset,
+                            const ChangesetConflictResolver &resolver)
+{
+    if (m_session) {
+        sqlite3session_enable((sqlite3_session *) m_session, 0);
+    }
+    int rc = sqlite3changeset_apply(
+        (sqlite3 *) m_handle, (int) changeset.size(),
+        (void *) changeset.data(), nullptr,
+        [](void *p, int conflict, sqlite3_changeset_iter *iter) -> int {
+            const ChangesetConflictResolver *resolver =
+                (const ChangesetConflictResolver *) p;
+            if (!*resolver) {
+                return SQLITE_CHANGESET_OMIT;
+            }
+            const char *table = nullptr;
+            int columnCount = 0;
+            int operation = 0;
+            sqlite3changeset_op(iter, &table, &columnCount, &operation,
+                                nullptr);
+            ChangesetResolution resolution = (*resolver)(
+                table ? table : "", (ChangesetConflict) conflict);
+            if (resolution == ChangesetResolution::Replace &&
+                conflict != SQLITE_CHANGESET_DATA &&
+                conflict != SQLITE_CHANGESET_CONFLICT) {
+                return SQLITE_CHANGESET_OMIT;
+            }
+            return (int) resolution;
+        },
+        (void *) &resolver);
+    if (m_session) {
+        sqlite3session_enable((sqlite3_session *) m_session, 1);
+    }
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::ApplyChangeset,
+                        rc, sqlite3_extended_errcode((sqlite3 *) m_handle),
+                        sqlite3_errmsg((sqlite3 *) m_handle), &m_error);
+    return false;
+}
+
+#else //SQLITE_ENABLE_SESSION
+
+bool Handle::IsSessionSupported()
+{
+    return false;
+}
+
+bool Handle::beginSession(const std::list<std::string> &tables,
+                          bool patchset,
+                          const SessionObserver &observer)
+{
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::Session,
+                        SQLITE_MISUSE, "Session is not enabled", &m_error);
+    return false;
+}
+
+bool Handle::createSession()
+{
+    return false;
+}
+
+void Handle::endSession()
+{
+}
+
+bool Handle::flushSession()
+{
+    m_error.reset();
+    return true;
+}
+
+bool Handle::applyChangeset(const Changeset &changeset,
+                            const ChangesetConflictResolver &resolver)
+{
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::ApplyChangeset,
+                        SQLITE_MISUSE, "Session is not enabled", &m_error);
+    return false;
+}
+
+#endif //SQLITE_ENABLE_SESSION
+
 std::string Handle::getBackupPath() const
 {
     return path + backupSuffix;
@@ -309,6 +802,80 @@ bool Handle::backup(const void *key, const unsigned int &length)
     return false;
 }
 
+bool Handle::copyTo(Handle &destination)
+{
+    return copyTo(destination, -1, nullptr);
+}
+
+bool Handle::copyTo(Handle &destination,
+                    int pagesPerStep,
+                    const CopyProgress &onProgress)
+{
+    sqlite3_backup *backup =
+        sqlite3_backup_init((sqlite3 *) destination.m_handle, "main",
+                            (sqlite3 *) m_handle, "main");
+    if (!backup) {
+        sqlite3 *handle = (sqlite3 *) destination.m_handle;
+        Error::ReportSQLite(m_tag, destination.path,
+                            Error::HandleOperation::Copy,
+                            sqlite3_errcode(handle),
+                            sqlite3_extended_errcode(handle),
+                            sqlite3_errmsg(handle), &m_error);
+        return false;
+    }
+    //Read transaction is kept during the copy so that it's a consistent snapshot
+    //Backup would restart from the first page if the source were changed by
+    //another handle between steps.
+    bool began = false;
+    if (pagesPerStep > 0 && !isInTransaction()) {
+        if (!execSQL("BEGIN; PRAGMA main.schema_version;")) {
+            sqlite3_backup_finish(backup);
+            return false;
+        }
+        began = true;
+    }
+    int rc;
+    bool cancelled = false;
+    do {
+        rc = sqlite3_backup_step(backup, pagesPerStep);
+        if (rc != SQLITE_OK && rc != SQLITE_DONE && rc != SQLITE_BUSY &&
+            rc != SQLITE_LOCKED) {
+            break;
+        }
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            sqlite3_sleep(10);
+        }
+        if (onProgress) {
+            int total = sqlite3_backup_pagecount(backup);
+            if (!onProgress(total - sqlite3_backup_remaining(backup), total) &&
+                rc != SQLITE_DONE) {
+                cancelled = true;
+                break;
+            }
+        }
+    } while (rc != SQLITE_DONE);
+    int finishRC = sqlite3_backup_finish(backup);
+    if (began) {
+        execSQL("COMMIT");
+    }
+    if (cancelled) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Copy,
+                            SQLITE_INTERRUPT, sqlite3_errstr(SQLITE_INTERRUPT),
+                            &m_error);
+        return false;
+    }
+    if (rc == SQLITE_DONE && finishRC == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    if (rc == SQLITE_DONE) {
+        rc = finishRC;
+    }
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::Copy, rc,
+                        sqlite3_errstr(rc), &m_error);
+    return false;
+}
+
 bool Handle::recoverFromPath(const std::string &corruptedDBPath,
                              const int pageSize,
                              const void *backupKey,
@@ -355,6 +922,401 @@ bool Handle::recoverFromPath(const std::string &corruptedDBPath,
     return true;
 }
 
+bool Handle::execSQL(const std::string &sql)
+{
+    int rc = sqlite3_exec((sqlite3 *) m_handle, sql.c_str(), nullptr, nullptr,
+                          nullptr);
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    recordError(rc);
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                        sqlite3_extended_errcode((sqlite3 *) m_handle),
+                        sqlite3_errmsg((sqlite3 *) m_handle), sql, &m_error);
+    return false;
+}
+
+//Empty for the index on expression
+static std::string GetLeadingColumn(sqlite3 *db, const std::string &index)
+{
+    std::string column;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db,
+                           "SELECT name FROM pragma_index_info(?1, 'main') "
+                           "WHERE seqno = 0",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, index.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW &&
+            sqlite3_column_text(stmt, 0)) {
+            column = (const char *) sqlite3_column_text(stmt, 0);
+        }
+    }
+    sqlite3_finalize(stmt);
+    return column;
+}
+
+bool Handle::findDamagedBtrees(std::list<std::string> &tables,
+                               std::list<std::string> &indexes,
+                               bool &unresolved)
+{
+    sqlite3 *db = (sqlite3 *) m_handle;
+    sqlite3_stmt *stmt = nullptr;
+    tables.clear();
+    indexes.clear();
+    unresolved = false;
+
+    //Integrity check is cheaper than scanning b-trees one by one when it's ok
+    std::string messages;
+    int rc = sqlite3_prepare_v2(db, "PRAGMA main.integrity_check", -1, &stmt,
+                                nullptr);
+    if (rc == SQLITE_OK) {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const char *message = (const char *) sqlite3_column_text(stmt, 0);
+            messages.append(message ? message : "").append("\n");
+        }
+        rc = sqlite3_finalize(stmt);
+    }
+    if (rc != SQLITE_OK && (rc & 0xff) != SQLITE_CORRUPT) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            "PRAGMA main.integrity_check", &m_error);
+        return false;
+    }
+    if (rc == SQLITE_OK && messages == "ok\n") {
+        m_error.reset();
+        return true;
+    }
+
+    static const char *s_btreesSQL =
+        "SELECT type, name, tbl_name FROM main.sqlite_master "
+        "WHERE type IN ('table', 'index') AND rootpage > 0 "
+        "ORDER BY type = 'index'";
+    rc = sqlite3_prepare_v2(db, s_btreesSQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Prepare, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            s_btreesSQL, &m_error);
+        return false;
+    }
+    std::list<std::pair<std::string, std::string>> btrees;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *type = (const char *) sqlite3_column_text(stmt, 0);
+        const char *name = (const char *) sqlite3_column_text(stmt, 1);
+        const char *table = (const char *) sqlite3_column_text(stmt, 2);
+        if (type && name && table) {
+            btrees.push_back({strcmp(type, "table") == 0 ? "" : name, table});
+        }
+    }
+    rc = sqlite3_finalize(stmt);
+    if (rc != SQLITE_OK) {
+        //sqlite_master itself is damaged
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Step, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            s_btreesSQL, &m_error);
+        return false;
+    }
+
+    //Scanning fails on the damaged page of b-tree, or the content of a row
+    bool resolved = false;
+    for (const auto &btree : btrees) {
+        const std::string &index = btree.first;
+        const std::string &table = btree.second;
+        if (std::find(tables.begin(), tables.end(), table) != tables.end()) {
+            continue;
+        }
+        bool damaged = false;
+        if (!index.empty()) {
+            damaged = messages.find(" index " + index + "\n") !=
+                      std::string::npos;
+        }
+        char *sql = nullptr;
+        if (index.empty()) {
+            sql = sqlite3_mprintf("SELECT * FROM main.\"%w\" NOT INDEXED",
+                                  table.c_str());
+        } else {
+            //count(*) is counted on the smallest b-tree regardless of
+            //INDEXED BY, so the index is walked in its order instead
+            std::string column = GetLeadingColumn(db, index);
+            sql = column.empty()
+                      ? sqlite3_mprintf("SELECT count(*) FROM main.\"%w\" "
+                                        "INDEXED BY \"%w\"",
+                                        table.c_str(), index.c_str())
+                      : sqlite3_mprintf("SELECT 1 FROM main.\"%w\" "
+                                        "INDEXED BY \"%w\" ORDER BY \"%w\"",
+                                        table.c_str(), index.c_str(),
+                                        column.c_str());
+        }
+        rc = damaged ? SQLITE_OK
+                     : sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+        if (!damaged && rc == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                ;
+            rc = sqlite3_finalize(stmt);
+            damaged = (rc & 0xff) == SQLITE_CORRUPT;
+        }
+        sqlite3_free(sql);
+        if (rc != SQLITE_OK && !damaged) {
+            Error::ReportSQLite(m_tag, path, Error::HandleOperation::Step, rc,
+                                sqlite3_extended_errcode(db),
+                                sqlite3_errmsg(db), &m_error);
+            return false;
+        }
+        if (!damaged) {
+            continue;
+        }
+        resolved = true;
+        //Indexes of constraints can only be rebuilt along with the table
+        if (index.empty() || index.compare(0, 7, "sqlite_") == 0) {
+            if (table.compare(0, 7, "sqlite_") != 0) {
+                tables.push_back(table);
+            }
+        } else {
+            indexes.push_back(index);
+        }
+    }
+    unresolved = !resolved;
+    //Indexes found before their tables are found damaged
+    for (auto iter = indexes.begin(); iter != indexes.end();) {
+        auto btree = std::find_if(
+            btrees.begin(), btrees.end(),
+            [&iter](const std::pair<std::string, std::string> &btree) {
+                return btree.first == *iter;
+            });
+        if (btree != btrees.end() &&
+            std::find(tables.begin(), tables.end(), btree->second) !=
+                tables.end()) {
+            iter = indexes.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    m_error.reset();
+    return true;
+}
+
+bool Handle::salvageTables(const std::string &corruptedDBPath,
+                           const std::list<std::string> &tables,
+                           const int pageSize,
+                           const void *key,
+                           const unsigned int &keyLength,
+                           int &damagedPages)
+{
+    damagedPages = 0;
+    std::vector<const char *> names;
+    for (const auto &table : tables) {
+        names.push_back(table.c_str());
+    }
+    sqliterk_master_info *info;
+    int rc = sqliterk_make_master(names.data(), (int) names.size(), &info);
+    if (rc != SQLITERK_OK) {
+        Error::ReportRepair(corruptedDBPath,
+                            WCDB::Error::RepairOperation::Repair, rc, &m_error);
+        return false;
+    }
+
+    sqliterk_cipher_conf conf;
+    memset(&conf, 0, sizeof(sqliterk_cipher_conf));
+    conf.key = key;
+    conf.key_len = keyLength;
+    conf.page_size = pageSize;
+    conf.use_hmac = true;
+
+    sqliterk *rk;
+    rc = sqliterk_open(corruptedDBPath.c_str(), &conf, &rk);
+    if (rc == SQLITERK_OK) {
+        //Only listed tables and their indexes are created
+        rc = sqliterk_output(rk, (sqlite3 *) m_handle, info, 0);
+        damagedPages = sqliterk_damaged_page_count(rk);
+        sqliterk_close(rk);
+    }
+    sqliterk_free_master(info);
+    if (rc != SQLITERK_OK) {
+        Error::ReportRepair(corruptedDBPath,
+                            WCDB::Error::RepairOperation::Repair, rc, &m_error);
+        return false;
+    }
+    m_error.reset();
+    return true;
+}
+
+bool Handle::getSchemaSQLs(const std::string &name,
+                           std::list<std::string> &sqls)
+{
+    static const char *s_schemaSQL =
+        "SELECT sql FROM main.sqlite_master "
+        "WHERE (name = ?1 OR tbl_name = ?1) AND sql IS NOT NULL "
+        "ORDER BY type != 'table'";
+    sqlite3 *db = (sqlite3 *) m_handle;
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, s_schemaSQL, -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            sqls.push_back((const char *) sqlite3_column_text(stmt, 0));
+        }
+        rc = sqlite3_finalize(stmt);
+    }
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            s_schemaSQL, &m_error);
+        return false;
+    }
+    if (sqls.empty()) {
+        Error::ReportCore(m_tag, path, Error::CoreOperation::Exec,
+                          Error::CoreCode::Misuse,
+                          ("No schema of " + name).c_str(), &m_error);
+        return false;
+    }
+    m_error.reset();
+    return true;
+}
+
+bool Handle::dropSchemaObject(const std::string &type,
+                              const std::string &name,
+                              bool &unlinked)
+{
+    sqlite3 *db = (sqlite3 *) m_handle;
+    char *sql = sqlite3_mprintf("DROP %s main.\"%w\"", type.c_str(),
+                                name.c_str());
+    int rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        return true;
+    }
+    if ((rc & 0xff) != SQLITE_CORRUPT) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            &m_error);
+        return false;
+    }
+
+    //Pages of damaged b-tree can't be freed, so they are left unlinked
+    int schemaVersion = 0;
+    sqlite3_stmt *stmt;
+    rc = sqlite3_prepare_v2(db, "PRAGMA main.schema_version", -1, &stmt,
+                            nullptr);
+    if (rc == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            schemaVersion = sqlite3_column_int(stmt, 0);
+        }
+        rc = sqlite3_finalize(stmt);
+    }
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            &m_error);
+        return false;
+    }
+    sql = sqlite3_mprintf("DELETE FROM main.sqlite_master "
+                          "WHERE name = %Q OR tbl_name = %Q",
+                          name.c_str(), name.c_str());
+    bool result = execSQL("PRAGMA writable_schema = ON") && execSQL(sql);
+    sqlite3_free(sql);
+    //Other connections reload the schema once its version changes
+    result = execSQL("PRAGMA writable_schema = OFF") && result &&
+             execSQL("PRAGMA main.schema_version = " +
+                     std::to_string(schemaVersion + 1));
+    //But this one keeps the stale schema, where the object still exists,
+    //until the transaction ends. Rolling back to a savepoint resets the
+    //schema changed, so it's reloaded by the next statement.
+    result = result && execSQL("SAVEPOINT wcdb_drop_schema_object;"
+                               "ROLLBACK TO wcdb_drop_schema_object;"
+                               "RELEASE wcdb_drop_schema_object");
+    unlinked = unlinked || result;
+    return result;
+}
+
+bool Handle::rebuildIndex(const std::string &index, bool &unlinked)
+{
+    std::list<std::string> sqls;
+    if (!getSchemaSQLs(index, sqls)) {
+        return false;
+    }
+    sqlite3 *db = (sqlite3 *) m_handle;
+    char *sql = sqlite3_mprintf("REINDEX main.\"%w\"", index.c_str());
+    int rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    if ((rc & 0xff) != SQLITE_CORRUPT) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                            &m_error);
+        return false;
+    }
+    return dropSchemaObject("INDEX", index, unlinked) && execSQL(sqls.front());
+}
+
+bool Handle::restoreTable(const std::string &table,
+                          Handle &source,
+                          int64_t &restoredRows,
+                          bool &unlinked)
+{
+    restoredRows = 0;
+    std::list<std::string> sqls;
+    if (!getSchemaSQLs(table, sqls) ||
+        !dropSchemaObject("TABLE", table, unlinked) ||
+        !execSQL(sqls.front())) {
+        return false;
+    }
+    sqls.pop_front();
+
+    char *sql = sqlite3_mprintf("SELECT * FROM main.\"%w\"", table.c_str());
+    sqlite3_stmt *select;
+    int rc = sqlite3_prepare_v2((sqlite3 *) source.m_handle, sql, -1, &select,
+                                nullptr);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        //Nothing salvaged
+        sqlite3_finalize(select);
+        select = nullptr;
+    }
+    int columns = select ? sqlite3_column_count(select) : 0;
+    sql = sqlite3_mprintf("INSERT INTO main.\"%w\" VALUES(", table.c_str());
+    for (int i = 0; i < columns; ++i) {
+        sql = sqlite3_mprintf("%z%s?", sql, i > 0 ? ", " : "");
+    }
+    sql = sqlite3_mprintf("%z)", sql);
+    sqlite3_stmt *insert = nullptr;
+    rc = select ? sqlite3_prepare_v2((sqlite3 *) m_handle, sql, -1, &insert,
+                                     nullptr)
+                : SQLITE_OK;
+    while (insert && rc == SQLITE_OK && sqlite3_step(select) == SQLITE_ROW) {
+        for (int i = 0; i < columns; ++i) {
+            sqlite3_bind_value(insert, i + 1, sqlite3_column_value(select, i));
+        }
+        rc = sqlite3_step(insert);
+        rc = rc == SQLITE_DONE ? sqlite3_reset(insert) : rc;
+        if (rc == SQLITE_OK) {
+            ++restoredRows;
+        }
+    }
+    sqlite3_finalize(insert);
+    sqlite3_finalize(select);
+    if (rc != SQLITE_OK) {
+        Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                            sqlite3_extended_errcode((sqlite3 *) m_handle),
+                            sqlite3_errmsg((sqlite3 *) m_handle), sql,
+                            &m_error);
+        sqlite3_free(sql);
+        return false;
+    }
+    sqlite3_free(sql);
+
+    //Indexes and triggers are created after rows are restored
+    for (const auto &schemaSQL : sqls) {
+        if (!execSQL(schemaSQL)) {
+            return false;
+        }
+    }
+    m_error.reset();
+    return true;
+}
+
 void Handle::setTag(Tag tag)
 {
     m_tag = tag;
@@ -370,14 +1332,233 @@ const Error &Handle::getError() const
     return m_error;
 }
 
+const Handle::ErrorHistory &Handle::getErrorHistory() const
+{
+    return m_errorHistory;
+}
+
+bool Handle::IsSuspiciousError(int code)
+{
+    switch (code & 0xff) {
+        case SQLITE_IOERR:
+        case SQLITE_NOMEM:
+        case SQLITE_SCHEMA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Handle::IsConstraintError(int code)
+{
+    return (code & 0xff) == SQLITE_CONSTRAINT;
+}
+
+bool Handle::reloadStatistics()
+{
+    sqlite3 *db = (sqlite3 *) m_handle;
+    //Ours is installed while statements are observed
+    bool owned = !m_statementObservers.empty() && !m_busyHandlerReleased;
+    int timeout = 0;
+    if (!owned) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "PRAGMA busy_timeout", -1, &stmt,
+                               nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            timeout = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_busy_handler(db, nullptr, nullptr);
+    int rc = sqlite3_exec(db, "ANALYZE sqlite_master", nullptr, nullptr,
+                          nullptr);
+    if (owned) {
+        sqlite3_busy_handler(db, Handle::BusyHandler, this);
+    } else {
+        sqlite3_busy_timeout(db, timeout);
+    }
+    if (rc == SQLITE_OK) {
+        m_error.reset();
+        return true;
+    }
+    Error::ReportSQLite(m_tag, path, Error::HandleOperation::Exec, rc,
+                        sqlite3_extended_errcode(db), sqlite3_errmsg(db),
+                        "ANALYZE sqlite_master", &m_error);
+    return false;
+}
+
+void Handle::recordError(int code)
+{
+    ++m_errorHistory.errors;
+    if (IsSuspiciousError(code)) {
+        ++m_errorHistory.suspicious;
+    }
+    m_errorHistory.lastCode = code;
+}
+
+bool Handle::validate()
+{
+    //It reloads the schema if it's changed and reads the header of file.
+    //PRAGMA schema_version doesn't, since it never loads the schema.
+    return execSQL("SELECT 1 FROM sqlite_master LIMIT 1");
+}
+
 int Handle::getChanges()
 {
     return sqlite3_changes((sqlite3 *) m_handle);
 }
 
+int Handle::getTotalChanges()
+{
+    return sqlite3_total_changes((sqlite3 *) m_handle);
+}
+
 bool Handle::isReadonly()
 {
     return sqlite3_db_readonly((sqlite3 *) m_handle, NULL) == 1;
 }
 
+bool Handle::isInTransaction()
+{
+    return sqlite3_get_autocommit((sqlite3 *) m_handle) == 0;
+}
+
+int64_t Handle::MemoryStatus::getBytes() const
+{
+    return cache + schema + statement;
+}
+
+Handle::MemoryStatus &Handle::MemoryStatus::
+operator+=(const Handle::MemoryStatus &other)
+{
+    cache += other.cache;
+    schema += other.schema;
+    statement += other.statement;
+    lookaside += other.lookaside;
+    return *this;
+}
+
+Handle::MemoryStatus Handle::getMemoryStatus()
+{
+    MemoryStatus status;
+    int current = 0;
+    int highwater = 0;
+    sqlite3 *db = (sqlite3 *) m_handle;
+    //Cache shared by multiple handles is divided among them
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED_SHARED, &current,
+                          &highwater, 0) == SQLITE_OK) {
+        status.cache = current;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &current,
+                          &highwater, 0) == SQLITE_OK) {
+        status.schema = current;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &current, &highwater,
+                          0) == SQLITE_OK) {
+        status.statement = current;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_USED, &current,
+                          &highwater, 0) == SQLITE_OK) {
+        status.lookaside = current;
+    }
+    return status;
+}
+
+int64_t Handle::shrinkMemory()
+{
+    int64_t before = getMemoryStatus().cache;
+    sqlite3_db_release_memory((sqlite3 *) m_handle);
+    return before - getMemoryStatus().cache;
+}
+
+bool Handle::setSortBudget(int workerThreads, int64_t memory)
+{
+    static const StatementPragma s_getCacheSize =
+        StatementPragma().pragma(Pragma::CacheSize);
+    if (!m_sortBudgeted) {
+        std::shared_ptr<StatementHandle> statementHandle =
+            prepare(s_getCacheSize);
+        if (!statementHandle) {
+            return false;
+        }
+        if (!statementHandle->step()) {
+            m_error = statementHandle->getError();
+            return false;
+        }
+        m_defaultCacheSize =
+            statementHandle->getValue<ColumnType::Integer64>(0);
+        statementHandle = nullptr;
+        m_defaultWorkerThreads = sqlite3_limit(
+            (sqlite3 *) m_handle, SQLITE_LIMIT_WORKER_THREADS, -1);
+        m_sortBudgeted = true;
+    }
+    //It's capped by SQLITE_MAX_WORKER_THREADS
+    sqlite3_limit((sqlite3 *) m_handle, SQLITE_LIMIT_WORKER_THREADS,
+                  std::max(workerThreads, 0));
+    //Sorter keeps as many bytes in memory as page cache may hold.
+    //Negative cache size is in KiB.
+    if (memory > 0) {
+        return exec(StatementPragma().pragma(Pragma::CacheSize,
+                                             -((memory + 1023) / 1024)));
+    }
+    return exec(
+        StatementPragma().pragma(Pragma::CacheSize, m_defaultCacheSize));
+}
+
+void Handle::resetSortBudget()
+{
+    if (!m_sortBudgeted) {
+        return;
+    }
+    m_sortBudgeted = false;
+    sqlite3_limit((sqlite3 *) m_handle, SQLITE_LIMIT_WORKER_THREADS,
+                  m_defaultWorkerThreads);
+    //Pages over the restored size are released
+    exec(StatementPragma().pragma(Pragma::CacheSize, m_defaultCacheSize));
+}
+
+void Handle::setCancellation(const Cancellation &cancellation)
+{
+    m_cancellation.reset(new Cancellation(cancellation));
+    setupProgress();
+}
+
+void Handle::resetCancellation()
+{
+    if (m_cancellation) {
+        m_cancellation = nullptr;
+        setupProgress();
+    }
+}
+
+Cancellation::State Handle::getCancellationState() const
+{
+    if (m_steppingCancellation) {
+        Cancellation::State state = m_steppingCancellation->getState();
+        if (state != Cancellation::State::None) {
+            return state;
+        }
+    }
+    if (m_cancellation) {
+        return m_cancellation->getState();
+    }
+    return Cancellation::State::None;
+}
+
+void Handle::setupProgress()
+{
+    if (m_cancellation || m_steppingCancellation) {
+        sqlite3_progress_handler(
+            (sqlite3 *) m_handle, cancellationCheckInterval,
+            [](void *p) -> int {
+                Handle *handle = (Handle *) p;
+                return handle->getCancellationState() !=
+                       Cancellation::State::None;
+            },
+            this);
+    } else {
+        sqlite3_progress_handler((sqlite3 *) m_handle, 0, nullptr, nullptr);
+    }
+}
+
 } //namespace WCDB
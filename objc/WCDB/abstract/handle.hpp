@@ -21,14 +21,19 @@
 #ifndef handle_hpp
 #define handle_hpp
 
+#include <WCDB/cancellation.hpp>
+#include <WCDB/changeset.hpp>
 #include <WCDB/declare.hpp>
 #include <WCDB/error.hpp>
 #include <WCDB/handle_statement.hpp>
 #include <WCDB/utility.hpp>
+#include <atomic>
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace WCDB {
 
@@ -41,6 +46,30 @@ typedef std::function<void(const std::string &)> SQLTrace;
 
 typedef std::function<void(Handle *, int, void *)> CommittedHook;
 
+//operation (SQLITE_INSERT/UPDATE/DELETE), table
+typedef std::function<void(int, const char *)> UpdatedHook;
+
+//copied pages, total pages. Return false to cancel.
+typedef std::function<bool(int, int)> CopyProgress;
+
+//type, data, size
+typedef std::function<void(ColumnType, const void *, int)> ValueObserver;
+
+//Counters of one execution of a statement
+struct StatementStatus {
+    int64_t cost;     //wall clock, in nanoseconds
+    int64_t busyWait; //in nanoseconds
+    int busyRetries;
+    int vmSteps;
+    int fullScanSteps;
+    int sorts;
+    int autoIndexes;
+    int reprepares;
+    int memory; //bytes used by the statement
+};
+typedef std::function<void(const char *sql, const StatementStatus &)>
+    StatementObserver;
+
 class Handle {
 public:
     Handle(const std::string &path);
@@ -61,6 +90,12 @@ public:
 
     void setPerformanceTrace(const PerformanceTrace &trace);
     void setSQLTrace(const SQLTrace &trace);
+    //Observers are called after each execution of statements. Lock waiting
+    //is timed by a busy handler following the current busy_timeout, which is
+    //taken over again after busy_timeout is changed by PRAGMA.
+    //Observers of different names are all called. nullptr removes it.
+    void registerStatementObserver(const std::string &name,
+                                   const StatementObserver &observer);
 
     bool backup(const void *key = nullptr, const unsigned int &length = 0);
     bool recoverFromPath(const std::string &corruptedDBPath,
@@ -70,16 +105,123 @@ public:
                          const void *databaseKey,
                          const unsigned int &databaseKeyLength);
     std::string getBackupPath() const;
+    //Copy the whole database to [destination] with online backup API
+    bool copyTo(Handle &destination);
+    //Copy [pagesPerStep] pages in each step. A read transaction is kept
+    //across steps, so that it's a consistent snapshot while other handles
+    //keep writing.
+    bool copyTo(Handle &destination,
+                int pagesPerStep,
+                const CopyProgress &onProgress);
+    //Pages are read and written by the sqlite_dbpage virtual table if
+    //SQLite is built with SQLITE_ENABLE_DBPAGE_VTAB.
+    static bool IsPageVTableSupported();
+    //SQLITE_CORRUPT, for pages decoded outside of SQLite
+    static int GetCorruptCode();
+
+    //Targeted repair
+    //Indexes of damaged [tables] are not listed in [indexes]
+    bool findDamagedBtrees(std::list<std::string> &tables,
+                           std::list<std::string> &indexes,
+                           bool &unresolved);
+    //Salvage rows of [tables] from the corrupted database into this one
+    bool salvageTables(const std::string &corruptedDBPath,
+                       const std::list<std::string> &tables,
+                       const int pageSize,
+                       const void *key,
+                       const unsigned int &keyLength,
+                       int &damagedPages);
+    //Damaged b-trees are unlinked, whose pages leak until VACUUM
+    bool rebuildIndex(const std::string &index, bool &unlinked);
+    //Recreate [table] and refill it with rows from [source]
+    bool restoreTable(const std::string &table,
+                      Handle &source,
+                      int64_t &restoredRows,
+                      bool &unlinked);
 
     const Error &getError() const;
 
-    void registerCommittedHook(const CommittedHook &onCommitted, void *info);
+    //Errors of statements executed by this handle
+    struct ErrorHistory {
+        int errors;
+        int suspicious; //see IsSuspiciousError
+        int lastCode;
+    };
+    const ErrorHistory &getErrorHistory() const;
+    //IOERR, NOMEM or SCHEMA (stale schema after retries) suggests that the
+    //state of handle is bad while the database may be fine
+    static bool IsSuspiciousError(int code);
+    //UNIQUE, NOT NULL, CHECK and so on, which fail the statement only
+    static bool IsConstraintError(int code);
+    //Cheap check of schema and file for handles idled for long
+    bool validate();
+    //sqlite_stat1 is loaded along with the schema. ANALYZE sqlite_master
+    //reloads it without analyzing any table, while it takes the write lock
+    //for a moment. It fails rather than waits for the lock.
+    bool reloadStatistics();
+
+    //Hooks of different names are all called. nullptr removes the hook.
+    void registerCommittedHook(const std::string &name,
+                               const CommittedHook &onCommitted,
+                               void *info);
+    //Called for each row changed, except rows of WITHOUT ROWID tables.
+    //Hooks of different names are all called. nullptr removes the hook.
+    void registerUpdatedHook(const std::string &name,
+                             const UpdatedHook &onUpdated);
+
+    //SQL function [function(value)] passes its argument to observer and returns NULL
+    bool registerValueObserver(const std::string &function,
+                               const ValueObserver &observer);
 
     static const std::string backupSuffix;
+    static const char *GetSQLiteVersion();
 
     int getChanges();
+    //Including the changes made by triggers and virtual tables
+    int getTotalChanges();
 
     bool isReadonly();
+    bool isInTransaction();
+
+    //Memory, in bytes except lookaside
+    struct MemoryStatus {
+        int64_t cache = 0;
+        int64_t schema = 0;
+        int64_t statement = 0;
+        //Slots of lookaside in use
+        int lookaside = 0;
+        int64_t getBytes() const;
+        MemoryStatus &operator+=(const MemoryStatus &other);
+    };
+    MemoryStatus getMemoryStatus();
+    //Release the unused pages of cache. It returns the bytes released.
+    int64_t shrinkMemory();
+
+    //Sorter of heavy statements, e.g. CREATE INDEX or a large ORDER BY.
+    //[workerThreads] helper threads are used and [memory] bytes are sorted
+    //in memory before spilling. 0 [memory] keeps the cache size.
+    bool setSortBudget(int workerThreads, int64_t memory);
+    void resetSortBudget();
+
+    //Statements will be interrupted once it is cancelled or expired
+    void setCancellation(const Cancellation &cancellation);
+    void resetCancellation();
+    //Interval of VM instructions between two checks
+    static const int cancellationCheckInterval;
+
+    //Session. Changes of [tables], or all tables if it's empty, are captured.
+    //Both SQLite and WCDB should be built with SQLITE_ENABLE_SESSION and
+    //SQLITE_ENABLE_PREUPDATE_HOOK.
+    static bool IsSessionSupported();
+    bool beginSession(const std::list<std::string> &tables,
+                      bool patchset,
+                      const SessionObserver &observer);
+    void endSession();
+    //Notify the changes committed since last flush and restart capturing. It does nothing in transaction.
+    bool flushSession();
+    //Changes applied are not captured by the session of this handle.
+    bool applyChangeset(const Changeset &changeset,
+                        const ChangesetConflictResolver &resolver);
 
 protected:
     Handle(const Handle &) = delete;
@@ -96,16 +238,57 @@ protected:
     typedef struct {
         CommittedHook onCommitted;
         void *info;
-        Handle *handle;
     } CommittedHookInfo;
-    CommittedHookInfo m_committedHookInfo;
+    std::map<std::string, CommittedHookInfo> m_committedHooks;
+    std::map<std::string, UpdatedHook> m_updatedHooks;
 
     void setupTrace();
+
+    void setupProgress();
+    Cancellation::State getCancellationState() const;
+    std::shared_ptr<Cancellation> m_cancellation;
+    std::shared_ptr<Cancellation> m_steppingCancellation;
+    friend class StatementHandle;
+
+    bool execSQL(const std::string &sql);
+    void recordError(int code);
+    ErrorHistory m_errorHistory;
+    bool getSchemaSQLs(const std::string &name, std::list<std::string> &sqls);
+    bool dropSchemaObject(const std::string &type,
+                          const std::string &name,
+                          bool &unlinked);
+
+    bool m_sortBudgeted;
+    int m_defaultWorkerThreads;
+    int64_t m_defaultCacheSize;
+
+    bool createSession();
+    void *m_session;
+    std::list<std::string> m_sessionTables;
+    bool m_sessionPatchset;
+    SessionObserver m_sessionObserver;
+    uint64_t m_sessionSequence;
+    static std::atomic<uint64_t> s_commitSequence;
+
     PerformanceTrace m_performanceTrace;
     SQLTrace m_sqlTrace;
+    std::map<std::string, StatementObserver> m_statementObservers;
+    void observeStatement(void *stmt, int64_t cost);
+    static int BusyHandler(void *p, int count);
+    static bool IsBusyTimeoutPragma(const char *sql);
+    void takeBusyHandler();
+    void releaseBusyHandler();
+    void prepareBusyHandler(const Statement &statement);
+    int m_busyTimeout; //in milliseconds
+    //sqlite's own handler is installed, since busy_timeout is being changed
+    bool m_busyHandlerReleased;
+    int64_t m_busyWait;
+    int m_busyRetries;
     std::map<const std::string, unsigned int> m_footprint;
     int64_t m_cost;
     bool m_aggregation;
+    //Key set lately. Setting it again makes sqlcipher derive it again.
+    std::vector<unsigned char> m_cipherKey;
 };
 
 } //namespace WCDB
@@ -19,15 +19,21 @@
  */
 
 #include <WCDB/handle_statement.hpp>
+#include <WCDB/scheduler.hpp>
 #include <sqlcipher/sqlite3.h>
 
 namespace WCDB {
 
-StatementHandle::StatementHandle(void *stmt, const Handle &handle)
-    : m_stmt(stmt), m_handle(handle)
+StatementHandle::StatementHandle(void *stmt, Handle &handle)
+    : m_stmt(stmt), m_handle(handle), m_cancellation(nullptr)
 {
 }
 
+void StatementHandle::setCancellation(const Cancellation &cancellation)
+{
+    m_cancellation.reset(new Cancellation(cancellation));
+}
+
 void StatementHandle::reset()
 {
     int rc = sqlite3_reset((sqlite3_stmt *) m_stmt);
@@ -44,11 +50,43 @@ void StatementHandle::reset()
 
 bool StatementHandle::step()
 {
-    int rc = sqlite3_step((sqlite3_stmt *) m_stmt);
+    if (m_cancellation) {
+        m_handle.m_steppingCancellation = m_cancellation;
+        m_handle.setupProgress();
+    }
+    int rc;
+    Scheduler *scheduler = Scheduler::shared();
+    if (!scheduler->shouldObserveForeground()) {
+        rc = sqlite3_step((sqlite3_stmt *) m_stmt);
+    } else {
+        Scheduler::Time begin = std::chrono::steady_clock::now();
+        rc = sqlite3_step((sqlite3_stmt *) m_stmt);
+        scheduler->observeForeground(std::chrono::steady_clock::now() - begin);
+    }
+    Cancellation::State state = Cancellation::State::None;
+    if (rc == SQLITE_INTERRUPT) {
+        state = m_handle.getCancellationState();
+    }
+    if (m_cancellation) {
+        m_handle.m_steppingCancellation = nullptr;
+        m_handle.setupProgress();
+    }
     if (rc == SQLITE_ROW || rc == SQLITE_OK || rc == SQLITE_DONE) {
         m_error.reset();
         return rc == SQLITE_ROW;
     }
+    if (state != Cancellation::State::None) {
+        //Reset it so that the handle can be reused safely
+        sqlite3_reset((sqlite3_stmt *) m_stmt);
+        Error::ReportCore(m_handle.getTag(), m_handle.path,
+                          Error::CoreOperation::Step,
+                          state == Cancellation::State::Cancelled
+                              ? Error::CoreCode::Cancelled
+                              : Error::CoreCode::Expired,
+                          sqlite3_sql((sqlite3_stmt *) m_stmt), &m_error);
+        return false;
+    }
+    m_handle.recordError(rc);
     sqlite3 *handle = sqlite3_db_handle((sqlite3_stmt *) m_stmt);
     Error::ReportSQLite(
         m_handle.getTag(), m_handle.path, Error::HandleOperation::Step, rc,
@@ -21,6 +21,7 @@
 #ifndef handle_statement_hpp
 #define handle_statement_hpp
 
+#include <WCDB/cancellation.hpp>
 #include <WCDB/column_type.hpp>
 #include <WCDB/describable.hpp>
 #include <WCDB/error.hpp>
@@ -36,6 +37,9 @@ public:
     bool isOK() const;
     const Error &getError() const;
 
+    //Step will be interrupted once it's cancelled or expired
+    void setCancellation(const Cancellation &cancellation);
+
     //bind, index begin with 1
     void reset();
 
@@ -158,13 +162,14 @@ protected:
     ColumnTypeInfo<ColumnType::Text>::CType getText(int index);
     ColumnTypeInfo<ColumnType::BLOB>::CType getBLOB(int index, int &size);
 
-    StatementHandle(void *stmt, const Handle &handle);
+    StatementHandle(void *stmt, Handle &handle);
     const StatementHandle &operator=(const StatementHandle &other) = delete;
     StatementHandle(const StatementHandle &other) = delete;
 
-    const Handle &m_handle;
+    Handle &m_handle;
     Error m_error;
     void *m_stmt;
+    std::shared_ptr<Cancellation> m_cancellation;
 
     friend class Handle;
 };
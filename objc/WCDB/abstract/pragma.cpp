@@ -22,6 +22,7 @@
 
 namespace WCDB {
 
+const Pragma Pragma::AnalysisLimit("analysis_limit");
 const Pragma Pragma::ApplicationId("application_id");
 const Pragma Pragma::AutoVacuum("auto_vacuum");
 const Pragma Pragma::AutomaticIndex("automatic_index");
@@ -73,6 +74,7 @@ const Pragma Pragma::LegacyFileFormat("legacy_file_format");
 const Pragma Pragma::LockingMode("locking_mode");
 const Pragma Pragma::MaxPageCount("max_page_count");
 const Pragma Pragma::MmapSize("mmap_size");
+const Pragma Pragma::Optimize("optimize");
 const Pragma Pragma::PageCount("page_count");
 const Pragma Pragma::PageSize("page_size");
 const Pragma Pragma::ParserTrace("parser_trace");
@@ -111,4 +113,9 @@ const std::string &Pragma::getName() const
     return m_description;
 }
 
+Pragma Pragma::inSchema(const std::string &schema) const
+{
+    return Pragma((schema + "." + getName()).c_str());
+}
+
 } //namespace WCDB
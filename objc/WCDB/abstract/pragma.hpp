@@ -27,6 +27,7 @@ namespace WCDB {
 
 class Pragma : public Describable {
 public:
+    static const Pragma AnalysisLimit;
     static const Pragma ApplicationId;
     static const Pragma AutoVacuum;
     static const Pragma AutomaticIndex;
@@ -78,6 +79,7 @@ public:
     static const Pragma LockingMode;
     static const Pragma MaxPageCount;
     static const Pragma MmapSize;
+    static const Pragma Optimize;
     static const Pragma PageCount;
     static const Pragma PageSize;
     static const Pragma ParserTrace;
@@ -108,6 +110,7 @@ public:
     static const Pragma WritableSchema;
 
     const std::string &getName() const;
+    Pragma inSchema(const std::string &schema) const;
 
 protected:
     Pragma(const char *name);
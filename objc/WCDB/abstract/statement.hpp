@@ -49,6 +49,11 @@ public:
         Rollback,
         Vacuum,
         Reindex,
+        CreateTrigger,
+        DropTrigger,
+        CreateView,
+        DropView,
+        Analyze,
     };
     Statement();
     virtual ~Statement();
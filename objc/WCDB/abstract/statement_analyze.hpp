@@ -0,0 +1,39 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef statement_analyze_hpp
+#define statement_analyze_hpp
+
+#include <WCDB/statement.hpp>
+
+namespace WCDB {
+
+class StatementAnalyze : public Statement {
+public:
+    StatementAnalyze &analyze();
+    //Name of schema, table or index
+    StatementAnalyze &analyze(const std::string &name);
+
+    virtual Statement::Type getStatementType() const override;
+};
+
+} //namespace WCDB
+
+#endif /* statement_analyze_hpp */
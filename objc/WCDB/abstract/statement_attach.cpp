@@ -47,4 +47,10 @@ StatementAttach &StatementAttach::as(const std::string &schema)
     return *this;
 }
 
+StatementAttach &StatementAttach::key(const Expr &key)
+{
+    m_description.append(" KEY " + key.getDescription());
+    return *this;
+}
+
 } //namespace WCDB
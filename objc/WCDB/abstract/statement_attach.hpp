@@ -31,6 +31,7 @@ public:
     StatementAttach &attach(const Expr &expr, const std::string &database);
 
     StatementAttach &as(const std::string &schema);
+    StatementAttach &key(const Expr &key);
 
     virtual Statement::Type getStatementType() const override;
 };
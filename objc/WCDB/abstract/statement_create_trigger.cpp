@@ -0,0 +1,102 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/expr.hpp>
+#include <WCDB/statement_create_trigger.hpp>
+
+namespace WCDB {
+
+StatementCreateTrigger &StatementCreateTrigger::create(
+    const std::string &trigger, bool ifNotExists, bool temp)
+{
+    m_description.append("CREATE ");
+    if (temp) {
+        m_description.append("TEMP ");
+    }
+    m_description.append("TRIGGER ");
+    if (ifNotExists) {
+        m_description.append("IF NOT EXISTS ");
+    }
+    m_description.append(trigger);
+    return *this;
+}
+
+StatementCreateTrigger &StatementCreateTrigger::before(Event event)
+{
+    m_description.append(" BEFORE ");
+    m_description.append(EventName(event));
+    return *this;
+}
+
+StatementCreateTrigger &StatementCreateTrigger::after(Event event)
+{
+    m_description.append(" AFTER ");
+    m_description.append(EventName(event));
+    return *this;
+}
+
+StatementCreateTrigger &StatementCreateTrigger::on(const std::string &table)
+{
+    m_description.append(" ON " + table + " FOR EACH ROW");
+    return *this;
+}
+
+StatementCreateTrigger &StatementCreateTrigger::when(const Expr &expr)
+{
+    if (!expr.isEmpty()) {
+        m_description.append(" WHEN " + expr.getDescription());
+    }
+    return *this;
+}
+
+StatementCreateTrigger &
+StatementCreateTrigger::execute(const Statement &statement)
+{
+    static const std::string s_end(" END");
+    if (m_description.size() > s_end.size() &&
+        m_description.compare(m_description.size() - s_end.size(),
+                              s_end.size(), s_end) == 0) {
+        m_description.erase(m_description.size() - s_end.size());
+    } else {
+        m_description.append(" BEGIN");
+    }
+    m_description.append(" " + statement.getDescription() + ";" + s_end);
+    return *this;
+}
+
+const char *StatementCreateTrigger::EventName(Event event)
+{
+    switch (event) {
+        case Event::Delete:
+            return "DELETE";
+        case Event::Insert:
+            return "INSERT";
+        case Event::Update:
+            return "UPDATE";
+    }
+    return "";
+}
+
+Statement::Type StatementCreateTrigger::getStatementType() const
+{
+    return Statement::Type::CreateTrigger;
+}
+
+} //namespace WCDB
@@ -0,0 +1,67 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef statement_create_trigger_hpp
+#define statement_create_trigger_hpp
+
+#include <WCDB/statement.hpp>
+
+namespace WCDB {
+
+class StatementCreateTrigger : public Statement {
+public:
+    enum class Event : int {
+        Delete,
+        Insert,
+        Update,
+    };
+
+    StatementCreateTrigger &create(const std::string &trigger,
+                                   bool ifNotExists = true,
+                                   bool temp = false);
+
+    StatementCreateTrigger &before(Event event);
+    StatementCreateTrigger &after(Event event);
+
+    template <typename T = Column>
+    typename std::enable_if<std::is_base_of<Column, T>::value,
+                            StatementCreateTrigger &>::type
+    of(const std::list<const T> &columnList)
+    {
+        m_description.append(" OF ");
+        joinDescribableList(columnList);
+        return *this;
+    }
+
+    StatementCreateTrigger &on(const std::string &table);
+    StatementCreateTrigger &when(const Expr &expr);
+
+    //It can be called multiple times for multiple statements.
+    StatementCreateTrigger &execute(const Statement &statement);
+
+    virtual Statement::Type getStatementType() const override;
+
+protected:
+    static const char *EventName(Event event);
+};
+
+} //namespace WCDB
+
+#endif /* statement_create_trigger_hpp */
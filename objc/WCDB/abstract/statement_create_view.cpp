@@ -0,0 +1,55 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/expr.hpp>
+#include <WCDB/statement_create_view.hpp>
+#include <WCDB/statement_select.hpp>
+
+namespace WCDB {
+
+StatementCreateView &StatementCreateView::create(const std::string &view,
+                                                 bool ifNotExists,
+                                                 bool temp)
+{
+    m_description.append("CREATE ");
+    if (temp) {
+        m_description.append("TEMP ");
+    }
+    m_description.append("VIEW ");
+    if (ifNotExists) {
+        m_description.append("IF NOT EXISTS ");
+    }
+    m_description.append(view);
+    return *this;
+}
+
+StatementCreateView &
+StatementCreateView::as(const StatementSelect &statementSelect)
+{
+    m_description.append(" AS " + statementSelect.getDescription());
+    return *this;
+}
+
+Statement::Type StatementCreateView::getStatementType() const
+{
+    return Statement::Type::CreateView;
+}
+
+} //namespace WCDB
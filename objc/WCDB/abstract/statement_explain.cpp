@@ -35,7 +35,12 @@ StatementExplain &StatementExplain::explain(const Statement &statement)
 
 StatementExplain &StatementExplain::explainQueryPlan(const Statement &statement)
 {
-    m_description.append("EXPLAIN QUERY PLAN" + statement.getDescription());
+    return explainQueryPlan(statement.getDescription());
+}
+
+StatementExplain &StatementExplain::explainQueryPlan(const std::string &sql)
+{
+    m_description.append("EXPLAIN QUERY PLAN " + sql);
     return *this;
 }
 
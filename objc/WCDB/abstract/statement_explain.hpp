@@ -29,6 +29,7 @@ class StatementExplain : public Statement {
 public:
     StatementExplain &explain(const Statement &statement);
     StatementExplain &explainQueryPlan(const Statement &statement);
+    StatementExplain &explainQueryPlan(const std::string &sql);
 
     virtual Statement::Type getStatementType() const override;
 };
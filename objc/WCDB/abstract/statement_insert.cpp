@@ -22,6 +22,7 @@
 #include <WCDB/expr.hpp>
 #include <WCDB/handle.hpp>
 #include <WCDB/statement_insert.hpp>
+#include <WCDB/statement_select.hpp>
 
 namespace WCDB {
 
@@ -37,6 +38,13 @@ StatementInsert &StatementInsert::insert(const std::string &table,
     return *this;
 }
 
+StatementInsert &
+StatementInsert::values(const StatementSelect &statementSelect)
+{
+    m_description.append(" " + statementSelect.getDescription());
+    return *this;
+}
+
 Statement::Type StatementInsert::getStatementType() const
 {
     return Statement::Type::Insert;
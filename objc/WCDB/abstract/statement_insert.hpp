@@ -65,6 +65,8 @@ public:
         return *this;
     }
 
+    StatementInsert &values(const StatementSelect &statementSelect);
+
     virtual Statement::Type getStatementType() const override;
 };
 
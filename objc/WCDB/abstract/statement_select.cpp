@@ -87,6 +87,13 @@ StatementSelect &StatementSelect::having(const Expr &having)
     return *this;
 }
 
+StatementSelect &
+StatementSelect::unionAll(const StatementSelect &statementSelect)
+{
+    m_description.append(" UNION ALL " + statementSelect.getDescription());
+    return *this;
+}
+
 Statement::Type StatementSelect::getStatementType() const
 {
     return Statement::Type::Select;
@@ -86,6 +86,8 @@ public:
 
     StatementSelect &having(const Expr &having);
 
+    StatementSelect &unionAll(const StatementSelect &statementSelect);
+
     virtual Statement::Type getStatementType() const override;
 
     static StatementSelect Fts3Tokenizer;
@@ -0,0 +1,197 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/analyzer.hpp>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<Analyzer>>
+    Analyzer::s_analyzers;
+std::mutex Analyzer::s_mutex;
+
+Analyzer::Counter::Counter() : m_last(nullptr)
+{
+}
+
+void Analyzer::Counter::count(const char *table)
+{
+    //Rows of a statement are mostly changed in the same table
+    if (!m_last || m_lastTable != table) {
+        m_lastTable = table;
+        m_last = &m_changes[m_lastTable];
+    }
+    ++*m_last;
+}
+
+std::unordered_map<std::string, int64_t> Analyzer::Counter::take()
+{
+    std::unordered_map<std::string, int64_t> changes;
+    changes.swap(m_changes);
+    m_last = nullptr;
+    return changes;
+}
+
+std::shared_ptr<Analyzer> Analyzer::Register(const std::string &path,
+                                             const Config &config)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    std::shared_ptr<Analyzer> &analyzer = s_analyzers[path];
+    analyzer.reset(new Analyzer(path, config));
+    return analyzer;
+}
+
+void Analyzer::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_analyzers.erase(path);
+}
+
+std::shared_ptr<Analyzer> Analyzer::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_analyzers.find(path);
+    if (iter == s_analyzers.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+Analyzer::Analyzer(const std::string &thePath, const Config &config)
+    : path(thePath)
+    , m_config(config)
+    , m_pinnedTables(config.pinnedTables)
+    , m_loaded(false)
+{
+}
+
+const Analyzer::Config &Analyzer::getConfig() const
+{
+    return m_config;
+}
+
+bool Analyzer::isDrifted(const std::string &name, const Table &table) const
+{
+    if (m_pinnedTables.find(name) != m_pinnedTables.end()) {
+        return false;
+    }
+    int64_t threshold = (int64_t)(table.rows * m_config.driftRatio);
+    return table.changes >= std::max(m_config.minChanges, threshold);
+}
+
+bool Analyzer::addChanges(
+    const std::unordered_map<std::string, int64_t> &changes)
+{
+    bool drifted = false;
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    for (const auto &iter : changes) {
+        //Statistics of system tables are not gathered
+        if (strncmp(iter.first.c_str(), "sqlite_", 7) == 0) {
+            continue;
+        }
+        Table &table = m_tables[iter.first];
+        table.changes += iter.second;
+        drifted = drifted || isDrifted(iter.first, table);
+    }
+    return drifted;
+}
+
+bool Analyzer::isLoaded() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_loaded;
+}
+
+void Analyzer::load(const std::unordered_map<std::string, int64_t> &rows)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    for (const auto &iter : rows) {
+        m_tables[iter.first].rows = iter.second;
+    }
+    m_loaded = true;
+}
+
+std::list<std::string> Analyzer::getDriftedTables() const
+{
+    std::list<std::pair<int64_t, std::string>> drifted;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        for (const auto &iter : m_tables) {
+            if (isDrifted(iter.first, iter.second)) {
+                drifted.push_back({iter.second.changes, iter.first});
+            }
+        }
+    }
+    //Most changed first
+    drifted.sort(std::greater<std::pair<int64_t, std::string>>());
+    std::list<std::string> tables;
+    for (const auto &iter : drifted) {
+        if ((int) tables.size() >= m_config.maxTablesPerRun) {
+            break;
+        }
+        tables.push_back(iter.second);
+    }
+    return tables;
+}
+
+void Analyzer::markAnalyzed(const std::string &table, int64_t rows)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Table &analyzed = m_tables[table];
+    analyzed.changes = 0;
+    analyzed.rows = rows;
+    ++analyzed.analyses;
+    analyzed.lastAnalyzed = time(nullptr);
+}
+
+void Analyzer::markDropped(const std::string &table)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_tables.erase(table);
+}
+
+void Analyzer::pin(const std::string &table)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_pinnedTables.insert(table);
+}
+
+Analyzer::Statistics Analyzer::getStatistics(const std::string &table) const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    bool pinned = m_pinnedTables.find(table) != m_pinnedTables.end();
+    auto iter = m_tables.find(table);
+    if (iter == m_tables.end()) {
+        return {0, 0, 0, 0, pinned};
+    }
+    return {iter->second.changes, iter->second.rows, iter->second.analyses,
+            iter->second.lastAnalyzed, pinned};
+}
+
+int64_t Analyzer::GetRows(const std::string &stat)
+{
+    //e.g. "10000 100 1", rows of table followed by rows per key of index
+    return strtoll(stat.c_str(), nullptr, 10);
+}
+
+} //namespace WCDB
@@ -0,0 +1,131 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef analyzer_hpp
+#define analyzer_hpp
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [Analyzer] counts the rows changed of each table since it's analyzed, and decides which tables have drifted from their sqlite_stat1 statistics.
+ * Tables in [pinnedTables] keep their statistics, e.g. imported known-good ones.
+ */
+class Analyzer {
+public:
+    struct Config {
+        //A table drifts once its changed rows reach
+        //max(minChanges, rows * driftRatio)
+        int64_t minChanges;
+        double driftRatio;
+        //Rows of each index sampled by ANALYZE, 0 for all.
+        //It's ignored before SQLite 3.32.0.
+        int analysisLimit;
+        //Tables analyzed after each idle period
+        int maxTablesPerRun;
+        std::set<std::string> pinnedTables;
+    };
+
+    //Row of sqlite_stat1
+    struct Stat {
+        std::string table;
+        std::string index; //empty for the table itself
+        std::string stat;
+    };
+
+    struct Statistics {
+        int64_t changes;
+        int64_t rows; //as of last analysis
+        int analyses;
+        int64_t lastAnalyzed; //seconds since epoch
+        bool pinned;
+    };
+
+    //Changes counted by a handle before they are committed
+    class Counter {
+    public:
+        Counter();
+        void count(const char *table);
+        std::unordered_map<std::string, int64_t> take();
+
+    protected:
+        std::unordered_map<std::string, int64_t> m_changes;
+        std::string m_lastTable;
+        int64_t *m_last;
+    };
+
+    static std::shared_ptr<Analyzer> Register(const std::string &path,
+                                              const Config &config);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<Analyzer> Get(const std::string &path);
+
+    const std::string path;
+    const Config &getConfig() const;
+
+    //Return true if any table drifts
+    bool addChanges(const std::unordered_map<std::string, int64_t> &changes);
+
+    //Rows of tables from sqlite_stat1
+    bool isLoaded() const;
+    void load(const std::unordered_map<std::string, int64_t> &rows);
+
+    std::list<std::string> getDriftedTables() const;
+    void markAnalyzed(const std::string &table, int64_t rows);
+    void markDropped(const std::string &table);
+    void pin(const std::string &table);
+
+    Statistics getStatistics(const std::string &table) const;
+
+    //Rows in the first field of [stat]
+    static int64_t GetRows(const std::string &stat);
+
+protected:
+    Analyzer(const std::string &path, const Config &config);
+    Analyzer(const Analyzer &) = delete;
+    Analyzer &operator=(const Analyzer &) = delete;
+
+    const Config m_config;
+
+    struct Table {
+        int64_t changes;
+        int64_t rows;
+        int analyses;
+        int64_t lastAnalyzed;
+    };
+    bool isDrifted(const std::string &name, const Table &table) const;
+    std::unordered_map<std::string, Table> m_tables;
+    std::set<std::string> m_pinnedTables;
+    bool m_loaded;
+    mutable std::mutex m_mutex;
+
+    static std::unordered_map<std::string, std::shared_ptr<Analyzer>>
+        s_analyzers;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* analyzer_hpp */
@@ -34,49 +34,68 @@ Configs::Configs(std::initializer_list<const ConfigWrap> configs)
     }
 }
 
+Configs::Configs(const Configs &other)
+    : m_configs(std::atomic_load(&other.m_configs))
+{
+}
+
+Configs &Configs::operator=(const Configs &other)
+{
+    std::atomic_store(&m_configs, std::atomic_load(&other.m_configs));
+    return *this;
+}
+
+//Retried if another config is set meanwhile, so that none of them is lost
 void Configs::setConfig(const std::string &name,
                         const Config &config,
                         Configs::Order order)
 {
-    std::shared_ptr<ConfigList> configs = m_configs;
-    std::shared_ptr<ConfigList> newConfigs(new ConfigList);
-    bool inserted = false;
-    for (const auto &wrap : *configs.get()) {
-        if (!inserted && order < wrap.order) {
+    std::shared_ptr<ConfigList> configs = std::atomic_load(&m_configs);
+    std::shared_ptr<ConfigList> newConfigs;
+    do {
+        newConfigs.reset(new ConfigList);
+        bool inserted = false;
+        for (const auto &wrap : *configs.get()) {
+            if (!inserted && order < wrap.order) {
+                newConfigs->push_back({name, config, order});
+                inserted = true;
+            }
+            if (name != wrap.name) {
+                newConfigs->push_back(wrap);
+            }
+        }
+        if (!inserted) {
             newConfigs->push_back({name, config, order});
-            inserted = true;
-        } else if (name != wrap.name) {
-            newConfigs->push_back(wrap);
         }
-    }
-    if (!inserted) {
-        newConfigs->push_back({name, config, order});
-    }
-    m_configs = newConfigs;
+    } while (
+        !std::atomic_compare_exchange_weak(&m_configs, &configs, newConfigs));
 }
 
 void Configs::setConfig(const std::string &name, const Config &config)
 {
-    std::shared_ptr<ConfigList> configs = m_configs;
-    std::shared_ptr<ConfigList> newConfigs(new ConfigList);
-    bool inserted = false;
-    for (const auto &wrap : *configs.get()) {
-        if (name != wrap.name) {
-            newConfigs->push_back(wrap);
-        } else {
-            newConfigs->push_back({name, config, wrap.order});
-            inserted = true;
+    std::shared_ptr<ConfigList> configs = std::atomic_load(&m_configs);
+    std::shared_ptr<ConfigList> newConfigs;
+    do {
+        newConfigs.reset(new ConfigList);
+        bool inserted = false;
+        for (const auto &wrap : *configs.get()) {
+            if (name != wrap.name) {
+                newConfigs->push_back(wrap);
+            } else {
+                newConfigs->push_back({name, config, wrap.order});
+                inserted = true;
+            }
         }
-    }
-    if (!inserted) {
-        newConfigs->push_back({name, config, INT_MAX});
-    }
-    m_configs = newConfigs;
+        if (!inserted) {
+            newConfigs->push_back({name, config, INT_MAX});
+        }
+    } while (
+        !std::atomic_compare_exchange_weak(&m_configs, &configs, newConfigs));
 }
 
 bool Configs::invoke(std::shared_ptr<Handle> &handle, Error &error)
 {
-    std::shared_ptr<ConfigList> configs = m_configs;
+    std::shared_ptr<ConfigList> configs = std::atomic_load(&m_configs);
     for (const auto &config : *configs.get()) {
         if (config.invoke && !config.invoke(handle, error)) {
             return false;
@@ -87,7 +106,7 @@ bool Configs::invoke(std::shared_ptr<Handle> &handle, Error &error)
 
 Config Configs::getConfigByName(const std::string &name) const
 {
-    std::shared_ptr<ConfigList> configs = m_configs;
+    std::shared_ptr<ConfigList> configs = std::atomic_load(&m_configs);
     for (const auto &config : *configs.get()) {
         if (config.name == name) {
             return config.invoke;
@@ -98,12 +117,13 @@ Config Configs::getConfigByName(const std::string &name) const
 
 bool operator==(const Configs &left, const Configs &right)
 {
-    return left.m_configs == right.m_configs;
+    return std::atomic_load(&left.m_configs) ==
+           std::atomic_load(&right.m_configs);
 }
 
 bool operator!=(const Configs &left, const Configs &right)
 {
-    return left.m_configs != right.m_configs;
+    return !(left == right);
 }
 
 } //namespace WCDB
@@ -75,13 +75,16 @@ public:
 
     Configs();
     Configs(std::initializer_list<const ConfigWrap> configs);
+    Configs(const Configs &other);
+    Configs &operator=(const Configs &other);
 
     Config getConfigByName(const std::string &name) const;
 
 protected:
     typedef std::list<ConfigWrap> ConfigList;
 
-    std::shared_ptr<ConfigList> m_configs; //copy-on-write
+    //copy-on-write, whose pointer is loaded and stored atomically
+    std::shared_ptr<ConfigList> m_configs;
 };
 
 struct ConfigWrap {
@@ -72,6 +72,16 @@ void Database::purgeFreeHandles()
     m_pool->purgeFreeHandles();
 }
 
+HandlePool::Statistics Database::getHandleStatistics() const
+{
+    return m_pool->getStatistics();
+}
+
+void Database::setHandleHealthConfig(const HandlePool::HealthConfig &config)
+{
+    m_pool->setHealthConfig(config);
+}
+
 void Database::PurgeFreeHandlesInAllDatabases()
 {
     HandlePool::PurgeFreeHandlesInAllPool();
@@ -22,7 +22,17 @@
 #define database_hpp
 
 #include <WCDB/abstract.h>
+#include <WCDB/analyzer.hpp>
 #include <WCDB/core_base.hpp>
+#include <WCDB/existence_filter.hpp>
+#include <WCDB/fts_merger.hpp>
+#include <WCDB/maintained_aggregate.hpp>
+#include <WCDB/plan_monitor.hpp>
+#include <WCDB/session.hpp>
+#include <WCDB/standby.hpp>
+#include <WCDB/statement_monitor.hpp>
+#include <WCDB/tiering.hpp>
+#include <WCDB/write_buffer.hpp>
 #include <WCDB/handle.hpp>
 #include <WCDB/handle_pool.hpp>
 #include <WCDB/statement_recyclable.hpp>
@@ -50,6 +60,11 @@ public:
 
     void purgeFreeHandles();
     static void PurgeFreeHandlesInAllDatabases();
+    //No handle is alive once it's closed
+    HandlePool::Statistics getHandleStatistics() const;
+    //Handles with suspicious errors are closed and replaced by new ones.
+    //Disabled by default.
+    void setHandleHealthConfig(const HandlePool::HealthConfig &config);
 
     //config
     enum class ConfigOrder : Configs::Order {
@@ -59,6 +74,7 @@ public:
         Synchronous = 3,
         Checkpoint = 4,
         Tokenize = 5,
+        Attach = 6,
     };
     static const std::string defaultBasicConfigName;
     static const std::string defaultCipherConfigName;
@@ -66,6 +82,12 @@ public:
     static const std::string defaultCheckpointConfigName;
     static const std::string defaultSynchronousConfigName;
     static const std::string defaultTokenizeConfigName;
+    static const std::string defaultSessionConfigName;
+    static const std::string defaultStandbyConfigName;
+    static const std::string defaultFTSMergeConfigName;
+    static const std::string defaultStatementMonitorConfigName;
+    static const std::string defaultPlanMonitorConfigName;
+    static const std::string defaultAnalyzeConfigName;
     static const Configs defaultConfigs;
     void setConfig(const std::string &name,
                    const Config &config,
@@ -93,6 +115,27 @@ public:
                                 Error &error) override;
     bool exec(const Statement &statement, Error &error) override;
     bool isTableExists(const std::string &tableName, Error &error) override;
+    RecyclableStatement prepare(const Statement &statement,
+                                const Cancellation &cancellation,
+                                Error &error);
+    bool exec(const Statement &statement,
+              const Cancellation &cancellation,
+              Error &error);
+    //Heavy statements, e.g. CREATE INDEX or a large ORDER BY, are sorted
+    //with an explicit budget. It's reset once the handle flows back, so that
+    //ordinary statements are unaffected.
+    struct SortBudget {
+        //Helper threads of sorter. 0 for single-threaded.
+        int workerThreads;
+        //Bytes sorted in memory before spilling. 0 keeps the cache size.
+        int64_t memory;
+    };
+    RecyclableStatement prepare(const Statement &statement,
+                                const SortBudget &budget,
+                                Error &error);
+    bool exec(const Statement &statement,
+              const SortBudget &budget,
+              Error &error);
 
     //transaction
     std::shared_ptr<Transaction> getTransaction(Error &error);
@@ -102,6 +145,10 @@ public:
     bool rollback(Error &error) override;
     bool runEmbeddedTransaction(TransactionBlock transaction,
                                 Error &error) override;
+    bool runTransaction(TransactionBlock transaction,
+                        const Cancellation &cancellation,
+                        Error &error);
+    using CoreBase::runTransaction;
 
     //Repair Kit
     bool backup(const void *key, const unsigned int &length, Error &error);
@@ -112,9 +159,326 @@ public:
                          const void *databaseKey,
                          const unsigned int &databaseKeyLength,
                          Error &error);
+    struct RepairReport {
+        std::list<std::string> damagedTables;
+        std::list<std::string> damagedIndexes;
+        //Rows restored into each damaged table
+        std::map<std::string, int64_t> salvagedRows;
+        int damagedPages = 0;
+        //Pages of damaged b-trees are leaked until VACUUM
+        bool leaked = false;
+        //Integrity check fails but no b-tree is found damaged
+        bool unresolved = false;
+    };
+    //Only the damaged tables are salvaged and the damaged indexes rebuilt.
+    //[key] and [pageSize] should be same as the cipher of database.
+    bool repairDamaged(const void *key,
+                       const unsigned int &keyLength,
+                       const int pageSize,
+                       RepairReport &report,
+                       Error &error);
+
+    //Existence Filter
+    //It should be set after the table is created. Only the writes through this process are observed.
+    void setExistenceFilter(const std::string &table,
+                            const std::string &column,
+                            size_t expectedCount,
+                            double falsePositiveRate = 0.01);
+    void removeExistenceFilter(const std::string &table,
+                               const std::string &column);
+    //false means the value does not exist definitely. The type of [value] should match the stored one.
+    bool mayExist(const std::string &table,
+                  const std::string &column,
+                  int64_t value);
+    bool mayExist(const std::string &table,
+                  const std::string &column,
+                  const std::string &value);
+    //The saved one is skipped if any write is not observed, e.g. by another process.
+    bool saveExistenceFilter(const std::string &table,
+                             const std::string &column,
+                             Error &error);
+    ExistenceFilter::Statistics
+    getExistenceFilterStatistics(const std::string &table,
+                                 const std::string &column);
+
+    //Maintained Aggregate
+    //COUNT(*) and SUM of [sumColumns] grouped by [groupColumn] are kept in a side table by triggers.
+    bool setMaintainedAggregate(const std::string &table,
+                                const std::string &groupColumn,
+                                const std::list<std::string> &sumColumns,
+                                Error &error);
+    bool removeMaintainedAggregate(const std::string &table,
+                                   const std::string &groupColumn,
+                                   Error &error);
+    //The type of [group] should match the stored one.
+    bool getMaintainedAggregate(const std::string &table,
+                                const std::string &groupColumn,
+                                int64_t group,
+                                MaintainedAggregate::Value &value,
+                                Error &error);
+    bool getMaintainedAggregate(const std::string &table,
+                                const std::string &groupColumn,
+                                const std::string &group,
+                                MaintainedAggregate::Value &value,
+                                Error &error);
+    //Rebuild the inconsistent ones
+    bool verifyMaintainedAggregates(Error &error);
+
+    //Tiering
+    //[key] nullptr uses the key of main database while an empty one means plain text. [pageSize] 0 uses the default one.
+    void setAttachment(const std::string &schema,
+                       const std::string &path,
+                       const void *key = nullptr,
+                       int keySize = 0,
+                       int pageSize = 0);
+    void removeAttachment(const std::string &schema);
+    //Rows matching [condition] are moved to the table with same name in [schema] in background, and then every minute.
+    bool setTiering(const std::string &table,
+                    const std::string &schema,
+                    const Expr &condition,
+                    int batchSize,
+                    Error &error);
+    void removeTiering(const std::string &table);
+    //Move all cold rows now
+    bool runTiering(Error &error);
+
+    //Session
+    //Changes of [tables], or all tables if it's empty, committed through this database are captured. [notification] is called for each transaction.
+    //It fails if session extension is not compiled in, see Handle::IsSessionSupported.
+    bool setSession(const std::list<std::string> &tables,
+                    bool patchset,
+                    const Session::Notification &notification,
+                    Error &error);
+    void removeSession();
+    //The changes captured since last time, combined into one
+    bool takeChangeset(Changeset &changeset, Error &error);
+    //[resolver] nullptr omits all conflicts
+    bool applyChangeset(const Changeset &changeset,
+                        const ChangesetConflictResolver &resolver,
+                        Error &error);
+
+    //Standby
+    //[key] and [pageSize] should be same as the cipher of database.
+    //Changes lost after promotion are bounded by [lag] if sqlite is compiled with SQLITE_ENABLE_DBPAGE_VTAB.
+    //Otherwise, each refresh copies the whole database, and the lag grows to 10 times its cost for large one.
+    void setStandby(const void *key,
+                    int keySize,
+                    int pageSize = 4096,
+                    const std::chrono::seconds &lag = std::chrono::seconds(10));
+    void removeStandby();
+    bool refreshStandby(Error &error);
+    //Replace the corrupted database with standby. It fails unless database is blockaded and closed.
+    bool promoteStandby(Error &error);
+    Standby::Statistics getStandbyStatistics();
+
+    //Online Copy
+    struct CopyOptions {
+        //Cipher of database, which should be same as the one set.
+        //nullptr [key] for plain text.
+        const void *key;
+        int keySize;
+        int pageSize;
+        //Pages copied in each step, between which foreground goes first
+        int pagesPerStep;
+        //The copy is rebuilt, which also vacuums it, if any of following
+        //is set.
+        bool vacuum;
+        //Cipher of the copy. nullptr [newKey] for plain text.
+        bool rekey;
+        const void *newKey;
+        int newKeySize;
+        //0 keeps the page size
+        int newPageSize;
+    };
+    //A transactionally consistent snapshot is copied to [destination],
+    //while others keep reading and writing.
+    //[progress] is called after each step of copying, not rebuilding.
+    bool copyTo(const std::string &destination,
+                const CopyOptions &options,
+                const CopyProgress &progress,
+                Error &error);
+
+    //Storage Analytics
+    struct BtreeStorage {
+        std::string name;
+        //The table it belongs to
+        std::string table;
+        bool isIndex = false;
+        int64_t leafPages = 0;
+        int64_t interiorPages = 0;
+        int64_t overflowPages = 0;
+        //Rows of table, or entries of index
+        int64_t entries = 0;
+        int64_t payload = 0; //in bytes
+        int64_t unused = 0;  //in bytes
+        //Pages out of order, which scatter the sequential reads
+        int64_t fragmentedPages = 0;
+        int64_t getPages() const;
+        double getFillFactor(int pageSize) const;
+        double getAveragePayload() const;
+    };
+    struct StorageReport {
+        int pageSize = 0;
+        int64_t pageCount = 0;
+        int64_t freelistPages = 0;
+        std::list<BtreeStorage> btrees;
+        //Upper bound of bytes reclaimed by VACUUM
+        int64_t getReclaimableBytes() const;
+    };
+    //Pages are read by sqlite_dbpage virtual table, one b-tree per read
+    //transaction, which yields to foreground every [pagesPerStep] pages.
+    //Checkpoints catch up between b-trees. Without SQLITE_ENABLE_DBPAGE_VTAB,
+    //they're scanned by dbstat in a single read transaction instead, which
+    //requires SQLITE_ENABLE_DBSTAT_VTAB.
+    bool analyzeStorage(StorageReport &report,
+                        Error &error,
+                        int pagesPerStep = 256);
+    typedef std::function<void(const StorageReport &, const Error &)>
+        StorageCallback;
+    //Analyze in background
+    void analyzeStorage(const StorageCallback &onAnalyzed,
+                        int pagesPerStep = 256);
+
+    //Memory
+    HandlePool::MemorySnapshot getMemorySnapshot();
+    //Caches of free handles are shrunk once [budget] bytes is exceeded
+    void setMemoryBudget(int64_t budget);
+    //path->snapshot
+    typedef std::function<void(
+        const std::map<std::string, HandlePool::MemorySnapshot> &)>
+        MemoryReport;
+    //nullptr to stop reporting
+    static void SetGlobalMemoryReport(const MemoryReport &report,
+                                      const std::chrono::seconds &interval =
+                                          std::chrono::seconds(60));
+
+    //FTS Merge
+    //Inline automerge of FTS3/4 [table] is disabled.
+    //Its segments are merged in background instead.
+    bool setFTSMerge(const std::string &table,
+                     const FTSMerger::Config &config,
+                     Error &error);
+    //Automerge is kept disabled
+    void removeFTSMerge(const std::string &table);
+    FTSMerger::Statistics getFTSMergeStatistics(const std::string &table);
+    //level->segments
+    bool getFTSSegmentCounts(const std::string &table,
+                             std::map<int64_t, int> &counts,
+                             Error &error);
+    //Merge all segments into one
+    bool optimizeFTS(const std::string &table, Error &error);
+
+    //Write Buffer
+    //Rows inserted by [bufferInsert] are flushed to [columns] of [table] in batched transactions.
+    //Statements through this database referring to [table] flush it first, so that buffered rows are read as written.
+    //Inside a transaction, they fail while rows are pending, since the flush would be rolled back with it.
+    bool setWriteBuffer(const std::string &table,
+                        const std::list<std::string> &columns,
+                        const WriteBuffer::Config &config,
+                        Error &error);
+    //Pending rows are flushed
+    bool removeWriteBuffer(const std::string &table, Error &error);
+    //Values of [row] are in the order of columns of the buffer
+    bool bufferInsert(const std::string &table,
+                      const WriteBuffer::Row &row,
+                      Error &error);
+    bool flushWriteBuffers(Error &error);
+    WriteBuffer::Statistics getWriteBufferStatistics(const std::string &table);
+
+    //Statement Monitor
+    //Execution counters of statements are aggregated by fingerprint while it's enabled. Statistics are kept after disabled until reset.
+    void setStatementMonitorEnabled(bool enabled, size_t maxFingerprints = 512);
+    std::list<StatementMonitor::Statistics> getStatementStatistics() const;
+    void resetStatementStatistics();
+
+    //Plan Monitor
+    //Query plans of statements are explained in background and recorded by fingerprint into a sidecar database. [onChanged] is called once the plan of a fingerprint differs from the recorded one, e.g. after upgrading SQLite or schema.
+    void setPlanMonitor(const PlanMonitor::Config &config,
+                        const PlanMonitor::ChangedCallback &onChanged);
+    void removePlanMonitor();
+
+    //Auto Analyze
+    //Rows changed of each table are counted once committed. Tables drifted from their statistics are analyzed in background once database is idle.
+    void setAutoAnalyze(const Analyzer::Config &config);
+    void removeAutoAnalyze();
+    Analyzer::Statistics getAnalyzeStatistics(const std::string &table);
+    //Rows of sqlite_stat1
+    bool exportStatistics(std::list<Analyzer::Stat> &stats, Error &error);
+    //Statistics of tables in [stats] are replaced, e.g. known-good ones for fresh installs. Pinned tables are no longer analyzed automatically in this launch.
+    bool importStatistics(const std::list<Analyzer::Stat> &stats,
+                          bool pin,
+                          Error &error);
 
 protected:
     static const std::array<std::string, 5> &subfixs();
+    static const std::string salvageSuffix;
+
+    static bool BuildExistenceFilter(Database &database,
+                                     ExistenceFilter &filter,
+                                     Error &error);
+    static bool PrepareExistenceFilterStamp(Database &database,
+                                            const ExistenceFilter &filter,
+                                            Error &error);
+    static bool GetExistenceFilterStamp(Database &database,
+                                        const ExistenceFilter &filter,
+                                        ExistenceFilter::Stamp &stamp,
+                                        Error &error);
+    bool mayExist(const std::string &table,
+                  const std::string &column,
+                  ColumnType type,
+                  const void *data,
+                  int size);
+
+    bool verifyMaintainedAggregate(const MaintainedAggregate &aggregate,
+                                   Error &error);
+
+    bool runTiering(const Tiering &tiering, Error &error);
+    static void ScheduleTiering(const std::string &key);
+
+    static bool RefreshStandby(Database &database,
+                               Standby &standby,
+                               Error &error);
+    static bool RefreshStandbyFully(Database &database,
+                                    Standby &standby,
+                                    RecyclableHandle &source,
+                                    Error &error);
+    //[supported] is false if standby can't be refreshed by pages, which leaves it untouched
+    static bool RefreshStandbyIncrementally(Database &database,
+                                            Standby &standby,
+                                            RecyclableHandle &source,
+                                            const std::set<uint32_t> &pages,
+                                            bool &supported,
+                                            Error &error);
+    static void ScheduleStandby(const std::string &path);
+    //Roll back the hot journal or checkpoint the wal of standby, and verify it
+    bool recoverStandby(Error &error);
+
+    static void ScheduleFTSMerge(const std::string &path);
+    static void MergeFTS(Database &database, FTSMerger &merger);
+    static void ScheduleAnalyze(const std::string &path);
+    static void Analyze(Database &database, Analyzer &analyzer);
+    static void SchedulePlanCheck(const std::string &path);
+    static void CheckPlans(Database &database, PlanMonitor &monitor);
+    static StatementInsert FTSCommand(const std::string &table,
+                                      const std::string &command);
+    bool rebuildMaintainedAggregate(const MaintainedAggregate &aggregate,
+                                    Error &error);
+    RecyclableStatement prepareMaintainedAggregate(
+        const std::string &table,
+        const std::string &groupColumn,
+        std::shared_ptr<const MaintainedAggregate> &aggregate,
+        Error &error);
+    bool stepMaintainedAggregate(RecyclableStatement &statementHandle,
+                                 const MaintainedAggregate &aggregate,
+                                 MaintainedAggregate::Value &value,
+                                 Error &error);
+
+    bool flushWriteBuffer(WriteBuffer &buffer, Error &error);
+    //It fails if the pending rows are referred inside a transaction, or they can't be flushed
+    bool flushWriteBuffersReferredBy(const Statement &statement, Error &error);
+    static void ScheduleWriteBufferFlush(const std::string &key);
+
+    static void Checkpoint(Database &database);
 
     RecyclableHandle flowOut(Error &error);
     static ThreadLocal<std::unordered_map<std::string, RecyclableHandle>>
@@ -0,0 +1,267 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/scheduler.hpp>
+#include <cmath>
+
+namespace WCDB {
+
+bool Database::setMaintainedAggregate(const std::string &table,
+                                      const std::string &groupColumn,
+                                      const std::list<std::string> &sumColumns,
+                                      Error &error)
+{
+    std::shared_ptr<const MaintainedAggregate> aggregate =
+        MaintainedAggregate::Register(getPath(), table, groupColumn,
+                                      sumColumns);
+    bool created = false;
+    bool result = runTransaction(
+        [this, &aggregate, &created](Error &error) -> bool {
+            //Triggers are always recreated since sum columns may be changed
+            for (const auto &statement :
+                 aggregate->getDropTriggerStatements()) {
+                if (!exec(statement, error)) {
+                    return false;
+                }
+            }
+            bool exists = isTableExists(aggregate->getName(), error);
+            if (!error.isOK()) {
+                return false;
+            }
+            if (exists) {
+                //Side table of the old columns
+                Error innerError;
+                if (!prepare(aggregate->getSelectStatement(), innerError)) {
+                    if (!exec(aggregate->getDropTableStatement(), error)) {
+                        return false;
+                    }
+                    exists = false;
+                }
+            }
+            if (!exists &&
+                !exec(aggregate->getCreateTableStatement(), error)) {
+                return false;
+            }
+            for (const auto &statement :
+                 aggregate->getCreateTriggerStatements()) {
+                if (!exec(statement, error)) {
+                    return false;
+                }
+            }
+            created = !exists;
+            return !created || rebuildMaintainedAggregate(*aggregate.get(),
+                                                          error);
+        },
+        nullptr, error);
+    if (!result) {
+        MaintainedAggregate::Unregister(getPath(), table, groupColumn);
+        return false;
+    }
+    if (!created) {
+        //The side table may be out of date, e.g. after repair
+        const std::string path = getPath();
+        Scheduler::shared()->post(Scheduler::Priority::Low,
+                                  [path, aggregate]() {
+                                      Database database(path);
+                                      Error innerError;
+                                      database.verifyMaintainedAggregate(
+                                          *aggregate.get(), innerError);
+                                  });
+    }
+    return true;
+}
+
+bool Database::removeMaintainedAggregate(const std::string &table,
+                                         const std::string &groupColumn,
+                                         Error &error)
+{
+    std::shared_ptr<const MaintainedAggregate> aggregate =
+        MaintainedAggregate::Get(getPath(), table, groupColumn);
+    if (!aggregate) {
+        //It's not set in this launch
+        aggregate =
+            MaintainedAggregate::Register(getPath(), table, groupColumn, {});
+    }
+    MaintainedAggregate::Unregister(getPath(), table, groupColumn);
+    return runTransaction(
+        [this, &aggregate](Error &error) -> bool {
+            for (const auto &statement :
+                 aggregate->getDropTriggerStatements()) {
+                if (!exec(statement, error)) {
+                    return false;
+                }
+            }
+            return exec(aggregate->getDropTableStatement(), error);
+        },
+        nullptr, error);
+}
+
+RecyclableStatement Database::prepareMaintainedAggregate(
+    const std::string &table,
+    const std::string &groupColumn,
+    std::shared_ptr<const MaintainedAggregate> &aggregate,
+    Error &error)
+{
+    aggregate = MaintainedAggregate::Get(getPath(), table, groupColumn);
+    if (!aggregate) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Prepare,
+                          Error::CoreCode::Misuse,
+                          "Maintained aggregate is not set", &error);
+        return RecyclableStatement(RecyclableHandle(nullptr, nullptr), nullptr);
+    }
+    return prepare(aggregate->getSelectStatement(), error);
+}
+
+bool Database::stepMaintainedAggregate(RecyclableStatement &statementHandle,
+                                       const MaintainedAggregate &aggregate,
+                                       MaintainedAggregate::Value &value,
+                                       Error &error)
+{
+    value.count = 0;
+    value.sums.assign(aggregate.sumColumns.size(), 0);
+    if (statementHandle->step()) {
+        value.count = statementHandle->getValue<ColumnType::Integer64>(0);
+        for (int i = 0; i < (int) value.sums.size(); ++i) {
+            value.sums[i] = statementHandle->getValue<ColumnType::Float>(i + 1);
+        }
+    }
+    if (!statementHandle->isOK()) {
+        error = statementHandle->getError();
+        return false;
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::getMaintainedAggregate(const std::string &table,
+                                      const std::string &groupColumn,
+                                      int64_t group,
+                                      MaintainedAggregate::Value &value,
+                                      Error &error)
+{
+    std::shared_ptr<const MaintainedAggregate> aggregate;
+    RecyclableStatement statementHandle =
+        prepareMaintainedAggregate(table, groupColumn, aggregate, error);
+    if (!statementHandle) {
+        return false;
+    }
+    statementHandle->bind<ColumnType::Integer64>(group, 1);
+    return stepMaintainedAggregate(statementHandle, *aggregate.get(), value,
+                                   error);
+}
+
+bool Database::getMaintainedAggregate(const std::string &table,
+                                      const std::string &groupColumn,
+                                      const std::string &group,
+                                      MaintainedAggregate::Value &value,
+                                      Error &error)
+{
+    std::shared_ptr<const MaintainedAggregate> aggregate;
+    RecyclableStatement statementHandle =
+        prepareMaintainedAggregate(table, groupColumn, aggregate, error);
+    if (!statementHandle) {
+        return false;
+    }
+    statementHandle->bind<ColumnType::Text>(group.c_str(), 1);
+    return stepMaintainedAggregate(statementHandle, *aggregate.get(), value,
+                                   error);
+}
+
+bool Database::verifyMaintainedAggregates(Error &error)
+{
+    for (const auto &aggregate : MaintainedAggregate::GetAll(getPath())) {
+        if (!verifyMaintainedAggregate(*aggregate.get(), error)) {
+            return false;
+        }
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::rebuildMaintainedAggregate(const MaintainedAggregate &aggregate,
+                                          Error &error)
+{
+    return exec(aggregate.getClearStatement(), error) &&
+           exec(aggregate.getRebuildStatement(), error);
+}
+
+bool Database::verifyMaintainedAggregate(const MaintainedAggregate &aggregate,
+                                         Error &error)
+{
+    //Base table and side table are compared in a same snapshot
+    if (!begin(StatementTransaction::Mode::Defered, error)) {
+        return false;
+    }
+    bool consistent = false;
+    {
+        //Totals are cheap to compare and catch the most of inconsistencies
+        RecyclableStatement base =
+            prepare(aggregate.getBaseTotalStatement(), error);
+        RecyclableStatement side =
+            base ? prepare(aggregate.getSideTotalStatement(), error) : base;
+        if (side && base->step() && side->step()) {
+            consistent = true;
+            //count of groups, count of rows, sums
+            int count = (int) aggregate.sumColumns.size() + 2;
+            for (int i = 0; i < count && consistent; ++i) {
+                double expected = base->getValue<ColumnType::Float>(i);
+                double actual = side->getValue<ColumnType::Float>(i);
+                consistent = std::fabs(expected - actual) <=
+                             1e-9 * std::fmax(1, std::fabs(expected));
+            }
+        }
+        if (base && !base->isOK()) {
+            error = base->getError();
+        } else if (side && !side->isOK()) {
+            error = side->getError();
+        }
+    }
+    if (consistent) {
+        //Errors in different groups may cancel out in totals. Since counts
+        //of groups are same, no extra group is left in side table once all
+        //groups of base table match.
+        RecyclableStatement mismatch =
+            prepare(aggregate.getMismatchStatement(), error);
+        if (mismatch && mismatch->step()) {
+            consistent = mismatch->getValue<ColumnType::Integer64>(0) == 0;
+        }
+        if (mismatch && !mismatch->isOK()) {
+            error = mismatch->getError();
+        }
+    }
+    Error innerError;
+    commit(innerError);
+    if (!error.isOK()) {
+        return false;
+    }
+    if (consistent) {
+        return true;
+    }
+    Error::Warning(
+        ("Rebuilding inconsistent aggregate: " + aggregate.getName()).c_str());
+    return runTransaction(
+        [this, &aggregate](Error &error) -> bool {
+            return rebuildMaintainedAggregate(aggregate, error);
+        },
+        nullptr, error);
+}
+
+} //namespace WCDB
@@ -0,0 +1,295 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/handle_statement.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace WCDB {
+
+static const std::string s_statTableName("sqlite_stat1");
+static const Column s_statTable("tbl");
+static const Column s_statIndex("idx");
+static const Column s_stat("stat");
+
+void Database::setAutoAnalyze(const Analyzer::Config &config)
+{
+    std::shared_ptr<Analyzer> analyzer =
+        Analyzer::Register(getPath(), config);
+    m_pool->setConfig(
+        Database::defaultAnalyzeConfigName,
+        [analyzer](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            //Rows are counted once committed
+            std::shared_ptr<Analyzer::Counter> counter(new Analyzer::Counter);
+            handle->registerUpdatedHook(
+                Database::defaultAnalyzeConfigName,
+                [counter](int, const char *table) { counter->count(table); });
+            handle->registerCommittedHook(
+                Database::defaultAnalyzeConfigName,
+                [analyzer, counter](Handle *handle, int pages, void *) {
+                    if (analyzer->addChanges(counter->take())) {
+                        Database::ScheduleAnalyze(handle->path);
+                    }
+                },
+                nullptr);
+            return true;
+        });
+    Database::ScheduleAnalyze(getPath());
+}
+
+void Database::removeAutoAnalyze()
+{
+    if (!Analyzer::Get(getPath())) {
+        return;
+    }
+    m_pool->setConfig(
+        Database::defaultAnalyzeConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerUpdatedHook(Database::defaultAnalyzeConfigName,
+                                        nullptr);
+            handle->registerCommittedHook(Database::defaultAnalyzeConfigName,
+                                          nullptr, nullptr);
+            return true;
+        });
+    Analyzer::Unregister(getPath());
+}
+
+Analyzer::Statistics Database::getAnalyzeStatistics(const std::string &table)
+{
+    std::shared_ptr<Analyzer> analyzer = Analyzer::Get(getPath());
+    if (!analyzer) {
+        return {0, 0, 0, 0, false};
+    }
+    return analyzer->getStatistics(table);
+}
+
+bool Database::exportStatistics(std::list<Analyzer::Stat> &stats,
+                                Error &error)
+{
+    std::list<const ColumnResult> results = {
+        ColumnResult(s_statTable), ColumnResult(s_statIndex),
+        ColumnResult(s_stat),
+    };
+    RecyclableStatement statementHandle = prepare(
+        StatementSelect().select(results).from(s_statTableName), error);
+    if (!statementHandle) {
+        return false;
+    }
+    stats.clear();
+    while (statementHandle->step()) {
+        const char *index = statementHandle->getValue<ColumnType::Text>(1);
+        stats.push_back({statementHandle->getValue<ColumnType::Text>(0),
+                         index ? index : "",
+                         statementHandle->getValue<ColumnType::Text>(2)});
+    }
+    error = statementHandle->getError();
+    return error.isOK();
+}
+
+bool Database::importStatistics(const std::list<Analyzer::Stat> &stats,
+                                bool pin,
+                                Error &error)
+{
+    //It creates sqlite_stat1 without analyzing any table
+    static const StatementAnalyze s_createStatTable =
+        StatementAnalyze().analyze("sqlite_master");
+    std::set<std::string> tables;
+    for (const Analyzer::Stat &stat : stats) {
+        tables.insert(stat.table);
+    }
+    bool result = runTransaction(
+        [this, &stats, &tables](Error &error) -> bool {
+            if (!exec(s_createStatTable, error)) {
+                return false;
+            }
+            for (const std::string &table : tables) {
+                if (!exec(StatementDelete()
+                              .deleteFrom(s_statTableName)
+                              .where(Expr(s_statTable) == table),
+                          error)) {
+                    return false;
+                }
+            }
+            std::list<const Expr> values = {
+                Expr::BindParameter, Expr::BindParameter,
+                Expr::BindParameter};
+            RecyclableStatement statementHandle = prepare(
+                StatementInsert()
+                    .insert(s_statTableName,
+                            {s_statTable, s_statIndex, s_stat},
+                            Conflict::NotSet)
+                    .values(values),
+                error);
+            if (!statementHandle) {
+                return false;
+            }
+            for (const Analyzer::Stat &stat : stats) {
+                statementHandle->reset();
+                statementHandle->bind<ColumnType::Text>(stat.table.c_str(),
+                                                        1);
+                if (stat.index.empty()) {
+                    statementHandle->bind<ColumnType::Null>(2);
+                } else {
+                    statementHandle->bind<ColumnType::Text>(
+                        stat.index.c_str(), 2);
+                }
+                statementHandle->bind<ColumnType::Text>(stat.stat.c_str(), 3);
+                statementHandle->step();
+                if (!statementHandle->isOK()) {
+                    error = statementHandle->getError();
+                    return false;
+                }
+            }
+            return true;
+        },
+        nullptr, error);
+    if (!result) {
+        return false;
+    }
+    std::shared_ptr<Analyzer> analyzer = Analyzer::Get(getPath());
+    if (analyzer) {
+        for (const Analyzer::Stat &stat : stats) {
+            analyzer->markAnalyzed(stat.table, Analyzer::GetRows(stat.stat));
+            if (pin) {
+                analyzer->pin(stat.table);
+            }
+        }
+    }
+    m_pool->reloadStatistics();
+    return true;
+}
+
+void Database::ScheduleAnalyze(const std::string &path)
+{
+    //Analyzing starts after database is idle for a while
+    static TimedQueue<std::string> s_timedQueue(5);
+    s_timedQueue.reQueue(path);
+    static std::thread s_analyzeThread([]() {
+        SET_THREAD_NAME(
+            ("WCDB-" + Database::defaultAnalyzeConfigName).c_str());
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &path) {
+                std::shared_ptr<Analyzer> analyzer = Analyzer::Get(path);
+                if (!analyzer) {
+                    return;
+                }
+                Database database(path);
+                Database::Analyze(database, *analyzer.get());
+                if (!analyzer->getDriftedTables().empty()) {
+                    //Resume after next idle
+                    s_timedQueue.reQueue(path);
+                }
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_analyzeThread.detach(); });
+}
+
+static bool GetStatRows(const RecyclableHandle &handle,
+                        const Expr &condition,
+                        std::unordered_map<std::string, int64_t> &rows)
+{
+    std::list<const ColumnResult> results = {ColumnResult(s_statTable),
+                                             ColumnResult(s_stat)};
+    std::shared_ptr<StatementHandle> statementHandle =
+        handle->prepare(StatementSelect()
+                            .select(results)
+                            .from(s_statTableName)
+                            .where(condition));
+    if (!statementHandle) {
+        return false;
+    }
+    while (statementHandle->step()) {
+        int64_t &tableRows =
+            rows[statementHandle->getValue<ColumnType::Text>(0)];
+        int64_t statRows =
+            Analyzer::GetRows(statementHandle->getValue<ColumnType::Text>(1));
+        tableRows = std::max(tableRows, statRows);
+    }
+    return statementHandle->isOK();
+}
+
+void Database::Analyze(Database &database, Analyzer &analyzer)
+{
+    static const StatementSelect s_getTable =
+        StatementSelect()
+            .select({ColumnResult(Column("name"))})
+            .from("sqlite_master")
+            .where(Expr(Column("type")) == "table" &&
+                   Expr(Column("name")) == Expr::BindParameter);
+    Error error;
+    RecyclableHandle handle = database.flowOut(error);
+    if (!handle) {
+        return;
+    }
+    if (!analyzer.isLoaded()) {
+        //sqlite_stat1 doesn't exist before the first analysis
+        std::unordered_map<std::string, int64_t> rows;
+        GetStatRows(handle, Expr(s_statIndex).isNull(), rows);
+        analyzer.load(rows);
+    }
+    const Analyzer::Config &config = analyzer.getConfig();
+    bool analyzed = false;
+    for (const std::string &table : analyzer.getDriftedTables()) {
+        bool exists = false;
+        std::unordered_map<std::string, int64_t> rows;
+        bool succeed = false;
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            std::shared_ptr<StatementHandle> statementHandle =
+                handle->prepare(s_getTable);
+            if (!statementHandle) {
+                return;
+            }
+            statementHandle->bind<ColumnType::Text>(table.c_str(), 1);
+            exists = statementHandle->step();
+            statementHandle = nullptr;
+            if (!exists) {
+                return;
+            }
+            //Bounded by sampling rows of each index
+            if (config.analysisLimit > 0) {
+                handle->exec(StatementPragma().pragma(Pragma::AnalysisLimit,
+                                                      config.analysisLimit));
+            }
+            succeed = handle->exec(StatementAnalyze().analyze(table)) &&
+                      GetStatRows(handle, Expr(s_statTable) == table, rows);
+        });
+        if (!exists) {
+            analyzer.markDropped(table);
+        } else if (succeed) {
+            analyzer.markAnalyzed(table, rows[table]);
+            analyzed = true;
+        } else {
+            break;
+        }
+    }
+    handle = nullptr;
+    if (analyzed) {
+        //Other handles keep the old statistics until they are reloaded
+        database.m_pool->reloadStatistics();
+    }
+}
+
+} //namespace WCDB
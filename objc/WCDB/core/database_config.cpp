@@ -22,9 +22,12 @@
 #include <WCDB/fts_modules.hpp>
 #include <WCDB/handle_statement.hpp>
 #include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
 #include <WCDB/timed_queue.hpp>
 #include <WCDB/utility.hpp>
+#include <mutex>
 #include <queue>
+#include <set>
 #include <thread>
 #include <vector>
 
@@ -36,6 +39,13 @@ const std::string Database::defaultTraceConfigName = "trace";
 const std::string Database::defaultCheckpointConfigName = "checkpoint";
 const std::string Database::defaultSynchronousConfigName = "synchronous";
 const std::string Database::defaultTokenizeConfigName = "tokenize";
+const std::string Database::defaultSessionConfigName = "session";
+const std::string Database::defaultStandbyConfigName = "standby";
+const std::string Database::defaultFTSMergeConfigName = "ftsMerge";
+const std::string Database::defaultStatementMonitorConfigName =
+    "statementMonitor";
+const std::string Database::defaultPlanMonitorConfigName = "planMonitor";
+const std::string Database::defaultAnalyzeConfigName = "autoAnalyze";
 std::shared_ptr<PerformanceTrace> Database::s_globalPerformanceTrace = nullptr;
 std::shared_ptr<SQLTrace> Database::s_globalSQLTrace = nullptr;
 
@@ -201,23 +211,43 @@ const Configs Database::defaultConfigs(
          Database::defaultCheckpointConfigName,
          [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
              handle->registerCommittedHook(
+                 Database::defaultCheckpointConfigName,
                  [](Handle *handle, int pages, void *) {
                      static TimedQueue<std::string> s_timedQueue(2);
+                     //Pages of WAL over the limit, which grows while its
+                     //checkpoint is held back
+                     static const int s_maxWalPages = 10000;
+                     static std::mutex s_mutex;
+                     static std::set<std::string> s_overLimit;
                      if (pages > 1000) {
+                         if (pages > s_maxWalPages) {
+                             std::lock_guard<std::mutex> lockGuard(s_mutex);
+                             s_overLimit.insert(handle->path);
+                         }
                          s_timedQueue.reQueue(handle->path);
                      }
                      static std::thread s_checkpointThread([]() {
-                         pthread_setname_np(
+                         SET_THREAD_NAME(
                              ("WCDB-" + Database::defaultCheckpointConfigName)
                                  .c_str());
                          while (true) {
                              s_timedQueue.waitUntilExpired(
                                  [](const std::string &path) {
-                                     Database database(path);
-                                     WCDB::Error innerError;
-                                     database.exec(StatementPragma().pragma(
-                                                       Pragma::WalCheckpoint),
-                                                   innerError);
+                                     Scheduler::Priority priority =
+                                         Scheduler::Priority::High;
+                                     {
+                                         std::lock_guard<std::mutex> lockGuard(
+                                             s_mutex);
+                                         if (s_overLimit.erase(path) > 0) {
+                                             priority =
+                                                 Scheduler::Priority::Urgent;
+                                         }
+                                     }
+                                     Scheduler::shared()->run(
+                                         priority, [&path]() {
+                                             Database database(path);
+                                             Database::Checkpoint(database);
+                                         });
                                  });
                          }
                      });
@@ -236,6 +266,41 @@ const Configs Database::defaultConfigs(
          (Configs::Order) Database::ConfigOrder::Tokenize,
      }});
 
+void Database::Checkpoint(Database &database)
+{
+    static const StatementPragma s_checkpoint =
+        StatementPragma().pragma(Pragma::WalCheckpoint);
+    static const StatementPragma s_getPageSize =
+        StatementPragma().pragma(Pragma::PageSize);
+
+    WCDB::Error innerError;
+    RecyclableStatement statementHandle =
+        database.prepare(s_checkpoint, innerError);
+    if (!statementHandle) {
+        return;
+    }
+    statementHandle->step();
+    if (!statementHandle->isOK()) {
+        return;
+    }
+    //busy, log, checkpointed
+    int checkpointed =
+        statementHandle->getValue<WCDB::ColumnType::Integer32>(2);
+    statementHandle = nullptr;
+    if (checkpointed <= 0) {
+        return;
+    }
+
+    statementHandle = database.prepare(s_getPageSize, innerError);
+    if (statementHandle && statementHandle->step()) {
+        int pageSize =
+            statementHandle->getValue<WCDB::ColumnType::Integer32>(0);
+        statementHandle = nullptr;
+        //It's only known after, which throttles the works next
+        Scheduler::shared()->consume((size_t) checkpointed * pageSize);
+    }
+}
+
 void Database::setConfig(const std::string &name,
                          const Config &config,
                          Configs::Order order)
@@ -272,6 +337,13 @@ void Database::setCipher(const void *key, int keySize, int pageSize)
                               return false;
                           }
 
+                          //Derive the key now, rather than while holding the
+                          //write lock by the first write
+                          if (!handle->validate()) {
+                              error = handle->getError();
+                              return false;
+                          }
+
                           error.reset();
                           return true;
                       });
@@ -0,0 +1,158 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/scheduler.hpp>
+#include <algorithm>
+
+namespace WCDB {
+
+bool Database::copyTo(const std::string &destination,
+                      const CopyOptions &options,
+                      const CopyProgress &progress,
+                      Error &error)
+{
+    static const StatementPragma s_pageSize =
+        StatementPragma().pragma(Pragma::PageSize);
+    static const std::string s_schema("wcdb_copy");
+
+    const std::string snapshotPath = destination + "-snapshot";
+    const std::string rebuiltPath = destination + "-rebuilt";
+    std::list<std::string> tempPaths;
+    for (const std::string &path : {snapshotPath, rebuiltPath}) {
+        for (const char *subfix : {"", "-wal", "-shm", "-journal"}) {
+            tempPaths.push_back(path + subfix);
+        }
+    }
+    const bool rebuild =
+        options.vacuum || options.rekey || options.newPageSize > 0;
+
+    bool result = false;
+    do {
+        if (!File::removeFiles(tempPaths, error)) {
+            break;
+        }
+        RecyclableHandle source = flowOut(error);
+        if (!source) {
+            break;
+        }
+        int pageSize = 4096;
+        {
+            std::shared_ptr<StatementHandle> statementHandle =
+                source->prepare(s_pageSize);
+            if (statementHandle && statementHandle->step()) {
+                pageSize = statementHandle->getValue<ColumnType::Integer32>(0);
+            }
+        }
+
+        //The snapshot is copied page by page, with the same cipher
+        bool copied = false;
+        {
+            Handle snapshot(snapshotPath);
+            if (!snapshot.open() ||
+                (options.key &&
+                 (!snapshot.setCipherKey(options.key, options.keySize) ||
+                  !snapshot.exec(StatementPragma().pragma(
+                      Pragma::CipherPageSize, options.pageSize))))) {
+                error = snapshot.getError();
+                break;
+            }
+            Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+                //Each step is charged before it's copied
+                int pagesPerStep =
+                    options.pagesPerStep > 0 ? options.pagesPerStep : 256;
+                Scheduler::shared()->consume((size_t) pagesPerStep * pageSize);
+                copied = source->copyTo(
+                    snapshot, pagesPerStep,
+                    [&](int copiedPages, int totalPages) -> bool {
+                        if (copiedPages < totalPages) {
+                            Scheduler::shared()->consume(
+                                (size_t) std::min(pagesPerStep,
+                                                  totalPages - copiedPages) *
+                                pageSize);
+                        }
+                        return !progress || progress(copiedPages, totalPages);
+                    });
+            });
+        }
+        if (!copied) {
+            error = source->getError();
+            break;
+        }
+        source = nullptr;
+        if (!rebuild) {
+            result = File::renameFile(snapshotPath, destination, error);
+            break;
+        }
+
+        //The private snapshot is rebuilt by export, which never blocks
+        //the database.
+        Handle rebuilder(snapshotPath);
+        if (!rebuilder.open() ||
+            (options.key &&
+             (!rebuilder.setCipherKey(options.key, options.keySize) ||
+              !rebuilder.exec(StatementPragma().pragma(Pragma::CipherPageSize,
+                                                       options.pageSize))))) {
+            error = rebuilder.getError();
+            break;
+        }
+        const void *newKey = options.rekey ? options.newKey : options.key;
+        int newKeySize = options.rekey ? options.newKeySize : options.keySize;
+        int newPageSize = options.newPageSize > 0 ? options.newPageSize
+                                                  : (options.key
+                                                         ? options.pageSize
+                                                         : pageSize);
+        //An empty key means plain text
+        static const char s_empty = 0;
+        StatementAttach attach =
+            StatementAttach().attach(rebuiltPath).as(s_schema).key(
+                newKey ? Expr(newKey, newKeySize) : Expr(&s_empty, 0));
+        if ((newKey && !rebuilder.exec(StatementPragma().pragma(
+                           Pragma::CipherDefaultPageSize, newPageSize))) ||
+            !rebuilder.exec(attach) ||
+            (!newKey &&
+             !rebuilder.exec(StatementPragma().pragma(
+                 Pragma::PageSize.inSchema(s_schema), newPageSize)))) {
+            error = rebuilder.getError();
+            break;
+        }
+        bool exported = false;
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            Error innerError;
+            Scheduler::shared()->consume(
+                File::getFileSize(snapshotPath, innerError));
+            exported = rebuilder.exec(StatementSelect().select(
+                {ColumnResult(Expr::Function("sqlcipher_export",
+                                             {Expr(s_schema)}))}));
+        });
+        if (!exported) {
+            error = rebuilder.getError();
+            break;
+        }
+        rebuilder.close();
+        result = File::renameFile(rebuiltPath, destination, error);
+    } while (false);
+    Error innerError;
+    File::removeFiles(tempPaths, innerError);
+    return result;
+}
+
+} //namespace WCDB
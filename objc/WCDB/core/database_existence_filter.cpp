@@ -0,0 +1,522 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/scheduler.hpp>
+#include <chrono>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+
+namespace WCDB {
+
+static const std::string s_stampTable = "wcdb_existence_filter_stamps";
+static const Column s_stampName("name");
+static const Column s_stampGeneration("generation");
+
+static StatementUpdate GetStampBump(const std::string &name)
+{
+    return StatementUpdate()
+        .update(s_stampTable)
+        .set(std::list<const std::pair<const Column, const Expr>>{
+            {s_stampGeneration, Expr(s_stampGeneration) + Expr(1)}})
+        .where(Expr(s_stampName) == Expr(name));
+}
+
+static const StatementCreateTable &GetStampTableCreation()
+{
+    static const StatementCreateTable s_createStampTable =
+        StatementCreateTable().create(
+            s_stampTable,
+            std::list<const ColumnDef>{
+                ColumnDef(s_stampName, ColumnType::Text).makePrimary(),
+                ColumnDef(s_stampGeneration, ColumnType::Integer64)
+                    .makeNotNull()
+                    .makeDefault(0),
+            });
+    return s_createStampTable;
+}
+
+static bool IsStampTableExisting(std::shared_ptr<Handle> &handle)
+{
+    static const StatementSelect s_getStampTable =
+        StatementSelect()
+            .select({ColumnResult(Expr(1))})
+            .from("sqlite_master")
+            .where(Expr(Column("name")) == Expr(s_stampTable));
+    std::shared_ptr<StatementHandle> statementHandle =
+        handle->prepare(s_getStampTable);
+    return statementHandle && statementHandle->step();
+}
+
+void Database::setExistenceFilter(const std::string &table,
+                                  const std::string &column,
+                                  size_t expectedCount,
+                                  double falsePositiveRate)
+{
+    std::shared_ptr<ExistenceFilter> filter = ExistenceFilter::Register(
+        getPath(), table, column, expectedCount, falsePositiveRate);
+    const std::string name = filter->getName();
+    //TEMP triggers bump the stamp of this process, whose table must exist
+    //before they're fired.
+    Error innerError;
+    if (!exec(GetStampTableCreation(), innerError)) {
+        Error::Warning(("Existence filter is not persistable: " +
+                        innerError.description())
+                           .c_str());
+    }
+    std::weak_ptr<ExistenceFilter> observed = filter;
+    ColumnResult observation(Expr::Function(
+        name, ExprList({Expr(Column(column).inTable("NEW"))})));
+    StatementUpdate localBump = GetStampBump(filter->getLocalStampName());
+    StatementCreateTrigger insertTrigger =
+        StatementCreateTrigger()
+            .create(name + "_insert", true, true)
+            .after(StatementCreateTrigger::Event::Insert)
+            .on(table)
+            .execute(StatementSelect().select({observation}))
+            .execute(localBump);
+    StatementCreateTrigger updateTrigger =
+        StatementCreateTrigger()
+            .create(name + "_update", true, true)
+            .after(StatementCreateTrigger::Event::Update)
+            .of({Column(column)})
+            .on(table)
+            .execute(StatementSelect().select({observation}))
+            .execute(localBump);
+    m_pool->setConfig(
+        name, [name, observed, insertTrigger, updateTrigger](
+                  std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            if (!IsStampTableExisting(handle)) {
+                //Writes of other processes can't be told without the stamp
+                std::shared_ptr<ExistenceFilter> filter = observed.lock();
+                if (filter) {
+                    filter->invalidate();
+                }
+                Error::Warning("Existence filter is invalidated without stamp");
+                return true;
+            }
+            if (!handle->registerValueObserver(
+                    name, [observed](ColumnType type, const void *data,
+                                     int size) {
+                        std::shared_ptr<ExistenceFilter> filter =
+                            observed.lock();
+                        if (filter) {
+                            filter->add(type, data, size);
+                        }
+                    })) {
+                error = handle->getError();
+                return false;
+            }
+            if (!handle->exec(insertTrigger) || !handle->exec(updateTrigger)) {
+                //Writes through this handle can't be observed
+                std::shared_ptr<ExistenceFilter> filter = observed.lock();
+                if (filter) {
+                    filter->invalidate();
+                }
+                Error::Warning(("Existence filter is invalidated: " +
+                                handle->getError().description())
+                                   .c_str());
+            }
+            return true;
+        });
+}
+
+void Database::removeExistenceFilter(const std::string &table,
+                                     const std::string &column)
+{
+    std::shared_ptr<ExistenceFilter> filter =
+        ExistenceFilter::Get(getPath(), table, column);
+    if (!filter) {
+        return;
+    }
+    const std::string name = filter->getName();
+    StatementDropTrigger dropInsertTrigger =
+        StatementDropTrigger().drop(name + "_insert");
+    StatementDropTrigger dropUpdateTrigger =
+        StatementDropTrigger().drop(name + "_update");
+    //The stamp is of no use since now, including those of each process
+    const std::string localPrefix = name + "#";
+    Error innerError;
+    if (!exec(StatementDropTrigger().drop(name + "_stamp_insert"),
+              innerError) ||
+        !exec(StatementDropTrigger().drop(name + "_stamp_update"),
+              innerError) ||
+        !exec(StatementDelete()
+                  .deleteFrom(s_stampTable)
+                  .where(Expr(s_stampName) == Expr(name) ||
+                         Expr(s_stampName)
+                                 .substr(Expr(1),
+                                         Expr((int) localPrefix.size())) ==
+                             Expr(localPrefix)),
+              innerError)) {
+        Error::Warning(("Existence filter stamp is not removed: " +
+                        innerError.description())
+                           .c_str());
+    }
+    File::removeFile(filter->getSidecarPath(), innerError);
+    m_pool->setConfig(
+        name, [dropInsertTrigger, dropUpdateTrigger](
+                  std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            if (!handle->exec(dropInsertTrigger) ||
+                !handle->exec(dropUpdateTrigger)) {
+                error = handle->getError();
+                return false;
+            }
+            return true;
+        });
+    ExistenceFilter::Unregister(getPath(), table, column);
+}
+
+bool Database::mayExist(const std::string &table,
+                        const std::string &column,
+                        int64_t value)
+{
+    return mayExist(table, column, ColumnType::Integer64, &value,
+                    sizeof(value));
+}
+
+bool Database::mayExist(const std::string &table,
+                        const std::string &column,
+                        const std::string &value)
+{
+    return mayExist(table, column, ColumnType::Text, value.data(),
+                    (int) value.size());
+}
+
+bool Database::mayExist(const std::string &table,
+                        const std::string &column,
+                        ColumnType type,
+                        const void *data,
+                        int size)
+{
+    std::shared_ptr<ExistenceFilter> filter =
+        ExistenceFilter::Get(getPath(), table, column);
+    if (!filter) {
+        return true;
+    }
+    if (filter->getState() == ExistenceFilter::State::Ready) {
+        //Writes of other processes are not observed, but told by the stamp
+        ExistenceFilter::Stamp stamp;
+        Error innerError;
+        if (!GetExistenceFilterStamp(*this, *filter.get(), stamp,
+                                     innerError) ||
+            !filter->isExpected(stamp)) {
+            filter->expire();
+        }
+    }
+    if (filter->shouldBuild()) {
+        const std::string path = getPath();
+        Scheduler::shared()->post(Scheduler::Priority::Low, [path, filter]() {
+            Database database(path);
+            Error innerError;
+            if (!Database::BuildExistenceFilter(database, *filter.get(),
+                                                innerError)) {
+                filter->invalidate();
+                Error::Warning(("Existence filter is invalidated: " +
+                                innerError.description())
+                                   .c_str());
+            }
+        });
+    }
+    return filter->mayExist(type, data, size);
+}
+
+bool Database::saveExistenceFilter(const std::string &table,
+                                   const std::string &column,
+                                   Error &error)
+{
+    std::shared_ptr<ExistenceFilter> filter =
+        ExistenceFilter::Get(getPath(), table, column);
+    if (!filter) {
+        error.reset();
+        return true;
+    }
+    //Block the writes so that the stamp stays the same while saving
+    if (!begin(StatementTransaction::Mode::Immediate, error)) {
+        return false;
+    }
+    ExistenceFilter::Stamp stamp;
+    if (!GetExistenceFilterStamp(*this, *filter.get(), stamp, error)) {
+        Error innerError;
+        rollback(innerError);
+        return false;
+    }
+    if (!filter->isExpected(stamp) || !filter->save(stamp)) {
+        Error::Warning("Existence filter is not saved");
+    }
+    if (!commit(error)) {
+        Error innerError;
+        rollback(innerError);
+        return false;
+    }
+    return true;
+}
+
+ExistenceFilter::Statistics
+Database::getExistenceFilterStatistics(const std::string &table,
+                                       const std::string &column)
+{
+    std::shared_ptr<ExistenceFilter> filter =
+        ExistenceFilter::Get(getPath(), table, column);
+    if (!filter) {
+        ExistenceFilter::Statistics statistics;
+        memset(&statistics, 0, sizeof(statistics));
+        return statistics;
+    }
+    return filter->getStatistics();
+}
+
+bool Database::PrepareExistenceFilterStamp(Database &database,
+                                           const ExistenceFilter &filter,
+                                           Error &error)
+{
+    const std::string name = filter.getName();
+    const std::string localName = filter.getLocalStampName();
+    //Persistent triggers bump the generation for the writes of any process
+    StatementUpdate bump = GetStampBump(name);
+    if (!database.exec(GetStampTableCreation(), error) ||
+        !database.exec(StatementInsert()
+                           .insert(s_stampTable, {s_stampName},
+                                   Conflict::Ignore)
+                           .values(std::list<const Expr>{Expr(name)}),
+                       error) ||
+        !database.exec(StatementInsert()
+                           .insert(s_stampTable, {s_stampName},
+                                   Conflict::Ignore)
+                           .values(std::list<const Expr>{Expr(localName)}),
+                       error) ||
+        !database.exec(StatementCreateTrigger()
+                           .create(name + "_stamp_insert", true, false)
+                           .after(StatementCreateTrigger::Event::Insert)
+                           .on(filter.table)
+                           .execute(bump),
+                       error) ||
+        !database.exec(StatementCreateTrigger()
+                           .create(name + "_stamp_update", true, false)
+                           .after(StatementCreateTrigger::Event::Update)
+                           .of({Column(filter.column)})
+                           .on(filter.table)
+                           .execute(bump),
+                       error)) {
+        return false;
+    }
+
+    //Stamps of the exited processes are of no use
+    const std::string localPrefix = name + "#";
+    RecyclableStatement statementHandle = database.prepare(
+        StatementSelect()
+            .select({ColumnResult(s_stampName)})
+            .from(s_stampTable)
+            .where(Expr(s_stampName)
+                       .substr(Expr(1), Expr((int) localPrefix.size())) ==
+                   Expr(localPrefix)),
+        error);
+    if (!statementHandle) {
+        return false;
+    }
+    std::list<std::string> exited;
+    while (statementHandle->step()) {
+        std::string localName = statementHandle->getValue<ColumnType::Text>(0);
+        pid_t pid = (pid_t) atol(localName.c_str() + localPrefix.size());
+        if (pid != getpid() && kill(pid, 0) != 0 && errno == ESRCH) {
+            exited.push_back(localName);
+        }
+    }
+    if (!statementHandle->isOK()) {
+        error = statementHandle->getError();
+        return false;
+    }
+    statementHandle = nullptr;
+    for (const std::string &localName : exited) {
+        if (!database.exec(StatementDelete()
+                               .deleteFrom(s_stampTable)
+                               .where(Expr(s_stampName) == Expr(localName)),
+                           error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Database::GetExistenceFilterStamp(Database &database,
+                                       const ExistenceFilter &filter,
+                                       ExistenceFilter::Stamp &stamp,
+                                       Error &error)
+{
+    //DDL, e.g. dropping the triggers, changes the schema version
+    RecyclableStatement versionHandle = database.prepare(
+        StatementPragma().pragma(Pragma::SchemaVersion), error);
+    if (!versionHandle) {
+        return false;
+    }
+    if (!versionHandle->step()) {
+        error = versionHandle->getError();
+        return false;
+    }
+    stamp.schemaVersion = versionHandle->getValue<ColumnType::Integer64>(0);
+
+    //Both are read in a same snapshot
+    const std::string name = filter.getName();
+    RecyclableStatement generationHandle = database.prepare(
+        StatementSelect()
+            .select({ColumnResult(s_stampName),
+                     ColumnResult(s_stampGeneration)})
+            .from(s_stampTable)
+            .where(Expr(s_stampName).in(std::list<const Expr>{
+                Expr(name), Expr(filter.getLocalStampName())})),
+        error);
+    if (!generationHandle) {
+        return false;
+    }
+    stamp.generation = -1;
+    stamp.local = 0;
+    while (generationHandle->step()) {
+        int64_t generation =
+            generationHandle->getValue<ColumnType::Integer64>(1);
+        if (name == generationHandle->getValue<ColumnType::Text>(0)) {
+            stamp.generation = generation;
+        } else {
+            stamp.local = generation;
+        }
+    }
+    if (!generationHandle->isOK()) {
+        error = generationHandle->getError();
+        return false;
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::BuildExistenceFilter(Database &database,
+                                    ExistenceFilter &filter,
+                                    Error &error)
+{
+    static const int s_maxBarrierRetries = 500;
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    filter.beginBuild();
+
+    //Wait for the writes in flight, whose values may miss the building filter
+    int retries = 0;
+    while (!database.begin(StatementTransaction::Mode::Immediate, error)) {
+        if (++retries > s_maxBarrierRetries) {
+            filter.endBuild(false, 0);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    //e.g. readonly. Writes of other processes can't be told without the stamp.
+    Error innerError;
+    if (!PrepareExistenceFilterStamp(database, filter, error) ||
+        !database.commit(error)) {
+        database.rollback(innerError);
+        filter.endBuild(false, 0);
+        return false;
+    }
+
+    if (!database.begin(StatementTransaction::Mode::Defered, error)) {
+        filter.endBuild(false, 0);
+        return false;
+    }
+    bool result = false;
+    bool loaded = false;
+    ExistenceFilter::Stamp stamp = {-1, 0, 0};
+    do {
+        if (!GetExistenceFilterStamp(database, filter, stamp, error)) {
+            break;
+        }
+        filter.expect(stamp);
+        loaded = filter.load(stamp);
+        if (loaded) {
+            result = true;
+            break;
+        }
+        RecyclableStatement statementHandle = database.prepare(
+            StatementSelect()
+                .select({ColumnResult(Expr(Column(filter.column)))})
+                .from(filter.table),
+            error);
+        if (!statementHandle) {
+            break;
+        }
+        //Each chunk is charged before it's scanned
+        static const size_t s_chunk = 1024 * 1024;
+        size_t scanned = 0;
+        size_t charged = s_chunk;
+        Scheduler::shared()->consume(s_chunk);
+        while (statementHandle->step()) {
+            int size = 0;
+            switch (statementHandle->getType(0)) {
+                case ColumnType::Integer64: {
+                    int64_t value =
+                        statementHandle->getValue<ColumnType::Integer64>(0);
+                    size = sizeof(value);
+                    filter.addBuilt(ColumnType::Integer64, &value, size);
+                } break;
+                case ColumnType::Float: {
+                    double value =
+                        statementHandle->getValue<ColumnType::Float>(0);
+                    size = sizeof(value);
+                    filter.addBuilt(ColumnType::Float, &value, size);
+                } break;
+                case ColumnType::Text: {
+                    const char *value =
+                        statementHandle->getValue<ColumnType::Text>(0);
+                    size = (int) strlen(value);
+                    filter.addBuilt(ColumnType::Text, value, size);
+                } break;
+                case ColumnType::BLOB: {
+                    const void *value =
+                        statementHandle->getValue<ColumnType::BLOB>(0, size);
+                    filter.addBuilt(ColumnType::BLOB, value, size);
+                } break;
+                default:
+                    break;
+            }
+            scanned += size;
+            if (scanned >= charged) {
+                Scheduler::shared()->consume(s_chunk);
+                charged += s_chunk;
+            }
+        }
+        if (!statementHandle->isOK()) {
+            error = statementHandle->getError();
+            break;
+        }
+        result = true;
+    } while (false);
+    database.commit(innerError);
+
+    filter.endBuild(result, std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - begin)
+                                .count());
+    if (result && !loaded) {
+        //It covers all the values of the snapshot
+        filter.save(stamp);
+    }
+    return result;
+}
+
+} //namespace WCDB
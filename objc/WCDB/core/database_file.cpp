@@ -81,6 +81,16 @@ const std::list<std::string> Database::getPaths() const
     for (const auto &subfix : Database::subfixs()) {
         paths.push_back(Path::addExtention(getPath(), subfix));
     }
+    std::list<std::string> sidecarPaths =
+        ExistenceFilter::GetSidecarPaths(getPath());
+    paths.insert(paths.end(), sidecarPaths.begin(), sidecarPaths.end());
+    std::list<std::string> logPaths = WriteBuffer::GetLogPaths(getPath());
+    paths.insert(paths.end(), logPaths.begin(), logPaths.end());
+    paths.push_back(Standby::GetPath(getPath()));
+    paths.push_back(PlanMonitor::GetPath(getPath()));
+    paths.push_back(Path::addExtention(PlanMonitor::GetPath(getPath()),
+                                       "-journal"));
+    paths.push_back(Path::addExtention(getPath(), salvageSuffix));
     return paths;
 }
 
@@ -0,0 +1,222 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/handle_statement.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/thread_local.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <thread>
+
+namespace WCDB {
+
+//Commits of merging are made by the merge thread, which don't break the idle
+static ThreadLocal<bool> s_merging(false);
+
+StatementInsert Database::FTSCommand(const std::string &table,
+                                     const std::string &command)
+{
+    //e.g. INSERT INTO table(table) VALUES('merge=X,Y')
+    std::list<const Column> columns = {Column(table)};
+    return StatementInsert()
+        .insert(table, columns, Conflict::NotSet)
+        .values(ExprList({Expr(command)}));
+}
+
+bool Database::setFTSMerge(const std::string &table,
+                           const FTSMerger::Config &config,
+                           Error &error)
+{
+    //The setting is persisted in database
+    if (!exec(FTSCommand(table, "automerge=0"), error)) {
+        return false;
+    }
+    std::shared_ptr<FTSMerger> merger = FTSMerger::Register(getPath());
+    merger->addTable(table, config);
+    m_pool->setConfig(
+        Database::defaultFTSMergeConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerCommittedHook(
+                Database::defaultFTSMergeConfigName,
+                [](Handle *handle, int pages, void *) {
+                    if (*s_merging.get()) {
+                        return;
+                    }
+                    std::shared_ptr<FTSMerger> merger =
+                        FTSMerger::Get(handle->path);
+                    if (merger) {
+                        merger->markDirty();
+                        //Idle time is counted from the last commit
+                        Database::ScheduleFTSMerge(handle->path);
+                    }
+                },
+                nullptr);
+            return true;
+        });
+    Database::ScheduleFTSMerge(getPath());
+    return true;
+}
+
+void Database::removeFTSMerge(const std::string &table)
+{
+    std::shared_ptr<FTSMerger> merger = FTSMerger::Get(getPath());
+    if (!merger || !merger->removeTable(table)) {
+        return;
+    }
+    m_pool->setConfig(
+        Database::defaultFTSMergeConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerCommittedHook(Database::defaultFTSMergeConfigName,
+                                          nullptr, nullptr);
+            return true;
+        });
+    FTSMerger::Unregister(getPath());
+}
+
+FTSMerger::Statistics
+Database::getFTSMergeStatistics(const std::string &table)
+{
+    std::shared_ptr<FTSMerger> merger = FTSMerger::Get(getPath());
+    if (!merger) {
+        return {0, 0, 0, false};
+    }
+    return merger->getStatistics(table);
+}
+
+bool Database::getFTSSegmentCounts(const std::string &table,
+                                   std::map<int64_t, int> &counts,
+                                   Error &error)
+{
+    static const Column s_level("level");
+    std::list<const ColumnResult> results = {
+        ColumnResult(s_level), ColumnResult(Expr(Column::Any).count()),
+    };
+    std::list<const Expr> groups = {Expr(s_level)};
+    RecyclableStatement statementHandle =
+        prepare(StatementSelect()
+                    .select(results)
+                    .from(table + "_segdir")
+                    .groupBy(groups),
+                error);
+    if (!statementHandle) {
+        return false;
+    }
+    counts.clear();
+    while (statementHandle->step()) {
+        counts[statementHandle->getValue<ColumnType::Integer64>(0)] =
+            statementHandle->getValue<ColumnType::Integer32>(1);
+    }
+    error = statementHandle->getError();
+    return error.isOK();
+}
+
+bool Database::optimizeFTS(const std::string &table, Error &error)
+{
+    bool result = false;
+    Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+        result = exec(FTSCommand(table, "optimize"), error);
+    });
+    return result;
+}
+
+void Database::ScheduleFTSMerge(const std::string &path)
+{
+    //Merging starts after database is idle for a while
+    static TimedQueue<std::string> s_timedQueue(2);
+    s_timedQueue.reQueue(path);
+    static std::thread s_mergeThread([]() {
+        SET_THREAD_NAME(
+            ("WCDB-" + Database::defaultFTSMergeConfigName).c_str());
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &path) {
+                std::shared_ptr<FTSMerger> merger = FTSMerger::Get(path);
+                if (!merger) {
+                    return;
+                }
+                Database database(path);
+                Database::MergeFTS(database, *merger.get());
+                if (merger->isPending()) {
+                    //Resume after next idle
+                    s_timedQueue.reQueue(path);
+                }
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_mergeThread.detach(); });
+}
+
+void Database::MergeFTS(Database &database, FTSMerger &merger)
+{
+    static const StatementPragma s_pageSize =
+        StatementPragma().pragma(Pragma::PageSize);
+    const std::map<std::string, FTSMerger::Config> configs =
+        merger.getTables();
+    for (const std::string &table : merger.beginRun()) {
+        auto iter = configs.find(table);
+        Error error;
+        RecyclableHandle handle =
+            iter != configs.end() ? database.flowOut(error)
+                                  : RecyclableHandle(nullptr, nullptr);
+        if (!handle) {
+            merger.endRun(table, 0, iter == configs.end());
+            continue;
+        }
+        const FTSMerger::Config &config = iter->second;
+        size_t pageSize = 4096;
+        std::shared_ptr<StatementHandle> statementHandle =
+            handle->prepare(s_pageSize);
+        if (statementHandle && statementHandle->step()) {
+            pageSize = statementHandle->getValue<ColumnType::Integer32>(0);
+        }
+        statementHandle = nullptr;
+
+        const uint64_t activity = merger.getActivity();
+        const StatementInsert merge =
+            FTSCommand(table, "merge=" + std::to_string(config.pagesPerStep) +
+                                  "," + std::to_string(config.minSegments));
+        int steps = 0;
+        bool finished = false;
+        //Yield to the foreground once database is no longer idle
+        for (int budget = config.pageBudget; budget > 0 && !finished &&
+                                             merger.getActivity() == activity;
+             budget -= config.pagesPerStep) {
+            bool succeed = false;
+            Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+                Scheduler::shared()->consume(config.pagesPerStep * pageSize);
+                int before = handle->getTotalChanges();
+                *s_merging.get() = true;
+                succeed = handle->exec(merge);
+                *s_merging.get() = false;
+                //Less than 2 rows changed means nothing is left to merge
+                finished =
+                    succeed && handle->getTotalChanges() - before < 2;
+            });
+            if (!succeed) {
+                break;
+            }
+            ++steps;
+        }
+        merger.endRun(table, steps, finished);
+    }
+}
+
+} //namespace WCDB
@@ -0,0 +1,75 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/macro.hpp>
+#include <mutex>
+#include <thread>
+
+namespace WCDB {
+
+HandlePool::MemorySnapshot Database::getMemorySnapshot()
+{
+    return m_pool->getMemorySnapshot();
+}
+
+void Database::setMemoryBudget(int64_t budget)
+{
+    m_pool->setMemoryBudget(budget);
+}
+
+void Database::SetGlobalMemoryReport(const MemoryReport &report,
+                                     const std::chrono::seconds &interval)
+{
+    static std::mutex s_mutex;
+    static std::shared_ptr<MemoryReport> s_report;
+    static std::chrono::seconds s_interval;
+    {
+        std::lock_guard<std::mutex> lockGuard(s_mutex);
+        s_report.reset(report ? new MemoryReport(report) : nullptr);
+        s_interval = interval;
+    }
+    if (!report) {
+        return;
+    }
+    static std::thread s_memoryThread([]() {
+        SET_THREAD_NAME("WCDB-memory");
+        while (true) {
+            std::chrono::seconds interval;
+            {
+                std::lock_guard<std::mutex> lockGuard(s_mutex);
+                interval = s_interval;
+            }
+            std::this_thread::sleep_for(interval);
+            std::shared_ptr<MemoryReport> report;
+            {
+                std::lock_guard<std::mutex> lockGuard(s_mutex);
+                report = s_report;
+            }
+            if (report) {
+                (*report.get())(HandlePool::GetMemorySnapshotsInAllPool());
+            }
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_memoryThread.detach(); });
+}
+
+} //namespace WCDB
@@ -0,0 +1,71 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+
+namespace WCDB {
+
+void Database::setStatementMonitorEnabled(bool enabled, size_t maxFingerprints)
+{
+    if (enabled) {
+        std::shared_ptr<StatementMonitor> monitor =
+            StatementMonitor::Register(getPath(), maxFingerprints);
+        m_pool->setConfig(
+            Database::defaultStatementMonitorConfigName,
+            [monitor](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+                handle->registerStatementObserver(
+                    Database::defaultStatementMonitorConfigName,
+                    [monitor](const char *sql, const StatementStatus &status) {
+                        monitor->add(sql, status);
+                    });
+                return true;
+            });
+    } else if (StatementMonitor::Get(getPath())) {
+        m_pool->setConfig(
+            Database::defaultStatementMonitorConfigName,
+            [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+                handle->registerStatementObserver(
+                    Database::defaultStatementMonitorConfigName, nullptr);
+                return true;
+            });
+    }
+}
+
+std::list<StatementMonitor::Statistics>
+Database::getStatementStatistics() const
+{
+    std::shared_ptr<StatementMonitor> monitor =
+        StatementMonitor::Get(getPath());
+    if (!monitor) {
+        return {};
+    }
+    return monitor->getStatistics();
+}
+
+void Database::resetStatementStatistics()
+{
+    std::shared_ptr<StatementMonitor> monitor =
+        StatementMonitor::Get(getPath());
+    if (monitor) {
+        monitor->reset();
+    }
+}
+
+} //namespace WCDB
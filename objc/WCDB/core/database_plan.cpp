@@ -0,0 +1,115 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/handle_statement.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <thread>
+
+namespace WCDB {
+
+void Database::setPlanMonitor(const PlanMonitor::Config &config,
+                              const PlanMonitor::ChangedCallback &onChanged)
+{
+    std::shared_ptr<PlanMonitor> monitor =
+        PlanMonitor::Register(getPath(), config, onChanged);
+    m_pool->setConfig(
+        Database::defaultPlanMonitorConfigName,
+        [monitor](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            std::string path = handle->path;
+            handle->registerStatementObserver(
+                Database::defaultPlanMonitorConfigName,
+                [monitor, path](const char *sql,
+                                const StatementStatus &status) {
+                    if (monitor->sample(sql, status)) {
+                        Database::SchedulePlanCheck(path);
+                    }
+                });
+            return true;
+        });
+}
+
+void Database::removePlanMonitor()
+{
+    if (!PlanMonitor::Get(getPath())) {
+        return;
+    }
+    m_pool->setConfig(
+        Database::defaultPlanMonitorConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerStatementObserver(
+                Database::defaultPlanMonitorConfigName, nullptr);
+            return true;
+        });
+    PlanMonitor::Unregister(getPath());
+}
+
+void Database::SchedulePlanCheck(const std::string &path)
+{
+    //Plans are explained after database is idle for a while
+    static TimedQueue<std::string> s_timedQueue(2);
+    s_timedQueue.reQueue(path);
+    static std::thread s_planThread([]() {
+        SET_THREAD_NAME(
+            ("WCDB-" + Database::defaultPlanMonitorConfigName).c_str());
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &path) {
+                std::shared_ptr<PlanMonitor> monitor = PlanMonitor::Get(path);
+                if (!monitor) {
+                    return;
+                }
+                Database database(path);
+                Database::CheckPlans(database, *monitor.get());
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_planThread.detach(); });
+}
+
+void Database::CheckPlans(Database &database, PlanMonitor &monitor)
+{
+    for (const auto &pending : monitor.takePending()) {
+        std::string plan;
+        Error error;
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            RecyclableStatement statementHandle = database.prepare(
+                StatementExplain().explainQueryPlan(pending.second), error);
+            if (!statementHandle) {
+                return;
+            }
+            //id, parent, notused, detail
+            while (statementHandle->step()) {
+                plan.append(statementHandle->getValue<ColumnType::Text>(3));
+                plan.push_back('\n');
+            }
+            error = statementHandle->getError();
+        });
+        //Statements of dropped tables or temporary ones fail to be explained
+        if (!error.isOK() || plan.empty()) {
+            continue;
+        }
+        monitor.record(pending.first, pending.second, plan, error);
+    }
+}
+
+} //namespace WCDB
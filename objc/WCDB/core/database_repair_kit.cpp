@@ -24,18 +24,26 @@
 #include <sqliterk/SQLiteRepairKit.h>
 #endif
 #include <WCDB/database.hpp>
+#include <WCDB/file.hpp>
 #include <WCDB/path.hpp>
+#include <WCDB/scheduler.hpp>
 #include <WCDB/utility.hpp>
+#include <thread>
 
 namespace WCDB {
 
+const std::string Database::salvageSuffix("-salvage");
+
 bool Database::backup(const void *key, const unsigned int &length, Error &error)
 {
     RecyclableHandle handle = flowOut(error);
     if (!handle) {
         return false;
     }
-    bool result = handle->backup(key, length);
+    bool result = false;
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        result = handle->backup(key, length);
+    });
     error = handle->getError();
     return result;
 }
@@ -52,10 +60,159 @@ bool Database::recoverFromPath(const std::string &corruptedDBPath,
     if (!handle) {
         return false;
     }
-    bool result = handle->recoverFromPath(corruptedDBPath, pageSize, backupKey,
-                                          backupKeyLength, databaseKey,
-                                          databaseKeyLength);
+    bool result = false;
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        Error innerError;
+        Scheduler::shared()->consume(
+            File::getFileSize(corruptedDBPath, innerError));
+        result = handle->recoverFromPath(corruptedDBPath, pageSize, backupKey,
+                                         backupKeyLength, databaseKey,
+                                         databaseKeyLength);
+    });
     error = handle->getError();
+    if (result) {
+        //Aggregates may be inconsistent with the recovered rows
+        const std::string path = getPath();
+        Scheduler::shared()->post(Scheduler::Priority::Low, [path]() {
+            Database database(path);
+            Error innerError;
+            database.verifyMaintainedAggregates(innerError);
+        });
+    }
+    return result;
+}
+
+bool Database::repairDamaged(const void *key,
+                             const unsigned int &keyLength,
+                             const int pageSize,
+                             RepairReport &report,
+                             Error &error)
+{
+    report = RepairReport();
+    RecyclableHandle handle = flowOut(error);
+    if (!handle) {
+        return false;
+    }
+    bool result = false;
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        Error innerError;
+        Scheduler::shared()->consume(File::getFileSize(getPath(), innerError));
+        result = handle->findDamagedBtrees(
+            report.damagedTables, report.damagedIndexes, report.unresolved);
+    });
+    if (!result) {
+        error = handle->getError();
+        return false;
+    }
+    if (report.damagedTables.empty() && report.damagedIndexes.empty()) {
+        error.reset();
+        return true;
+    }
+
+    //Repair kit parses the database file, so WAL is checkpointed and
+    //writers are blocked until repaired
+    static const StatementPragma s_checkpoint =
+        StatementPragma().pragma(Pragma::WalCheckpoint, "TRUNCATE");
+    static const StatementTransaction s_begin =
+        StatementTransaction().begin(StatementTransaction::Mode::Immediate);
+    static const StatementTransaction s_commit =
+        StatementTransaction().commit();
+    static const StatementTransaction s_rollback =
+        StatementTransaction().rollback();
+    const std::string walPath = Path::addExtention(getPath(), "-wal");
+    bool checkpointed = false;
+    for (int retry = 0; retry < 3 && !checkpointed; ++retry) {
+        if (retry > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (!handle->exec(s_checkpoint) || !handle->exec(s_begin)) {
+            error = handle->getError();
+            return false;
+        }
+        Error innerError;
+        checkpointed = File::getFileSize(walPath, innerError) == 0;
+        if (!checkpointed) {
+            handle->exec(s_rollback);
+        }
+    }
+    if (!checkpointed) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                          Error::CoreCode::Exceed,
+                          "WAL can't be checkpointed for repairing", &error);
+        return false;
+    }
+
+    const std::string salvagePath =
+        Path::addExtention(getPath(), salvageSuffix);
+    const std::list<std::string> salvagePaths = {
+        salvagePath, salvagePath + "-wal", salvagePath + "-shm",
+        salvagePath + "-journal",
+    };
+    result = false;
+    do {
+        if (!File::removeFiles(salvagePaths, error)) {
+            break;
+        }
+        Handle salvage(salvagePath);
+        if (!salvage.open() ||
+            (keyLength > 0 &&
+             (!salvage.setCipherKey(key, keyLength) ||
+              !salvage.exec(StatementPragma().pragma(Pragma::CipherPageSize,
+                                                     pageSize))))) {
+            error = salvage.getError();
+            break;
+        }
+        bool salvaged = report.damagedTables.empty();
+        Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+            salvaged = salvaged ||
+                       salvage.salvageTables(getPath(), report.damagedTables,
+                                             pageSize, key, keyLength,
+                                             report.damagedPages);
+        });
+        if (!salvaged) {
+            error = salvage.getError();
+            break;
+        }
+        //Intact tables are left untouched
+        bool restored = true;
+        Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+            for (const auto &index : report.damagedIndexes) {
+                if (!handle->rebuildIndex(index, report.leaked)) {
+                    restored = false;
+                    return;
+                }
+            }
+            for (const auto &table : report.damagedTables) {
+                int64_t rows = 0;
+                if (!handle->restoreTable(table, salvage, rows,
+                                          report.leaked)) {
+                    restored = false;
+                    return;
+                }
+                report.salvagedRows[table] = rows;
+            }
+        });
+        if (!restored || !handle->exec(s_commit)) {
+            error = handle->getError();
+            break;
+        }
+        result = true;
+    } while (false);
+    if (!result) {
+        handle->exec(s_rollback);
+    }
+    Error innerError;
+    File::removeFiles(salvagePaths, innerError);
+    if (result) {
+        error.reset();
+        //Aggregates may be inconsistent with the salvaged rows
+        const std::string path = getPath();
+        Scheduler::shared()->post(Scheduler::Priority::Low, [path]() {
+            Database database(path);
+            Error innerError;
+            database.verifyMaintainedAggregates(innerError);
+        });
+    }
     return result;
 }
 
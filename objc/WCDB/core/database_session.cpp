@@ -0,0 +1,97 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+
+namespace WCDB {
+
+bool Database::setSession(const std::list<std::string> &tables,
+                          bool patchset,
+                          const Session::Notification &notification,
+                          Error &error)
+{
+    if (!Handle::IsSessionSupported()) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Prepare,
+                          Error::CoreCode::Misuse,
+                          "Session extension is not compiled in", &error);
+        return false;
+    }
+    std::shared_ptr<Session> session =
+        Session::Register(getPath(), tables, patchset, notification);
+    std::weak_ptr<Session> collector = session;
+    m_pool->setConfig(
+        Database::defaultSessionConfigName,
+        [tables, patchset, collector](std::shared_ptr<Handle> &handle,
+                                      Error &error) -> bool {
+            if (!handle->beginSession(
+                    tables, patchset,
+                    [collector](const Changeset &changeset,
+                                uint64_t sequence) {
+                        std::shared_ptr<Session> session = collector.lock();
+                        if (session) {
+                            session->collect(changeset, sequence);
+                        }
+                    })) {
+                error = handle->getError();
+                return false;
+            }
+            return true;
+        });
+    error.reset();
+    return true;
+}
+
+void Database::removeSession()
+{
+    m_pool->setConfig(
+        Database::defaultSessionConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->endSession();
+            return true;
+        });
+    Session::Unregister(getPath());
+}
+
+bool Database::takeChangeset(Changeset &changeset, Error &error)
+{
+    std::shared_ptr<Session> session = Session::Get(getPath());
+    if (!session) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Prepare,
+                          Error::CoreCode::Misuse, "Session is not set",
+                          &error);
+        return false;
+    }
+    return session->take(changeset, error);
+}
+
+bool Database::applyChangeset(const Changeset &changeset,
+                              const ChangesetConflictResolver &resolver,
+                              Error &error)
+{
+    RecyclableHandle handle = flowOut(error);
+    if (!handle) {
+        return false;
+    }
+    bool result = handle->applyChangeset(changeset, resolver);
+    error = handle->getError();
+    return result;
+}
+
+} //namespace WCDB
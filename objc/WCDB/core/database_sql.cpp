@@ -20,6 +20,8 @@
 
 #include <WCDB/database.hpp>
 #include <WCDB/error.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/scheduler.hpp>
 
 namespace WCDB {
 
@@ -32,6 +34,9 @@ RecyclableStatement Database::prepare(const Statement &statement, Error &error)
                           &error);
         return RecyclableStatement(RecyclableHandle(nullptr, nullptr), nullptr);
     }
+    if (!flushWriteBuffersReferredBy(statement, error)) {
+        return RecyclableStatement(RecyclableHandle(nullptr, nullptr), nullptr);
+    }
     RecyclableHandle handle = flowOut(error);
     return CoreBase::prepare(handle, statement, error);
 }
@@ -45,8 +50,103 @@ bool Database::exec(const Statement &statement, Error &error)
                           &error);
         return false;
     }
+    if (!flushWriteBuffersReferredBy(statement, error)) {
+        return false;
+    }
     RecyclableHandle handle = flowOut(error);
-    return CoreBase::exec(handle, statement, error);
+    if (statement.getStatementType() != Statement::Type::Vacuum) {
+        return CoreBase::exec(handle, statement, error);
+    }
+    bool result = false;
+    //The user is waiting for it, whose hold-back is bounded
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        Error innerError;
+        Scheduler::shared()->consume(File::getFileSize(getPath(), innerError));
+        result = CoreBase::exec(handle, statement, error);
+    });
+    return result;
+}
+
+RecyclableStatement Database::prepare(const Statement &statement,
+                                      const Cancellation &cancellation,
+                                      Error &error)
+{
+    RecyclableStatement statementHandle = prepare(statement, error);
+    if (statementHandle) {
+        statementHandle->setCancellation(cancellation);
+    }
+    return statementHandle;
+}
+
+bool Database::exec(const Statement &statement,
+                    const Cancellation &cancellation,
+                    Error &error)
+{
+    bool result = false;
+    auto work = [&]() {
+        RecyclableStatement statementHandle =
+            prepare(statement, cancellation, error);
+        if (!statementHandle) {
+            return;
+        }
+        while (statementHandle->step()) {
+        }
+        result = statementHandle->isOK();
+        error = statementHandle->getError();
+    };
+    if (statement.getStatementType() != Statement::Type::Vacuum) {
+        work();
+        return result;
+    }
+    //The user is waiting for it, whose hold-back is bounded
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        Error innerError;
+        Scheduler::shared()->consume(File::getFileSize(getPath(), innerError));
+        work();
+    });
+    return result;
+}
+
+RecyclableStatement Database::prepare(const Statement &statement,
+                                      const SortBudget &budget,
+                                      Error &error)
+{
+    if (statement.getStatementType() == Statement::Type::Transaction) {
+        return prepare(statement, error);
+    }
+    if (!flushWriteBuffersReferredBy(statement, error)) {
+        return RecyclableStatement(RecyclableHandle(nullptr, nullptr), nullptr);
+    }
+    RecyclableHandle handle = flowOut(error);
+    //The sorter is set up by the first step, so that it's budgeted before.
+    if (handle != nullptr &&
+        !handle->setSortBudget(budget.workerThreads, budget.memory)) {
+        error = handle->getError();
+        return RecyclableStatement(RecyclableHandle(nullptr, nullptr), nullptr);
+    }
+    return CoreBase::prepare(handle, statement, error);
+}
+
+bool Database::exec(const Statement &statement,
+                    const SortBudget &budget,
+                    Error &error)
+{
+    bool result = false;
+    //The user is waiting for it, whose hold-back is bounded
+    Scheduler::shared()->run(Scheduler::Priority::High, [&]() {
+        Error innerError;
+        Scheduler::shared()->consume(File::getFileSize(getPath(), innerError));
+        RecyclableStatement statementHandle =
+            prepare(statement, budget, error);
+        if (!statementHandle) {
+            return;
+        }
+        while (statementHandle->step()) {
+        }
+        result = statementHandle->isOK();
+        error = statementHandle->getError();
+    });
+    return result;
 }
 
 bool Database::isTableExists(const std::string &tableName, Error &error)
@@ -0,0 +1,541 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/handle_statement.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <string.h>
+#include <thread>
+
+namespace WCDB {
+
+void Database::setStandby(const void *key,
+                          int keySize,
+                          int pageSize,
+                          const std::chrono::seconds &lag)
+{
+    Standby::Register(getPath(), key, keySize, pageSize, lag);
+    m_pool->setConfig(
+        Database::defaultStandbyConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerCommittedHook(
+                Database::defaultStandbyConfigName,
+                [](Handle *handle, int frames, void *) {
+                    std::shared_ptr<Standby> standby =
+                        Standby::Get(handle->path);
+                    if (standby &&
+                        standby->markDirty(handle->path + "-wal", frames)) {
+                        Database::ScheduleStandby(handle->path);
+                    }
+                },
+                nullptr);
+            return true;
+        });
+    Database::ScheduleStandby(getPath());
+}
+
+void Database::removeStandby()
+{
+    m_pool->setConfig(
+        Database::defaultStandbyConfigName,
+        [](std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            handle->registerCommittedHook(Database::defaultStandbyConfigName,
+                                          nullptr, nullptr);
+            return true;
+        });
+    Standby::Unregister(getPath());
+}
+
+void Database::ScheduleStandby(const std::string &path)
+{
+    static TimedQueue<std::string> s_timedQueue(1);
+    s_timedQueue.reQueue(path);
+    static std::thread s_standbyThread([]() {
+        SET_THREAD_NAME(
+            ("WCDB-" + Database::defaultStandbyConfigName).c_str());
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &path) {
+                std::shared_ptr<Standby> standby = Standby::Get(path);
+                if (!standby) {
+                    return;
+                }
+                if (standby->isDue()) {
+                    Database database(path);
+                    Error innerError;
+                    //Pages newer than the snapshot are left dirty
+                    if (Database::RefreshStandby(database, *standby.get(),
+                                                 innerError) &&
+                        !standby->isDirty()) {
+                        return;
+                    }
+                }
+                //Wait for next time
+                s_timedQueue.reQueue(path);
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_standbyThread.detach(); });
+}
+
+bool Database::RefreshStandby(Database &database,
+                              Standby &standby,
+                              Error &error)
+{
+    static const StatementPragma s_getPageCount =
+        StatementPragma().pragma(Pragma::PageCount);
+
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    bool incremental = false;
+    bool result = false;
+    do {
+        RecyclableHandle source = database.flowOut(error);
+        if (!source) {
+            break;
+        }
+        //Pages collected before it are kept by the snapshot below
+        uint64_t sequence = standby.getSequence();
+        if (!source->exec(StatementTransaction().begin(
+                StatementTransaction::Mode::Defered))) {
+            error = source->getError();
+            break;
+        }
+        {
+            //Read transaction starts here
+            std::shared_ptr<StatementHandle> statementHandle =
+                source->prepare(s_getPageCount);
+            if (!statementHandle || !statementHandle->step()) {
+                error = statementHandle ? statementHandle->getError()
+                                        : source->getError();
+                statementHandle = nullptr;
+                source->exec(StatementTransaction().rollback());
+                break;
+            }
+        }
+        std::set<uint32_t> pages;
+        if (!standby.beginRefresh(sequence, pages)) {
+            result = Database::RefreshStandbyIncrementally(
+                database, standby, source, pages, incremental, error);
+        }
+        source->exec(StatementTransaction().rollback());
+        if (!incremental) {
+            result = Database::RefreshStandbyFully(database, standby, source,
+                                                   error);
+        }
+    } while (false);
+    standby.endRefresh(result, incremental,
+                       std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - begin)
+                           .count());
+    return result;
+}
+
+bool Database::RefreshStandbyIncrementally(Database &database,
+                                           Standby &standby,
+                                           RecyclableHandle &source,
+                                           const std::set<uint32_t> &pages,
+                                           bool &supported,
+                                           Error &error)
+{
+    static const StatementPragma s_getPageSize =
+        StatementPragma().pragma(Pragma::PageSize);
+    static const StatementPragma s_getPageCount =
+        StatementPragma().pragma(Pragma::PageCount);
+    static const StatementPragma s_getAutoVacuum =
+        StatementPragma().pragma(Pragma::AutoVacuum);
+    static const std::string s_pageTable("sqlite_dbpage");
+    static const Column s_pageNumber("pgno");
+    static const Column s_pageData("data");
+    static const StatementSelect s_selectPage =
+        StatementSelect()
+            .select({ColumnResult(s_pageData)})
+            .from(s_pageTable)
+            .where(Expr(s_pageNumber) == Expr::BindParameter);
+    static const StatementUpdate s_updatePage =
+        StatementUpdate()
+            .update(s_pageTable)
+            .set(std::list<const std::pair<const Column, const Expr>>{
+                {s_pageData, Expr::BindParameter}})
+            .where(Expr(s_pageNumber) == Expr::BindParameter);
+
+    auto getInteger =
+        [](const std::shared_ptr<StatementHandle> &statementHandle,
+           int64_t &value) -> bool {
+        if (!statementHandle || !statementHandle->step()) {
+            return false;
+        }
+        value = statementHandle->getValue<ColumnType::Integer64>(0);
+        return true;
+    };
+
+    supported = false;
+    const std::string standbyPath = Standby::GetPath(database.getPath());
+    Error innerError;
+    if (!Handle::IsPageVTableSupported() ||
+        !File::isExists(standbyPath, innerError)) {
+        return false;
+    }
+    //Pages of source are read in the read transaction of caller
+    std::shared_ptr<StatementHandle> sourcePage = source->prepare(s_selectPage);
+    int64_t pageSize = 0;
+    int64_t sourcePages = 0;
+    int64_t autoVacuum = 0;
+    //Pages are moved in commit if auto vacuum is on
+    if (!sourcePage || !getInteger(source->prepare(s_getPageSize), pageSize) ||
+        !getInteger(source->prepare(s_getPageCount), sourcePages) ||
+        !getInteger(source->prepare(s_getAutoVacuum), autoVacuum) ||
+        autoVacuum != 0) {
+        return false;
+    }
+
+    Handle destination(standbyPath);
+    if (!destination.open() ||
+        (!standby.key.empty() &&
+         (!destination.setCipherKey(standby.key.data(),
+                                    (int) standby.key.size()) ||
+          !destination.exec(StatementPragma().pragma(Pragma::CipherPageSize,
+                                                     standby.pageSize))))) {
+        return false;
+    }
+    int64_t standbyPages = 0;
+    bool result = false;
+    do {
+        std::shared_ptr<StatementHandle> standbyPage =
+            destination.prepare(s_selectPage);
+        int64_t standbyPageSize = 0;
+        if (!standbyPage ||
+            !getInteger(destination.prepare(s_getPageSize), standbyPageSize) ||
+            !getInteger(destination.prepare(s_getPageCount), standbyPages) ||
+            standbyPageSize != pageSize) {
+            break;
+        }
+        //Standby is written from now on
+        supported = true;
+        Scheduler::shared()->run(Scheduler::Priority::Default, [&]() {
+            Scheduler::shared()->consume((size_t) pages.size() * pageSize);
+            if (sourcePages > standbyPages) {
+                //Appended pages are zeros, which are unused until it's
+                //covered by the database size in header of page 1.
+                if (!File::truncateFile(standbyPath,
+                                        (size_t) sourcePages * pageSize,
+                                        error)) {
+                    return;
+                }
+                if (!destination.exec(StatementTransaction().begin(
+                        StatementTransaction::Mode::Immediate))) {
+                    error = destination.getError();
+                    return;
+                }
+                standbyPage->bind<ColumnType::Integer32>(1, 1);
+                if (!standbyPage->step()) {
+                    error = standbyPage->getError();
+                    return;
+                }
+                int size = 0;
+                const unsigned char *data =
+                    (const unsigned char *) standbyPage
+                        ->getValue<ColumnType::BLOB>(0, size);
+                std::vector<unsigned char> firstPage(data, data + size);
+                standbyPage->reset();
+                //See https://www.sqlite.org/fileformat2.html#in_header_database_size
+                for (int i = 0; i < 4; ++i) {
+                    firstPage[28 + i] =
+                        (unsigned char) (sourcePages >> (8 * (3 - i)));
+                }
+                std::shared_ptr<StatementHandle> updatePage =
+                    destination.prepare(s_updatePage);
+                if (!updatePage) {
+                    error = destination.getError();
+                    return;
+                }
+                updatePage->bind<ColumnType::BLOB>(
+                    firstPage.data(), (int) firstPage.size(), 1);
+                updatePage->bind<ColumnType::Integer32>(1, 2);
+                updatePage->step();
+                if (!updatePage->isOK()) {
+                    error = updatePage->getError();
+                    return;
+                }
+                updatePage = nullptr;
+                if (!destination.exec(StatementTransaction().commit())) {
+                    error = destination.getError();
+                    return;
+                }
+            }
+            std::shared_ptr<StatementHandle> updatePage =
+                destination.prepare(s_updatePage);
+            if (!updatePage ||
+                !destination.exec(StatementTransaction().begin(
+                    StatementTransaction::Mode::Immediate))) {
+                error = destination.getError();
+                return;
+            }
+            //Page 1 goes last, since the schema is reloaded once its cookie changes
+            std::list<uint32_t> orderedPages(pages.begin(), pages.end());
+            if (!orderedPages.empty() && orderedPages.front() == 1) {
+                orderedPages.splice(orderedPages.end(), orderedPages,
+                                    orderedPages.begin());
+            }
+            for (uint32_t pageNumber : orderedPages) {
+                if (pageNumber > sourcePages) {
+                    //Truncated
+                    continue;
+                }
+                sourcePage->reset();
+                sourcePage->bind<ColumnType::Integer32>(pageNumber, 1);
+                if (!sourcePage->step()) {
+                    error = sourcePage->getError();
+                    return;
+                }
+                int size = 0;
+                const void *data =
+                    sourcePage->getValue<ColumnType::BLOB>(0, size);
+                updatePage->reset();
+                updatePage->bind<ColumnType::BLOB>(data, size, 1);
+                updatePage->bind<ColumnType::Integer32>(pageNumber, 2);
+                updatePage->step();
+                if (!updatePage->isOK()) {
+                    error = updatePage->getError();
+                    return;
+                }
+            }
+            updatePage = nullptr;
+            if (!destination.exec(StatementTransaction().commit())) {
+                error = destination.getError();
+                return;
+            }
+            result = true;
+        });
+    } while (false);
+    destination.close();
+    //Pages beyond the size in header are not used
+    if (result && sourcePages < standbyPages) {
+        result = File::truncateFile(standbyPath,
+                                    (size_t) sourcePages * pageSize, error);
+    }
+    return result;
+}
+
+bool Database::RefreshStandbyFully(Database &database,
+                                   Standby &standby,
+                                   RecyclableHandle &source,
+                                   Error &error)
+{
+    static const StatementPragma s_quickCheck =
+        StatementPragma().pragma(Pragma::QuickCheck);
+
+    const std::string standbyPath = Standby::GetPath(database.getPath());
+    const std::string tempPath = standbyPath + "-temp";
+    const std::list<std::string> tempPaths = {
+        tempPath, tempPath + "-wal", tempPath + "-shm", tempPath + "-journal",
+    };
+    bool result = false;
+    do {
+        if (!File::removeFiles(tempPaths, error)) {
+            break;
+        }
+        //The copy is verified before it replaces the old one
+        Handle destination(tempPath);
+        if (!destination.open() ||
+            (!standby.key.empty() &&
+             (!destination.setCipherKey(standby.key.data(),
+                                        (int) standby.key.size()) ||
+              !destination.exec(StatementPragma().pragma(
+                  Pragma::CipherPageSize, standby.pageSize))))) {
+            error = destination.getError();
+            break;
+        }
+        bool copied = false;
+        Scheduler::shared()->run(Scheduler::Priority::Default, [&]() {
+            Error innerError;
+            Scheduler::shared()->consume(
+                File::getFileSize(database.getPath(), innerError));
+            copied = source->copyTo(destination);
+        });
+        if (!copied) {
+            error = source->getError();
+            break;
+        }
+        std::shared_ptr<StatementHandle> statementHandle =
+            destination.prepare(s_quickCheck);
+        if (!statementHandle) {
+            error = destination.getError();
+            break;
+        }
+        if (!statementHandle->step()) {
+            error = statementHandle->getError();
+            break;
+        }
+        const char *checked = statementHandle->getValue<ColumnType::Text>(0);
+        if (!checked || strcmp(checked, "ok") != 0) {
+            Error::ReportCore(database.getTag(), tempPath,
+                              Error::CoreOperation::Step,
+                              Error::CoreCode::Misuse,
+                              "Standby is not verified", &error);
+            break;
+        }
+        result = true;
+    } while (false);
+    //Destination is closed before renamed
+    result = result && File::renameFile(tempPath, standbyPath, error);
+    Error innerError;
+    File::removeFiles(tempPaths, innerError);
+    return result;
+}
+
+bool Database::refreshStandby(Error &error)
+{
+    std::shared_ptr<Standby> standby = Standby::Get(getPath());
+    if (!standby) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                          Error::CoreCode::Misuse, "Standby is not set",
+                          &error);
+        return false;
+    }
+    return Database::RefreshStandby(*this, *standby.get(), error);
+}
+
+bool Database::recoverStandby(Error &error)
+{
+    static const StatementPragma s_quickCheck =
+        StatementPragma().pragma(Pragma::QuickCheck);
+
+    const std::string standbyPath = Standby::GetPath(getPath());
+    std::shared_ptr<Standby> standby = Standby::Get(getPath());
+    if (!standby) {
+        //Pages in journal can't be read without the cipher
+        Error::ReportCore(getTag(), standbyPath, Error::CoreOperation::Exec,
+                          Error::CoreCode::Misuse,
+                          "Standby with hot journal can't be recovered "
+                          "unless it's set",
+                          &error);
+        return false;
+    }
+    {
+        //Journal is rolled back by the first read, and wal is checkpointed
+        //when the last connection is closed
+        Handle handle(standbyPath);
+        if (!handle.open() ||
+            (!standby->key.empty() &&
+             (!handle.setCipherKey(standby->key.data(),
+                                   (int) standby->key.size()) ||
+              !handle.exec(StatementPragma().pragma(Pragma::CipherPageSize,
+                                                    standby->pageSize))))) {
+            error = handle.getError();
+            return false;
+        }
+        std::shared_ptr<StatementHandle> statementHandle =
+            handle.prepare(s_quickCheck);
+        if (!statementHandle) {
+            error = handle.getError();
+            return false;
+        }
+        if (!statementHandle->step()) {
+            error = statementHandle->getError();
+            return false;
+        }
+        const char *checked = statementHandle->getValue<ColumnType::Text>(0);
+        if (!checked || strcmp(checked, "ok") != 0) {
+            Error::ReportCore(getTag(), standbyPath, Error::CoreOperation::Step,
+                              Error::CoreCode::Misuse,
+                              "Standby is not verified", &error);
+            return false;
+        }
+    }
+    for (const char *suffix : {"-journal", "-wal"}) {
+        if (File::isExists(standbyPath + suffix, error)) {
+            Error::ReportCore(getTag(), standbyPath,
+                              Error::CoreOperation::Exec,
+                              Error::CoreCode::Misuse,
+                              "Standby is still in use", &error);
+            return false;
+        }
+        if (!error.isOK()) {
+            return false;
+        }
+    }
+    //Shm is left by the closed connection
+    return File::removeFile(standbyPath + "-shm", error);
+}
+
+bool Database::promoteStandby(Error &error)
+{
+    if (!isBlockaded() || isOpened()) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                          Error::CoreCode::Misuse,
+                          "Standby can't be promoted unless database is "
+                          "blockaded and closed",
+                          &error);
+        return false;
+    }
+    const std::string standbyPath = Standby::GetPath(getPath());
+    if (!File::isExists(standbyPath, error)) {
+        if (error.isOK()) {
+            Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                              Error::CoreCode::Misuse,
+                              "Standby does not exist", &error);
+        }
+        return false;
+    }
+    //Journal or wal left by an interrupted refresh is rolled back or
+    //checkpointed before the standby is moved away from it
+    bool hot = false;
+    for (const char *suffix : {"-journal", "-wal"}) {
+        hot = hot || File::isExists(standbyPath + suffix, error);
+        if (!error.isOK()) {
+            return false;
+        }
+    }
+    if (hot && !recoverStandby(error)) {
+        return false;
+    }
+    //Frames in wal of the corrupted one should not be applied to standby
+    const std::list<std::string> paths = {
+        getPath() + "-wal", getPath() + "-shm", getPath() + "-journal",
+    };
+    if (!File::removeFiles(paths, error) ||
+        !File::renameFile(standbyPath, getPath(), error)) {
+        return false;
+    }
+    std::shared_ptr<Standby> standby = Standby::Get(getPath());
+    if (standby) {
+        standby->markDirty();
+        Database::ScheduleStandby(getPath());
+    }
+    error.reset();
+    return true;
+}
+
+Standby::Statistics Database::getStandbyStatistics()
+{
+    std::shared_ptr<Standby> standby = Standby::Get(getPath());
+    if (!standby) {
+        Standby::Statistics statistics;
+        memset(&statistics, 0, sizeof(statistics));
+        return statistics;
+    }
+    return standby->getStatistics();
+}
+
+} //namespace WCDB
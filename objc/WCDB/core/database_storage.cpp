@@ -0,0 +1,550 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/scheduler.hpp>
+#include <algorithm>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+namespace WCDB {
+
+int64_t Database::BtreeStorage::getPages() const
+{
+    return leafPages + interiorPages + overflowPages;
+}
+
+double Database::BtreeStorage::getFillFactor(int pageSize) const
+{
+    int64_t bytes = getPages() * pageSize;
+    return bytes > 0 ? (double) (bytes - unused) / bytes : 0;
+}
+
+double Database::BtreeStorage::getAveragePayload() const
+{
+    return entries > 0 ? (double) payload / entries : 0;
+}
+
+int64_t Database::StorageReport::getReclaimableBytes() const
+{
+    int64_t bytes = freelistPages * pageSize;
+    for (const BtreeStorage &btree : btrees) {
+        bytes += btree.unused;
+    }
+    return bytes;
+}
+
+static uint32_t GetBigEndian16(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[0] << 8) | bytes[1];
+}
+
+static uint32_t GetBigEndian32(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) |
+           ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+//Returns the length of varint at [bytes], or 0 if it runs over [end]
+static int GetVarint(const unsigned char *bytes,
+                     const unsigned char *end,
+                     uint64_t &value)
+{
+    value = 0;
+    for (int i = 0; i < 9; ++i) {
+        if (bytes + i >= end) {
+            return 0;
+        }
+        if (i == 8) {
+            value = (value << 8) | bytes[i];
+            return 9;
+        }
+        value = (value << 7) | (bytes[i] & 0x7f);
+        if ((bytes[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+typedef std::function<bool(uint32_t, std::vector<unsigned char> &)>
+    PageReader;
+
+//Pages are visited in the same order as dbstat does, which is the page
+//itself, then the overflow pages and the child of each cell, then the right
+//child. Returns false with [malformed] set to the page not decodable.
+static bool WalkBtree(const PageReader &readPage,
+                      const std::function<void(uint32_t)> &onVisited,
+                      uint32_t pageNumber,
+                      int usableSize,
+                      int depth,
+                      Database::BtreeStorage &btree,
+                      uint32_t &malformed)
+{
+    std::vector<unsigned char> page;
+    if (!readPage(pageNumber, page)) {
+        return false;
+    }
+    //See https://www.sqlite.org/fileformat2.html#b_tree_pages
+    const int header = pageNumber == 1 ? 100 : 0;
+    if (depth > 32 || usableSize <= 35 ||
+        (int) page.size() < header + 12 || (int) page.size() < usableSize) {
+        malformed = pageNumber;
+        return false;
+    }
+    const unsigned char *data = page.data();
+    const unsigned char flags = data[header];
+    bool leaf = false;
+    switch (flags) {
+        case 0x0a:
+        case 0x0d:
+            leaf = true;
+            break;
+        case 0x02:
+        case 0x05:
+            break;
+        default:
+            malformed = pageNumber;
+            return false;
+    }
+    const int headerSize = header + (leaf ? 8 : 12);
+    const int cells = (int) GetBigEndian16(data + header + 3);
+    if (headerSize + cells * 2 > usableSize) {
+        malformed = pageNumber;
+        return false;
+    }
+    int64_t unused = (int64_t) GetBigEndian16(data + header + 5) -
+                     headerSize - cells * 2 + data[header + 7];
+    //Freeblocks are chained in ascending order of offset
+    for (uint32_t offset = GetBigEndian16(data + header + 1), last = 0;
+         offset != 0; last = offset, offset = GetBigEndian16(data + offset)) {
+        if (offset <= last || (int) offset + 4 > usableSize) {
+            malformed = pageNumber;
+            return false;
+        }
+        unused += GetBigEndian16(data + offset + 2);
+    }
+    if (leaf) {
+        ++btree.leafPages;
+        btree.entries += cells;
+    } else {
+        ++btree.interiorPages;
+        //Interior cells of index are entries as well
+        btree.entries += btree.isIndex ? cells : 0;
+    }
+    btree.unused += unused;
+    onVisited(pageNumber);
+
+    //See https://www.sqlite.org/fileformat2.html#b_tree_cell_format
+    const int minLocal = (usableSize - 12) * 32 / 255 - 23;
+    const int maxLocal =
+        flags == 0x0d ? usableSize - 35 : (usableSize - 12) * 64 / 255 - 23;
+    const unsigned char *end = data + usableSize;
+    for (int i = 0; i < cells; ++i) {
+        uint32_t offset = GetBigEndian16(data + headerSize + i * 2);
+        if ((int) offset < headerSize ||
+            (int) offset + (leaf ? 0 : 4) >= usableSize) {
+            malformed = pageNumber;
+            return false;
+        }
+        uint32_t child = leaf ? 0 : GetBigEndian32(data + offset);
+        offset += leaf ? 0 : 4;
+        if (flags != 0x05) {
+            uint64_t payload = 0;
+            uint64_t rowid = 0;
+            int length = GetVarint(data + offset, end, payload);
+            if (length > 0 && flags == 0x0d) {
+                int rowidLength = GetVarint(data + offset + length, end, rowid);
+                length = rowidLength > 0 ? length + rowidLength : 0;
+            }
+            if (length == 0 || payload > INT32_MAX) {
+                malformed = pageNumber;
+                return false;
+            }
+            offset += length;
+            int64_t local = minLocal + ((int64_t) payload - minLocal) %
+                                           (usableSize - 4);
+            if (local > maxLocal) {
+                local = minLocal;
+            }
+            if ((int64_t) payload <= local) {
+                btree.payload += payload;
+            } else {
+                btree.payload += local;
+                if ((int64_t) offset + local + 4 > usableSize) {
+                    malformed = pageNumber;
+                    return false;
+                }
+                int64_t remaining = (int64_t) payload - local;
+                uint32_t overflow = GetBigEndian32(data + offset + local);
+                while (remaining > 0) {
+                    std::vector<unsigned char> overflowPage;
+                    if (overflow == 0) {
+                        malformed = pageNumber;
+                        return false;
+                    }
+                    if (!readPage(overflow, overflowPage)) {
+                        return false;
+                    }
+                    if ((int) overflowPage.size() < usableSize) {
+                        malformed = overflow;
+                        return false;
+                    }
+                    int64_t stored =
+                        std::min<int64_t>(remaining, usableSize - 4);
+                    ++btree.overflowPages;
+                    btree.payload += stored;
+                    btree.unused += usableSize - 4 - stored;
+                    onVisited(overflow);
+                    remaining -= stored;
+                    overflow = GetBigEndian32(overflowPage.data());
+                }
+            }
+        }
+        if (child != 0 &&
+            !WalkBtree(readPage, onVisited, child, usableSize, depth + 1,
+                       btree, malformed)) {
+            return false;
+        }
+    }
+    if (!leaf &&
+        !WalkBtree(readPage, onVisited, GetBigEndian32(data + header + 8),
+                   usableSize, depth + 1, btree, malformed)) {
+        return false;
+    }
+    return true;
+}
+
+bool Database::analyzeStorage(StorageReport &report,
+                              Error &error,
+                              int pagesPerStep)
+{
+    static const Column s_name("name");
+    static const Column s_tableName("tbl_name");
+    static const Column s_type("type");
+    static const Column s_rootPage("rootpage");
+    static const StatementSelect s_getBtrees =
+        StatementSelect()
+            .select({ColumnResult(s_name), ColumnResult(s_tableName),
+                     ColumnResult(s_type), ColumnResult(s_rootPage)})
+            .from("sqlite_master")
+            .where(Expr(s_rootPage) > 0);
+    static const StatementSelect s_getRootPage =
+        StatementSelect()
+            .select({ColumnResult(s_rootPage)})
+            .from("sqlite_master")
+            .where(Expr(s_name) == Expr::BindParameter);
+    static const Column s_pageNumber("pgno");
+    static const StatementSelect s_getPage =
+        StatementSelect()
+            .select({ColumnResult(Column("data"))})
+            .from("sqlite_dbpage")
+            .where(Expr(s_pageNumber) == Expr::BindParameter);
+    //Pages are listed in the traversal order of each b-tree
+    static const StatementSelect s_getPages =
+        StatementSelect()
+            .select({ColumnResult(s_name), ColumnResult(Column("pagetype")),
+                     ColumnResult(Column("ncell")),
+                     ColumnResult(Column("payload")),
+                     ColumnResult(Column("unused")),
+                     ColumnResult(Column("pageno"))})
+            .from("dbstat");
+    static const std::list<std::pair<Pragma, int64_t StorageReport::*>>
+        s_pragmas = {
+            {Pragma::PageCount, &StorageReport::pageCount},
+            {Pragma::FreelistCount, &StorageReport::freelistPages},
+        };
+
+    report = StorageReport();
+    const bool pageReadable = Handle::IsPageVTableSupported();
+    std::unordered_map<std::string, BtreeStorage> btrees;
+    std::list<std::pair<uint32_t, std::string>> rootPages;
+    int usableSize = 0;
+    //Schema and counts are of a same snapshot
+    if (!begin(StatementTransaction::Mode::Defered, error)) {
+        return false;
+    }
+    bool result = false;
+    do {
+        RecyclableStatement statementHandle =
+            prepare(StatementPragma().pragma(Pragma::PageSize), error);
+        if (!statementHandle || !statementHandle->step()) {
+            error = statementHandle ? statementHandle->getError() : error;
+            break;
+        }
+        report.pageSize = statementHandle->getValue<ColumnType::Integer32>(0);
+        bool succeed = true;
+        for (const auto &pragma : s_pragmas) {
+            statementHandle =
+                prepare(StatementPragma().pragma(pragma.first), error);
+            if (!statementHandle || !statementHandle->step()) {
+                error = statementHandle ? statementHandle->getError() : error;
+                succeed = false;
+                break;
+            }
+            report.*pragma.second =
+                statementHandle->getValue<ColumnType::Integer64>(0);
+        }
+        if (!succeed) {
+            break;
+        }
+        if (pageReadable) {
+            //Bytes reserved at the end of each page, e.g. by cipher
+            statementHandle = prepare(s_getPage, error);
+            if (!statementHandle) {
+                break;
+            }
+            statementHandle->bind<ColumnType::Integer32>(1, 1);
+            if (!statementHandle->step()) {
+                error = statementHandle->getError();
+                break;
+            }
+            int size = 0;
+            const unsigned char *data =
+                (const unsigned char *) statementHandle
+                    ->getValue<ColumnType::BLOB>(0, size);
+            usableSize = report.pageSize - (size > 20 ? data[20] : 0);
+        }
+
+        BtreeStorage &master = btrees["sqlite_master"];
+        master.name = master.table = "sqlite_master";
+        rootPages.push_back({1, master.name});
+        statementHandle = prepare(s_getBtrees, error);
+        if (!statementHandle) {
+            break;
+        }
+        while (statementHandle->step()) {
+            const char *name = statementHandle->getValue<ColumnType::Text>(0);
+            const char *table = statementHandle->getValue<ColumnType::Text>(1);
+            const char *type = statementHandle->getValue<ColumnType::Text>(2);
+            BtreeStorage &btree = btrees[name ? name : ""];
+            btree.name = name ? name : "";
+            btree.table = table ? table : "";
+            btree.isIndex = type && strcmp(type, "index") == 0;
+            rootPages.push_back(
+                {(uint32_t) statementHandle->getValue<ColumnType::Integer64>(
+                     3),
+                 btree.name});
+        }
+        if (!statementHandle->isOK()) {
+            error = statementHandle->getError();
+            break;
+        }
+        result = true;
+    } while (false);
+    Error innerError;
+    commit(innerError);
+    if (!result) {
+        return false;
+    }
+
+    result = false;
+    if (pageReadable) {
+        //Each b-tree is walked in a read transaction of its own, which is
+        //released before the next one, so that checkpoints catch up in between
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            int pages = 0;
+            //Each step is charged before it's walked
+            Scheduler::shared()->consume((size_t) pagesPerStep *
+                                         report.pageSize);
+            auto onVisited = [&](uint32_t) {
+                if (++pages >= pagesPerStep) {
+                    Scheduler::shared()->consume((size_t) pages *
+                                                 report.pageSize);
+                    pages = 0;
+                }
+            };
+            for (const auto &rootPage : rootPages) {
+                if (!begin(StatementTransaction::Mode::Defered, error)) {
+                    return;
+                }
+                bool walked = false;
+                do {
+                    //Root pages may be moved or dropped since it's listed
+                    uint32_t root = rootPage.first;
+                    if (root != 1) {
+                        RecyclableStatement getRootPage =
+                            prepare(s_getRootPage, error);
+                        if (!getRootPage) {
+                            break;
+                        }
+                        getRootPage->bind<ColumnType::Text>(
+                            rootPage.second.c_str(), 1);
+                        root = getRootPage->step()
+                                   ? (uint32_t) getRootPage->getValue<
+                                         ColumnType::Integer64>(0)
+                                   : 0;
+                        if (!getRootPage->isOK()) {
+                            error = getRootPage->getError();
+                            break;
+                        }
+                    }
+                    if (root == 0) {
+                        walked = true;
+                        break;
+                    }
+                    RecyclableStatement getPage = prepare(s_getPage, error);
+                    if (!getPage) {
+                        break;
+                    }
+                    auto readPage = [&](uint32_t pageNumber,
+                                        std::vector<unsigned char> &page) {
+                        getPage->reset();
+                        getPage->bind<ColumnType::Integer64>(pageNumber, 1);
+                        if (!getPage->step()) {
+                            //Pages out of the database are malformed
+                            page.clear();
+                            error = getPage->getError();
+                            return getPage->isOK();
+                        }
+                        int size = 0;
+                        const unsigned char *data =
+                            (const unsigned char *) getPage
+                                ->getValue<ColumnType::BLOB>(0, size);
+                        page.assign(data, data + size);
+                        return true;
+                    };
+                    BtreeStorage &btree = btrees[rootPage.second];
+                    int64_t lastPage = 0;
+                    uint32_t malformed = 0;
+                    walked = WalkBtree(
+                        readPage,
+                        [&](uint32_t pageNumber) {
+                            if (lastPage != 0 && pageNumber != lastPage + 1) {
+                                ++btree.fragmentedPages;
+                            }
+                            lastPage = pageNumber;
+                            onVisited(pageNumber);
+                        },
+                        root, usableSize, 0, btree, malformed);
+                    if (malformed != 0) {
+                        const std::string message =
+                            "Page " + std::to_string(malformed) + " of " +
+                            btree.name + " is malformed";
+                        Error::ReportSQLite(
+                            getTag(), getPath(), Error::HandleOperation::Step,
+                            Handle::GetCorruptCode(), message.c_str(), &error);
+                    }
+                } while (false);
+                commit(innerError);
+                if (!walked) {
+                    return;
+                }
+            }
+            result = true;
+        });
+    } else {
+        //dbstat can't resume from a b-tree, so that all pages are walked in a
+        //single read transaction
+        if (!begin(StatementTransaction::Mode::Defered, error)) {
+            return false;
+        }
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            RecyclableStatement statementHandle = prepare(s_getPages, error);
+            if (!statementHandle) {
+                return;
+            }
+            BtreeStorage *btree = nullptr;
+            int64_t lastPage = 0;
+            int pages = 0;
+            //Each step is charged before it's walked
+            Scheduler::shared()->consume((size_t) pagesPerStep *
+                                         report.pageSize);
+            while (statementHandle->step()) {
+                const char *name =
+                    statementHandle->getValue<ColumnType::Text>(0);
+                if (!btree || btree->name != (name ? name : "")) {
+                    auto iter = btrees.find(name ? name : "");
+                    btree = iter != btrees.end() ? &iter->second : nullptr;
+                    lastPage = 0;
+                }
+                if (++pages >= pagesPerStep) {
+                    Scheduler::shared()->consume((size_t) pages *
+                                                 report.pageSize);
+                    pages = 0;
+                }
+                if (!btree) {
+                    continue;
+                }
+                const char *type =
+                    statementHandle->getValue<ColumnType::Text>(1);
+                int64_t cells =
+                    statementHandle->getValue<ColumnType::Integer64>(2);
+                if (type && strcmp(type, "leaf") == 0) {
+                    ++btree->leafPages;
+                    btree->entries += cells;
+                } else if (type && strcmp(type, "overflow") == 0) {
+                    ++btree->overflowPages;
+                } else {
+                    ++btree->interiorPages;
+                    //Interior cells of index are entries as well
+                    btree->entries += btree->isIndex ? cells : 0;
+                }
+                btree->payload +=
+                    statementHandle->getValue<ColumnType::Integer64>(3);
+                btree->unused +=
+                    statementHandle->getValue<ColumnType::Integer64>(4);
+                int64_t page =
+                    statementHandle->getValue<ColumnType::Integer64>(5);
+                if (lastPage != 0 && page != lastPage + 1) {
+                    ++btree->fragmentedPages;
+                }
+                lastPage = page;
+            }
+            if (statementHandle->isOK()) {
+                result = true;
+            } else {
+                error = statementHandle->getError();
+            }
+        });
+        commit(innerError);
+    }
+    if (!result) {
+        return false;
+    }
+    for (auto &iter : btrees) {
+        if (iter.second.getPages() > 0) {
+            report.btrees.push_back(std::move(iter.second));
+        }
+    }
+    report.btrees.sort([](const BtreeStorage &a, const BtreeStorage &b) {
+        return a.getPages() > b.getPages();
+    });
+    return true;
+}
+
+void Database::analyzeStorage(const StorageCallback &onAnalyzed,
+                              int pagesPerStep)
+{
+    const std::string path = getPath();
+    Scheduler::shared()->post(
+        Scheduler::Priority::Low, [path, onAnalyzed, pagesPerStep]() {
+            Database database(path);
+            StorageReport report;
+            Error error;
+            database.analyzeStorage(report, error, pagesPerStep);
+            if (onAnalyzed) {
+                onAnalyzed(report, error);
+            }
+        });
+}
+
+} //namespace WCDB
@@ -0,0 +1,312 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <limits>
+#include <thread>
+
+namespace WCDB {
+
+static bool IsAttached(std::shared_ptr<Handle> &handle,
+                       const std::string &schema)
+{
+    static const StatementPragma s_databaseList =
+        StatementPragma().pragma(Pragma::DatabaseList);
+    std::shared_ptr<StatementHandle> statementHandle =
+        handle->prepare(s_databaseList);
+    if (!statementHandle) {
+        return false;
+    }
+    while (statementHandle->step()) {
+        //seq, name, file
+        if (schema == statementHandle->getValue<ColumnType::Text>(1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Database::setAttachment(const std::string &schema,
+                             const std::string &path,
+                             const void *key,
+                             int keySize,
+                             int pageSize)
+{
+    StatementAttach attach = StatementAttach().attach(path).as(schema);
+    if (key) {
+        attach.key(Expr(key, keySize));
+    }
+    bool cipher = !key || keySize > 0;
+    StatementDetach detach = StatementDetach().detach(schema);
+    m_pool->setConfig(
+        "attach_" + schema,
+        [attach, detach, schema, cipher, pageSize](
+            std::shared_ptr<Handle> &handle, Error &error) -> bool {
+            //Configs may be invoked again on the same handle
+            if (IsAttached(handle, schema) && !handle->exec(detach)) {
+                error = handle->getError();
+                return false;
+            }
+
+            //Page size of attached cipher database follows the default one
+            static const StatementPragma s_getCipherDefaultPageSize =
+                StatementPragma().pragma(Pragma::CipherDefaultPageSize);
+            int defaultPageSize = 0;
+            if (cipher && pageSize > 0) {
+                std::shared_ptr<StatementHandle> statementHandle =
+                    handle->prepare(s_getCipherDefaultPageSize);
+                if (statementHandle && statementHandle->step()) {
+                    defaultPageSize =
+                        statementHandle->getValue<ColumnType::Integer32>(0);
+                }
+                statementHandle = nullptr;
+                if (defaultPageSize <= 0 ||
+                    !handle->exec(StatementPragma().pragma(
+                        Pragma::CipherDefaultPageSize, pageSize))) {
+                    error = handle->getError();
+                    return false;
+                }
+            }
+            bool result = handle->exec(attach);
+            if (defaultPageSize > 0) {
+                handle->exec(StatementPragma().pragma(
+                    Pragma::CipherDefaultPageSize, defaultPageSize));
+            }
+            if (!result) {
+                error = handle->getError();
+                return false;
+            }
+
+            //It takes effect only if archive is empty
+            if ((!cipher && pageSize > 0 &&
+                 !handle->exec(StatementPragma().pragma(
+                     Pragma::PageSize.inSchema(schema), pageSize))) ||
+                !handle->exec(StatementPragma().pragma(
+                    Pragma::JournalMode.inSchema(schema), "WAL"))) {
+                error = handle->getError();
+                return false;
+            }
+            error.reset();
+            return true;
+        },
+        (Configs::Order) Database::ConfigOrder::Attach);
+}
+
+void Database::removeAttachment(const std::string &schema)
+{
+    StatementDetach detach = StatementDetach().detach(schema);
+    m_pool->setConfig(
+        "attach_" + schema,
+        [detach, schema](std::shared_ptr<Handle> &handle,
+                         Error &error) -> bool {
+            if (IsAttached(handle, schema) && !handle->exec(detach)) {
+                error = handle->getError();
+                return false;
+            }
+            error.reset();
+            return true;
+        },
+        (Configs::Order) Database::ConfigOrder::Attach);
+}
+
+bool Database::setTiering(const std::string &table,
+                          const std::string &schema,
+                          const Expr &condition,
+                          int batchSize,
+                          Error &error)
+{
+    std::shared_ptr<const Tiering> tiering =
+        Tiering::Register(getPath(), table, schema, condition, batchSize);
+    if (!exec(tiering->getCreateArchiveStatement(), error)) {
+        Tiering::Unregister(getPath(), table);
+        return false;
+    }
+    StatementCreateView createView = tiering->getCreateViewStatement();
+    StatementDropView dropView = tiering->getDropViewStatement();
+    m_pool->setConfig(
+        tiering->getName(),
+        [createView, dropView](std::shared_ptr<Handle> &handle,
+                               Error &error) -> bool {
+            //The old view may refer to another schema
+            if (!handle->exec(dropView) || !handle->exec(createView)) {
+                error = handle->getError();
+                return false;
+            }
+            return true;
+        });
+
+    const std::string path = getPath();
+    Scheduler::shared()->post(Scheduler::Priority::Low, [path, tiering]() {
+        Database database(path);
+        Error innerError;
+        database.runTiering(*tiering.get(), innerError);
+    });
+    //Rows become cold as time goes by
+    Database::ScheduleTiering(tiering->getKey());
+    return true;
+}
+
+void Database::ScheduleTiering(const std::string &key)
+{
+    //Cold rows are moved every minute
+    static TimedQueue<std::string> s_timedQueue(60);
+    s_timedQueue.reQueue(key);
+    static std::thread s_tieringThread([]() {
+        SET_THREAD_NAME("WCDB-tiering");
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &key) {
+                std::shared_ptr<const Tiering> tiering =
+                    Tiering::GetByKey(key);
+                if (!tiering) {
+                    //Removed
+                    return;
+                }
+                Database database(tiering->path);
+                //Closed or blockaded ones are left alone until next time
+                if (database.isOpened() && !database.isBlockaded()) {
+                    Scheduler::shared()->run(
+                        Scheduler::Priority::Low, [&database, &tiering]() {
+                            Error innerError;
+                            database.runTiering(*tiering.get(), innerError);
+                        });
+                }
+                s_timedQueue.reQueue(key);
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_tieringThread.detach(); });
+}
+
+void Database::removeTiering(const std::string &table)
+{
+    std::shared_ptr<const Tiering> tiering = Tiering::Get(getPath(), table);
+    if (!tiering) {
+        return;
+    }
+    StatementDropView dropView = tiering->getDropViewStatement();
+    m_pool->setConfig(tiering->getName(),
+                      [dropView](std::shared_ptr<Handle> &handle,
+                                 Error &error) -> bool {
+                          handle->exec(dropView);
+                          return true;
+                      });
+    Tiering::Unregister(getPath(), table);
+}
+
+bool Database::runTiering(Error &error)
+{
+    for (const auto &tiering : Tiering::GetAll(getPath())) {
+        bool result = false;
+        Scheduler::shared()->run(Scheduler::Priority::Low, [&]() {
+            result = runTiering(*tiering.get(), error);
+        });
+        if (!result) {
+            return false;
+        }
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::runTiering(const Tiering &tiering, Error &error)
+{
+    //Rows before it are moved or skipped
+    int64_t cursor = std::numeric_limits<int64_t>::min();
+    bool more = true;
+    while (more) {
+        int skipped = 0;
+        bool result = runTransaction(
+            [this, &tiering, &cursor, &more, &skipped](Error &error) -> bool {
+                std::list<int64_t> rowids;
+                RecyclableStatement statementHandle =
+                    prepare(tiering.getBatchStatement(), error);
+                if (!statementHandle) {
+                    return false;
+                }
+                statementHandle->bind<ColumnType::Integer64>(cursor, 1);
+                while (statementHandle->step()) {
+                    rowids.push_back(
+                        statementHandle->getValue<ColumnType::Integer64>(0));
+                }
+                if (!statementHandle->isOK()) {
+                    error = statementHandle->getError();
+                    return false;
+                }
+                more = rowids.size() >= (size_t) tiering.batchSize &&
+                       rowids.back() < std::numeric_limits<int64_t>::max();
+                RecyclableStatement archive =
+                    prepare(tiering.getArchiveStatement(), error);
+                if (!archive) {
+                    return false;
+                }
+                RecyclableStatement evict =
+                    prepare(tiering.getEvictStatement(), error);
+                if (!evict) {
+                    return false;
+                }
+                for (int64_t rowid : rowids) {
+                    archive->reset();
+                    archive->bind<ColumnType::Integer64>(rowid, 1);
+                    archive->step();
+                    if (!archive->isOK()) {
+                        //Only the failed statement is rolled back
+                        if (Handle::IsConstraintError(
+                                archive->getError().getCode())) {
+                            ++skipped;
+                            continue;
+                        }
+                        error = archive->getError();
+                        return false;
+                    }
+                    evict->reset();
+                    evict->bind<ColumnType::Integer64>(rowid, 1);
+                    evict->step();
+                    if (!evict->isOK()) {
+                        error = evict->getError();
+                        return false;
+                    }
+                }
+                if (more) {
+                    cursor = rowids.back() + 1;
+                }
+                return true;
+            },
+            nullptr, error);
+        if (!result) {
+            return false;
+        }
+        if (skipped > 0) {
+            //They are tried again in next run
+            Error::Warning(("Tiering skips " + std::to_string(skipped) +
+                            " rows of [" + tiering.table +
+                            "] conflicting with the archive")
+                               .c_str());
+        }
+        //Yield to foreground between batches
+        Scheduler::shared()->consume(0);
+    }
+    return true;
+}
+
+} //namespace WCDB
@@ -88,6 +88,23 @@ bool Database::rollback(Error &error)
     return result;
 }
 
+bool Database::runTransaction(TransactionBlock transaction,
+                              const Cancellation &cancellation,
+                              Error &error)
+{
+    //The cancellation will be reset once the handle flows back
+    return CoreBase::runTransaction(
+        [this, &transaction, &cancellation](Error &error) -> bool {
+            RecyclableHandle handle = flowOut(error);
+            if (!handle) {
+                return false;
+            }
+            handle->setCancellation(cancellation);
+            return transaction(error);
+        },
+        nullptr, error);
+}
+
 bool Database::runEmbeddedTransaction(TransactionBlock transaction,
                                       Error &error)
 {
@@ -0,0 +1,301 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/database.hpp>
+#include <WCDB/file.hpp>
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <WCDB/timed_queue.hpp>
+#include <thread>
+
+namespace WCDB {
+
+bool Database::setWriteBuffer(const std::string &table,
+                              const std::list<std::string> &columns,
+                              const WriteBuffer::Config &config,
+                              Error &error)
+{
+    //Rows of the old one are flushed in the old way
+    std::shared_ptr<WriteBuffer> old = WriteBuffer::Get(getPath(), table);
+    if (old && !flushWriteBuffer(*old.get(), error)) {
+        return false;
+    }
+    int64_t sequence = 0;
+    if (config.logged) {
+        if (!exec(WriteBuffer::GetCreateSequenceTableStatement(), error)) {
+            return false;
+        }
+        RecyclableStatement statementHandle =
+            prepare(WriteBuffer::GetSequenceStatement(table), error);
+        if (!statementHandle) {
+            return false;
+        }
+        if (statementHandle->step()) {
+            sequence = statementHandle->getValue<ColumnType::Integer64>(0);
+        } else if (!statementHandle->isOK()) {
+            error = statementHandle->getError();
+            return false;
+        }
+    }
+    std::shared_ptr<WriteBuffer> buffer =
+        WriteBuffer::Register(getPath(), table, columns, config, sequence);
+    if (buffer->hasPending()) {
+        //Replayed rows
+        Database::ScheduleWriteBufferFlush(buffer->getKey());
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::removeWriteBuffer(const std::string &table, Error &error)
+{
+    std::shared_ptr<WriteBuffer> buffer = WriteBuffer::Get(getPath(), table);
+    if (!buffer) {
+        error.reset();
+        return true;
+    }
+    if (!flushWriteBuffer(*buffer.get(), error)) {
+        return false;
+    }
+    WriteBuffer::Unregister(getPath(), table);
+    //Rows appended since the first flush
+    if (!flushWriteBuffer(*buffer.get(), error)) {
+        //Logged ones are replayed once it's set again
+        return false;
+    }
+    return !buffer->config.logged ||
+           File::removeFile(buffer->getLogPath(), error);
+}
+
+bool Database::bufferInsert(const std::string &table,
+                            const WriteBuffer::Row &row,
+                            Error &error)
+{
+    std::shared_ptr<WriteBuffer> buffer = WriteBuffer::Get(getPath(), table);
+    if (!buffer || row.size() != buffer->columns.size()) {
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                          Error::CoreCode::Misuse,
+                          buffer ? "Row does not match the write buffer"
+                                 : "No write buffer is set for the table",
+                          &error);
+        return false;
+    }
+    switch (buffer->append(row)) {
+        case WriteBuffer::Appended::Failed:
+            Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Exec,
+                              Error::CoreCode::Exceed,
+                              "Write buffer is full or its log is unwritable",
+                              &error);
+            return false;
+        case WriteBuffer::Appended::First:
+            Database::ScheduleWriteBufferFlush(buffer->getKey());
+            break;
+        case WriteBuffer::Appended::Full: {
+            const std::string path = getPath();
+            Scheduler::shared()->post(Scheduler::Priority::Default,
+                                      [path, buffer]() {
+                                          Database database(path);
+                                          Error innerError;
+                                          database.flushWriteBuffer(
+                                              *buffer.get(), innerError);
+                                      });
+        } break;
+        default:
+            break;
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::flushWriteBuffers(Error &error)
+{
+    for (const auto &buffer : WriteBuffer::GetAll(getPath())) {
+        if (!flushWriteBuffer(*buffer.get(), error)) {
+            return false;
+        }
+    }
+    error.reset();
+    return true;
+}
+
+WriteBuffer::Statistics
+Database::getWriteBufferStatistics(const std::string &table)
+{
+    std::shared_ptr<WriteBuffer> buffer = WriteBuffer::Get(getPath(), table);
+    if (!buffer) {
+        return {0, 0, 0, 0, 0, 0};
+    }
+    return buffer->getStatistics();
+}
+
+bool Database::flushWriteBuffersReferredBy(const Statement &statement,
+                                           Error &error)
+{
+    std::list<std::shared_ptr<WriteBuffer>> buffers =
+        WriteBuffer::GetAll(getPath());
+    //It may flush a buffer which isn't referred, but never miss one.
+    const std::string &sql = statement.getDescription();
+    std::list<std::shared_ptr<WriteBuffer>> referred;
+    for (const auto &buffer : buffers) {
+        if (buffer->hasPending() &&
+            sql.find(buffer->table) != std::string::npos) {
+            referred.push_back(buffer);
+        }
+    }
+    if (referred.empty()) {
+        error.reset();
+        return true;
+    }
+    //Rows flushed inside a transaction would be rolled back together, so
+    //that it fails instead of missing them
+    std::unordered_map<std::string, RecyclableHandle> *threadedHandle =
+        s_threadedHandle.get();
+    if (threadedHandle->find(getPath()) != threadedHandle->end()) {
+        const std::string message = "Pending rows of write buffer [" +
+                                    referred.front()->table +
+                                    "] can't be referred inside a "
+                                    "transaction. Flush it before the "
+                                    "transaction begins";
+        Error::ReportCore(getTag(), getPath(), Error::CoreOperation::Prepare,
+                          Error::CoreCode::Misuse, message.c_str(), &error);
+        return false;
+    }
+    for (const auto &buffer : referred) {
+        if (!flushWriteBuffer(*buffer.get(), error)) {
+            return false;
+        }
+    }
+    error.reset();
+    return true;
+}
+
+bool Database::flushWriteBuffer(WriteBuffer &buffer, Error &error)
+{
+    std::unique_lock<std::mutex> flushLock = buffer.lockFlush();
+    WriteBuffer::SequencedRows rows;
+    buffer.beginFlush(rows);
+    if (rows.empty()) {
+        error.reset();
+        return true;
+    }
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    bool result = runTransaction(
+        [this, &buffer, &rows](Error &error) -> bool {
+            //Rows appended since it begins are left for the next flush
+            RecyclableHandle handle = flowOut(error);
+            RecyclableStatement statementHandle =
+                CoreBase::prepare(handle, buffer.getInsertStatement(), error);
+            if (!statementHandle) {
+                return false;
+            }
+            for (const auto &pending : rows) {
+                int index = 1;
+                for (const WriteBuffer::Value &value : pending.second) {
+                    switch (value.type) {
+                        case ColumnType::Integer64:
+                            statementHandle->bind<ColumnType::Integer64>(
+                                value.integer, index);
+                            break;
+                        case ColumnType::Float:
+                            statementHandle->bind<ColumnType::Float>(
+                                value.real, index);
+                            break;
+                        case ColumnType::Text:
+                            statementHandle->bind<ColumnType::Text>(
+                                value.data.c_str(), index);
+                            break;
+                        case ColumnType::BLOB:
+                            statementHandle->bind<ColumnType::BLOB>(
+                                value.data.data(), (int) value.data.size(),
+                                index);
+                            break;
+                        default:
+                            statementHandle->bind<ColumnType::Null>(index);
+                            break;
+                    }
+                    ++index;
+                }
+                statementHandle->step();
+                if (!statementHandle->isOK()) {
+                    error = statementHandle->getError();
+                    return false;
+                }
+                statementHandle->reset();
+            }
+            if (!buffer.config.logged) {
+                return true;
+            }
+            //Logged rows up to it are skipped by replay
+            statementHandle = CoreBase::prepare(
+                handle, buffer.getUpdateSequenceStatement(), error);
+            if (!statementHandle) {
+                return false;
+            }
+            statementHandle->bind<ColumnType::Integer64>(rows.back().first, 1);
+            statementHandle->step();
+            if (!statementHandle->isOK()) {
+                error = statementHandle->getError();
+                return false;
+            }
+            return true;
+        },
+        nullptr, error);
+    buffer.endFlush(rows, result,
+                    std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count());
+    return result;
+}
+
+void Database::ScheduleWriteBufferFlush(const std::string &key)
+{
+    //Pending buffers are checked every second until their windows expire
+    static TimedQueue<std::string> s_timedQueue(1);
+    s_timedQueue.reQueue(key);
+    static std::thread s_flushThread([]() {
+        SET_THREAD_NAME("WCDB-writeBuffer");
+        while (true) {
+            s_timedQueue.waitUntilExpired([](const std::string &key) {
+                std::shared_ptr<WriteBuffer> buffer =
+                    WriteBuffer::GetByKey(key);
+                if (!buffer) {
+                    return;
+                }
+                if (buffer->isDue()) {
+                    Database database(buffer->path);
+                    Scheduler::shared()->run(
+                        Scheduler::Priority::Default, [&]() {
+                            Error innerError;
+                            database.flushWriteBuffer(*buffer.get(),
+                                                      innerError);
+                        });
+                }
+                if (buffer->hasPending()) {
+                    s_timedQueue.reQueue(key);
+                }
+            });
+        }
+    });
+    static std::once_flag s_flag;
+    std::call_once(s_flag, []() { s_flushThread.detach(); });
+}
+
+} //namespace WCDB
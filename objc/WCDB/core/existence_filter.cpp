@@ -0,0 +1,359 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/existence_filter.hpp>
+#include <WCDB/file.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<ExistenceFilter>>
+    ExistenceFilter::s_filters;
+std::mutex ExistenceFilter::s_mutex;
+
+static const char s_sidecarMagic[8] = {'W', 'C', 'D', 'B', 'E', 'X', 'F', '2'};
+
+std::shared_ptr<ExistenceFilter>
+ExistenceFilter::Register(const std::string &path,
+                          const std::string &table,
+                          const std::string &column,
+                          size_t expectedCount,
+                          double falsePositiveRate)
+{
+    std::shared_ptr<ExistenceFilter> filter(new ExistenceFilter(
+        path, table, column, expectedCount, falsePositiveRate));
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_filters[GetKey(path, table, column)] = filter;
+    return filter;
+}
+
+void ExistenceFilter::Unregister(const std::string &path,
+                                 const std::string &table,
+                                 const std::string &column)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_filters.erase(GetKey(path, table, column));
+}
+
+std::shared_ptr<ExistenceFilter>
+ExistenceFilter::Get(const std::string &path,
+                     const std::string &table,
+                     const std::string &column)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_filters.find(GetKey(path, table, column));
+    if (iter == s_filters.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::list<std::string> ExistenceFilter::GetSidecarPaths(const std::string &path)
+{
+    std::list<std::string> paths;
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    for (const auto &iter : s_filters) {
+        if (iter.second->path == path) {
+            paths.push_back(iter.second->getSidecarPath());
+        }
+    }
+    return paths;
+}
+
+std::string ExistenceFilter::GetKey(const std::string &path,
+                                    const std::string &table,
+                                    const std::string &column)
+{
+    return path + "\n" + table + "\n" + column;
+}
+
+ExistenceFilter::ExistenceFilter(const std::string &thePath,
+                                 const std::string &theTable,
+                                 const std::string &theColumn,
+                                 size_t expectedCount,
+                                 double falsePositiveRate)
+    : path(thePath)
+    , table(theTable)
+    , column(theColumn)
+    , m_expectedCount(expectedCount)
+    , m_falsePositiveRate(falsePositiveRate)
+    , m_state(State::Unbuilt)
+    , m_stale(false)
+    , m_filter(new BloomFilter(expectedCount, falsePositiveRate))
+    , m_building(nullptr)
+    , m_rebuilding(false)
+    , m_buildingAdds(0)
+    , m_expected({-1, 0, 0})
+    , m_lookups(0)
+    , m_definiteMisses(0)
+    , m_builds(0)
+    , m_lastBuildCost(0)
+{
+}
+
+std::string ExistenceFilter::getName() const
+{
+    return "wcdb_existence_filter_" + table + "_" + column;
+}
+
+std::string ExistenceFilter::getLocalStampName() const
+{
+    return getName() + "#" + std::to_string(getpid());
+}
+
+std::string ExistenceFilter::getSidecarPath() const
+{
+    return path + "-filter-" + table + "-" + column;
+}
+
+ExistenceFilter::State ExistenceFilter::getState() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_state;
+}
+
+bool ExistenceFilter::shouldBuild()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    switch (m_state) {
+        case State::Unbuilt:
+            m_state = State::Building;
+            return true;
+        case State::Ready:
+            //Too many values make the false positive rate grow
+            if (!m_rebuilding &&
+                (m_stale || m_filter->getAddedCount() >
+                                2 * m_filter->getExpectedCount())) {
+                m_rebuilding = true;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+void ExistenceFilter::invalidate()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_state = State::Invalid;
+    m_building = nullptr;
+}
+
+void ExistenceFilter::expire()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_stale = true;
+}
+
+void ExistenceFilter::AddTo(BloomFilter &filter,
+                            ColumnType type,
+                            const void *data,
+                            int size)
+{
+    if (type == ColumnType::Null) {
+        return;
+    }
+    //Values of different types never equal
+    std::string key(1, (char) type);
+    key.append((const char *) data, size);
+    filter.add(key.data(), key.size());
+}
+
+void ExistenceFilter::add(ColumnType type, const void *data, int size)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_state != State::Invalid) {
+        AddTo(*m_filter.get(), type, data, size);
+        if (m_building) {
+            AddTo(*m_building.get(), type, data, size);
+            ++m_buildingAdds;
+        }
+    }
+}
+
+bool ExistenceFilter::mayExist(ColumnType type, const void *data, int size)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_state != State::Ready || m_stale || type == ColumnType::Null) {
+        return true;
+    }
+    ++m_lookups;
+    std::string key(1, (char) type);
+    key.append((const char *) data, size);
+    if (m_filter->mayContain(key.data(), key.size())) {
+        return true;
+    }
+    ++m_definiteMisses;
+    return false;
+}
+
+void ExistenceFilter::beginBuild()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    size_t expectedCount = m_expectedCount;
+    if (m_rebuilding && m_filter->getAddedCount() > expectedCount) {
+        expectedCount = m_filter->getAddedCount();
+    }
+    m_building.reset(new BloomFilter(expectedCount, m_falsePositiveRate));
+    m_buildingAdds = 0;
+}
+
+void ExistenceFilter::addBuilt(ColumnType type, const void *data, int size)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_building) {
+        AddTo(*m_building.get(), type, data, size);
+    }
+}
+
+void ExistenceFilter::endBuild(bool succeed, double cost)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_state == State::Invalid) {
+        return;
+    }
+    if (succeed && m_building) {
+        m_filter = std::move(m_building);
+        m_state = State::Ready;
+        m_stale = false;
+        ++m_builds;
+        m_lastBuildCost = cost;
+    } else if (m_state == State::Building) {
+        m_state = State::Unbuilt;
+    }
+    m_building = nullptr;
+    m_rebuilding = false;
+}
+
+void ExistenceFilter::expect(const Stamp &stamp)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_expected = stamp;
+}
+
+bool ExistenceFilter::isExpected(const Stamp &stamp) const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    //Writes of this process bump both in a same transaction, so only those of
+    //other processes or schema change make it differ
+    return stamp.generation >= 0 &&
+           stamp.generation - stamp.local ==
+               m_expected.generation - m_expected.local &&
+           stamp.schemaVersion == m_expected.schemaVersion;
+}
+
+//Layout: magic(8) generation(8) schemaVersion(8) filter
+bool ExistenceFilter::load(const Stamp &stamp)
+{
+    if (stamp.generation < 0) {
+        return false;
+    }
+    const std::string sidecarPath = getSidecarPath();
+    FILE *file = fopen(sidecarPath.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::string data;
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, size);
+    }
+    fclose(file);
+
+    Stamp saved;
+    const size_t headerSize = sizeof(s_sidecarMagic) +
+                              sizeof(saved.generation) +
+                              sizeof(saved.schemaVersion);
+    if (data.size() < headerSize ||
+        memcmp(data.data(), s_sidecarMagic, sizeof(s_sidecarMagic)) != 0) {
+        return false;
+    }
+    memcpy(&saved.generation, data.data() + sizeof(s_sidecarMagic),
+           sizeof(saved.generation));
+    memcpy(&saved.schemaVersion,
+           data.data() + sizeof(s_sidecarMagic) + sizeof(saved.generation),
+           sizeof(saved.schemaVersion));
+    std::unique_ptr<BloomFilter> filter(
+        new BloomFilter(m_expectedCount, m_falsePositiveRate));
+    size_t bitCount = filter->getBitCount();
+    if (saved.generation != stamp.generation ||
+        saved.schemaVersion != stamp.schemaVersion ||
+        !filter->deserialize(data.substr(headerSize)) ||
+        filter->getBitCount() < bitCount) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    //Values added since the build began would be lost
+    if (!m_building || m_buildingAdds > 0) {
+        return false;
+    }
+    m_building = std::move(filter);
+    return true;
+}
+
+bool ExistenceFilter::save(const Stamp &stamp)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_state != State::Ready || stamp.generation < 0) {
+        return false;
+    }
+    const std::string sidecarPath = getSidecarPath();
+    const std::string tempPath = sidecarPath + "-temp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::string data = m_filter->serialize();
+    bool result =
+        fwrite(s_sidecarMagic, sizeof(s_sidecarMagic), 1, file) == 1 &&
+        fwrite(&stamp.generation, sizeof(stamp.generation), 1, file) == 1 &&
+        fwrite(&stamp.schemaVersion, sizeof(stamp.schemaVersion), 1, file) ==
+            1 &&
+        fwrite(data.data(), data.size(), 1, file) == 1;
+    result = fclose(file) == 0 && result;
+    if (result && rename(tempPath.c_str(), sidecarPath.c_str()) == 0) {
+        return true;
+    }
+    Error innerError;
+    File::removeFile(tempPath, innerError);
+    return false;
+}
+
+ExistenceFilter::Statistics ExistenceFilter::getStatistics() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Statistics statistics;
+    statistics.bitCount = m_filter->getBitCount();
+    statistics.hashCount = m_filter->getHashCount();
+    statistics.memorySize = m_filter->getMemorySize();
+    statistics.addedCount = m_filter->getAddedCount();
+    statistics.lookups = m_lookups;
+    statistics.definiteMisses = m_definiteMisses;
+    statistics.builds = m_builds;
+    statistics.lastBuildCost = m_lastBuildCost;
+    return statistics;
+}
+
+} //namespace WCDB
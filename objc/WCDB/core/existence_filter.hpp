@@ -0,0 +1,153 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef existence_filter_hpp
+#define existence_filter_hpp
+
+#include <WCDB/bloom_filter.hpp>
+#include <WCDB/column_type.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [ExistenceFilter] answers whether a value may exist in a column.
+ * It's fed by a TEMP trigger on each handle of the database, so that only writes through this process are observed.
+ * Writes of other processes are told by the stamp of database, which makes it stale and answer may exist until rebuilt.
+ * It's never wrong for a value that exists, but may be for one that doesn't, with the configured false positive rate.
+ * Its sidecar is only trusted when the generation kept by persistent triggers matches, so writes of any process make it stale.
+ */
+class ExistenceFilter {
+public:
+    static std::shared_ptr<ExistenceFilter>
+    Register(const std::string &path,
+             const std::string &table,
+             const std::string &column,
+             size_t expectedCount,
+             double falsePositiveRate);
+    static void Unregister(const std::string &path,
+                           const std::string &table,
+                           const std::string &column);
+    static std::shared_ptr<ExistenceFilter> Get(const std::string &path,
+                                                const std::string &table,
+                                                const std::string &column);
+    static std::list<std::string> GetSidecarPaths(const std::string &path);
+
+    const std::string path;
+    const std::string table;
+    const std::string column;
+
+    std::string getName() const;
+    //Name of the stamp row counting the writes of this process
+    std::string getLocalStampName() const;
+    std::string getSidecarPath() const;
+
+    enum class State : int {
+        Unbuilt,
+        Building,
+        Ready,
+        Invalid, //It will always answer may exist
+    };
+    State getState() const;
+    //Return true if it's unbuilt, or stale or overfull and should be rebuilt
+    bool shouldBuild();
+    void invalidate();
+    //It answers may exist until rebuilt
+    void expire();
+
+    void add(ColumnType type, const void *data, int size);
+    //false means it does not exist definitely
+    bool mayExist(ColumnType type, const void *data, int size);
+
+    //build
+    void beginBuild();
+    void addBuilt(ColumnType type, const void *data, int size);
+    void endBuild(bool succeed, double cost);
+
+    //persistence. [generation] is bumped by persistent triggers on every write of column, whichever process makes it.
+    //[local] is bumped by TEMP triggers in the same transaction, so that it only counts the writes of this process.
+    struct Stamp {
+        int64_t generation; //-1 means it's not persistable
+        int64_t local;
+        int64_t schemaVersion;
+    };
+    //It's expected as long as no other process writes since [expect]
+    void expect(const Stamp &stamp);
+    bool isExpected(const Stamp &stamp) const;
+    //[load] replaces the building one with the sidecar
+    bool load(const Stamp &stamp);
+    bool save(const Stamp &stamp);
+
+    struct Statistics {
+        size_t bitCount;
+        int hashCount;
+        size_t memorySize;
+        size_t addedCount;
+        uint64_t lookups;
+        uint64_t definiteMisses;
+        uint64_t builds;
+        double lastBuildCost; //in seconds
+    };
+    Statistics getStatistics() const;
+
+protected:
+    ExistenceFilter(const std::string &path,
+                    const std::string &table,
+                    const std::string &column,
+                    size_t expectedCount,
+                    double falsePositiveRate);
+    ExistenceFilter(const ExistenceFilter &) = delete;
+    ExistenceFilter &operator=(const ExistenceFilter &) = delete;
+
+    static std::string GetKey(const std::string &path,
+                              const std::string &table,
+                              const std::string &column);
+    static void
+    AddTo(BloomFilter &filter, ColumnType type, const void *data, int size);
+
+    const size_t m_expectedCount;
+    const double m_falsePositiveRate;
+
+    mutable std::mutex m_mutex;
+    State m_state;
+    bool m_stale;
+    std::unique_ptr<BloomFilter> m_filter;
+    std::unique_ptr<BloomFilter> m_building;
+    bool m_rebuilding;
+    size_t m_buildingAdds;
+    Stamp m_expected;
+
+    uint64_t m_lookups;
+    uint64_t m_definiteMisses;
+    uint64_t m_builds;
+    double m_lastBuildCost;
+
+    static std::unordered_map<std::string, std::shared_ptr<ExistenceFilter>>
+        s_filters;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* existence_filter_hpp */
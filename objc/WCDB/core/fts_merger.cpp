@@ -0,0 +1,159 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/fts_merger.hpp>
+#include <ctime>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<FTSMerger>>
+    FTSMerger::s_mergers;
+std::mutex FTSMerger::s_mutex;
+
+std::shared_ptr<FTSMerger> FTSMerger::Register(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    std::shared_ptr<FTSMerger> &merger = s_mergers[path];
+    if (!merger) {
+        merger.reset(new FTSMerger(path));
+    }
+    return merger;
+}
+
+void FTSMerger::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_mergers.erase(path);
+}
+
+std::shared_ptr<FTSMerger> FTSMerger::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_mergers.find(path);
+    if (iter == s_mergers.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+FTSMerger::FTSMerger(const std::string &thePath)
+    : path(thePath), m_activity(0)
+{
+}
+
+void FTSMerger::addTable(const std::string &table, const Config &config)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Table &entry = m_tables[table];
+    entry.config = config;
+    entry.statistics.runs = 0;
+    entry.statistics.steps = 0;
+    entry.statistics.lastMergedTime = 0;
+    //Segments may be left unmerged since last launch
+    entry.statistics.pending = true;
+}
+
+bool FTSMerger::removeTable(const std::string &table)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_tables.erase(table);
+    return m_tables.empty();
+}
+
+std::map<std::string, FTSMerger::Config> FTSMerger::getTables() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    std::map<std::string, Config> tables;
+    for (const auto &iter : m_tables) {
+        tables[iter.first] = iter.second.config;
+    }
+    return tables;
+}
+
+void FTSMerger::markDirty()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    ++m_activity;
+    //Which table is changed is unknown to commit hook
+    for (auto &iter : m_tables) {
+        iter.second.statistics.pending = true;
+    }
+}
+
+uint64_t FTSMerger::getActivity() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_activity;
+}
+
+std::list<std::string> FTSMerger::beginRun()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    std::list<std::string> tables;
+    for (auto &iter : m_tables) {
+        if (iter.second.statistics.pending) {
+            //Commits since now make it pending again
+            iter.second.statistics.pending = false;
+            tables.push_back(iter.first);
+        }
+    }
+    return tables;
+}
+
+void FTSMerger::endRun(const std::string &table, int steps, bool finished)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    auto iter = m_tables.find(table);
+    if (iter == m_tables.end()) {
+        return;
+    }
+    Statistics &statistics = iter->second.statistics;
+    ++statistics.runs;
+    statistics.steps += steps;
+    if (steps > 0) {
+        statistics.lastMergedTime = (int64_t) time(nullptr);
+    }
+    if (!finished) {
+        statistics.pending = true;
+    }
+}
+
+bool FTSMerger::isPending() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    for (const auto &iter : m_tables) {
+        if (iter.second.statistics.pending) {
+            return true;
+        }
+    }
+    return false;
+}
+
+FTSMerger::Statistics FTSMerger::getStatistics(const std::string &table) const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    auto iter = m_tables.find(table);
+    if (iter == m_tables.end()) {
+        return {0, 0, 0, false};
+    }
+    return iter->second.statistics;
+}
+
+} //namespace WCDB
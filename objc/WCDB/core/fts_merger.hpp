@@ -0,0 +1,96 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef fts_merger_hpp
+#define fts_merger_hpp
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [FTSMerger] takes over the segment merging of FTS3/4 tables of a database.
+ * Inline automerge is disabled and the segments are merged incrementally in background once the database is idle.
+ */
+class FTSMerger {
+public:
+    static std::shared_ptr<FTSMerger> Register(const std::string &path);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<FTSMerger> Get(const std::string &path);
+
+    const std::string path;
+
+    struct Config {
+        //Pages merged by each step, which is the [X] of 'merge=X,Y'
+        int pagesPerStep;
+        //Minimum segments of a level to merge, the [Y] of 'merge=X,Y'
+        int minSegments;
+        //Pages merged in one run at most. Runs are resumed after idle again.
+        int pageBudget;
+    };
+    void addTable(const std::string &table, const Config &config);
+    //Return true if no table is left
+    bool removeTable(const std::string &table);
+    std::map<std::string, Config> getTables() const;
+
+    void markDirty();
+    //Incremented by each commit but those of merging, which tells whether
+    //database is still idle
+    uint64_t getActivity() const;
+    //Return the tables to be merged
+    std::list<std::string> beginRun();
+    void endRun(const std::string &table, int steps, bool finished);
+    bool isPending() const;
+
+    struct Statistics {
+        uint64_t runs;
+        uint64_t steps;
+        int64_t lastMergedTime; //unix time, 0 if never
+        bool pending;
+    };
+    Statistics getStatistics(const std::string &table) const;
+
+protected:
+    FTSMerger(const std::string &path);
+    FTSMerger(const FTSMerger &) = delete;
+    FTSMerger &operator=(const FTSMerger &) = delete;
+
+    struct Table {
+        Config config;
+        Statistics statistics;
+    };
+    mutable std::mutex m_mutex;
+    std::map<std::string, Table> m_tables;
+    uint64_t m_activity;
+
+    static std::unordered_map<std::string, std::shared_ptr<FTSMerger>>
+        s_mergers;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* fts_merger_hpp */
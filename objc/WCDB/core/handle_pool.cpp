@@ -31,6 +31,7 @@ std::mutex HandlePool::s_mutex;
 const int HandlePool::s_hardwareConcurrency =
     std::thread::hardware_concurrency();
 const int HandlePool::s_maxConcurrency = 64;
+const std::chrono::seconds HandlePool::s_shrinkInterval(1);
 
 RecyclableHandlePool HandlePool::GetPool(const std::string &path,
                                          const Configs &defaultConfigs)
@@ -90,12 +91,39 @@ void HandlePool::PurgeFreeHandlesInAllPool()
     }
 }
 
+std::map<std::string, HandlePool::MemorySnapshot>
+HandlePool::GetMemorySnapshotsInAllPool()
+{
+    std::list<std::shared_ptr<HandlePool>> handlePools;
+    {
+        std::lock_guard<std::mutex> lockGuard(s_mutex);
+        for (const auto &iter : s_pools) {
+            handlePools.push_back(iter.second.first);
+        }
+    }
+    std::map<std::string, MemorySnapshot> snapshots;
+    for (const auto &handlePool : handlePools) {
+        snapshots[handlePool->path] = handlePool->getMemorySnapshot();
+    }
+    return snapshots;
+}
+
 HandlePool::HandlePool(const std::string &thePath, const Configs &configs)
     : path(thePath)
     , tag(InvalidTag)
     , m_configs(configs)
+    , m_maxSuspiciousErrors(HealthConfig().maxSuspiciousErrors)
+    , m_idleValidationInterval(HealthConfig().idleValidationInterval)
+    , m_validations(0)
+    , m_replacements(0)
+    , m_statisticsGeneration(0)
     , m_handles(s_hardwareConcurrency)
     , m_aliveHandleCount(0)
+    , m_memoryBudget(0)
+    , m_shrinking(false)
+    , m_shrinks(0)
+    , m_lastShrink(std::chrono::steady_clock::now() - s_shrinkInterval)
+    , m_exceeded(false)
 {
 }
 
@@ -133,6 +161,153 @@ void HandlePool::purgeFreeHandles()
     m_rwlock.unlockRead();
 }
 
+void HandlePool::reloadStatistics()
+{
+    m_rwlock.lockRead();
+    ++m_statisticsGeneration;
+    //Reloading doesn't wait for the write lock, so that it's short enough to
+    //be done in place
+    m_handles.forEach([this](const std::shared_ptr<HandleWrap> &handleWrap) {
+        reloadStatisticsIfStale(handleWrap);
+    });
+    m_rwlock.unlockRead();
+}
+
+void HandlePool::reloadStatisticsIfStale(
+    const std::shared_ptr<HandleWrap> &handleWrap)
+{
+    int generation = m_statisticsGeneration.load();
+    if (handleWrap->statisticsGeneration != generation &&
+        handleWrap->handle->reloadStatistics()) {
+        handleWrap->statisticsGeneration = generation;
+    }
+}
+
+HandlePool::Statistics HandlePool::getStatistics() const
+{
+    return {m_aliveHandleCount.load(), (int) m_handles.size(),
+            m_validations.load(), m_replacements.load()};
+}
+
+void HandlePool::setHealthConfig(const HealthConfig &config)
+{
+    m_maxSuspiciousErrors.store(config.maxSuspiciousErrors);
+    m_idleValidationInterval.store(config.idleValidationInterval);
+}
+
+bool HandlePool::isHealthy(const std::shared_ptr<HandleWrap> &handleWrap)
+{
+    int suspicious = handleWrap->handle->getErrorHistory().suspicious;
+    int newSuspicious = suspicious - handleWrap->seenSuspicious;
+    handleWrap->seenSuspicious = suspicious;
+    if (newSuspicious > 0) {
+        handleWrap->suspicious += newSuspicious;
+    } else if (handleWrap->suspicious > 0) {
+        --handleWrap->suspicious;
+    }
+    int maxSuspiciousErrors = m_maxSuspiciousErrors.load();
+    return maxSuspiciousErrors <= 0 ||
+           handleWrap->suspicious < maxSuspiciousErrors;
+}
+
+bool HandlePool::validateIfIdle(const std::shared_ptr<HandleWrap> &handleWrap)
+{
+    int interval = m_idleValidationInterval.load();
+    if (interval <= 0 || std::chrono::steady_clock::now() -
+                                 handleWrap->lastUsed <
+                             std::chrono::seconds(interval)) {
+        return true;
+    }
+    ++m_validations;
+    //A new one is cheaper than telling whether the failure is transient
+    return handleWrap->handle->validate();
+}
+
+void HandlePool::quarantine(const std::shared_ptr<HandleWrap> &handleWrap)
+{
+    //It's closed once released, and a new one is generated on demand
+    ++m_replacements;
+    const Handle::ErrorHistory &history = handleWrap->handle->getErrorHistory();
+    Error::Warning(("A handle of database:" + std::to_string(tag.load()) +
+                    " is replaced after " + std::to_string(history.errors) +
+                    " errors, the last code is " +
+                    std::to_string(history.lastCode))
+                       .c_str());
+}
+
+HandlePool::MemorySnapshot HandlePool::getMemorySnapshot()
+{
+    MemorySnapshot snapshot;
+    snapshot.budget = m_memoryBudget.load();
+    snapshot.shrinks = m_shrinks.load();
+    m_handles.forEach([this](const std::shared_ptr<HandleWrap> &handleWrap) {
+        Handle::MemoryStatus memoryStatus =
+            handleWrap->handle->getMemoryStatus();
+        SpinLockGuard<Spin> lockGuard(m_memorySpin);
+        handleWrap->memoryStatus = memoryStatus;
+    });
+    SpinLockGuard<Spin> lockGuard(m_memorySpin);
+    for (auto iter = m_trackedHandles.begin();
+         iter != m_trackedHandles.end();) {
+        std::shared_ptr<HandleWrap> handleWrap = iter->lock();
+        if (handleWrap) {
+            snapshot.total += handleWrap->memoryStatus;
+            snapshot.handles.push_back(handleWrap->memoryStatus);
+            ++iter;
+        } else {
+            iter = m_trackedHandles.erase(iter);
+        }
+    }
+    return snapshot;
+}
+
+void HandlePool::setMemoryBudget(int64_t budget)
+{
+    m_memoryBudget.store(budget);
+}
+
+void HandlePool::shrinkMemoryIfExceeded()
+{
+    int64_t budget = m_memoryBudget.load();
+    if (budget <= 0 || m_shrinking.exchange(true)) {
+        return;
+    }
+    //Caches refill soon after shrinking, so it's done at most once per interval
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (now < m_lastShrink + s_shrinkInterval) {
+        m_shrinking.store(false);
+        return;
+    }
+    if (getMemorySnapshot().total.getBytes() <= budget) {
+        m_exceeded = false;
+        m_shrinking.store(false);
+        return;
+    }
+    //Handles in use are left alone. Free ones are shrunk in place, so that
+    //they are neither missed by flowOut nor reordered meanwhile.
+    m_handles.forEach([this](const std::shared_ptr<HandleWrap> &handleWrap) {
+        handleWrap->handle->shrinkMemory();
+        Handle::MemoryStatus memoryStatus =
+            handleWrap->handle->getMemoryStatus();
+        SpinLockGuard<Spin> lockGuard(m_memorySpin);
+        handleWrap->memoryStatus = memoryStatus;
+    });
+    ++m_shrinks;
+    m_lastShrink = now;
+    bool exceeded = getMemorySnapshot().total.getBytes() > budget;
+    //Warn once until it's back under the budget
+    bool warn = exceeded && !m_exceeded;
+    m_exceeded = exceeded;
+    m_shrinking.store(false);
+    if (warn) {
+        Error::Warning(("The memory of database:" +
+                        std::to_string(tag.load()) +
+                        " still exceeds the budget after shrinking")
+                           .c_str());
+    }
+}
+
 bool HandlePool::isDrained()
 {
     return m_aliveHandleCount == 0;
@@ -142,6 +317,14 @@ RecyclableHandle HandlePool::flowOut(Error &error)
 {
     m_rwlock.lockRead();
     std::shared_ptr<HandleWrap> handleWrap = m_handles.popBack();
+    if (handleWrap && !validateIfIdle(handleWrap)) {
+        quarantine(handleWrap);
+        --m_aliveHandleCount;
+        handleWrap = nullptr;
+    }
+    if (handleWrap) {
+        reloadStatisticsIfStale(handleWrap);
+    }
     if (handleWrap == nullptr) {
         if (m_aliveHandleCount < s_maxConcurrency) {
             handleWrap = generate(error);
@@ -183,7 +366,21 @@ RecyclableHandle HandlePool::flowOut(Error &error)
 void HandlePool::flowBack(const std::shared_ptr<HandleWrap> &handleWrap)
 {
     if (handleWrap) {
-        bool inserted = m_handles.pushBack(handleWrap);
+        handleWrap->handle->resetCancellation();
+        handleWrap->handle->resetSortBudget();
+        if (handleWrap->handle->isInTransaction()) {
+            //e.g. a transaction interrupted without rollback
+            handleWrap->handle->exec(StatementTransaction().rollback());
+        }
+        handleWrap->handle->flushSession();
+        handleWrap->lastUsed = std::chrono::steady_clock::now();
+        bool healthy = isHealthy(handleWrap);
+        if (!healthy) {
+            quarantine(handleWrap);
+        }
+        bool inserted = healthy && m_handles.pushBack(handleWrap);
+        //Free handles are shrunk before the pool may be drained
+        shrinkMemoryIfExceeded();
         m_rwlock.unlockRead();
         if (!inserted) {
             --m_aliveHandleCount;
@@ -197,13 +394,20 @@ std::shared_ptr<HandleWrap> HandlePool::generate(Error &error)
     handle->setTag(tag.load());
     Configs defaultConfigs =
         m_configs; //cache config to avoid multi-thread assigning
+    //Statistics are loaded along with the schema, which is later than now
+    int statisticsGeneration = m_statisticsGeneration.load();
     if (!handle->open()) {
         error = handle->getError();
         return nullptr;
     }
     if (defaultConfigs.invoke(handle, error)) {
-        return std::shared_ptr<HandleWrap>(
+        std::shared_ptr<HandleWrap> handleWrap(
             new HandleWrap(handle, defaultConfigs));
+        handleWrap->statisticsGeneration = statisticsGeneration;
+        handleWrap->memoryStatus = handle->getMemoryStatus();
+        SpinLockGuard<Spin> lockGuard(m_memorySpin);
+        m_trackedHandles.push_back(handleWrap);
+        return handleWrap;
     }
     return nullptr;
 }
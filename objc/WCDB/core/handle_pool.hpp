@@ -28,7 +28,9 @@
 #include <WCDB/handle_recyclable.hpp>
 #include <WCDB/recyclable.hpp>
 #include <WCDB/rwlock.hpp>
+#include <WCDB/spin.hpp>
 #include <WCDB/utility.hpp>
+#include <map>
 #include <unordered_map>
 
 namespace WCDB {
@@ -43,6 +45,17 @@ public:
     static RecyclableHandlePool GetPool(Tag tag);
     static void PurgeFreeHandlesInAllPool();
 
+    struct MemorySnapshot {
+        Handle::MemoryStatus total;
+        //Free handles are sampled when it's taken. Handles in use can't be
+        //sampled by other threads, which are counted with their last status.
+        std::list<Handle::MemoryStatus> handles;
+        int64_t budget = 0;
+        int shrinks = 0;
+    };
+    //path->snapshot
+    static std::map<std::string, MemorySnapshot> GetMemorySnapshotsInAllPool();
+
 protected:
     static std::unordered_map<std::string,
                               std::pair<std::shared_ptr<HandlePool>, int>>
@@ -64,6 +77,34 @@ public:
     bool isBlockaded() const;
 
     void purgeFreeHandles();
+    //Handles reload the statistics of sqlite_stat1, e.g. after ANALYZE by
+    //other handles. Free ones do it now, and the others or the ones failed
+    //do it before their next use.
+    void reloadStatistics();
+
+    struct Statistics {
+        int aliveHandles; //free ones and the ones in use
+        int freeHandles;
+        int validatedHandles;
+        int replacedHandles;
+    };
+    Statistics getStatistics() const;
+
+    struct HealthConfig {
+        //Handles are replaced once their suspicious errors reach it. Each use
+        //without a new one forgives one of them, so that sporadic ones don't
+        //add up. 0 to never replace, which is the default.
+        int maxSuspiciousErrors = 0;
+        //Free handles idled longer are validated before reused, in seconds.
+        //The ones failing it are replaced. 0 to never validate, which is the
+        //default.
+        int idleValidationInterval = 0;
+    };
+    void setHealthConfig(const HealthConfig &config);
+
+    MemorySnapshot getMemorySnapshot();
+    //Caches of free handles are shrunk once [budget] is exceeded. 0 for none.
+    void setMemoryBudget(int64_t budget);
 
     void setConfig(const std::string &name,
                    const Config &config,
@@ -84,10 +125,32 @@ protected:
 
     void flowBack(const std::shared_ptr<HandleWrap> &handleWrap);
 
+    //It's called once per use, which counts the new suspicious errors
+    bool isHealthy(const std::shared_ptr<HandleWrap> &handleWrap);
+    bool validateIfIdle(const std::shared_ptr<HandleWrap> &handleWrap);
+    void reloadStatisticsIfStale(const std::shared_ptr<HandleWrap> &handleWrap);
+    std::atomic<int> m_statisticsGeneration;
+    void quarantine(const std::shared_ptr<HandleWrap> &handleWrap);
+    std::atomic<int> m_maxSuspiciousErrors;
+    std::atomic<int> m_idleValidationInterval;
+    std::atomic<int> m_validations;
+    std::atomic<int> m_replacements;
+
     ConcurrentList<HandleWrap> m_handles;
     std::atomic<int> m_aliveHandleCount;
+
+    void shrinkMemoryIfExceeded();
+    Spin m_memorySpin;
+    std::list<std::weak_ptr<HandleWrap>> m_trackedHandles;
+    std::atomic<int64_t> m_memoryBudget;
+    std::atomic<bool> m_shrinking;
+    std::atomic<int> m_shrinks;
+    //Following are guarded by m_shrinking
+    std::chrono::steady_clock::time_point m_lastShrink;
+    bool m_exceeded;
     static const int s_hardwareConcurrency;
     static const int s_maxConcurrency;
+    static const std::chrono::seconds s_shrinkInterval;
 };
 
 } //namespace WCDB
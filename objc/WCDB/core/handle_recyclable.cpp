@@ -24,7 +24,12 @@ namespace WCDB {
 
 HandleWrap::HandleWrap(const std::shared_ptr<Handle> &theSqlBase,
                        const Configs &theConfigs)
-    : handle(theSqlBase), configs(theConfigs)
+    : handle(theSqlBase)
+    , configs(theConfigs)
+    , lastUsed(std::chrono::steady_clock::now())
+    , suspicious(0)
+    , seenSuspicious(0)
+    , statisticsGeneration(0)
 {
 }
 
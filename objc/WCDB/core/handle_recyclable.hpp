@@ -23,7 +23,9 @@
 
 #include <WCDB/abstract.h>
 #include <WCDB/config.hpp>
+#include <WCDB/handle.hpp>
 #include <WCDB/recyclable.hpp>
+#include <chrono>
 #include <memory>
 
 namespace WCDB {
@@ -32,10 +34,18 @@ class HandleWrap {
 public:
     HandleWrap(const std::shared_ptr<Handle> &handle, const Configs &configs);
 
-    constexpr Handle *operator->() const { return handle.get(); }
+    Handle *operator->() const { return handle.get(); }
 
     std::shared_ptr<Handle> handle;
     Configs configs;
+    //Sampled while it's free, by memory snapshot and shrinking of pool
+    Handle::MemoryStatus memoryStatus;
+    std::chrono::steady_clock::time_point lastUsed;
+    //Suspicious errors not forgiven yet, and the ones in error history seen by pool
+    int suspicious;
+    int seenSuspicious;
+    //Statistics of the pool it has loaded
+    int statisticsGeneration;
 };
 
 class RecyclableHandle {
@@ -43,7 +53,7 @@ public:
     RecyclableHandle(
         const std::shared_ptr<HandleWrap> &value,
         const Recyclable<std::shared_ptr<HandleWrap>>::OnRecycled &onRecycled);
-    constexpr Handle *operator->() const { return m_value->operator->(); }
+    Handle *operator->() const { return m_value->operator->(); }
     operator bool() const;
     bool operator!=(const std::nullptr_t &) const;
     bool operator==(const std::nullptr_t &) const;
@@ -0,0 +1,327 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/maintained_aggregate.hpp>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<const MaintainedAggregate>>
+    MaintainedAggregate::s_aggregates;
+std::mutex MaintainedAggregate::s_mutex;
+
+const Column MaintainedAggregate::s_groupKey("groupKey");
+const Column MaintainedAggregate::s_rowCount("rowCount");
+
+std::shared_ptr<const MaintainedAggregate>
+MaintainedAggregate::Register(const std::string &path,
+                              const std::string &table,
+                              const std::string &groupColumn,
+                              const std::list<std::string> &sumColumns)
+{
+    std::shared_ptr<const MaintainedAggregate> aggregate(
+        new MaintainedAggregate(path, table, groupColumn, sumColumns));
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_aggregates[GetKey(path, table, groupColumn)] = aggregate;
+    return aggregate;
+}
+
+void MaintainedAggregate::Unregister(const std::string &path,
+                                     const std::string &table,
+                                     const std::string &groupColumn)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_aggregates.erase(GetKey(path, table, groupColumn));
+}
+
+std::shared_ptr<const MaintainedAggregate>
+MaintainedAggregate::Get(const std::string &path,
+                         const std::string &table,
+                         const std::string &groupColumn)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_aggregates.find(GetKey(path, table, groupColumn));
+    if (iter == s_aggregates.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::list<std::shared_ptr<const MaintainedAggregate>>
+MaintainedAggregate::GetAll(const std::string &path)
+{
+    std::list<std::shared_ptr<const MaintainedAggregate>> aggregates;
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    for (const auto &iter : s_aggregates) {
+        if (iter.second->path == path) {
+            aggregates.push_back(iter.second);
+        }
+    }
+    return aggregates;
+}
+
+std::string MaintainedAggregate::GetKey(const std::string &path,
+                                        const std::string &table,
+                                        const std::string &groupColumn)
+{
+    return path + "\n" + table + "\n" + groupColumn;
+}
+
+MaintainedAggregate::MaintainedAggregate(
+    const std::string &thePath,
+    const std::string &theTable,
+    const std::string &theGroupColumn,
+    const std::list<std::string> &theSumColumns)
+    : path(thePath)
+    , table(theTable)
+    , groupColumn(theGroupColumn)
+    , sumColumns(theSumColumns)
+{
+}
+
+std::string MaintainedAggregate::getName() const
+{
+    return "wcdb_aggregate_" + table + "_" + groupColumn;
+}
+
+Column MaintainedAggregate::SumColumn(const std::string &column)
+{
+    return Column("sum_" + column);
+}
+
+StatementCreateTable MaintainedAggregate::getCreateTableStatement() const
+{
+    //BLOB affinity keeps the group value as it's stored in base table
+    std::list<const ColumnDef> columnDefs = {
+        ColumnDef(s_groupKey, ColumnType::BLOB).makePrimary(),
+        ColumnDef(s_rowCount, ColumnType::Integer64)
+            .makeNotNull()
+            .makeDefault(0),
+    };
+    for (const std::string &sumColumn : sumColumns) {
+        columnDefs.push_back(ColumnDef(SumColumn(sumColumn),
+                                       ColumnType::Integer64)
+                                 .makeNotNull()
+                                 .makeDefault(0));
+    }
+    return StatementCreateTable().create(getName(), columnDefs);
+}
+
+StatementDropTable MaintainedAggregate::getDropTableStatement() const
+{
+    return StatementDropTable().drop(getName());
+}
+
+StatementInsert
+MaintainedAggregate::getEnsureStatement(const std::string &row) const
+{
+    Expr group = Column(groupColumn).inTable(row);
+    return StatementInsert()
+        .insert(getName(), {s_groupKey}, Conflict::Ignore)
+        .values(StatementSelect()
+                    .select({ColumnResult(group)})
+                    .where(group.isNotNull()));
+}
+
+StatementUpdate
+MaintainedAggregate::getAccumulateStatement(const std::string &row,
+                                            bool increase) const
+{
+    std::list<const std::pair<const Column, const Expr>> values;
+    Expr one(1);
+    values.push_back({s_rowCount, increase ? Expr(s_rowCount) + one
+                                           : Expr(s_rowCount) - one});
+    for (const std::string &sumColumn : sumColumns) {
+        Column column = SumColumn(sumColumn);
+        Expr value = Expr::Function(
+            "coalesce", ExprList({Column(sumColumn).inTable(row), Expr(0)}));
+        values.push_back(
+            {column, increase ? Expr(column) + value : Expr(column) - value});
+    }
+    return StatementUpdate()
+        .update(getName())
+        .set(values)
+        .where(Expr(s_groupKey) == Column(groupColumn).inTable(row));
+}
+
+StatementDelete
+MaintainedAggregate::getCleanStatement(const std::string &row) const
+{
+    return StatementDelete().deleteFrom(getName()).where(
+        Expr(s_groupKey) == Column(groupColumn).inTable(row) &&
+        Expr(s_rowCount) <= 0);
+}
+
+std::list<StatementCreateTrigger>
+MaintainedAggregate::getCreateTriggerStatements() const
+{
+    const std::string name = getName();
+    std::list<const Column> columns = {Column(groupColumn)};
+    for (const std::string &sumColumn : sumColumns) {
+        columns.push_back(Column(sumColumn));
+    }
+    return {
+        StatementCreateTrigger()
+            .create(name + "_insert")
+            .after(StatementCreateTrigger::Event::Insert)
+            .on(table)
+            .execute(getEnsureStatement("NEW"))
+            .execute(getAccumulateStatement("NEW", true)),
+        StatementCreateTrigger()
+            .create(name + "_delete")
+            .after(StatementCreateTrigger::Event::Delete)
+            .on(table)
+            .execute(getAccumulateStatement("OLD", false))
+            .execute(getCleanStatement("OLD")),
+        StatementCreateTrigger()
+            .create(name + "_update")
+            .after(StatementCreateTrigger::Event::Update)
+            .of(columns)
+            .on(table)
+            .execute(getAccumulateStatement("OLD", false))
+            .execute(getCleanStatement("OLD"))
+            .execute(getEnsureStatement("NEW"))
+            .execute(getAccumulateStatement("NEW", true)),
+    };
+}
+
+std::list<StatementDropTrigger>
+MaintainedAggregate::getDropTriggerStatements() const
+{
+    const std::string name = getName();
+    return {
+        StatementDropTrigger().drop(name + "_insert"),
+        StatementDropTrigger().drop(name + "_delete"),
+        StatementDropTrigger().drop(name + "_update"),
+    };
+}
+
+StatementDelete MaintainedAggregate::getClearStatement() const
+{
+    return StatementDelete().deleteFrom(getName());
+}
+
+StatementInsert MaintainedAggregate::getRebuildStatement() const
+{
+    std::list<const Column> columns = {s_groupKey, s_rowCount};
+    std::list<const ColumnResult> results = {
+        ColumnResult(Expr(Column(groupColumn))),
+        ColumnResult(Expr(Column::Any).count()),
+    };
+    for (const std::string &sumColumn : sumColumns) {
+        columns.push_back(SumColumn(sumColumn));
+        results.push_back(ColumnResult(Expr::Function(
+            "coalesce", ExprList({Expr(Column(sumColumn)).sum(), Expr(0)}))));
+    }
+    return StatementInsert()
+        .insert(getName(), columns)
+        .values(StatementSelect()
+                    .select(results)
+                    .from(table)
+                    .where(Expr(Column(groupColumn)).isNotNull())
+                    .groupBy({Expr(Column(groupColumn))}));
+}
+
+StatementSelect MaintainedAggregate::getSelectStatement() const
+{
+    std::list<const ColumnResult> results = {ColumnResult(Expr(s_rowCount))};
+    for (const std::string &sumColumn : sumColumns) {
+        results.push_back(ColumnResult(Expr(SumColumn(sumColumn))));
+    }
+    return StatementSelect()
+        .select(results)
+        .from(getName())
+        .where(Expr(s_groupKey) == Expr::BindParameter);
+}
+
+StatementSelect MaintainedAggregate::getBaseTotalStatement() const
+{
+    Expr group = Column(groupColumn);
+    std::list<const ColumnResult> results = {
+        ColumnResult(group.count(true)), ColumnResult(group.count()),
+    };
+    for (const std::string &sumColumn : sumColumns) {
+        results.push_back(ColumnResult(Expr::Function(
+            "coalesce", ExprList({Expr(Column(sumColumn)).sum(), Expr(0)}))));
+    }
+    return StatementSelect().select(results).from(table).where(
+        group.isNotNull());
+}
+
+StatementSelect MaintainedAggregate::getSideTotalStatement() const
+{
+    std::list<const ColumnResult> results = {
+        ColumnResult(Expr(Column::Any).count()),
+        ColumnResult(Expr::Function(
+            "coalesce", ExprList({Expr(s_rowCount).sum(), Expr(0)}))),
+    };
+    for (const std::string &sumColumn : sumColumns) {
+        results.push_back(ColumnResult(Expr::Function(
+            "coalesce",
+            ExprList({Expr(SumColumn(sumColumn)).sum(), Expr(0)}))));
+    }
+    return StatementSelect().select(results).from(getName());
+}
+
+StatementSelect MaintainedAggregate::getMismatchStatement() const
+{
+    //Fresh aggregate of base table, in the same shape as the side table
+    std::list<const ColumnResult> results = {
+        ColumnResult(Expr(Column(groupColumn))).as(s_groupKey.getName()),
+        ColumnResult(Expr(Column::Any).count()).as(s_rowCount.getName()),
+    };
+    for (const std::string &sumColumn : sumColumns) {
+        results.push_back(
+            ColumnResult(Expr::Function("coalesce",
+                                        ExprList({Expr(Column(sumColumn)).sum(),
+                                                  Expr(0)})))
+                .as(SumColumn(sumColumn).getName()));
+    }
+    StatementSelect fresh = StatementSelect()
+                                .select(results)
+                                .from(table)
+                                .where(Expr(Column(groupColumn)).isNotNull())
+                                .groupBy({Expr(Column(groupColumn))});
+
+    static const std::string base("base");
+    const std::string side = getName();
+    Expr mismatch =
+        Expr(s_groupKey.inTable(side)).isNull() ||
+        Expr(s_rowCount.inTable(side)) != Expr(s_rowCount.inTable(base));
+    for (const std::string &sumColumn : sumColumns) {
+        //Sums accumulated by triggers may differ in rounding, which is
+        //tolerated up to 1e-9 of the expected one.
+        Expr expected = SumColumn(sumColumn).inTable(base);
+        Expr actual = SumColumn(sumColumn).inTable(side);
+        Expr difference = Expr::Function("abs", ExprList({actual - expected}));
+        Expr tolerance = Expr::Function(
+            "max",
+            ExprList({Expr(1), Expr::Function("abs", ExprList({expected}))}));
+        mismatch = mismatch || difference * Expr(1000000000) > tolerance;
+    }
+    return StatementSelect()
+        .select({ColumnResult(Expr(Column::Any).count())})
+        .from(JoinClause(Subquery(fresh).as(base).getDescription())
+                  .join(Subquery(side), JoinClause::Type::Left)
+                  .on(Expr(s_groupKey.inTable(side)) ==
+                      Expr(s_groupKey.inTable(base))))
+        .where(mismatch);
+}
+
+} //namespace WCDB
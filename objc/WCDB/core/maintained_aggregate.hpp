@@ -0,0 +1,111 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef maintained_aggregate_hpp
+#define maintained_aggregate_hpp
+
+#include <WCDB/abstract.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WCDB {
+
+/*
+ * [MaintainedAggregate] keeps COUNT(*) and SUM(column) of a table grouped by a column in a side table.
+ * The side table is updated by triggers, so it's always in the same transaction as the base write.
+ * Rows with NULL group are not counted.
+ */
+class MaintainedAggregate {
+public:
+    static std::shared_ptr<const MaintainedAggregate>
+    Register(const std::string &path,
+             const std::string &table,
+             const std::string &groupColumn,
+             const std::list<std::string> &sumColumns);
+    static void Unregister(const std::string &path,
+                           const std::string &table,
+                           const std::string &groupColumn);
+    static std::shared_ptr<const MaintainedAggregate>
+    Get(const std::string &path,
+        const std::string &table,
+        const std::string &groupColumn);
+    static std::list<std::shared_ptr<const MaintainedAggregate>>
+    GetAll(const std::string &path);
+
+    const std::string path;
+    const std::string table;
+    const std::string groupColumn;
+    const std::list<std::string> sumColumns;
+
+    //name of the side table
+    std::string getName() const;
+
+    struct Value {
+        int64_t count;
+        std::vector<double> sums; //same order as [sumColumns]
+    };
+
+    StatementCreateTable getCreateTableStatement() const;
+    StatementDropTable getDropTableStatement() const;
+    std::list<StatementCreateTrigger> getCreateTriggerStatements() const;
+    std::list<StatementDropTrigger> getDropTriggerStatements() const;
+    StatementDelete getClearStatement() const;
+    StatementInsert getRebuildStatement() const;
+    //Bind the group value to index 1
+    StatementSelect getSelectStatement() const;
+    //count of groups, count of rows and sums
+    StatementSelect getBaseTotalStatement() const;
+    StatementSelect getSideTotalStatement() const;
+    //Count of groups missing or differing in the side table
+    StatementSelect getMismatchStatement() const;
+
+protected:
+    MaintainedAggregate(const std::string &path,
+                        const std::string &table,
+                        const std::string &groupColumn,
+                        const std::list<std::string> &sumColumns);
+
+    static std::string GetKey(const std::string &path,
+                              const std::string &table,
+                              const std::string &groupColumn);
+
+    static const Column s_groupKey;
+    static const Column s_rowCount;
+    static Column SumColumn(const std::string &column);
+
+    //statements in trigger for a row of [row], which is NEW or OLD
+    StatementInsert getEnsureStatement(const std::string &row) const;
+    StatementUpdate getAccumulateStatement(const std::string &row,
+                                           bool increase) const;
+    StatementDelete getCleanStatement(const std::string &row) const;
+
+    static std::unordered_map<std::string,
+                              std::shared_ptr<const MaintainedAggregate>>
+        s_aggregates;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* maintained_aggregate_hpp */
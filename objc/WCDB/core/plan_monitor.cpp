@@ -0,0 +1,349 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/abstract.h>
+#include <WCDB/plan_monitor.hpp>
+#include <WCDB/statement_monitor.hpp>
+#include <cctype>
+#include <sstream>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+namespace WCDB {
+
+static const std::string s_planTableName("wcdb_plans");
+static const Column s_fingerprint("fingerprint");
+static const Column s_plan("plan");
+static const Column s_version("version");
+static const Column s_cost("cost");
+static const Column s_time("time");
+
+std::unordered_map<std::string, std::shared_ptr<PlanMonitor>>
+    PlanMonitor::s_monitors;
+std::mutex PlanMonitor::s_mutex;
+
+bool PlanMonitor::Change::isRegression() const
+{
+    return newFullScan || lostIndex || newTempBTree;
+}
+
+std::shared_ptr<PlanMonitor>
+PlanMonitor::Register(const std::string &path,
+                      const Config &config,
+                      const ChangedCallback &onChanged)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    std::shared_ptr<PlanMonitor> &monitor = s_monitors[path];
+    monitor.reset(new PlanMonitor(path, config, onChanged));
+    return monitor;
+}
+
+void PlanMonitor::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_monitors.erase(path);
+}
+
+std::shared_ptr<PlanMonitor> PlanMonitor::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_monitors.find(path);
+    if (iter == s_monitors.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::string PlanMonitor::GetPath(const std::string &path)
+{
+    return path + "-plans";
+}
+
+PlanMonitor::PlanMonitor(const std::string &thePath,
+                         const Config &config,
+                         const ChangedCallback &onChanged)
+    : path(thePath), m_config(config), m_onChanged(onChanged)
+{
+}
+
+bool PlanMonitor::IsExplainable(const char *sql)
+{
+    while (isspace((unsigned char) *sql)) {
+        ++sql;
+    }
+    static const char *s_prefixes[] = {"SELECT", "INSERT", "UPDATE",
+                                       "DELETE", "REPLACE", "WITH"};
+    for (const char *prefix : s_prefixes) {
+        size_t length = strlen(prefix);
+        if (strncasecmp(sql, prefix, length) == 0 &&
+            !isalnum((unsigned char) sql[length]) && sql[length] != '_') {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlanMonitor::sample(const char *sql, const StatementStatus &status)
+{
+    if (!IsExplainable(sql)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    std::string fingerprint;
+    auto cached = m_fingerprints.find(sql);
+    if (cached != m_fingerprints.end()) {
+        fingerprint = cached->second;
+    } else {
+        fingerprint = StatementMonitor::Fingerprint(sql);
+        //Texts of SQLs with literals are unbounded
+        if (m_fingerprints.size() < m_config.maxFingerprints * 2) {
+            m_fingerprints[sql] = fingerprint;
+        }
+    }
+    auto iter = m_entries.find(fingerprint);
+    if (iter == m_entries.end()) {
+        if (m_entries.size() >= m_config.maxFingerprints) {
+            return false;
+        }
+        iter = m_entries.insert({fingerprint, {0, 0, 0, false, false, ""}})
+                   .first;
+    }
+    Entry &entry = iter->second;
+    ++entry.executions;
+    entry.totalCost += status.cost;
+    if (entry.sampled && (m_config.resampleInterval == 0 ||
+                          entry.executions - entry.sampledAt <
+                              m_config.resampleInterval)) {
+        return false;
+    }
+    entry.sampled = true;
+    entry.sampledAt = entry.executions;
+    if (entry.pending) {
+        return false;
+    }
+    entry.pending = true;
+    entry.sql = sql;
+    m_pending.push_back(fingerprint);
+    return true;
+}
+
+std::list<std::pair<std::string, std::string>> PlanMonitor::takePending()
+{
+    std::list<std::pair<std::string, std::string>> pendings;
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    for (const std::string &fingerprint : m_pending) {
+        Entry &entry = m_entries[fingerprint];
+        entry.pending = false;
+        pendings.push_back({fingerprint, std::move(entry.sql)});
+        entry.sql.clear();
+    }
+    m_pending.clear();
+    return pendings;
+}
+
+bool PlanMonitor::isPending() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return !m_pending.empty();
+}
+
+static std::string GetTable(std::istringstream &stream)
+{
+    //"SCAN TABLE t AS a" before 3.36.0 or "SCAN t AS a"
+    std::string table;
+    stream >> table;
+    if (table == "TABLE") {
+        stream >> table;
+    }
+    return table;
+}
+
+PlanMonitor::Summary PlanMonitor::Summarize(const std::string &plan)
+{
+    Summary summary;
+    summary.tempBTree = false;
+    std::istringstream lines(plan);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.find("USE TEMP B-TREE") != std::string::npos) {
+            summary.tempBTree = true;
+            continue;
+        }
+        std::istringstream stream(line);
+        std::string operation;
+        stream >> operation;
+        if (operation != "SCAN" && operation != "SEARCH") {
+            continue;
+        }
+        if (line.find("SUBQUERY") != std::string::npos ||
+            line.find("CONSTANT ROW") != std::string::npos) {
+            continue;
+        }
+        std::string table = GetTable(stream);
+        size_t using_ = line.find(" USING ");
+        if (using_ == std::string::npos) {
+            if (operation == "SCAN") {
+                summary.fullScans.insert(table);
+            }
+            continue;
+        }
+        std::string index;
+        size_t found = line.find("INDEX ", using_);
+        if (line.find("VIRTUAL TABLE", using_) != std::string::npos) {
+            index = "VIRTUAL TABLE";
+        } else if (found != std::string::npos) {
+            std::istringstream(line.substr(found + 6)) >> index;
+        } else if (line.find("PRIMARY KEY", using_) != std::string::npos) {
+            index = "PRIMARY KEY";
+        }
+        if (!index.empty()) {
+            summary.indexes.insert(table + ":" + index);
+        } else if (operation == "SCAN") {
+            summary.fullScans.insert(table);
+        }
+    }
+    return summary;
+}
+
+static bool Includes(const std::set<std::string> &set,
+                     const std::set<std::string> &subset)
+{
+    for (const std::string &element : subset) {
+        if (set.find(element) == set.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PlanMonitor::prepareStore(Error &error)
+{
+    if (m_store) {
+        return true;
+    }
+    std::unique_ptr<Handle> store(new Handle(GetPath(path)));
+    std::list<const ColumnDef> columnDefs = {
+        ColumnDef(s_fingerprint, ColumnType::Text).makePrimary(),
+        ColumnDef(s_plan, ColumnType::Text),
+        ColumnDef(s_version, ColumnType::Text),
+        ColumnDef(s_cost, ColumnType::Integer64),
+        ColumnDef(s_time, ColumnType::Integer64),
+    };
+    if (!store->open() ||
+        !store->exec(
+            StatementCreateTable().create(s_planTableName, columnDefs))) {
+        error = store->getError();
+        return false;
+    }
+    m_store = std::move(store);
+    return true;
+}
+
+bool PlanMonitor::record(const std::string &fingerprint,
+                         const std::string &sql,
+                         const std::string &plan,
+                         Error &error)
+{
+    int64_t cost = 0;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        auto iter = m_entries.find(fingerprint);
+        if (iter != m_entries.end() && iter->second.executions > 0) {
+            cost = iter->second.totalCost / iter->second.executions;
+        }
+    }
+    std::string version = Handle::GetSQLiteVersion();
+
+    Change change;
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_storeMutex);
+        if (!prepareStore(error)) {
+            return false;
+        }
+        std::shared_ptr<StatementHandle> statementHandle =
+            m_store->prepare(StatementSelect()
+                                 .select({ColumnResult(s_plan),
+                                          ColumnResult(s_version),
+                                          ColumnResult(s_cost)})
+                                 .from(s_planTableName)
+                                 .where(Expr(s_fingerprint) ==
+                                        Expr::BindParameter));
+        if (!statementHandle) {
+            error = m_store->getError();
+            return false;
+        }
+        statementHandle->bind<ColumnType::Text>(fingerprint.c_str(), 1);
+        if (statementHandle->step()) {
+            change.oldPlan = statementHandle->getValue<ColumnType::Text>(0);
+            change.oldVersion =
+                statementHandle->getValue<ColumnType::Text>(1);
+            change.oldCost =
+                statementHandle->getValue<ColumnType::Integer64>(2);
+            changed = change.oldPlan != plan;
+        } else if (!statementHandle->isOK()) {
+            error = statementHandle->getError();
+            return false;
+        }
+        statementHandle = nullptr;
+
+        std::list<const Expr> values = {
+            Expr::BindParameter, Expr::BindParameter, Expr::BindParameter,
+            Expr::BindParameter, Expr::BindParameter};
+        statementHandle = m_store->prepare(
+            StatementInsert()
+                .insert(s_planTableName,
+                        {s_fingerprint, s_plan, s_version, s_cost, s_time},
+                        Conflict::Replace)
+                .values(values));
+        if (!statementHandle) {
+            error = m_store->getError();
+            return false;
+        }
+        statementHandle->bind<ColumnType::Text>(fingerprint.c_str(), 1);
+        statementHandle->bind<ColumnType::Text>(plan.c_str(), 2);
+        statementHandle->bind<ColumnType::Text>(version.c_str(), 3);
+        statementHandle->bind<ColumnType::Integer64>(cost, 4);
+        statementHandle->bind<ColumnType::Integer64>(time(nullptr), 5);
+        if (!statementHandle->step() && !statementHandle->isOK()) {
+            error = statementHandle->getError();
+            return false;
+        }
+    }
+    error.reset();
+    if (changed && m_onChanged) {
+        Summary oldSummary = Summarize(change.oldPlan);
+        Summary newSummary = Summarize(plan);
+        change.fingerprint = fingerprint;
+        change.sql = sql;
+        change.newPlan = plan;
+        change.newVersion = version;
+        change.newCost = cost;
+        change.newFullScan =
+            !Includes(oldSummary.fullScans, newSummary.fullScans);
+        change.lostIndex = !Includes(newSummary.indexes, oldSummary.indexes);
+        change.newTempBTree = newSummary.tempBTree && !oldSummary.tempBTree;
+        m_onChanged(change);
+    }
+    return true;
+}
+
+} //namespace WCDB
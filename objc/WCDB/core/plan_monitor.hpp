@@ -0,0 +1,131 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef plan_monitor_hpp
+#define plan_monitor_hpp
+
+#include <WCDB/handle.hpp>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [PlanMonitor] records the query plan of each statement fingerprint of a database into a sidecar store, and reports once the plan of a fingerprint changes, e.g. after schema or SQLite upgrades.
+ * Fingerprints are sampled by the execution counters of handles. Plans are explained in background once database is idle.
+ */
+class PlanMonitor {
+public:
+    struct Config {
+        //Explain a fingerprint again after these executions.
+        //0 to explain it only once per launch.
+        uint64_t resampleInterval;
+        size_t maxFingerprints;
+    };
+
+    struct Change {
+        std::string fingerprint;
+        std::string sql;
+        std::string oldPlan;
+        std::string newPlan;
+        std::string oldVersion; //SQLite version
+        std::string newVersion;
+        int64_t oldCost; //average, in nanoseconds
+        int64_t newCost;
+        bool newFullScan;
+        bool lostIndex;
+        bool newTempBTree;
+        bool isRegression() const;
+    };
+    typedef std::function<void(const Change &)> ChangedCallback;
+
+    static std::shared_ptr<PlanMonitor>
+    Register(const std::string &path,
+             const Config &config,
+             const ChangedCallback &onChanged);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<PlanMonitor> Get(const std::string &path);
+    static std::string GetPath(const std::string &path);
+
+    const std::string path;
+
+    //Return true if the fingerprint of [sql] should be explained
+    bool sample(const char *sql, const StatementStatus &status);
+    //fingerprint->sql
+    std::list<std::pair<std::string, std::string>> takePending();
+    bool isPending() const;
+
+    //Compare [plan] with the recorded one and record it
+    bool record(const std::string &fingerprint,
+                const std::string &sql,
+                const std::string &plan,
+                Error &error);
+
+    //Details of EXPLAIN QUERY PLAN, one line each
+    struct Summary {
+        std::set<std::string> fullScans; //tables
+        std::set<std::string> indexes;   //table:index
+        bool tempBTree;
+    };
+    static Summary Summarize(const std::string &plan);
+
+protected:
+    PlanMonitor(const std::string &path,
+                const Config &config,
+                const ChangedCallback &onChanged);
+    PlanMonitor(const PlanMonitor &) = delete;
+    PlanMonitor &operator=(const PlanMonitor &) = delete;
+
+    static bool IsExplainable(const char *sql);
+    bool prepareStore(Error &error);
+
+    const Config m_config;
+    const ChangedCallback m_onChanged;
+
+    struct Entry {
+        uint64_t executions;
+        int64_t totalCost;
+        uint64_t sampledAt;
+        bool sampled;
+        bool pending;
+        std::string sql;
+    };
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::string> m_fingerprints;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<std::string> m_pending;
+
+    //Only used by the background thread
+    std::mutex m_storeMutex;
+    std::unique_ptr<Handle> m_store;
+
+    static std::unordered_map<std::string, std::shared_ptr<PlanMonitor>>
+        s_monitors;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* plan_monitor_hpp */
@@ -0,0 +1,107 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/session.hpp>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<Session>> Session::s_sessions;
+std::mutex Session::s_mutex;
+
+std::shared_ptr<Session> Session::Register(const std::string &path,
+                                           const std::list<std::string> &tables,
+                                           bool patchset,
+                                           const Notification &notification)
+{
+    std::shared_ptr<Session> session(
+        new Session(path, tables, patchset, notification));
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_sessions[path] = session;
+    return session;
+}
+
+void Session::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_sessions.erase(path);
+}
+
+std::shared_ptr<Session> Session::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_sessions.find(path);
+    if (iter == s_sessions.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+Session::Session(const std::string &thePath,
+                 const std::list<std::string> &theTables,
+                 bool thePatchset,
+                 const Notification &notification)
+    : path(thePath)
+    , tables(theTables)
+    , patchset(thePatchset)
+    , m_notification(notification)
+{
+}
+
+void Session::collect(const Changeset &changeset, uint64_t sequence)
+{
+    if (m_notification) {
+        m_notification(changeset);
+    }
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Changeset &collected = m_changesets[sequence];
+    //Changesets with a same sequence, which is rare, can be concatenated
+    collected.insert(collected.end(), changeset.begin(), changeset.end());
+}
+
+bool Session::take(Changeset &changeset, Error &error)
+{
+    std::map<uint64_t, Changeset> changesets;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        changesets.swap(m_changesets);
+    }
+    ChangesetGroup group;
+    bool result = true;
+    for (const auto &iter : changesets) {
+        if (!group.add(iter.second, error)) {
+            result = false;
+            break;
+        }
+    }
+    result = result && group.output(changeset, error);
+    if (!result) {
+        //Put them back so that they can be taken again
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        for (const auto &iter : changesets) {
+            Changeset &collected = m_changesets[iter.first];
+            //Those collected with a same sequence since then go after
+            collected.insert(collected.begin(), iter.second.begin(),
+                             iter.second.end());
+        }
+    }
+    return result;
+}
+
+} //namespace WCDB
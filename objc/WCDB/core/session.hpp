@@ -0,0 +1,79 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef session_hpp
+#define session_hpp
+
+#include <WCDB/changeset.hpp>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [Session] collects the changesets captured by the session on each handle of a database.
+ * Handles flush their changes once they flow back to pool, so each changeset is a committed transaction.
+ * Changesets are combined in the order of commits.
+ */
+class Session {
+public:
+    typedef std::function<void(const Changeset &)> Notification;
+
+    static std::shared_ptr<Session>
+    Register(const std::string &path,
+             const std::list<std::string> &tables,
+             bool patchset,
+             const Notification &notification);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<Session> Get(const std::string &path);
+
+    const std::string path;
+    const std::list<std::string> tables;
+    const bool patchset;
+
+    void collect(const Changeset &changeset, uint64_t sequence);
+    //Combine the changes collected since last time. They are kept on failure.
+    bool take(Changeset &changeset, Error &error);
+
+protected:
+    Session(const std::string &path,
+            const std::list<std::string> &tables,
+            bool patchset,
+            const Notification &notification);
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    const Notification m_notification;
+
+    std::mutex m_mutex;
+    std::map<uint64_t, Changeset> m_changesets; //sequence->changeset
+
+    static std::unordered_map<std::string, std::shared_ptr<Session>>
+        s_sessions;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* session_hpp */
@@ -0,0 +1,267 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/standby.hpp>
+#include <algorithm>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace WCDB {
+
+//Beyond it, copying the whole database is cheaper
+static const size_t s_maxDirtyPages = 65536;
+static const int s_maxIncrementalRefreshes = 64;
+static const std::chrono::seconds s_maxRetryDelay(600);
+//Full refreshes take up at most 1/s_fullRefreshCostRatio of the time
+static const int s_fullRefreshCostRatio = 10;
+
+static uint32_t GetBigEndian32(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) |
+           ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3];
+}
+
+std::unordered_map<std::string, std::shared_ptr<Standby>> Standby::s_standbys;
+std::mutex Standby::s_mutex;
+
+std::shared_ptr<Standby> Standby::Register(const std::string &path,
+                                           const void *key,
+                                           int keySize,
+                                           int pageSize,
+                                           const std::chrono::seconds &lag)
+{
+    std::shared_ptr<Standby> standby(
+        new Standby(path, key, keySize, pageSize, lag));
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_standbys[path] = standby;
+    return standby;
+}
+
+void Standby::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_standbys.erase(path);
+}
+
+std::shared_ptr<Standby> Standby::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_standbys.find(path);
+    if (iter == s_standbys.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::string Standby::GetPath(const std::string &path)
+{
+    return path + "-standby";
+}
+
+Standby::Standby(const std::string &thePath,
+                 const void *theKey,
+                 int keySize,
+                 int thePageSize,
+                 const std::chrono::seconds &theLag)
+    : path(thePath)
+    , key((const unsigned char *) theKey,
+          (const unsigned char *) theKey + (theKey ? keySize : 0))
+    , pageSize(thePageSize)
+    , lag(theLag)
+    , m_dirty(true) //The standby may be stale since last launch
+    , m_fullyDirty(true)
+    , m_sequence(0)
+    , m_walSalt(0)
+    , m_walFrames(0)
+    , m_incrementalRefreshes(0)
+    , m_failures(0)
+    , m_fullRefreshCost(0)
+    , m_lastRefresh(std::chrono::steady_clock::now() - theLag)
+    , m_nextRetry(m_lastRefresh)
+{
+    m_statistics.refreshes = 0;
+    m_statistics.incrementalRefreshes = 0;
+    m_statistics.failures = 0;
+    m_statistics.lastRefreshCost = 0;
+    m_statistics.lastRefreshedTime = 0;
+    m_statistics.dirty = true;
+}
+
+bool Standby::setDirty()
+{
+    if (m_dirty) {
+        return false;
+    }
+    m_dirty = true;
+    return true;
+}
+
+bool Standby::markDirty(const std::string &walPath, int frames)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    collectPages(walPath, frames);
+    return setDirty();
+}
+
+bool Standby::markDirty()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_fullyDirty = true;
+    m_dirtyPages.clear();
+    return setDirty();
+}
+
+//See https://www.sqlite.org/fileformat2.html#walformat
+void Standby::collectPages(const std::string &walPath, int frames)
+{
+    int fd = open(walPath.c_str(), O_RDONLY);
+    unsigned char header[32];
+    if (fd < 0 || pread(fd, header, sizeof(header), 0) != sizeof(header)) {
+        m_fullyDirty = true;
+    } else {
+        uint32_t walPageSize = GetBigEndian32(header + 8);
+        uint32_t salt = GetBigEndian32(header + 16);
+        if (salt != m_walSalt) {
+            //Salt increases by one each time wal restarts. Otherwise, the frames of restarts are missed.
+            if (salt != m_walSalt + 1) {
+                m_fullyDirty = true;
+            }
+            m_walSalt = salt;
+            m_walFrames = 0;
+        }
+        if (!m_fullyDirty && frames > m_walFrames) {
+            if (m_dirtyPages.size() + (frames - m_walFrames) >
+                s_maxDirtyPages) {
+                m_fullyDirty = true;
+            }
+            for (int i = m_walFrames; i < frames && !m_fullyDirty; ++i) {
+                //page number, size of database, salt-1
+                unsigned char frameHeader[12];
+                if (pread(fd, frameHeader, sizeof(frameHeader),
+                          sizeof(header) +
+                              (off_t) i * (walPageSize + 24)) !=
+                        sizeof(frameHeader) ||
+                    GetBigEndian32(frameHeader + 8) != salt) {
+                    //It's restarted after committed
+                    m_fullyDirty = true;
+                } else {
+                    m_dirtyPages[GetBigEndian32(frameHeader)] = ++m_sequence;
+                }
+            }
+        }
+        m_walFrames = std::max(m_walFrames, frames);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (m_fullyDirty) {
+        m_dirtyPages.clear();
+    }
+}
+
+bool Standby::isDirty() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_dirty;
+}
+
+bool Standby::isDue() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration interval = lag;
+    if (m_incrementalRefreshes == 0) {
+        //Last one copied the whole database, so does the next one without
+        //dbpage vtab
+        interval = std::max(
+            interval, std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                          std::chrono::duration<double>(
+                              m_fullRefreshCost * s_fullRefreshCostRatio)));
+    }
+    return now >= m_lastRefresh + interval && now >= m_nextRetry;
+}
+
+uint64_t Standby::getSequence() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_sequence + 1;
+}
+
+bool Standby::beginRefresh(uint64_t sequence, std::set<uint32_t> &pages)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_lastRefresh = std::chrono::steady_clock::now();
+    bool full = m_fullyDirty ||
+                m_incrementalRefreshes >= s_maxIncrementalRefreshes;
+    m_fullyDirty = false;
+    pages.clear();
+    for (auto iter = m_dirtyPages.begin(); iter != m_dirtyPages.end();) {
+        pages.insert(iter->first);
+        if (iter->second < sequence) {
+            iter = m_dirtyPages.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    //Commits since now make it dirty again
+    m_dirty = !m_dirtyPages.empty();
+    return full;
+}
+
+void Standby::endRefresh(bool succeed, bool incremental, double cost)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (succeed) {
+        ++m_statistics.refreshes;
+        if (incremental) {
+            ++m_statistics.incrementalRefreshes;
+            ++m_incrementalRefreshes;
+        } else {
+            m_incrementalRefreshes = 0;
+            m_fullRefreshCost = cost;
+        }
+        m_statistics.lastRefreshCost = cost;
+        m_statistics.lastRefreshedTime = (int64_t) time(nullptr);
+        m_failures = 0;
+    } else {
+        ++m_statistics.failures;
+        //Standby may be partially written
+        m_dirty = true;
+        m_fullyDirty = true;
+        m_dirtyPages.clear();
+        std::chrono::seconds delay =
+            std::max(lag, std::chrono::seconds(1)) * (1 << std::min(m_failures, 10));
+        m_nextRetry =
+            std::chrono::steady_clock::now() + std::min(delay, s_maxRetryDelay);
+        ++m_failures;
+    }
+}
+
+Standby::Statistics Standby::getStatistics() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.dirty = m_dirty;
+    return statistics;
+}
+
+} //namespace WCDB
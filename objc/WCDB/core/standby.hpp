@@ -0,0 +1,119 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef standby_hpp
+#define standby_hpp
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WCDB {
+
+/*
+ * [Standby] is a verified copy of database, which is refreshed in background after commits.
+ * It's refreshed at most once per [lag], so that the changes lost after promotion are bounded by [lag].
+ * Pages of the frames committed into wal are collected, so that only those pages are copied in the refresh.
+ * The whole database is copied and verified at first, after failures and periodically, since frames written
+ * while the wal restarts unseen are missed.
+ * Pages are read by dbpage vtab, without which, e.g. the sqlcipher of iOS and macOS frameworks, each refresh
+ * copies and verifies the whole database. The interval after a full refresh is then stretched to
+ * [s_fullRefreshCostRatio] times its cost if it's longer than [lag].
+ */
+class Standby {
+public:
+    static std::shared_ptr<Standby> Register(const std::string &path,
+                                             const void *key,
+                                             int keySize,
+                                             int pageSize,
+                                             const std::chrono::seconds &lag);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<Standby> Get(const std::string &path);
+    static std::string GetPath(const std::string &path);
+
+    const std::string path;
+    const std::vector<unsigned char> key;
+    const int pageSize;
+    const std::chrono::seconds lag;
+
+    //Collect the pages of frames in [walPath] up to [frames]. Return true if it becomes dirty
+    bool markDirty(const std::string &walPath, int frames);
+    //The whole database is copied in next refresh. Return true if it becomes dirty
+    bool markDirty();
+    bool isDirty() const;
+    //It's delayed more after each failure in a row
+    bool isDue() const;
+    //Pages collected before the returned sequence are kept by the snapshot read after it
+    uint64_t getSequence() const;
+    //Return true if the whole database should be copied. Otherwise, [pages] are the ones to be copied.
+    //Pages collected since [sequence] are kept dirty, since they may be newer than the snapshot.
+    bool beginRefresh(uint64_t sequence, std::set<uint32_t> &pages);
+    void endRefresh(bool succeed, bool incremental, double cost);
+
+    struct Statistics {
+        uint64_t refreshes;
+        uint64_t incrementalRefreshes;
+        uint64_t failures;
+        double lastRefreshCost;    //in seconds
+        int64_t lastRefreshedTime; //unix time, 0 if never
+        bool dirty;
+    };
+    Statistics getStatistics() const;
+
+protected:
+    Standby(const std::string &path,
+            const void *key,
+            int keySize,
+            int pageSize,
+            const std::chrono::seconds &lag);
+    Standby(const Standby &) = delete;
+    Standby &operator=(const Standby &) = delete;
+
+    bool setDirty();
+    void collectPages(const std::string &walPath, int frames);
+
+    mutable std::mutex m_mutex;
+    bool m_dirty;
+    bool m_fullyDirty;
+    //page number -> sequence it's collected at
+    std::map<uint32_t, uint64_t> m_dirtyPages;
+    uint64_t m_sequence;
+    uint32_t m_walSalt;
+    int m_walFrames;
+    int m_incrementalRefreshes; //since last full one
+    int m_failures;             //in a row
+    double m_fullRefreshCost;   //of last full one, in seconds
+    std::chrono::steady_clock::time_point m_lastRefresh;
+    std::chrono::steady_clock::time_point m_nextRetry;
+    Statistics m_statistics;
+
+    static std::unordered_map<std::string, std::shared_ptr<Standby>>
+        s_standbys;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* standby_hpp */
@@ -0,0 +1,218 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/statement_monitor.hpp>
+#include <algorithm>
+#include <cctype>
+
+namespace WCDB {
+
+const std::string StatementMonitor::overflowFingerprint("<other>");
+std::unordered_map<std::string, std::shared_ptr<StatementMonitor>>
+    StatementMonitor::s_monitors;
+std::mutex StatementMonitor::s_mutex;
+
+std::shared_ptr<StatementMonitor>
+StatementMonitor::Register(const std::string &path, size_t maxFingerprints)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    std::shared_ptr<StatementMonitor> &monitor = s_monitors[path];
+    if (!monitor) {
+        monitor.reset(new StatementMonitor(path, maxFingerprints));
+    }
+    return monitor;
+}
+
+void StatementMonitor::Unregister(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_monitors.erase(path);
+}
+
+std::shared_ptr<StatementMonitor>
+StatementMonitor::Get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_monitors.find(path);
+    if (iter == s_monitors.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+StatementMonitor::StatementMonitor(const std::string &thePath,
+                                   size_t maxFingerprints)
+    : path(thePath), m_maxFingerprints(maxFingerprints)
+{
+}
+
+static bool IsIdentifierChar(char c)
+{
+    return isalnum((unsigned char) c) || c == '_' || c == '$' ||
+           (unsigned char) c >= 0x80;
+}
+
+static void AppendParameter(std::string &fingerprint)
+{
+    //Lists of values, e.g. IN(?, ?, ?), are folded into one
+    size_t size = fingerprint.size();
+    if (size >= 2 && fingerprint[size - 1] == ',' &&
+        fingerprint[size - 2] == '?') {
+        fingerprint.pop_back();
+        return;
+    }
+    if (size >= 3 && fingerprint[size - 1] == ' ' &&
+        fingerprint[size - 2] == ',' && fingerprint[size - 3] == '?') {
+        fingerprint.resize(size - 2);
+        return;
+    }
+    fingerprint.push_back('?');
+}
+
+std::string StatementMonitor::Fingerprint(const char *sql)
+{
+    std::string fingerprint;
+    const char *p = sql;
+    while (*p) {
+        char c = *p;
+        if (isspace((unsigned char) c)) {
+            while (isspace((unsigned char) *p)) {
+                ++p;
+            }
+            if (!fingerprint.empty() && *p) {
+                fingerprint.push_back(' ');
+            }
+        } else if (c == '\'' ||
+                   ((c == 'x' || c == 'X') && p[1] == '\'' &&
+                    (fingerprint.empty() ||
+                     !IsIdentifierChar(fingerprint.back())))) {
+            //String or blob literal
+            p += c == '\'' ? 1 : 2;
+            while (*p) {
+                if (*p == '\'') {
+                    if (p[1] != '\'') {
+                        ++p;
+                        break;
+                    }
+                    ++p;
+                }
+                ++p;
+            }
+            AppendParameter(fingerprint);
+        } else if (c == '"' || c == '`' || c == '[') {
+            //Quoted identifier is kept
+            char end = c == '[' ? ']' : c;
+            fingerprint.push_back(*p++);
+            while (*p && *p != end) {
+                fingerprint.push_back(*p++);
+            }
+            if (*p) {
+                fingerprint.push_back(*p++);
+            }
+        } else if ((isdigit((unsigned char) c) ||
+                    (c == '.' && isdigit((unsigned char) p[1]))) &&
+                   (fingerprint.empty() ||
+                    !IsIdentifierChar(fingerprint.back()))) {
+            //Numeric literal, including hex and exponent
+            while (IsIdentifierChar(*p) || *p == '.' ||
+                   ((*p == '+' || *p == '-') &&
+                    (p[-1] == 'e' || p[-1] == 'E'))) {
+                ++p;
+            }
+            AppendParameter(fingerprint);
+        } else if (c == '?') {
+            //Numbered parameter, e.g. ?1
+            ++p;
+            while (isdigit((unsigned char) *p)) {
+                ++p;
+            }
+            AppendParameter(fingerprint);
+        } else {
+            fingerprint.push_back(*p++);
+        }
+    }
+    return fingerprint;
+}
+
+void StatementMonitor::add(const char *sql, const StatementStatus &status)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    std::string uncached;
+    const std::string *fingerprint;
+    auto fingerprintIter = m_fingerprints.find(sql);
+    if (fingerprintIter != m_fingerprints.end()) {
+        fingerprint = &fingerprintIter->second;
+    } else if (m_fingerprints.size() < m_maxFingerprints * 4) {
+        fingerprint =
+            &m_fingerprints.insert({sql, Fingerprint(sql)}).first->second;
+    } else {
+        //SQLs with literals are unbounded, stop caching them at some point
+        uncached = Fingerprint(sql);
+        fingerprint = &uncached;
+    }
+
+    auto iter = m_statistics.find(*fingerprint);
+    if (iter == m_statistics.end()) {
+        const std::string &key = m_statistics.size() < m_maxFingerprints
+                                     ? *fingerprint
+                                     : overflowFingerprint;
+        iter = m_statistics.find(key);
+        if (iter == m_statistics.end()) {
+            Statistics statistics = Statistics();
+            statistics.fingerprint = key;
+            iter = m_statistics.insert({key, statistics}).first;
+        }
+    }
+    Statistics &statistics = iter->second;
+    ++statistics.executions;
+    statistics.totalCost += status.cost;
+    statistics.maxCost = std::max(statistics.maxCost, status.cost);
+    statistics.busyWait += status.busyWait;
+    statistics.busyRetries += status.busyRetries;
+    statistics.vmSteps += status.vmSteps;
+    statistics.fullScanSteps += status.fullScanSteps;
+    statistics.sorts += status.sorts;
+    statistics.autoIndexes += status.autoIndexes;
+    statistics.reprepares += status.reprepares;
+    statistics.maxMemory = std::max(statistics.maxMemory, status.memory);
+}
+
+std::list<StatementMonitor::Statistics> StatementMonitor::getStatistics() const
+{
+    std::list<Statistics> result;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        for (const auto &iter : m_statistics) {
+            result.push_back(iter.second);
+        }
+    }
+    result.sort([](const Statistics &lhs, const Statistics &rhs) {
+        return lhs.totalCost > rhs.totalCost;
+    });
+    return result;
+}
+
+void StatementMonitor::reset()
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_statistics.clear();
+}
+
+} //namespace WCDB
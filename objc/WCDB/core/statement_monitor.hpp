@@ -0,0 +1,88 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef statement_monitor_hpp
+#define statement_monitor_hpp
+
+#include <WCDB/handle.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [StatementMonitor] aggregates the execution counters of statements of a database by their fingerprints.
+ * Fingerprint is the SQL with literals replaced by '?', so that statements differ only in values are counted together.
+ */
+class StatementMonitor {
+public:
+    static std::shared_ptr<StatementMonitor>
+    Register(const std::string &path, size_t maxFingerprints);
+    static void Unregister(const std::string &path);
+    static std::shared_ptr<StatementMonitor> Get(const std::string &path);
+
+    const std::string path;
+
+    static std::string Fingerprint(const char *sql);
+    //Statements beyond [maxFingerprints] are counted in [overflowFingerprint]
+    static const std::string overflowFingerprint;
+
+    void add(const char *sql, const StatementStatus &status);
+
+    struct Statistics {
+        std::string fingerprint;
+        uint64_t executions;
+        int64_t totalCost; //in nanoseconds
+        int64_t maxCost;   //in nanoseconds
+        int64_t busyWait;  //in nanoseconds
+        uint64_t busyRetries;
+        uint64_t vmSteps;
+        uint64_t fullScanSteps;
+        uint64_t sorts;
+        uint64_t autoIndexes;
+        uint64_t reprepares;
+        int maxMemory;
+    };
+    //Sorted by total cost, descending
+    std::list<Statistics> getStatistics() const;
+    void reset();
+
+protected:
+    StatementMonitor(const std::string &path, size_t maxFingerprints);
+    StatementMonitor(const StatementMonitor &) = delete;
+    StatementMonitor &operator=(const StatementMonitor &) = delete;
+
+    mutable std::mutex m_mutex;
+    size_t m_maxFingerprints;
+    //sql->fingerprint, which saves normalizing the same sql again
+    std::unordered_map<std::string, std::string> m_fingerprints;
+    std::unordered_map<std::string, Statistics> m_statistics;
+
+    static std::unordered_map<std::string, std::shared_ptr<StatementMonitor>>
+        s_monitors;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* statement_monitor_hpp */
@@ -0,0 +1,166 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/tiering.hpp>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<const Tiering>>
+    Tiering::s_tierings;
+std::mutex Tiering::s_mutex;
+
+std::shared_ptr<const Tiering> Tiering::Register(const std::string &path,
+                                                 const std::string &table,
+                                                 const std::string &schema,
+                                                 const Expr &condition,
+                                                 int batchSize)
+{
+    std::shared_ptr<const Tiering> tiering(
+        new Tiering(path, table, schema, condition, batchSize));
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_tierings[GetKey(path, table)] = tiering;
+    return tiering;
+}
+
+void Tiering::Unregister(const std::string &path, const std::string &table)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_tierings.erase(GetKey(path, table));
+}
+
+std::shared_ptr<const Tiering> Tiering::Get(const std::string &path,
+                                            const std::string &table)
+{
+    return GetByKey(GetKey(path, table));
+}
+
+std::shared_ptr<const Tiering> Tiering::GetByKey(const std::string &key)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_tierings.find(key);
+    if (iter == s_tierings.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::list<std::shared_ptr<const Tiering>>
+Tiering::GetAll(const std::string &path)
+{
+    std::list<std::shared_ptr<const Tiering>> tierings;
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    for (const auto &iter : s_tierings) {
+        if (iter.second->path == path) {
+            tierings.push_back(iter.second);
+        }
+    }
+    return tierings;
+}
+
+std::string Tiering::GetKey(const std::string &path, const std::string &table)
+{
+    return path + "\n" + table;
+}
+
+Tiering::Tiering(const std::string &thePath,
+                 const std::string &theTable,
+                 const std::string &theSchema,
+                 const Expr &theCondition,
+                 int theBatchSize)
+    : path(thePath)
+    , table(theTable)
+    , schema(theSchema)
+    , condition(theCondition)
+    , batchSize(theBatchSize)
+{
+}
+
+std::string Tiering::getName() const
+{
+    return "tiering_" + table;
+}
+
+std::string Tiering::getKey() const
+{
+    return GetKey(path, table);
+}
+
+std::string Tiering::getViewName() const
+{
+    return table + "_tiered";
+}
+
+StatementCreateTable Tiering::getCreateArchiveStatement() const
+{
+    return StatementCreateTable()
+        .create(schema + "." + table)
+        .as(StatementSelect()
+                .select({ColumnResult(Expr(Column::Any))})
+                .from("main." + table)
+                .where(Expr(0)));
+}
+
+StatementCreateView Tiering::getCreateViewStatement() const
+{
+    StatementSelect archive = StatementSelect()
+                                  .select({ColumnResult(Expr(Column::Any))})
+                                  .from(schema + "." + table);
+    return StatementCreateView()
+        .create(getViewName(), true, true)
+        .as(StatementSelect()
+                .select({ColumnResult(Expr(Column::Any))})
+                .from("main." + table)
+                .unionAll(archive));
+}
+
+StatementDropView Tiering::getDropViewStatement() const
+{
+    return StatementDropView().drop(getViewName());
+}
+
+StatementSelect Tiering::getBatchStatement() const
+{
+    return StatementSelect()
+        .select({ColumnResult(Expr(Column::Rowid))})
+        .from("main." + table)
+        .where(Expr(Column::Rowid) >= Expr::BindParameter && condition)
+        .orderBy({Order(Expr(Column::Rowid))})
+        .limit(batchSize);
+}
+
+StatementInsert Tiering::getArchiveStatement() const
+{
+    //Archived rows are never replaced
+    return StatementInsert()
+        .insert(schema + "." + table)
+        .values(StatementSelect()
+                    .select({ColumnResult(Expr(Column::Any))})
+                    .from("main." + table)
+                    .where(Expr(Column::Rowid) == Expr::BindParameter));
+}
+
+StatementDelete Tiering::getEvictStatement() const
+{
+    return StatementDelete()
+        .deleteFrom("main." + table)
+        .where(Expr(Column::Rowid) == Expr::BindParameter);
+}
+
+} //namespace WCDB
@@ -0,0 +1,92 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef tiering_hpp
+#define tiering_hpp
+
+#include <WCDB/abstract.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace WCDB {
+
+/*
+ * [Tiering] moves the cold rows of a table, which match [condition], to the table with same name in an attached archive schema.
+ * A TEMP view, which unions both tiers, is created on each handle.
+ * Cold rows are moved every minute while the database is opened. Rows conflicting with the archive are left in the table
+ * and reported, without failing the others.
+ * Table without rowid is not supported.
+ */
+class Tiering {
+public:
+    static std::shared_ptr<const Tiering> Register(const std::string &path,
+                                                   const std::string &table,
+                                                   const std::string &schema,
+                                                   const Expr &condition,
+                                                   int batchSize);
+    static void Unregister(const std::string &path, const std::string &table);
+    static std::shared_ptr<const Tiering> Get(const std::string &path,
+                                              const std::string &table);
+    static std::shared_ptr<const Tiering> GetByKey(const std::string &key);
+    static std::list<std::shared_ptr<const Tiering>>
+    GetAll(const std::string &path);
+
+    const std::string path;
+    const std::string table;
+    const std::string schema;
+    const Expr condition;
+    const int batchSize;
+
+    std::string getName() const;
+    std::string getKey() const;
+    //view of both tiers
+    std::string getViewName() const;
+
+    //It creates the archive table without constraints and indexes if it does not exist.
+    StatementCreateTable getCreateArchiveStatement() const;
+    StatementCreateView getCreateViewStatement() const;
+    StatementDropView getDropViewStatement() const;
+    //rowid of a batch of cold rows from the bound one
+    StatementSelect getBatchStatement() const;
+    //Copy the row of bound rowid to archive and then delete it
+    StatementInsert getArchiveStatement() const;
+    StatementDelete getEvictStatement() const;
+
+protected:
+    Tiering(const std::string &path,
+            const std::string &table,
+            const std::string &schema,
+            const Expr &condition,
+            int batchSize);
+
+    static std::string GetKey(const std::string &path,
+                              const std::string &table);
+
+    static std::unordered_map<std::string, std::shared_ptr<const Tiering>>
+        s_tierings;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* tiering_hpp */
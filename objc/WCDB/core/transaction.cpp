@@ -114,6 +114,12 @@ int Transaction::getChanges()
     return m_handle->getChanges();
 }
 
+void Transaction::setCancellation(const Cancellation &cancellation)
+{
+    std::lock_guard<std::mutex> lockGuard(*m_mutex.get());
+    m_handle->setCancellation(cancellation);
+}
+
 Transaction::~Transaction()
 {
     if (m_isInTransaction) {
@@ -49,6 +49,8 @@ public:
 
     int getChanges();
 
+    void setCancellation(const Cancellation &cancellation);
+
 protected:
     Transaction() = delete;
     Transaction(const Transaction &) = delete;
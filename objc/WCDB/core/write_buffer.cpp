@@ -0,0 +1,618 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/file.hpp>
+#include <WCDB/write_buffer.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace WCDB {
+
+std::unordered_map<std::string, std::shared_ptr<WriteBuffer>>
+    WriteBuffer::s_buffers;
+std::atomic<int> WriteBuffer::s_count(0);
+std::mutex WriteBuffer::s_mutex;
+
+static const Column s_sequenceTable("tableName");
+static const Column s_sequence("sequence");
+static const std::string s_sequenceTableName("wcdb_write_buffer");
+
+WriteBuffer::Value::Value(std::nullptr_t)
+    : type(ColumnType::Null), integer(0), real(0)
+{
+}
+
+WriteBuffer::Value::Value(int value)
+    : type(ColumnType::Integer64), integer(value), real(0)
+{
+}
+
+WriteBuffer::Value::Value(int64_t value)
+    : type(ColumnType::Integer64), integer(value), real(0)
+{
+}
+
+WriteBuffer::Value::Value(double value)
+    : type(ColumnType::Float), integer(0), real(value)
+{
+}
+
+WriteBuffer::Value::Value(const char *value)
+    : type(value ? ColumnType::Text : ColumnType::Null)
+    , integer(0)
+    , real(0)
+    , data(value ? value : "")
+{
+}
+
+WriteBuffer::Value::Value(const std::string &value)
+    : type(ColumnType::Text), integer(0), real(0), data(value)
+{
+}
+
+WriteBuffer::Value::Value(const void *value, int size)
+    : type(ColumnType::BLOB)
+    , integer(0)
+    , real(0)
+    , data((const char *) value, value ? size : 0)
+{
+}
+
+std::shared_ptr<WriteBuffer>
+WriteBuffer::Register(const std::string &path,
+                      const std::string &table,
+                      const std::list<std::string> &columns,
+                      const Config &config,
+                      int64_t sequence)
+{
+    std::shared_ptr<WriteBuffer> buffer(
+        new WriteBuffer(path, table, columns, config));
+    buffer->replay(sequence);
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_buffers[GetKey(path, table)] = buffer;
+    s_count = (int) s_buffers.size();
+    return buffer;
+}
+
+void WriteBuffer::Unregister(const std::string &path, const std::string &table)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    s_buffers.erase(GetKey(path, table));
+    s_count = (int) s_buffers.size();
+}
+
+std::shared_ptr<WriteBuffer> WriteBuffer::Get(const std::string &path,
+                                              const std::string &table)
+{
+    return GetByKey(GetKey(path, table));
+}
+
+std::shared_ptr<WriteBuffer> WriteBuffer::GetByKey(const std::string &key)
+{
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    auto iter = s_buffers.find(key);
+    if (iter == s_buffers.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+std::list<std::shared_ptr<WriteBuffer>>
+WriteBuffer::GetAll(const std::string &path)
+{
+    std::list<std::shared_ptr<WriteBuffer>> buffers;
+    //It's checked before each statement, so the common case skips locking
+    if (s_count.load() == 0) {
+        return buffers;
+    }
+    std::lock_guard<std::mutex> lockGuard(s_mutex);
+    for (const auto &iter : s_buffers) {
+        if (iter.second->path == path) {
+            buffers.push_back(iter.second);
+        }
+    }
+    return buffers;
+}
+
+std::list<std::string> WriteBuffer::GetLogPaths(const std::string &path)
+{
+    std::list<std::string> paths;
+    for (const auto &buffer : GetAll(path)) {
+        if (buffer->config.logged) {
+            paths.push_back(buffer->getLogPath());
+        }
+    }
+    return paths;
+}
+
+std::string WriteBuffer::GetKey(const std::string &path,
+                                const std::string &table)
+{
+    return path + "\n" + table;
+}
+
+WriteBuffer::WriteBuffer(const std::string &thePath,
+                         const std::string &theTable,
+                         const std::list<std::string> &theColumns,
+                         const Config &theConfig)
+    : path(thePath)
+    , table(theTable)
+    , columns(theColumns)
+    , config(theConfig)
+    , m_pendingBytes(0)
+    , m_sequence(0)
+    , m_flushRequested(false)
+    , m_logFD(-1)
+    , m_logSize(0)
+{
+    m_statistics.pendingRows = 0;
+    m_statistics.pendingBytes = 0;
+    m_statistics.flushes = 0;
+    m_statistics.flushedRows = 0;
+    m_statistics.failures = 0;
+    m_statistics.lastFlushCost = 0;
+}
+
+WriteBuffer::~WriteBuffer()
+{
+    if (m_logFD >= 0) {
+        close(m_logFD);
+    }
+}
+
+std::string WriteBuffer::getKey() const
+{
+    return GetKey(path, table);
+}
+
+std::string WriteBuffer::getLogPath() const
+{
+    return path + "-wbuf-" + table;
+}
+
+StatementInsert WriteBuffer::getInsertStatement() const
+{
+    std::list<const Column> columnList;
+    std::list<const Expr> values;
+    for (const std::string &column : columns) {
+        columnList.push_back(Column(column));
+        values.push_back(Expr::BindParameter);
+    }
+    return StatementInsert()
+        .insert(table, columnList, Conflict::NotSet)
+        .values(values);
+}
+
+StatementCreateTable WriteBuffer::GetCreateSequenceTableStatement()
+{
+    std::list<const ColumnDef> columnDefs = {
+        ColumnDef(s_sequenceTable, ColumnType::Text).makePrimary(),
+        ColumnDef(s_sequence, ColumnType::Integer64)
+            .makeNotNull()
+            .makeDefault(0),
+    };
+    return StatementCreateTable().create(s_sequenceTableName, columnDefs);
+}
+
+StatementSelect WriteBuffer::GetSequenceStatement(const std::string &table)
+{
+    return StatementSelect()
+        .select({ColumnResult(s_sequence)})
+        .from(s_sequenceTableName)
+        .where(Expr(s_sequenceTable) == table);
+}
+
+StatementInsert WriteBuffer::getUpdateSequenceStatement() const
+{
+    std::list<const Expr> values = {Expr(table), Expr::BindParameter};
+    return StatementInsert()
+        .insert(s_sequenceTableName, {s_sequenceTable, s_sequence},
+                Conflict::Replace)
+        .values(values);
+}
+
+size_t WriteBuffer::GetSize(const Row &row)
+{
+    size_t size = 0;
+    for (const Value &value : row) {
+        size += sizeof(Value) + value.data.size();
+    }
+    return size;
+}
+
+uint32_t WriteBuffer::Checksum(const char *data, size_t size)
+{
+    //FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void WriteBuffer::Encode(int64_t sequence, const Row &row, std::string &record)
+{
+    std::string payload;
+    payload.append((const char *) &sequence, sizeof(sequence));
+    uint32_t count = (uint32_t) row.size();
+    payload.append((const char *) &count, sizeof(count));
+    for (const Value &value : row) {
+        payload.push_back((char) value.type);
+        switch (value.type) {
+            case ColumnType::Integer64:
+                payload.append((const char *) &value.integer,
+                               sizeof(value.integer));
+                break;
+            case ColumnType::Float:
+                payload.append((const char *) &value.real, sizeof(value.real));
+                break;
+            case ColumnType::Text:
+            case ColumnType::BLOB: {
+                uint32_t size = (uint32_t) value.data.size();
+                payload.append((const char *) &size, sizeof(size));
+                payload.append(value.data);
+            } break;
+            default:
+                break;
+        }
+    }
+    uint32_t size = (uint32_t) payload.size();
+    uint32_t checksum = Checksum(payload.data(), payload.size());
+    record.append((const char *) &size, sizeof(size));
+    record.append((const char *) &checksum, sizeof(checksum));
+    record.append(payload);
+}
+
+bool WriteBuffer::Decode(const char *data,
+                         size_t size,
+                         int64_t &sequence,
+                         Row &row,
+                         size_t &consumed)
+{
+    uint32_t payloadSize, checksum, count;
+    const size_t headerSize = sizeof(payloadSize) + sizeof(checksum);
+    if (size < headerSize) {
+        return false;
+    }
+    memcpy(&payloadSize, data, sizeof(payloadSize));
+    memcpy(&checksum, data + sizeof(payloadSize), sizeof(checksum));
+    //Torn record at the tail
+    if (size - headerSize < payloadSize ||
+        Checksum(data + headerSize, payloadSize) != checksum) {
+        return false;
+    }
+    const char *cursor = data + headerSize;
+    const char *end = cursor + payloadSize;
+    if (end - cursor < (ptrdiff_t)(sizeof(sequence) + sizeof(count))) {
+        return false;
+    }
+    memcpy(&sequence, cursor, sizeof(sequence));
+    cursor += sizeof(sequence);
+    memcpy(&count, cursor, sizeof(count));
+    cursor += sizeof(count);
+    row.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (cursor >= end) {
+            return false;
+        }
+        ColumnType type = (ColumnType) *cursor++;
+        switch (type) {
+            case ColumnType::Null:
+                row.push_back(Value(nullptr));
+                break;
+            case ColumnType::Integer64: {
+                int64_t integer;
+                if (end - cursor < (ptrdiff_t) sizeof(integer)) {
+                    return false;
+                }
+                memcpy(&integer, cursor, sizeof(integer));
+                cursor += sizeof(integer);
+                row.push_back(Value(integer));
+            } break;
+            case ColumnType::Float: {
+                double real;
+                if (end - cursor < (ptrdiff_t) sizeof(real)) {
+                    return false;
+                }
+                memcpy(&real, cursor, sizeof(real));
+                cursor += sizeof(real);
+                row.push_back(Value(real));
+            } break;
+            case ColumnType::Text:
+            case ColumnType::BLOB: {
+                uint32_t length;
+                if (end - cursor < (ptrdiff_t) sizeof(length)) {
+                    return false;
+                }
+                memcpy(&length, cursor, sizeof(length));
+                cursor += sizeof(length);
+                if ((size_t)(end - cursor) < length) {
+                    return false;
+                }
+                if (type == ColumnType::Text) {
+                    row.push_back(Value(std::string(cursor, length)));
+                } else {
+                    row.push_back(Value(cursor, (int) length));
+                }
+                cursor += length;
+            } break;
+            default:
+                return false;
+        }
+    }
+    consumed = headerSize + payloadSize;
+    return true;
+}
+
+//Data is kept across power loss once it returns true
+static bool SyncFile(int fd)
+{
+#ifdef __APPLE__
+    //fsync of Darwin doesn't flush the cache of drive
+    if (fcntl(fd, F_FULLFSYNC) == 0) {
+        return true;
+    }
+#endif
+    return fsync(fd) == 0;
+}
+
+//Renamed entry is kept across power loss once it returns true
+static bool SyncDirectory(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    const std::string directory =
+        slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = SyncFile(fd);
+    return close(fd) == 0 && result;
+}
+
+bool WriteBuffer::openLog()
+{
+    if (m_logFD >= 0) {
+        return true;
+    }
+    m_logFD = open(getLogPath().c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (m_logFD < 0) {
+        Error::Warning(("Opening write buffer log failed: " + getLogPath() +
+                        ", " + strerror(errno))
+                           .c_str());
+        return false;
+    }
+    off_t size = lseek(m_logFD, 0, SEEK_END);
+    m_logSize = size > 0 ? (size_t) size : 0;
+    return true;
+}
+
+bool WriteBuffer::writeLog(const std::string &data)
+{
+    if (!openLog()) {
+        return false;
+    }
+    //Row is accepted once it's synced, so that it's kept across power loss
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result =
+            write(m_logFD, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        written += (size_t) result;
+    }
+    if (written == data.size() && SyncFile(m_logFD)) {
+        m_logSize += data.size();
+        return true;
+    }
+    Error::Warning(("Writing write buffer log failed: " + getLogPath() +
+                    ", " + strerror(errno))
+                       .c_str());
+    //Drop the partial record, which would hide the following ones
+    if (ftruncate(m_logFD, (off_t) m_logSize) != 0) {
+        close(m_logFD);
+        m_logFD = -1;
+    }
+    return false;
+}
+
+void WriteBuffer::compactLog()
+{
+    std::string data;
+    for (const auto &pending : m_pending) {
+        Encode(pending.first, pending.second, data);
+    }
+    const std::string logPath = getLogPath();
+    const std::string tempPath = logPath + "-temp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    //Temp file is synced before it replaces the log, so that the log is
+    //either the old one or the compacted one after power loss
+    bool result = write(fd, data.data(), data.size()) == (ssize_t) data.size();
+    result = result && SyncFile(fd);
+    result = close(fd) == 0 && result;
+    if (!result || rename(tempPath.c_str(), logPath.c_str()) != 0) {
+        Error innerError;
+        File::removeFile(tempPath, innerError);
+        return;
+    }
+    SyncDirectory(logPath);
+    if (m_logFD >= 0) {
+        close(m_logFD);
+        m_logFD = -1;
+    }
+    openLog();
+}
+
+void WriteBuffer::replay(int64_t sequence)
+{
+    if (!config.logged) {
+        return;
+    }
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (m_sequence < sequence) {
+        m_sequence = sequence;
+    }
+    if (!openLog()) {
+        return;
+    }
+    std::string data;
+    char buffer[4096];
+    ssize_t size;
+    lseek(m_logFD, 0, SEEK_SET);
+    while ((size = read(m_logFD, buffer, sizeof(buffer))) > 0) {
+        data.append(buffer, (size_t) size);
+    }
+
+    size_t offset = 0;
+    int64_t recordSequence;
+    Row row;
+    size_t consumed;
+    while (Decode(data.data() + offset, data.size() - offset,
+                  recordSequence, row, consumed)) {
+        offset += consumed;
+        if (recordSequence <= sequence) {
+            //Flushed before the crash, but the log wasn't truncated
+            continue;
+        }
+        if (m_pending.empty()) {
+            m_firstPending = std::chrono::steady_clock::now();
+        }
+        m_pendingBytes += GetSize(row);
+        m_pending.push_back({recordSequence, row});
+        if (recordSequence > m_sequence) {
+            m_sequence = recordSequence;
+        }
+    }
+    if (offset < data.size()) {
+        Error::Warning(("Torn write buffer log is truncated: " + getLogPath())
+                           .c_str());
+        if (ftruncate(m_logFD, (off_t) offset) == 0) {
+            m_logSize = offset;
+        }
+    }
+}
+
+WriteBuffer::Appended WriteBuffer::append(const Row &row)
+{
+    size_t size = GetSize(row);
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    //Back pressure while the flushes keep failing
+    if (m_pending.size() >= (size_t) config.maxRows * 4 ||
+        (m_pendingBytes > 0 && m_pendingBytes + size > config.maxBytes * 4)) {
+        return Appended::Failed;
+    }
+    int64_t sequence = m_sequence + 1;
+    if (config.logged) {
+        std::string record;
+        Encode(sequence, row, record);
+        if (!writeLog(record)) {
+            return Appended::Failed;
+        }
+    }
+    m_sequence = sequence;
+    bool first = m_pending.empty();
+    if (first) {
+        m_firstPending = std::chrono::steady_clock::now();
+    }
+    m_pending.push_back({sequence, row});
+    m_pendingBytes += size;
+    if (!m_flushRequested && (m_pending.size() >= (size_t) config.maxRows ||
+                              m_pendingBytes >= config.maxBytes)) {
+        m_flushRequested = true;
+        return Appended::Full;
+    }
+    return first ? Appended::First : Appended::Buffered;
+}
+
+bool WriteBuffer::hasPending() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return !m_pending.empty();
+}
+
+bool WriteBuffer::isDue() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return !m_pending.empty() &&
+           std::chrono::steady_clock::now() >= m_firstPending + config.window;
+}
+
+std::unique_lock<std::mutex> WriteBuffer::lockFlush()
+{
+    return std::unique_lock<std::mutex>(m_flushMutex);
+}
+
+void WriteBuffer::beginFlush(SequencedRows &rows)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    rows.clear();
+    rows.swap(m_pending);
+    m_pendingBytes = 0;
+    m_flushRequested = false;
+}
+
+void WriteBuffer::endFlush(SequencedRows &rows, bool succeed, double cost)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (succeed) {
+        ++m_statistics.flushes;
+        m_statistics.flushedRows += rows.size();
+        m_statistics.lastFlushCost = cost;
+        if (config.logged && m_logFD >= 0) {
+            if (m_pending.empty()) {
+                if (ftruncate(m_logFD, 0) == 0) {
+                    m_logSize = 0;
+                }
+            } else if (m_logSize > config.maxBytes * 2) {
+                //Rows appended during flush keep the log from truncation
+                compactLog();
+            }
+        }
+        return;
+    }
+    ++m_statistics.failures;
+    if (m_pending.empty()) {
+        m_firstPending = std::chrono::steady_clock::now();
+    }
+    for (const auto &pending : rows) {
+        m_pendingBytes += GetSize(pending.second);
+    }
+    m_pending.splice(m_pending.begin(), rows);
+}
+
+WriteBuffer::Statistics WriteBuffer::getStatistics() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.pendingRows = m_pending.size();
+    statistics.pendingBytes = m_pendingBytes;
+    return statistics;
+}
+
+} //namespace WCDB
@@ -0,0 +1,177 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef write_buffer_hpp
+#define write_buffer_hpp
+
+#include <WCDB/abstract.h>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WCDB {
+
+/*
+ * [WriteBuffer] accepts the inserts of an append-heavy table in memory and flushes them to database in batched transactions.
+ * It's flushed once [maxRows] or [maxBytes] is buffered, or the oldest buffered row has waited for [window].
+ * With [logged], each row is appended to a log file and synced before it's accepted. Rows are kept across process crash and power loss, and replayed once the buffer is set again.
+ * It costs a sync of the log per row.
+ * Unlogged rows are lost if the process exits before they are flushed.
+ */
+class WriteBuffer {
+public:
+    struct Config {
+        int maxRows;
+        size_t maxBytes;
+        //Buffered rows are flushed within it
+        std::chrono::seconds window;
+        bool logged;
+    };
+
+    struct Value {
+        Value(std::nullptr_t);
+        Value(int value);
+        Value(int64_t value);
+        Value(double value);
+        Value(const char *value);
+        Value(const std::string &value);
+        Value(const void *value, int size);
+
+        ColumnType type; //Null, Integer64, Float, Text or BLOB
+        int64_t integer;
+        double real;
+        std::string data; //Text or BLOB
+    };
+    typedef std::vector<Value> Row;
+    //sequence->row
+    typedef std::list<std::pair<int64_t, Row>> SequencedRows;
+
+    //[sequence] is the last flushed one, which is stored in database.
+    //Logged rows after it are replayed into the buffer before it's shared.
+    static std::shared_ptr<WriteBuffer>
+    Register(const std::string &path,
+             const std::string &table,
+             const std::list<std::string> &columns,
+             const Config &config,
+             int64_t sequence);
+    static void Unregister(const std::string &path, const std::string &table);
+    static std::shared_ptr<WriteBuffer> Get(const std::string &path,
+                                            const std::string &table);
+    static std::shared_ptr<WriteBuffer> GetByKey(const std::string &key);
+    static std::list<std::shared_ptr<WriteBuffer>>
+    GetAll(const std::string &path);
+    static std::list<std::string> GetLogPaths(const std::string &path);
+
+    const std::string path;
+    const std::string table;
+    const std::list<std::string> columns;
+    const Config config;
+
+    std::string getKey() const;
+    std::string getLogPath() const;
+
+    StatementInsert getInsertStatement() const;
+    //Sequence of the last flushed row of each logged buffer
+    static StatementCreateTable GetCreateSequenceTableStatement();
+    static StatementSelect GetSequenceStatement(const std::string &table);
+    StatementInsert getUpdateSequenceStatement() const;
+
+    enum class Appended : int {
+        Failed, //Log is unwritable or too much is pending
+        First,  //The first pending row, which starts the window
+        Buffered,
+        Full, //It should be flushed now
+    };
+    Appended append(const Row &row);
+    bool hasPending() const;
+    //The oldest pending row has waited for [window]
+    bool isDue() const;
+
+    //Flushes of a buffer are serialized to keep the order of rows
+    std::unique_lock<std::mutex> lockFlush();
+    //Take all pending rows
+    void beginFlush(SequencedRows &rows);
+    //Failed rows are put back in front of pending ones
+    void endFlush(SequencedRows &rows, bool succeed, double cost);
+
+    struct Statistics {
+        size_t pendingRows;
+        size_t pendingBytes;
+        uint64_t flushes;
+        uint64_t flushedRows;
+        uint64_t failures;
+        double lastFlushCost; //in seconds
+    };
+    Statistics getStatistics() const;
+
+    ~WriteBuffer();
+
+protected:
+    WriteBuffer(const std::string &path,
+                const std::string &table,
+                const std::list<std::string> &columns,
+                const Config &config);
+    WriteBuffer(const WriteBuffer &) = delete;
+    WriteBuffer &operator=(const WriteBuffer &) = delete;
+
+    static std::string GetKey(const std::string &path,
+                              const std::string &table);
+    static size_t GetSize(const Row &row);
+
+    void replay(int64_t sequence);
+
+    //Log record: size(4) checksum(4) sequence(8) count(4) values
+    static void Encode(int64_t sequence, const Row &row, std::string &record);
+    static bool Decode(const char *data,
+                       size_t size,
+                       int64_t &sequence,
+                       Row &row,
+                       size_t &consumed);
+    static uint32_t Checksum(const char *data, size_t size);
+    bool openLog();
+    bool writeLog(const std::string &data);
+    //Called with [m_mutex] locked
+    void compactLog();
+
+    mutable std::mutex m_mutex;
+    std::mutex m_flushMutex;
+    SequencedRows m_pending;
+    size_t m_pendingBytes;
+    int64_t m_sequence;
+    std::chrono::steady_clock::time_point m_firstPending;
+    bool m_flushRequested;
+    int m_logFD;
+    size_t m_logSize;
+    Statistics m_statistics;
+
+    static std::unordered_map<std::string, std::shared_ptr<WriteBuffer>>
+        s_buffers;
+    static std::atomic<int> s_count;
+    static std::mutex s_mutex;
+};
+
+} //namespace WCDB
+
+#endif /* write_buffer_hpp */
@@ -0,0 +1,144 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/bloom_filter.hpp>
+#include <cmath>
+#include <string.h>
+
+namespace WCDB {
+
+BloomFilter::BloomFilter(size_t expectedCount, double falsePositiveRate)
+    : m_expectedCount(expectedCount > 0 ? expectedCount : 1)
+    , m_addedCount(0)
+{
+    if (falsePositiveRate <= 0 || falsePositiveRate >= 1) {
+        falsePositiveRate = 0.01;
+    }
+    //m = -n*ln(p)/ln(2)^2, k = m/n*ln(2)
+    double bitCount = -(double) m_expectedCount * log(falsePositiveRate) /
+                      (M_LN2 * M_LN2);
+    m_bitCount = (size_t) ceil(bitCount / 64) * 64;
+    m_hashCount = (int) round((double) m_bitCount / m_expectedCount * M_LN2);
+    if (m_hashCount < 1) {
+        m_hashCount = 1;
+    }
+    m_bits.resize(m_bitCount / 64, 0);
+}
+
+uint64_t BloomFilter::Hash(const void *data, size_t size)
+{
+    //FNV-1a with a final avalanche
+    const unsigned char *bytes = (const unsigned char *) data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+void BloomFilter::add(const void *data, size_t size)
+{
+    //Double hashing: h(i) = h1 + i*h2
+    uint64_t hash = Hash(data, size);
+    uint64_t h1 = hash & 0xffffffff;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < m_hashCount; ++i) {
+        uint64_t bit = (h1 + i * h2) % m_bitCount;
+        m_bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    ++m_addedCount;
+}
+
+bool BloomFilter::mayContain(const void *data, size_t size) const
+{
+    uint64_t hash = Hash(data, size);
+    uint64_t h1 = hash & 0xffffffff;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < m_hashCount; ++i) {
+        uint64_t bit = (h1 + i * h2) % m_bitCount;
+        if ((m_bits[bit / 64] & (1ULL << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t BloomFilter::getBitCount() const
+{
+    return m_bitCount;
+}
+
+int BloomFilter::getHashCount() const
+{
+    return m_hashCount;
+}
+
+size_t BloomFilter::getMemorySize() const
+{
+    return m_bits.size() * sizeof(uint64_t);
+}
+
+size_t BloomFilter::getAddedCount() const
+{
+    return m_addedCount;
+}
+
+size_t BloomFilter::getExpectedCount() const
+{
+    return m_expectedCount;
+}
+
+//Layout: bitCount(8) hashCount(8) expectedCount(8) addedCount(8) bits
+std::string BloomFilter::serialize() const
+{
+    uint64_t header[4] = {m_bitCount, (uint64_t) m_hashCount, m_expectedCount,
+                          m_addedCount};
+    std::string data((const char *) header, sizeof(header));
+    data.append((const char *) m_bits.data(), getMemorySize());
+    return data;
+}
+
+bool BloomFilter::deserialize(const std::string &data)
+{
+    uint64_t header[4];
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(header, data.data(), sizeof(header));
+    if (header[0] == 0 || header[0] % 64 != 0 || header[1] == 0 ||
+        data.size() != sizeof(header) + header[0] / 8) {
+        return false;
+    }
+    m_bitCount = (size_t) header[0];
+    m_hashCount = (int) header[1];
+    m_expectedCount = (size_t) header[2];
+    m_addedCount = (size_t) header[3];
+    m_bits.resize(m_bitCount / 64);
+    memcpy(m_bits.data(), data.data() + sizeof(header), getMemorySize());
+    return true;
+}
+
+} //namespace WCDB
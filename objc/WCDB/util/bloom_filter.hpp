@@ -0,0 +1,61 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef bloom_filter_hpp
+#define bloom_filter_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace WCDB {
+
+class BloomFilter {
+public:
+    BloomFilter(size_t expectedCount, double falsePositiveRate);
+
+    void add(const void *data, size_t size);
+    //false means it's not added definitely
+    bool mayContain(const void *data, size_t size) const;
+
+    size_t getBitCount() const;
+    int getHashCount() const;
+    size_t getMemorySize() const;
+    size_t getAddedCount() const;
+    size_t getExpectedCount() const;
+
+    //serialization
+    std::string serialize() const;
+    bool deserialize(const std::string &data);
+
+protected:
+    static uint64_t Hash(const void *data, size_t size);
+
+    std::vector<uint64_t> m_bits;
+    size_t m_bitCount;
+    int m_hashCount;
+    size_t m_expectedCount;
+    size_t m_addedCount;
+};
+
+} //namespace WCDB
+
+#endif /* bloom_filter_hpp */
@@ -0,0 +1,69 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/cancellation.hpp>
+
+namespace WCDB {
+
+Cancellation::Cancellation() : m_token(new Token)
+{
+    m_token->cancelled = false;
+    m_token->deadline = 0;
+}
+
+void Cancellation::cancel()
+{
+    m_token->cancelled = true;
+}
+
+void Cancellation::setDeadline(
+    const std::chrono::steady_clock::time_point &deadline)
+{
+    m_token->deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            deadline.time_since_epoch())
+                            .count();
+}
+
+void Cancellation::setTimeout(const std::chrono::milliseconds &timeout)
+{
+    setDeadline(std::chrono::steady_clock::now() + timeout);
+}
+
+bool Cancellation::isCancelled() const
+{
+    return getState() != State::None;
+}
+
+Cancellation::State Cancellation::getState() const
+{
+    if (m_token->cancelled.load(std::memory_order_relaxed)) {
+        return State::Cancelled;
+    }
+    int64_t deadline = m_token->deadline.load(std::memory_order_relaxed);
+    if (deadline > 0 &&
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+                .count() >= deadline) {
+        return State::Expired;
+    }
+    return State::None;
+}
+
+} //namespace WCDB
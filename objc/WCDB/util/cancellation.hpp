@@ -0,0 +1,61 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef cancellation_hpp
+#define cancellation_hpp
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace WCDB {
+
+/*
+ * [Cancellation] is a token shared by its copies.
+ * It can be cancelled or given a deadline from any thread. Statements running under it will be interrupted cooperatively.
+ */
+class Cancellation {
+public:
+    Cancellation();
+
+    enum class State : int {
+        None = 0,
+        Cancelled = 1,
+        Expired = 2,
+    };
+
+    void cancel();
+    void setDeadline(const std::chrono::steady_clock::time_point &deadline);
+    void setTimeout(const std::chrono::milliseconds &timeout);
+
+    bool isCancelled() const;
+    State getState() const;
+
+protected:
+    typedef struct {
+        std::atomic<bool> cancelled;
+        std::atomic<int64_t> deadline; //in nanoseconds, 0 for none
+    } Token;
+    std::shared_ptr<Token> m_token;
+};
+
+} //namespace WCDB
+
+#endif /* cancellation_hpp */
@@ -22,7 +22,9 @@
 #define concurrent_list_hpp
 
 #include <WCDB/spin.hpp>
+#include <functional>
 #include <list>
+#include <memory>
 
 namespace WCDB {
 
@@ -92,6 +94,15 @@ public:
         return m_list.size();
     }
 
+    //Elements are neither pushed nor popped by others while visited
+    void forEach(const std::function<void(const ElementType &)> &visit)
+    {
+        SpinLockGuard<Spin> lockGuard(m_spin);
+        for (const ElementType &value : m_list) {
+            visit(value);
+        }
+    }
+
     size_t clear()
     {
         SpinLockGuard<Spin> lockGuard(m_spin);
@@ -62,7 +62,27 @@ ErrorValue::Type ErrorValue::getType() const
     return m_type;
 }
 
-std::shared_ptr<Error::ReportMethod> Error::s_reportMethod;
+std::shared_ptr<Error::ReportMethod>
+    Error::s_reportMethod(new Error::ReportMethod([](const Error &error) {
+        switch (error.getType()) {
+            case Error::Type::SQLiteGlobal:
+#if DEBUG
+                printf("[WCDB][DEBUG]%s\n", error.description().c_str());
+#endif
+                break;
+            case Error::Type::Warning:
+                printf("[WCDB][WARNING]%s\n", error.description().c_str());
+                break;
+            default:
+                printf("[WCDB][ERROR]%s\n", error.description().c_str());
+#if DEBUG
+                if (error.getType() == Error::Type::Abort) {
+                    abort();
+                }
+#endif
+                break;
+        }
+    }));
 
 ThreadLocal<bool> Error::s_slient(false);
 
@@ -105,33 +125,12 @@ void Error::reset()
 void Error::report() const
 {
     if (!*s_slient.get()) {
-        if (!s_reportMethod) {
-            s_reportMethod.reset(
-                (new Error::ReportMethod([](const Error &error) {
-                    switch (error.getType()) {
-                        case Error::Type::SQLiteGlobal:
-#if DEBUG
-                            printf("[WCDB][DEBUG]%s\n",
-                                   error.description().c_str());
-#endif
-                            break;
-                        case Error::Type::Warning:
-                            printf("[WCDB][WARNING]%s\n",
-                                   error.description().c_str());
-                            break;
-                        default:
-                            printf("[WCDB][ERROR]%s\n",
-                                   error.description().c_str());
-#if DEBUG
-                            if (error.getType() == Error::Type::Abort) {
-                                abort();
-                            }
-#endif
-                            break;
-                    }
-                })));
+        //It may be set by another thread meanwhile
+        std::shared_ptr<ReportMethod> reportMethod =
+            std::atomic_load(&s_reportMethod);
+        if (reportMethod) {
+            (*reportMethod)(*this);
         }
-        (*s_reportMethod)(*this);
     }
 }
 
@@ -218,7 +217,8 @@ std::string Error::description() const
 
 void Error::SetReportMethod(const ReportMethod &reportMethod)
 {
-    s_reportMethod.reset(new ReportMethod(reportMethod));
+    std::atomic_store(&s_reportMethod,
+                      std::make_shared<ReportMethod>(reportMethod));
 }
 
 void Error::Report(Error::Type type,
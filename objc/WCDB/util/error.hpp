@@ -26,6 +26,7 @@
 #include <climits>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
 namespace WCDB {
@@ -86,6 +87,10 @@ public:
         Finalize = 6,
         SetCipherKey = 7,
         IsTableExists = 8,
+        CreateFunction = 9,
+        Session = 10,
+        ApplyChangeset = 11,
+        Copy = 12,
     };
     enum class InterfaceOperation : int {
         StatementHandle = 1,
@@ -105,6 +110,7 @@ public:
         GetThreadedHandle = 6,
         FlowOut = 7,
         Tokenize = 8,
+        Step = 9,
     };
     enum class SystemCallOperation : int {
         Lstat = 1,
@@ -113,6 +119,8 @@ public:
         Link = 4,
         Unlink = 5,
         Mkdir = 6,
+        Rename = 7,
+        Truncate = 8,
     };
     enum class RepairOperation : int {
         SaveMaster,
@@ -123,6 +131,8 @@ public:
     enum class CoreCode : int {
         Misuse = 1,
         Exceed = 2,
+        Cancelled = 3,
+        Expired = 4,
     };
     enum class InterfaceCode : int {
         ORM = 1,
@@ -92,6 +92,26 @@ bool removeFile(const std::string &path, Error &error)
     return false;
 }
 
+bool renameFile(const std::string &from, const std::string &to, Error &error)
+{
+    if (rename(from.c_str(), to.c_str()) == 0) {
+        return true;
+    }
+    Error::ReportSystemCall(Error::SystemCallOperation::Rename, to, errno,
+                            strerror(errno), &error);
+    return false;
+}
+
+bool truncateFile(const std::string &path, size_t size, Error &error)
+{
+    if (truncate(path.c_str(), (off_t) size) == 0) {
+        return true;
+    }
+    Error::ReportSystemCall(Error::SystemCallOperation::Truncate, path, errno,
+                            strerror(errno), &error);
+    return false;
+}
+
 bool createDirectory(const std::string &path, Error &error)
 {
     if (mkdir(path.c_str(), 0755) == 0) {
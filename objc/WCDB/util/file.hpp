@@ -36,6 +36,9 @@ bool createHardLink(const std::string &from,
                     Error &error);
 bool removeHardLink(const std::string &path, Error &error);
 bool removeFile(const std::string &path, Error &error);
+bool renameFile(const std::string &from, const std::string &to, Error &error);
+//It's filled with zeros if it grows
+bool truncateFile(const std::string &path, size_t size, Error &error);
 bool createDirectory(const std::string &path, Error &error);
 //Combination
 size_t getFilesSize(const std::list<std::string> &paths, Error &error);
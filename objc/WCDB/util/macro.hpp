@@ -21,8 +21,17 @@
 #ifndef macro_hpp
 #define macro_hpp
 
+#include <pthread.h>
+
 #define _CONCAT(a, b) a##b
 #define CONCAT(a, b) _CONCAT(a, b)
 #define UNUSED_UNIQUE_ID CONCAT(_unused, __COUNTER__)
 
+//Name of current thread, which is truncated to 15 characters on Linux
+#ifdef __APPLE__
+#define SET_THREAD_NAME(name) pthread_setname_np(name)
+#else
+#define SET_THREAD_NAME(name) pthread_setname_np(pthread_self(), name)
+#endif
+
 #endif /* macro_hpp */
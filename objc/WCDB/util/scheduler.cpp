@@ -0,0 +1,298 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <WCDB/macro.hpp>
+#include <WCDB/scheduler.hpp>
+#include <algorithm>
+#include <pthread.h>
+#include <thread>
+
+namespace WCDB {
+
+const Scheduler::Duration Scheduler::s_maxHoldBack = std::chrono::seconds(5);
+const Scheduler::Duration Scheduler::s_maxHighHoldBack =
+    std::chrono::seconds(1);
+
+ThreadLocal<bool> Scheduler::s_background(false);
+ThreadLocal<Scheduler::Priority>
+    Scheduler::s_priority(Scheduler::Priority::Low);
+ThreadLocal<Scheduler::Duration> Scheduler::s_heldBack(Scheduler::Duration(0));
+
+Scheduler *Scheduler::shared()
+{
+    static Scheduler s_scheduler;
+    return &s_scheduler;
+}
+
+Scheduler::Scheduler()
+    : m_sequence(0)
+    , m_running(0)
+    , m_urgentRunning(0)
+    , m_concurrency(2)
+    , m_threads(0)
+    , m_idleThreads(0)
+    , m_budget(0)
+    , m_slice(std::chrono::milliseconds(100))
+    , m_debt(std::chrono::steady_clock::now())
+    , m_threshold(0)
+    , m_holdBack(std::chrono::milliseconds(100))
+    , m_lastSlow()
+    , m_pending(0)
+    , m_finished(0)
+    , m_consumedBytes(0)
+    , m_throttled(0)
+    , m_heldBack(0)
+{
+}
+
+bool Scheduler::IsBackgroundThread()
+{
+    return *s_background.get();
+}
+
+bool Scheduler::IsUrgentThread()
+{
+    return *s_background.get() && *s_priority.get() == Priority::Urgent;
+}
+
+bool Scheduler::CanHoldBack(const Duration &heldBack)
+{
+    if (*s_priority.get() == Priority::High) {
+        return *s_heldBack.get() + heldBack < s_maxHighHoldBack;
+    }
+    return heldBack < s_maxHoldBack;
+}
+
+void Scheduler::ChargeHoldBack(const Duration &heldBack)
+{
+    if (*s_priority.get() == Priority::High) {
+        *s_heldBack.get() += heldBack;
+    }
+}
+
+void Scheduler::post(Priority priority, const Work &work)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    auto iter = m_works.begin();
+    while (iter != m_works.end() && iter->first <= priority) {
+        ++iter;
+    }
+    m_works.insert(iter, {priority, work});
+    ++m_pending;
+    //Posted works may run as many as the concurrency
+    if (m_idleThreads == 0 && m_threads < m_concurrency) {
+        ++m_threads;
+        std::thread thread([this]() {
+            SET_THREAD_NAME("WCDB-scheduler");
+            loop();
+        });
+        thread.detach();
+    }
+    m_worksCond.notify_one();
+}
+
+void Scheduler::loop()
+{
+    while (true) {
+        std::pair<Priority, Work> element;
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            ++m_idleThreads;
+            while (m_works.empty()) {
+                m_worksCond.wait(lockGuard);
+            }
+            --m_idleThreads;
+            element = m_works.front();
+            m_works.pop_front();
+            --m_pending;
+        }
+        run(element.first, element.second);
+    }
+}
+
+void Scheduler::run(Priority priority, const Work &work)
+{
+    bool *background = s_background.get();
+    if (*background) {
+        //nested work runs in the turn of its outer work
+        work();
+        return;
+    }
+    *s_priority.get() = priority;
+    *s_heldBack.get() = Duration(0);
+    acquire(priority);
+    *background = true;
+    work();
+    *background = false;
+    release(priority);
+}
+
+void Scheduler::acquire(Priority priority)
+{
+    std::unique_lock<std::mutex> lockGuard(m_mutex);
+    if (priority == Priority::Urgent) {
+        ++m_urgentRunning;
+        ++m_pending;
+        return;
+    }
+    Ticket ticket = {priority, m_sequence++};
+    m_tickets.insert(ticket);
+    ++m_pending;
+    Time begin = std::chrono::steady_clock::now();
+    bool heldBack = false;
+    while (true) {
+        if (m_running >= m_concurrency || *m_tickets.begin() != ticket) {
+            m_cond.wait(lockGuard);
+            continue;
+        }
+        Time now = std::chrono::steady_clock::now();
+        if (CanHoldBack(now - begin) && isHoldingBack(now)) {
+            if (!heldBack) {
+                heldBack = true;
+                ++m_heldBack;
+            }
+            m_cond.wait_until(lockGuard, std::min(m_lastSlow + m_holdBack,
+                                                  now + s_maxHighHoldBack));
+            continue;
+        }
+        break;
+    }
+    ChargeHoldBack(std::chrono::steady_clock::now() - begin);
+    m_tickets.erase(ticket);
+    ++m_running;
+    //The next one may be admitted as well
+    m_cond.notify_all();
+}
+
+void Scheduler::release(Priority priority)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    if (priority == Priority::Urgent) {
+        --m_urgentRunning;
+    } else {
+        --m_running;
+    }
+    ++m_finished;
+    --m_pending;
+    m_cond.notify_all();
+}
+
+void Scheduler::consume(size_t bytes)
+{
+    std::unique_lock<std::mutex> lockGuard(m_mutex);
+    m_consumedBytes += bytes;
+    if (IsUrgentThread()) {
+        return;
+    }
+    Time now = std::chrono::steady_clock::now();
+    if (m_budget > 0) {
+        //Leaky bucket. The burst is limited to one slice.
+        Time floor = now - m_slice;
+        if (m_debt < floor) {
+            m_debt = floor;
+        }
+        m_debt += std::chrono::duration_cast<Duration>(
+            std::chrono::duration<double, Duration::period>(
+                (double) m_slice.count() * bytes / m_budget));
+        if (m_debt > now) {
+            ++m_throttled;
+            Time until = m_debt;
+            while (now < until) {
+                m_cond.wait_until(lockGuard, until);
+                now = std::chrono::steady_clock::now();
+            }
+        }
+    }
+    Time begin = now;
+    bool heldBack = false;
+    while (CanHoldBack(now - begin) && isHoldingBack(now)) {
+        if (!heldBack) {
+            heldBack = true;
+            ++m_heldBack;
+        }
+        m_cond.wait_until(lockGuard, std::min(m_lastSlow + m_holdBack,
+                                              now + s_maxHighHoldBack));
+        now = std::chrono::steady_clock::now();
+    }
+    ChargeHoldBack(now - begin);
+}
+
+void Scheduler::setBudget(size_t bytesPerSlice,
+                          const std::chrono::milliseconds &slice)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_budget = bytesPerSlice;
+    m_slice = slice;
+}
+
+void Scheduler::setConcurrency(size_t concurrency)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_concurrency = std::max(concurrency, (size_t) 1);
+    m_cond.notify_all();
+}
+
+void Scheduler::setLatencyThreshold(const std::chrono::microseconds &threshold,
+                                    const std::chrono::milliseconds &holdBack)
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_threshold =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(threshold)
+            .count();
+    m_holdBack = holdBack;
+    m_cond.notify_all();
+}
+
+bool Scheduler::isHoldingBack(const Time &now) const
+{
+    return m_threshold.load() > 0 && now < m_lastSlow + m_holdBack;
+}
+
+bool Scheduler::shouldObserveForeground() const
+{
+    return m_threshold.load(std::memory_order_relaxed) > 0 &&
+           m_pending.load(std::memory_order_relaxed) > 0;
+}
+
+void Scheduler::observeForeground(const Duration &cost)
+{
+    if (IsBackgroundThread() ||
+        std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count() <
+            m_threshold.load()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    m_lastSlow = std::chrono::steady_clock::now();
+}
+
+Scheduler::Metrics Scheduler::getMetrics() const
+{
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    Metrics metrics;
+    metrics.queued = m_tickets.size() + m_works.size();
+    metrics.running = m_running + m_urgentRunning;
+    metrics.finished = m_finished;
+    metrics.consumedBytes = m_consumedBytes;
+    metrics.throttled = m_throttled;
+    metrics.heldBack = m_heldBack;
+    return metrics;
+}
+
+} //namespace WCDB
@@ -0,0 +1,142 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef scheduler_hpp
+#define scheduler_hpp
+
+#include <WCDB/thread_local.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+
+namespace WCDB {
+
+/*
+ * [Scheduler] is the process-wide coordinator of background maintenance, e.g. checkpoint, backup, repair and vacuum.
+ * Works are admitted in priority order, up to the concurrency at a time.
+ * I/O issued by works is charged by [consume] before it's done, and throttled to the budget per time slice.
+ * Works are held back while foreground statements are slower than the latency threshold.
+ * High works, e.g. the ones the user is waiting for, go first and are held back for a bounded time in total.
+ * Urgent works, i.e. checkpoint of a WAL over its size limit, are neither queued, throttled nor held back.
+ */
+class Scheduler {
+public:
+    static Scheduler *shared();
+
+    enum class Priority : int {
+        Urgent = -1,
+        High = 0,
+        Default = 1,
+        Low = 2,
+    };
+
+    typedef std::function<void(void)> Work;
+    //Work will be run on the scheduler thread
+    void post(Priority priority, const Work &work);
+    //Work will be run on current thread once its turn comes
+    void run(Priority priority, const Work &work);
+
+    //Charge the I/O that running work is about to issue. It blocks while the budget is exceeded or the foreground is slow.
+    void consume(size_t bytes);
+
+    //Number of non-urgent works running at the same time. 2 by default.
+    void setConcurrency(size_t concurrency);
+
+    //0 for unlimited
+    void setBudget(size_t bytesPerSlice,
+                   const std::chrono::milliseconds &slice);
+    //0 for never hold back
+    void setLatencyThreshold(const std::chrono::microseconds &threshold,
+                             const std::chrono::milliseconds &holdBack);
+
+    typedef std::chrono::steady_clock::time_point Time;
+    typedef std::chrono::steady_clock::duration Duration;
+    bool shouldObserveForeground() const;
+    void observeForeground(const Duration &cost);
+
+    struct Metrics {
+        size_t queued;
+        size_t running;
+        uint64_t finished;
+        uint64_t consumedBytes;
+        uint64_t throttled;
+        uint64_t heldBack;
+    };
+    Metrics getMetrics() const;
+
+    static bool IsBackgroundThread();
+    static bool IsUrgentThread();
+
+protected:
+    Scheduler();
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    typedef std::pair<Priority, uint64_t> Ticket;
+    void acquire(Priority priority);
+    void release(Priority priority);
+    bool isHoldingBack(const Time &now) const;
+    //[heldBack] is the time current work has been held back by the caller
+    static bool CanHoldBack(const Duration &heldBack);
+    static void ChargeHoldBack(const Duration &heldBack);
+    void loop();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::set<Ticket> m_tickets;
+    uint64_t m_sequence;
+    size_t m_running;
+    size_t m_urgentRunning;
+    size_t m_concurrency;
+
+    std::list<std::pair<Priority, Work>> m_works;
+    std::condition_variable m_worksCond;
+    size_t m_threads;
+    size_t m_idleThreads;
+
+    size_t m_budget;
+    Duration m_slice;
+    Time m_debt;
+
+    std::atomic<int64_t> m_threshold; //in nanoseconds
+    Duration m_holdBack;
+    Time m_lastSlow;
+    std::atomic<size_t> m_pending;
+
+    uint64_t m_finished;
+    uint64_t m_consumedBytes;
+    uint64_t m_throttled;
+    uint64_t m_heldBack;
+
+    static const Duration s_maxHoldBack;
+    static const Duration s_maxHighHoldBack;
+    static ThreadLocal<bool> s_background;
+    static ThreadLocal<Priority> s_priority;
+    //Time held back since the high work began
+    static ThreadLocal<Duration> s_heldBack;
+};
+
+} //namespace WCDB
+
+#endif /* scheduler_hpp */
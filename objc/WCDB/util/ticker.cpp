@@ -19,7 +19,11 @@
  */
 
 #include <WCDB/ticker.hpp>
+#ifdef __APPLE__
 #include <mach/mach_time.h>
+#else
+#include <chrono>
+#endif
 #include <mutex>
 
 namespace WCDB {
@@ -30,7 +34,13 @@ Ticker::Ticker() : m_base(0)
 
 void Ticker::tick()
 {
+#ifdef __APPLE__
     uint64_t now = mach_absolute_time();
+#else
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+#endif
     if (m_base != 0) {
         m_elapses.push_back(now - m_base);
     }
@@ -78,10 +88,16 @@ inline double Ticker::secondsFromElapse(const uint64_t &elapse)
     static double s_denom = 0;
     static std::once_flag s_once;
     std::call_once(s_once, []() {
+#ifdef __APPLE__
         mach_timebase_info_data_t info;
         mach_timebase_info(&info);
         s_numer = info.numer;
         s_denom = info.denom;
+#else
+        //Elapses are in nanoseconds
+        s_numer = 1;
+        s_denom = 1;
+#endif
     });
 
     return (double) elapse * s_numer / s_denom / 1000 / 1000 / 1000;
@@ -21,6 +21,7 @@
 #ifndef ticker_hpp
 #define ticker_hpp
 
+#include <memory>
 #include <string>
 #include <vector>
 
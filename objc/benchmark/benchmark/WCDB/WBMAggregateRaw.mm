@@ -0,0 +1,123 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "WBMAggregateRaw.h"
+#import <WCDB/database.hpp>
+
+static const int WBMAggregateGroupCount = 1000;
+
+@implementation WBMAggregateRaw {
+    std::shared_ptr<WCDB::Database> _database;
+}
+
++ (const NSString *)benchmarkType
+{
+    return WCTBenchmarkTypeAggregateRaw;
+}
+
+- (void)prepare
+{
+    WCDB::Database database(_path.UTF8String);
+    WCDB::Error error;
+    std::string table = _tableName.UTF8String;
+    std::list<const WCDB::ColumnDef> columnDefs = {
+        WCDB::ColumnDef(WCDB::Column("groupKey"), WCDB::ColumnType::Integer64),
+        WCDB::ColumnDef(WCDB::Column("size"), WCDB::ColumnType::Integer64),
+    };
+    BOOL result = database.exec(WCDB::StatementCreateTable().create(table, columnDefs), error);
+    //Raw query is served by index, as is the common practice
+    std::list<const WCDB::ColumnIndex> columnIndexes = {WCDB::ColumnIndex(WCDB::Column("groupKey"))};
+    result = result && database.exec(WCDB::StatementCreateIndex().create(table + "_index").on(table, columnIndexes), error);
+    if (!result) {
+        abort();
+    }
+    NSUInteger count = _config.batchWriteCount;
+    result = database.runTransaction(
+        [&database, &table, count](WCDB::Error &error) -> bool {
+            WCDB::RecyclableStatement statement = database.prepare(
+                WCDB::StatementInsert()
+                    .insert(table, {WCDB::Column("groupKey"), WCDB::Column("size")}, WCDB::Conflict::NotSet)
+                    .values({WCDB::Expr::BindParameter, WCDB::Expr::BindParameter}),
+                error);
+            if (!statement) {
+                return false;
+            }
+            for (NSUInteger i = 0; i < count; ++i) {
+                statement->reset();
+                statement->bind<WCDB::ColumnType::Integer64>(i % WBMAggregateGroupCount, 1);
+                statement->bind<WCDB::ColumnType::Integer64>(i, 2);
+                statement->step();
+                if (!statement->isOK()) {
+                    error = statement->getError();
+                    return false;
+                }
+            }
+            return true;
+        },
+        nullptr, error);
+    if (!result) {
+        abort();
+    }
+    database.close(nullptr);
+}
+
+- (void)preBenchmark
+{
+    _database.reset(new WCDB::Database(_path.UTF8String));
+    if (!_database->canOpen()) {
+        abort();
+    }
+}
+
+- (NSUInteger)benchmark
+{
+    WCDB::Error error;
+    WCDB::Column groupKey("groupKey");
+    WCDB::RecyclableStatement statement = _database->prepare(
+        WCDB::StatementSelect()
+            .select({WCDB::ColumnResult(WCDB::Expr(WCDB::Column::Any).count()),
+                     WCDB::ColumnResult(WCDB::Expr(WCDB::Column("size")).sum())})
+            .from(_tableName.UTF8String)
+            .where(WCDB::Expr(groupKey) == WCDB::Expr::BindParameter),
+        error);
+    if (!statement) {
+        abort();
+    }
+    int64_t total = 0;
+    for (int i = 0; i < WBMAggregateGroupCount; ++i) {
+        statement->reset();
+        statement->bind<WCDB::ColumnType::Integer64>(i, 1);
+        if (!statement->step()) {
+            abort();
+        }
+        total += statement->getValue<WCDB::ColumnType::Integer64>(0);
+    }
+    if (total != (int64_t) _config.batchWriteCount) {
+        abort();
+    }
+    return WBMAggregateGroupCount;
+}
+
+- (void)postBenchmark
+{
+    _database.reset();
+}
+
+@end
@@ -0,0 +1,112 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "WBMConfigOrder.h"
+#import <WCDB/database.hpp>
+#include <mutex>
+#include <vector>
+
+//Each reopening invokes all the configs in order
+static const int s_configCount = 64;
+static const int s_openCount = 1000;
+
+@implementation WBMConfigOrder {
+    std::shared_ptr<WCDB::Database> _database;
+    std::shared_ptr<std::mutex> _mutex;
+    std::shared_ptr<std::vector<int>> _invoked;
+}
+
++ (const NSString *)benchmarkType
+{
+    return WCTBenchmarkTypeConfigOrder;
+}
+
+- (void)prepare
+{
+    WCTDatabase *database = [[WCTDatabase alloc] initWithPath:_path];
+    {
+        BOOL result = [database createTableAndIndexesOfName:_tableName withClass:WBMObject.class];
+        if (!result) {
+            abort();
+        }
+    }
+    [database close];
+}
+
+- (void)preBenchmark
+{
+    _database.reset(new WCDB::Database(_path.UTF8String));
+    _mutex.reset(new std::mutex);
+    _invoked.reset(new std::vector<int>);
+
+    //Set in descending order, so that each one is inserted in front of the others
+    std::shared_ptr<std::mutex> mutex = _mutex;
+    std::shared_ptr<std::vector<int>> invoked = _invoked;
+    for (int i = s_configCount - 1; i >= 0; --i) {
+        WCDB::Configs::Order order = (WCDB::Configs::Order) WCDB::Database::ConfigOrder::Attach + 1 + i;
+        _database->setConfig("config_order_" + std::to_string(i), [mutex, invoked, i](std::shared_ptr<WCDB::Handle> &handle, WCDB::Error &error) -> bool {
+            std::lock_guard<std::mutex> lockGuard(*mutex.get());
+            invoked->push_back(i);
+            error.reset();
+            return true;
+        }, order);
+    }
+    //Resetting one keeps its order and the others
+    _database->setConfig("config_order_0", [mutex, invoked](std::shared_ptr<WCDB::Handle> &handle, WCDB::Error &error) -> bool {
+        std::lock_guard<std::mutex> lockGuard(*mutex.get());
+        invoked->push_back(0);
+        error.reset();
+        return true;
+    });
+}
+
+- (NSUInteger)benchmark
+{
+    for (int i = 0; i < s_openCount; ++i) {
+        {
+            std::lock_guard<std::mutex> lockGuard(*_mutex.get());
+            _invoked->clear();
+        }
+        if (!_database->canOpen()) {
+            abort();
+        }
+        {
+            std::lock_guard<std::mutex> lockGuard(*_mutex.get());
+            if (_invoked->size() != s_configCount) {
+                abort();
+            }
+            for (int j = 0; j < s_configCount; ++j) {
+                if ((*_invoked.get())[j] != j) {
+                    abort();
+                }
+            }
+        }
+        _database->close(nullptr);
+    }
+    return s_openCount;
+}
+
+- (void)postBenchmark
+{
+    _database.reset();
+}
+
+@end
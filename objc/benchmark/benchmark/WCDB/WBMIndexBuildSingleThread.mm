@@ -0,0 +1,107 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "WBMIndexBuildSingleThread.h"
+#import <WCDB/database.hpp>
+
+//Index is built by the sorter of the calling thread only
+static const int WBMIndexBuildWorkerThreads = 0;
+
+@implementation WBMIndexBuildSingleThread {
+    std::shared_ptr<WCDB::Database> _database;
+}
+
++ (const NSString *)benchmarkType
+{
+    return WCTBenchmarkTypeIndexBuildSingleThread;
+}
+
+- (void)prepare
+{
+    WCDB::Database database(_path.UTF8String);
+    WCDB::Error error;
+    std::string table = _tableName.UTF8String;
+    std::list<const WCDB::ColumnDef> columnDefs = {
+        WCDB::ColumnDef(WCDB::Column("key"), WCDB::ColumnType::Integer64),
+        WCDB::ColumnDef(WCDB::Column("value"), WCDB::ColumnType::BLOB),
+    };
+    BOOL result = database.exec(WCDB::StatementCreateTable().create(table, columnDefs), error);
+    if (!result) {
+        abort();
+    }
+    NSUInteger count = _config.batchWriteCount;
+    NSData *value = [_randomGenerator dataWithLength:_config.valueLength];
+    result = database.runTransaction(
+        [&database, &table, count, value](WCDB::Error &error) -> bool {
+            WCDB::RecyclableStatement statement = database.prepare(
+                WCDB::StatementInsert()
+                    .insert(table, {WCDB::Column("key"), WCDB::Column("value")}, WCDB::Conflict::NotSet)
+                    .values({WCDB::Expr::BindParameter, WCDB::Expr::BindParameter}),
+                error);
+            if (!statement) {
+                return false;
+            }
+            for (NSUInteger i = 0; i < count; ++i) {
+                statement->reset();
+                //Keys are shuffled, so that they are really sorted
+                statement->bind<WCDB::ColumnType::Integer64>((i * 2654435761u) % count, 1);
+                statement->bind<WCDB::ColumnType::BLOB>(value.bytes, (int) value.length, 2);
+                statement->step();
+                if (!statement->isOK()) {
+                    error = statement->getError();
+                    return false;
+                }
+            }
+            return true;
+        },
+        nullptr, error);
+    if (!result) {
+        abort();
+    }
+    database.close(nullptr);
+}
+
+- (void)preBenchmark
+{
+    _database.reset(new WCDB::Database(_path.UTF8String));
+    if (!_database->canOpen()) {
+        abort();
+    }
+}
+
+- (NSUInteger)benchmark
+{
+    WCDB::Error error;
+    std::string table = _tableName.UTF8String;
+    std::list<const WCDB::ColumnIndex> columnIndexes = {WCDB::ColumnIndex(WCDB::Column("key"))};
+    WCDB::Database::SortBudget budget = {WBMIndexBuildWorkerThreads, 64 * 1024 * 1024};
+    BOOL result = _database->exec(WCDB::StatementCreateIndex().create(table + "_index").on(table, columnIndexes), budget, error);
+    if (!result) {
+        abort();
+    }
+    return _config.batchWriteCount;
+}
+
+- (void)postBenchmark
+{
+    _database.reset();
+}
+
+@end
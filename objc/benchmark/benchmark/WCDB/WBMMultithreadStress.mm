@@ -0,0 +1,246 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "WBMMultithreadStress.h"
+#import <WCDB/database.hpp>
+#import <atomic>
+#import <random>
+
+//Each thread runs a mix of operations drawn from its own generator seeded by the config, so that a failed run can be replayed with the same seed.
+static const int WBMStressThreadCount = 8;
+static const int64_t WBMStressTimeout = 600; //seconds
+
+typedef NS_ENUM(int, WBMStressOperation) {
+    WBMStressOperationRead = 0,
+    WBMStressOperationWrite,
+    WBMStressOperationTransaction,
+    WBMStressOperationRollback,
+    WBMStressOperationConfig,
+    WBMStressOperationPurge,
+    WBMStressOperationClose,
+    WBMStressOperationStatistics,
+};
+
+@implementation WBMMultithreadStress {
+    std::shared_ptr<WCDB::Database> _database;
+    dispatch_group_t _group;
+    dispatch_queue_t _queue;
+    NSData *_cipher;
+    NSData *_value;
+    //Rows of committed writes
+    std::atomic<int64_t> _committed;
+    std::atomic<int64_t> _nextKey;
+    std::atomic<int64_t> _operations;
+}
+
++ (const NSString *)benchmarkType
+{
+    return WCTBenchmarkTypeMultithreadStress;
+}
+
+- (instancetype)initWithConfig:(WCTBenchmarkConfig *)config
+{
+    if (self = [super initWithConfig:config]) {
+        _cipher = [@"stress" dataUsingEncoding:NSASCIIStringEncoding];
+    }
+    return self;
+}
+
+- (void)prepare
+{
+    WCDB::Database database(_path.UTF8String);
+    database.setCipher(_cipher.bytes, (int) _cipher.length);
+    WCDB::Error error;
+    std::list<const WCDB::ColumnDef> columnDefs = {
+        WCDB::ColumnDef(WCDB::Column("key"), WCDB::ColumnType::Integer64).makePrimary(),
+        WCDB::ColumnDef(WCDB::Column("value"), WCDB::ColumnType::BLOB),
+    };
+    BOOL result = database.exec(WCDB::StatementCreateTable().create(_tableName.UTF8String, columnDefs), error);
+    if (!result) {
+        abort();
+    }
+    database.close(nullptr);
+}
+
+- (void)preBenchmark
+{
+    _database.reset(new WCDB::Database(_path.UTF8String));
+    _database->setCipher(_cipher.bytes, (int) _cipher.length);
+    if (!_database->canOpen()) {
+        abort();
+    }
+    _group = dispatch_group_create();
+    _queue = dispatch_queue_create(self.class.name.UTF8String, DISPATCH_QUEUE_CONCURRENT);
+    _value = [_randomGenerator dataWithLength:_config.valueLength];
+    _committed = 0;
+    _nextKey = 0;
+    _operations = 0;
+}
+
+- (BOOL)insertRows:(int)count withDatabase:(WCDB::Database &)database error:(WCDB::Error &)error
+{
+    WCDB::RecyclableStatement statement = database.prepare(
+        WCDB::StatementInsert()
+            .insert(_tableName.UTF8String, {WCDB::Column("key"), WCDB::Column("value")}, WCDB::Conflict::NotSet)
+            .values({WCDB::Expr::BindParameter, WCDB::Expr::BindParameter}),
+        error);
+    if (!statement) {
+        return NO;
+    }
+    for (int i = 0; i < count; ++i) {
+        statement->reset();
+        statement->bind<WCDB::ColumnType::Integer64>(_nextKey++, 1);
+        statement->bind<WCDB::ColumnType::BLOB>(_value.bytes, (int) _value.length, 2);
+        statement->step();
+        if (!statement->isOK()) {
+            error = statement->getError();
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (int64_t)countRowsWithDatabase:(WCDB::Database &)database
+{
+    WCDB::Error error;
+    WCDB::RecyclableStatement statement = database.prepare(
+        WCDB::StatementSelect()
+            .select({WCDB::ColumnResult(WCDB::Expr(WCDB::Column::Any).count())})
+            .from(_tableName.UTF8String),
+        error);
+    if (!statement || !statement->step()) {
+        abort();
+    }
+    return statement->getValue<WCDB::ColumnType::Integer64>(0);
+}
+
+- (void)checkStatistics
+{
+    WCDB::HandlePool::Statistics statistics = _database->getHandleStatistics();
+    //Each thread holds at most one handle at a time, plus the one of checkpoint in background.
+    //Counts of free handles are not compared since they are not read atomically with the alive ones.
+    if (statistics.aliveHandles > WBMStressThreadCount + 1) {
+        abort();
+    }
+}
+
+- (void)runOperation:(WBMStressOperation)operation withGenerator:(std::mt19937 &)generator
+{
+    WCDB::Database &database = *_database.get();
+    WCDB::Error error;
+    switch (operation) {
+        case WBMStressOperationRead: {
+            //Committed writes are never lost
+            int64_t committed = _committed.load();
+            if ([self countRowsWithDatabase:database] < committed) {
+                abort();
+            }
+        } break;
+        case WBMStressOperationWrite:
+            if (![self insertRows:1 withDatabase:database error:error]) {
+                abort();
+            }
+            ++_committed;
+            break;
+        case WBMStressOperationTransaction: {
+            int count = std::uniform_int_distribution<int>(1, 16)(generator);
+            BOOL result = database.runTransaction([self, &database, count](WCDB::Error &error) -> bool {
+                return [self insertRows:count withDatabase:database error:error];
+            },
+                                                  nullptr, error);
+            if (!result) {
+                abort();
+            }
+            _committed += count;
+        } break;
+        case WBMStressOperationRollback: {
+            int count = std::uniform_int_distribution<int>(1, 16)(generator);
+            database.runTransaction([self, &database, count](WCDB::Error &error) -> bool {
+                [self insertRows:count withDatabase:database error:error];
+                return false;
+            },
+                                    nullptr, error);
+        } break;
+        case WBMStressOperationConfig: {
+            //A no-op config forces all handles to be reconfigured
+            database.setConfig("stress", [](std::shared_ptr<WCDB::Handle> &, WCDB::Error &error) -> bool {
+                error.reset();
+                return true;
+            });
+        } break;
+        case WBMStressOperationPurge:
+            database.purgeFreeHandles();
+            break;
+        case WBMStressOperationClose:
+            //Blockade and close while others keep going
+            database.close(nullptr);
+            break;
+        case WBMStressOperationStatistics:
+            [self checkStatistics];
+            break;
+    }
+    ++_operations;
+}
+
+- (NSUInteger)benchmark
+{
+    int operationsPerThread = (int) _config.writeCount / WBMStressThreadCount;
+    for (int i = 0; i < WBMStressThreadCount; ++i) {
+        unsigned int seed = _config.randomSeed + i;
+        dispatch_group_async(_group, _queue, ^{
+          std::mt19937 generator(seed);
+          //Reads and writes dominate. Config changes and closing are rare.
+          std::discrete_distribution<int> distribution({40, 30, 10, 5, 2, 2, 1, 10});
+          for (int j = 0; j < operationsPerThread; ++j) {
+              [self runOperation:(WBMStressOperation) distribution(generator) withGenerator:generator];
+          }
+        });
+    }
+    //Deadlocks are reported as timeout
+    if (dispatch_group_wait(_group, dispatch_time(DISPATCH_TIME_NOW, WBMStressTimeout * NSEC_PER_SEC)) != 0) {
+        abort();
+    }
+
+    //No write is lost and no handle is leaked
+    if ([self countRowsWithDatabase:*_database.get()] != _committed.load()) {
+        abort();
+    }
+    WCDB::HandlePool::Statistics statistics = _database->getHandleStatistics();
+    if (statistics.freeHandles > statistics.aliveHandles ||
+        statistics.aliveHandles > WBMStressThreadCount + 1) {
+        abort();
+    }
+    //Background checkpoint may take a new handle once it's drained
+    WCDB::Database *database = _database.get();
+    database->close([database, &statistics]() {
+        statistics = database->getHandleStatistics();
+    });
+    if (statistics.aliveHandles != 0 || statistics.freeHandles != 0) {
+        abort();
+    }
+    return (NSUInteger) _operations.load();
+}
+
+- (void)postBenchmark
+{
+    _database.reset();
+}
+
+@end
@@ -0,0 +1,123 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "WBMOnlineCopy.h"
+#import <WCDB/database.hpp>
+
+@implementation WBMOnlineCopy {
+    std::shared_ptr<WCDB::Database> _database;
+    WCTDatabase *_writer;
+    NSString *_destination;
+    dispatch_group_t _group;
+    dispatch_queue_t _queue;
+    NSArray *_objects;
+}
+
++ (const NSString *)benchmarkType
+{
+    return WCTBenchmarkTypeOnlineCopy;
+}
+
+- (void)prepare
+{
+    WCTDatabase *database = [[WCTDatabase alloc] initWithPath:_path];
+    {
+        BOOL result = [database createTableAndIndexesOfName:_tableName withClass:WBMObject.class];
+        if (!result) {
+            abort();
+        }
+        NSMutableArray *objects = [[NSMutableArray alloc] init];
+        for (int i = 0; i < _config.batchWriteCount; ++i) {
+            WBMObject *object = [[WBMObject alloc] init];
+            object.key = i;
+            object.value = [_randomGenerator dataWithLength:_config.valueLength];
+            [objects addObject:object];
+        }
+        result = [database insertObjects:objects into:_tableName];
+        if (!result) {
+            abort();
+        }
+    }
+    [database close];
+}
+
+- (void)preBenchmark
+{
+    _destination = [_path stringByAppendingString:@"-copy"];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    if ([fm fileExistsAtPath:_destination]) {
+        BOOL result = [fm removeItemAtPath:_destination error:nil];
+        if (!result) {
+            abort();
+        }
+    }
+
+    _database.reset(new WCDB::Database(_path.UTF8String));
+    _writer = [[WCTDatabase alloc] initWithPath:_path];
+    if (!_database->canOpen()) {
+        abort();
+    }
+
+    _group = dispatch_group_create();
+    _queue = dispatch_queue_create(self.class.name.UTF8String, DISPATCH_QUEUE_CONCURRENT);
+    NSMutableArray *objects = [[NSMutableArray alloc] init];
+    for (int i = 0; i < _config.writeCount; ++i) {
+        WBMObject *object = [[WBMObject alloc] init];
+        object.key = i + (int) _config.batchWriteCount;
+        object.value = [_randomGenerator dataWithLength:_config.valueLength];
+        [objects addObject:object];
+    }
+    _objects = objects;
+}
+
+- (NSUInteger)benchmark
+{
+    //Writes keep going while copying, one transaction for each object
+    dispatch_group_async(_group, _queue, ^{
+      for (WBMObject *object in _objects) {
+          BOOL result = [_writer insertObject:object into:_tableName];
+          if (!result) {
+              abort();
+          }
+      }
+    });
+
+    int copiedPages = 0;
+    WCDB::Database::CopyOptions options = {};
+    options.pagesPerStep = 256;
+    WCDB::Error error;
+    BOOL result = _database->copyTo(_destination.UTF8String, options, [&copiedPages](int copied, int) -> bool {
+        copiedPages = copied;
+        return true;
+    }, error);
+    if (!result) {
+        abort();
+    }
+    dispatch_group_wait(_group, DISPATCH_TIME_FOREVER);
+    return copiedPages;
+}
+
+- (void)postBenchmark
+{
+    _database.reset();
+    _writer = nil;
+}
+
+@end
@@ -28,6 +28,7 @@ extern const NSString *WCTBenchmarkTypeBaselineBatchWrite;
 extern const NSString *WCTBenchmarkTypeMultithreadReadRead;
 extern const NSString *WCTBenchmarkTypeMultithreadReadWrite;
 extern const NSString *WCTBenchmarkTypeMultithreadWriteWrite;
+extern const NSString *WCTBenchmarkTypeMultithreadStress;
 
 extern const NSString *WCTBenchmarkTypeSyncWrite;
 
@@ -39,6 +40,16 @@ extern const NSString *WCTBenchmarkTypeTracerWrite;
 
 extern const NSString *WCTBenchmarkTypeInitialization;
 
+extern const NSString *WCTBenchmarkTypeAggregateRaw;
+extern const NSString *WCTBenchmarkTypeAggregateMaintained;
+
+extern const NSString *WCTBenchmarkTypeIndexBuildSingleThread;
+extern const NSString *WCTBenchmarkTypeIndexBuildMultithread;
+
+extern const NSString *WCTBenchmarkTypeOnlineCopy;
+
+extern const NSString *WCTBenchmarkTypeConfigOrder;
+
 //database type
 extern const NSString *WCTBenchmarkDatabaseWCDB;
 
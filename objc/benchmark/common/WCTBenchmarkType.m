@@ -27,6 +27,7 @@ const NSString *WCTBenchmarkTypeBaselineBatchWrite = @"Baseline_Batch_Write";
 const NSString *WCTBenchmarkTypeMultithreadReadRead = @"Multithread_Read-Read";
 const NSString *WCTBenchmarkTypeMultithreadReadWrite = @"Multithread_Read-Write";
 const NSString *WCTBenchmarkTypeMultithreadWriteWrite = @"Multithread_Write-Write";
+const NSString *WCTBenchmarkTypeMultithreadStress = @"Multithread_Stress";
 
 const NSString *WCTBenchmarkTypeSyncWrite = @"Sync_Write";
 
@@ -38,6 +39,16 @@ const NSString *WCTBenchmarkTypeTracerWrite = @"Tracer_Write";
 
 const NSString *WCTBenchmarkTypeInitialization = @"Initialization";
 
+const NSString *WCTBenchmarkTypeAggregateRaw = @"Aggregate_Raw";
+const NSString *WCTBenchmarkTypeAggregateMaintained = @"Aggregate_Maintained";
+
+const NSString *WCTBenchmarkTypeIndexBuildSingleThread = @"Index_Build_Single-Thread";
+const NSString *WCTBenchmarkTypeIndexBuildMultithread = @"Index_Build_Multithread";
+
+const NSString *WCTBenchmarkTypeOnlineCopy = @"Online_Copy";
+
+const NSString *WCTBenchmarkTypeConfigOrder = @"Config_Order";
+
 //database type
 const NSString *WCTBenchmarkDatabaseWCDB = @"WCDB";
 
@@ -151,6 +151,8 @@ int64_t sqliterk_column_rowid(sqliterk_column *column);
 
 int sqliterk_parsed_page_count(sqliterk *rk);
 int sqliterk_valid_page_count(sqliterk *rk);
+// Pages failed to be parsed, among the parsed b-trees
+int sqliterk_damaged_page_count(sqliterk *rk);
 int sqliterk_page_count(sqliterk *rk);
 unsigned int sqliterk_integrity(sqliterk *rk);
 
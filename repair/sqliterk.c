@@ -353,6 +353,14 @@ int sqliterkGetValidPageCount(sqliterk *rk)
     return sqliterkPagerGetValidPageCount(rk->pager);
 }
 
+int sqliterkGetDamagedPageCount(sqliterk *rk)
+{
+    if (!rk) {
+        return 0;
+    }
+    return sqliterkPagerGetDamagedPageCount(rk->pager);
+}
+
 int sqliterkGetPageCount(sqliterk *rk)
 {
     if (!rk) {
@@ -38,6 +38,7 @@ void *sqliterkGetUserInfo(sqliterk *rk);
 
 int sqliterkGetParsedPageCount(sqliterk *rk);
 int sqliterkGetValidPageCount(sqliterk *rk);
+int sqliterkGetDamagedPageCount(sqliterk *rk);
 int sqliterkGetPageCount(sqliterk *rk);
 unsigned int sqliterkGetIntegrity(sqliterk *rk);
 
@@ -165,6 +165,11 @@ int sqliterk_valid_page_count(sqliterk *rk)
     return sqliterkGetValidPageCount(rk);
 }
 
+int sqliterk_damaged_page_count(sqliterk *rk)
+{
+    return sqliterkGetDamagedPageCount(rk);
+}
+
 int sqliterk_page_count(sqliterk *rk)
 {
     return sqliterkGetPageCount(rk);
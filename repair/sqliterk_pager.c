@@ -597,6 +597,22 @@ int sqliterkPagerGetValidPageCount(sqliterk_pager *pager)
     return pager->pagecount - pager->freepagecount;
 }
 
+int sqliterkPagerGetDamagedPageCount(sqliterk_pager *pager)
+{
+    if (!pager || !pager->pagesStatus) {
+        return 0;
+    }
+
+    int i, count = 0;
+    for (i = 0; i < pager->pagecount; i++) {
+        if (pager->pagesStatus[i] == sqliterk_status_damaged ||
+            pager->pagesStatus[i] == sqliterk_status_invalid) {
+            count++;
+        }
+    }
+    return count;
+}
+
 unsigned int sqliterkPagerGetIntegrity(sqliterk_pager *pager)
 {
     if (!pager) {
@@ -85,6 +85,7 @@ void sqliterkPagerSetStatus(sqliterk_pager *pager,
 sqliterk_status sqliterkPagerGetStatus(sqliterk_pager *pager, int pageno);
 int sqliterkPagerGetParsedPageCount(sqliterk_pager *pager);
 int sqliterkPagerGetValidPageCount(sqliterk_pager *pager);
+int sqliterkPagerGetDamagedPageCount(sqliterk_pager *pager);
 unsigned int sqliterkPagerGetIntegrity(sqliterk_pager *pager);
 
 int sqliterkPageAcquire(sqliterk_pager *pager,
@@ -21,6 +21,7 @@
 #ifndef sqliterk_util_h
 #define sqliterk_util_h
 
+#include <stdint.h>
 #include <stdio.h>
 
 int sqliterkParseInt(const unsigned char *data,
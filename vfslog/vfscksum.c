@@ -0,0 +1,1032 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+** This file contains the implementation of an SQLite vfs wrapper that
+** keeps a checksum for each page of the main database file and verifies
+** it whenever the page is read from disk.
+**
+** Checksums are stored in a sidecar file named after the database with
+** a "-cksum" suffix, since the reserved bytes of each page are already
+** taken by SQLCipher.  The sidecar starts with a 16-byte header, holding
+** the magic "WCDBCKS2", the big-endian page size and the big-endian
+** generation of the last sync, followed by an 8-byte entry for each page,
+** holding the big-endian 32-bit checksum and the generation it's written
+** in.  A zero checksum stands for an unknown page, e.g. written before this
+** vfs was used, and is never verified.  The sidecar is reset whenever the
+** page size changes.
+**
+** A page and its checksum reach the disk together only after a sync, which
+** bumps the generation.  Entries newer than the last sync may disagree with
+** their pages after a crash, so that they are made unknown when the sidecar
+** is opened.
+**
+** Frames read from the WAL file are verified against the checksum chain
+** in their frame headers, which SQLite itself checks during recovery only.
+** Checkpoint copies frames through xRead, so a corrupted frame fails the
+** checkpoint instead of being written into the main database file.
+**
+** On mismatch, the page number is logged with SQLITE_CORRUPT through
+** sqlite3_log() and recorded in the statistics returned by vcksumGetStats().
+** By default, only the read of a mismatched WAL frame fails with
+** SQLITE_CORRUPT, since frames broken by a crash are dropped by recovery
+** before they can be read.  Page mismatches are only reported unless
+** VCKSUM_VERIFY_ALL is set by vcksumSetVerify().
+**
+** Once a database is written through this vfs, it should always be opened
+** with it, or the sidecar must be deleted.  Otherwise, pages written
+** without it will be reported as corrupted.
+*/
+
+#include "sqlite3.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vfscksum.h"
+
+#define VCKSUM_HEADER_SIZE 16
+#define VCKSUM_ENTRY_SIZE 8
+#define VCKSUM_WAL_HEADER_SIZE 32
+#define VCKSUM_WAL_FRAME_HEADER_SIZE 24
+
+static const char VCKSUM_MAGIC[8] = {'W', 'C', 'D', 'B', 'C', 'K', 'S', '2'};
+
+/*
+** Forward declaration of objects used by this utility
+*/
+typedef struct VCksumInfo VCksumInfo;
+typedef struct VCksumVfs VCksumVfs;
+typedef struct VCksumFile VCksumFile;
+
+/* There is one of the following objects for each database file, which
+** is shared by all of its connections in this process, for both the main
+** database file and the WAL file.
+*/
+struct VCksumInfo {
+    VCksumInfo *pNext;     /* Next in a list of all active infos */
+    VCksumInfo **ppPrev;   /* Pointer to this in the list */
+    int nRef;              /* Number of references to this object */
+    int nFilename;         /* Length of zFilename in bytes */
+    char *zFilename;       /* Name of database file */
+    int fd;                /* Sidecar file.  -1 if not opened yet */
+    int pageSize;          /* Page size of sidecar.  0 if unknown */
+    uint32_t generation;   /* Generation of entries written since last sync */
+    int verify;            /* One of VCKSUM_VERIFY_* */
+    VCksumStat stat;       /* Statistics */
+    sqlite3_mutex *mutex;  /* Mutex to protect fields above */
+};
+
+struct VCksumVfs {
+    sqlite3_vfs base;  /* VFS methods */
+    sqlite3_vfs *pVfs; /* Parent VFS */
+};
+
+struct VCksumFile {
+    sqlite3_file base;   /* IO methods */
+    sqlite3_file *pReal; /* Underlying file handle */
+    VCksumInfo *pInfo;   /* NULL for files other than database and WAL */
+    int isWal;           /* True for WAL file */
+    int walBigEndian;    /* Byte order of WAL checksums.  -1 if unknown */
+};
+
+#define REALVFS(p) (((VCksumVfs *) (p))->pVfs)
+
+/*
+** Methods for VCksumFile
+*/
+static int vcksumClose(sqlite3_file *);
+static int vcksumRead(sqlite3_file *, void *, int iAmt, sqlite3_int64 iOfst);
+static int
+vcksumWrite(sqlite3_file *, const void *, int iAmt, sqlite3_int64 iOfst);
+static int vcksumTruncate(sqlite3_file *, sqlite3_int64 size);
+static int vcksumSync(sqlite3_file *, int flags);
+static int vcksumFileSize(sqlite3_file *, sqlite3_int64 *pSize);
+static int vcksumLock(sqlite3_file *, int);
+static int vcksumUnlock(sqlite3_file *, int);
+static int vcksumCheckReservedLock(sqlite3_file *, int *pResOut);
+static int vcksumFileControl(sqlite3_file *, int op, void *pArg);
+static int vcksumSectorSize(sqlite3_file *);
+static int vcksumDeviceCharacteristics(sqlite3_file *);
+static int vcksumShmMap(sqlite3_file *, int, int, int, void volatile **);
+static int vcksumShmLock(sqlite3_file *, int, int, int);
+static void vcksumShmBarrier(sqlite3_file *);
+static int vcksumShmUnmap(sqlite3_file *, int);
+static int vcksumFetch(sqlite3_file *, sqlite3_int64, int, void **);
+static int vcksumUnfetch(sqlite3_file *, sqlite3_int64, void *);
+
+/*
+** Methods for VCksumVfs
+*/
+static int vcksumOpen(sqlite3_vfs *, const char *, sqlite3_file *, int, int *);
+static int vcksumDelete(sqlite3_vfs *, const char *zName, int syncDir);
+static int vcksumAccess(sqlite3_vfs *, const char *zName, int flags, int *);
+static int
+vcksumFullPathname(sqlite3_vfs *, const char *zName, int, char *zOut);
+static void *vcksumDlOpen(sqlite3_vfs *, const char *zFilename);
+static void vcksumDlError(sqlite3_vfs *, int nByte, char *zErrMsg);
+static void (*vcksumDlSym(sqlite3_vfs *pVfs, void *p, const char *zSym))(void);
+static void vcksumDlClose(sqlite3_vfs *, void *);
+static int vcksumRandomness(sqlite3_vfs *, int nByte, char *zOut);
+static int vcksumSleep(sqlite3_vfs *, int microseconds);
+static int vcksumCurrentTime(sqlite3_vfs *, double *);
+static int vcksumGetLastError(sqlite3_vfs *, int, char *);
+static int vcksumCurrentTimeInt64(sqlite3_vfs *, sqlite3_int64 *);
+static int
+vcksumSetSystemCall(sqlite3_vfs *, const char *, sqlite3_syscall_ptr);
+static sqlite3_syscall_ptr vcksumGetSystemCall(sqlite3_vfs *, const char *);
+static const char *vcksumNextSystemCall(sqlite3_vfs *, const char *);
+
+static VCksumVfs vcksum_vfs = {{
+                                   3,          /* iVersion */
+                                   0,          /* szOsFile */
+                                   1024,       /* mxPathname */
+                                   0,          /* pNext */
+                                   "vfscksum", /* zName */
+                                   0,          /* pAppData */
+                                   vcksumOpen,             /* xOpen */
+                                   vcksumDelete,           /* xDelete */
+                                   vcksumAccess,           /* xAccess */
+                                   vcksumFullPathname,     /* xFullPathname */
+                                   vcksumDlOpen,           /* xDlOpen */
+                                   vcksumDlError,          /* xDlError */
+                                   vcksumDlSym,            /* xDlSym */
+                                   vcksumDlClose,          /* xDlClose */
+                                   vcksumRandomness,       /* xRandomness */
+                                   vcksumSleep,            /* xSleep */
+                                   vcksumCurrentTime,      /* xCurrentTime */
+                                   vcksumGetLastError,     /* xGetLastError */
+                                   vcksumCurrentTimeInt64, /* xCurrentTimeInt64 */
+                                   vcksumSetSystemCall,    /* xSetSystemCall */
+                                   vcksumGetSystemCall,    /* xGetSystemCall */
+                                   vcksumNextSystemCall,   /* xNextSystemCall */
+                               },
+                               0};
+
+static sqlite3_io_methods vcksum_io_methods = {
+    3,                           /* iVersion */
+    vcksumClose,                 /* xClose */
+    vcksumRead,                  /* xRead */
+    vcksumWrite,                 /* xWrite */
+    vcksumTruncate,              /* xTruncate */
+    vcksumSync,                  /* xSync */
+    vcksumFileSize,              /* xFileSize */
+    vcksumLock,                  /* xLock */
+    vcksumUnlock,                /* xUnlock */
+    vcksumCheckReservedLock,     /* xCheckReservedLock */
+    vcksumFileControl,           /* xFileControl */
+    vcksumSectorSize,            /* xSectorSize */
+    vcksumDeviceCharacteristics, /* xDeviceCharacteristics */
+    vcksumShmMap,                /* xShmMap */
+    vcksumShmLock,               /* xShmLock */
+    vcksumShmBarrier,            /* xShmBarrier */
+    vcksumShmUnmap,              /* xShmUnmap */
+    vcksumFetch,                 /* xFetch */
+    vcksumUnfetch,               /* xUnfetch */
+};
+
+static uint32_t vcksumGet4Big(const unsigned char *x)
+{
+    return ((uint32_t) x[0] << 24) | ((uint32_t) x[1] << 16) |
+           ((uint32_t) x[2] << 8) | (uint32_t) x[3];
+}
+
+static uint32_t vcksumGet4Little(const unsigned char *x)
+{
+    return ((uint32_t) x[3] << 24) | ((uint32_t) x[2] << 16) |
+           ((uint32_t) x[1] << 8) | (uint32_t) x[0];
+}
+
+static void vcksumPut4Big(unsigned char *x, uint32_t v)
+{
+    x[0] = (unsigned char) (v >> 24);
+    x[1] = (unsigned char) (v >> 16);
+    x[2] = (unsigned char) (v >> 8);
+    x[3] = (unsigned char) v;
+}
+
+/*
+** Accumulate the checksum of a block of content in the way the WAL
+** frame checksum is computed.  n must be a multiple of 8.
+*/
+static void
+vcksumAccumulate(int bigEndian, const unsigned char *p, int n, uint32_t *s)
+{
+    const unsigned char *pEnd = p + n;
+    uint32_t s1 = s[0], s2 = s[1];
+    if (bigEndian) {
+        for (; p < pEnd; p += 8) {
+            s1 += vcksumGet4Big(p) + s2;
+            s2 += vcksumGet4Big(p + 4) + s1;
+        }
+    } else {
+        for (; p < pEnd; p += 8) {
+            s1 += vcksumGet4Little(p) + s2;
+            s2 += vcksumGet4Little(p + 4) + s1;
+        }
+    }
+    s[0] = s1;
+    s[1] = s2;
+}
+
+/*
+** Compute the checksum of a page.  It's never zero.
+*/
+static uint32_t vcksumPage(const unsigned char *p, int n)
+{
+    uint32_t s[2] = {0, 0};
+    uint32_t cksum;
+    vcksumAccumulate(0, p, n, s);
+    cksum = s[0] ^ (s[1] << 1 | s[1] >> 31);
+    return cksum ? cksum : 1;
+}
+
+/*
+** Return true if the I/O is on a whole page.
+*/
+static int vcksumIsPage(int iAmt, sqlite3_int64 iOfst)
+{
+    return iAmt >= 512 && iAmt <= 65536 && (iAmt & (iAmt - 1)) == 0 &&
+           iOfst % iAmt == 0;
+}
+
+/*
+** List of all active infos.  Protected by the master mutex.
+*/
+static VCksumInfo *allInfos = 0;
+
+/*
+** Close a VCksumInfo object
+*/
+static void vcksumInfoClose(VCksumInfo *p)
+{
+    sqlite3_mutex *pMutex;
+    if (!p)
+        return;
+    pMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_MASTER);
+    sqlite3_mutex_enter(pMutex);
+    if (--p->nRef > 0) {
+        sqlite3_mutex_leave(pMutex);
+        return;
+    }
+    *p->ppPrev = p->pNext;
+    if (p->pNext)
+        p->pNext->ppPrev = p->ppPrev;
+    sqlite3_mutex_leave(pMutex);
+    if (p->fd >= 0)
+        close(p->fd);
+    sqlite3_mutex_free(p->mutex);
+    sqlite3_free(p);
+}
+
+/*
+** Open a VCksumInfo object on the given database or WAL file
+*/
+static VCksumInfo *vcksumInfoOpen(const char *zFilename, int isWal)
+{
+    int nName = (int) strlen(zFilename);
+    sqlite3_mutex *pMutex;
+    VCksumInfo *pInfo, *pTemp;
+
+    if (isWal) {
+        if (nName <= 4 || strcmp(zFilename + nName - 4, "-wal") != 0)
+            return 0;
+        nName -= 4;
+    }
+    pTemp = sqlite3_malloc(sizeof(*pInfo) + nName + 1);
+    if (pTemp == 0)
+        return 0;
+    pMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_MASTER);
+    sqlite3_mutex_enter(pMutex);
+    for (pInfo = allInfos; pInfo; pInfo = pInfo->pNext) {
+        if (pInfo->nFilename == nName &&
+            !memcmp(pInfo->zFilename, zFilename, nName)) {
+            break;
+        }
+    }
+    if (pInfo == 0) {
+        pInfo = pTemp;
+        pTemp = 0;
+        memset(pInfo, 0, sizeof(*pInfo));
+        pInfo->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+        if (!pInfo->mutex) {
+            sqlite3_mutex_leave(pMutex);
+            sqlite3_free(pInfo);
+            return 0;
+        }
+        pInfo->zFilename = (char *) &pInfo[1];
+        memcpy(pInfo->zFilename, zFilename, nName);
+        pInfo->zFilename[nName] = 0;
+        pInfo->nFilename = nName;
+        pInfo->fd = -1;
+        pInfo->generation = 1;
+        pInfo->verify = VCKSUM_VERIFY_FRAMES;
+        pInfo->ppPrev = &allInfos;
+        if (allInfos)
+            allInfos->ppPrev = &pInfo->pNext;
+        pInfo->pNext = allInfos;
+        allInfos = pInfo;
+    }
+    pInfo->nRef++;
+    sqlite3_mutex_leave(pMutex);
+    if (pTemp)
+        sqlite3_free(pTemp);
+    return pInfo;
+}
+
+/*
+** Make the entries written since the last sync unknown.  Generation of
+** this process continues from the last sync, so they must not be left.
+** Must be called with the info mutex held.
+*/
+static void vcksumSidecarRecover(VCksumInfo *pInfo)
+{
+    unsigned char aBuf[VCKSUM_ENTRY_SIZE * 512];
+    off_t iOfst = VCKSUM_HEADER_SIZE;
+    ssize_t nRead;
+    int i, dirty;
+
+    while ((nRead = pread(pInfo->fd, aBuf, sizeof(aBuf), iOfst)) > 0) {
+        nRead -= nRead % VCKSUM_ENTRY_SIZE;
+        dirty = 0;
+        for (i = 0; i < nRead; i += VCKSUM_ENTRY_SIZE) {
+            if (vcksumGet4Big(aBuf + i) != 0 &&
+                vcksumGet4Big(aBuf + i + 4) >= pInfo->generation) {
+                memset(aBuf + i, 0, VCKSUM_ENTRY_SIZE);
+                pInfo->stat.unknownPages++;
+                dirty = 1;
+            }
+        }
+        if (dirty && pwrite(pInfo->fd, aBuf, nRead, iOfst) != nRead) {
+            /* The stale checksums would be reported as mismatches */
+            pInfo->pageSize = 0;
+            sqlite3_log(SQLITE_IOERR, "vfscksum: cannot recover sidecar of %s",
+                        pInfo->zFilename);
+            return;
+        }
+        if (nRead < (ssize_t) sizeof(aBuf))
+            break;
+        iOfst += nRead;
+    }
+}
+
+/*
+** Open the sidecar file if it's not opened yet.  Return false on failure,
+** in which case checksums are neither verified nor stored.
+** Must be called with the info mutex held.
+*/
+static int vcksumSidecarOpen(VCksumInfo *pInfo)
+{
+    unsigned char aHdr[VCKSUM_HEADER_SIZE];
+    char *zPath;
+
+    if (pInfo->fd >= 0)
+        return 1;
+    zPath = sqlite3_mprintf("%s-cksum", pInfo->zFilename);
+    if (!zPath)
+        return 0;
+    pInfo->fd = open(zPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (pInfo->fd < 0) {
+        sqlite3_log(SQLITE_CANTOPEN, "vfscksum: cannot open %s", zPath);
+        sqlite3_free(zPath);
+        return 0;
+    }
+    sqlite3_free(zPath);
+    if (pread(pInfo->fd, aHdr, sizeof(aHdr), 0) == sizeof(aHdr) &&
+        memcmp(aHdr, VCKSUM_MAGIC, sizeof(VCKSUM_MAGIC)) == 0) {
+        pInfo->pageSize = (int) vcksumGet4Big(aHdr + 8);
+        pInfo->generation = vcksumGet4Big(aHdr + 12) + 1;
+        vcksumSidecarRecover(pInfo);
+    }
+    return 1;
+}
+
+/*
+** Reset the sidecar with a new page size.
+** Must be called with the info mutex held.
+*/
+static int vcksumSidecarReset(VCksumInfo *pInfo, int pageSize)
+{
+    unsigned char aHdr[VCKSUM_HEADER_SIZE];
+    memset(aHdr, 0, sizeof(aHdr));
+    memcpy(aHdr, VCKSUM_MAGIC, sizeof(VCKSUM_MAGIC));
+    vcksumPut4Big(aHdr + 8, (uint32_t) pageSize);
+    vcksumPut4Big(aHdr + 12, pInfo->generation - 1);
+    pInfo->pageSize = 0;
+    if (ftruncate(pInfo->fd, 0) != 0 ||
+        pwrite(pInfo->fd, aHdr, sizeof(aHdr), 0) != sizeof(aHdr)) {
+        return 0;
+    }
+    pInfo->pageSize = pageSize;
+    return 1;
+}
+
+/*
+** Load the stored checksum of a page.  Zero is returned if it's unknown.
+*/
+static uint32_t vcksumLoad(VCksumInfo *pInfo, int pageSize, uint32_t pgno)
+{
+    unsigned char aCksum[4];
+    uint32_t cksum = 0;
+    sqlite3_mutex_enter(pInfo->mutex);
+    if (vcksumSidecarOpen(pInfo) && pInfo->pageSize == pageSize &&
+        pread(pInfo->fd, aCksum, sizeof(aCksum),
+              VCKSUM_HEADER_SIZE + (off_t)(pgno - 1) * VCKSUM_ENTRY_SIZE) ==
+            sizeof(aCksum)) {
+        cksum = vcksumGet4Big(aCksum);
+    }
+    sqlite3_mutex_leave(pInfo->mutex);
+    return cksum;
+}
+
+/*
+** Store the checksum of a page.  The sidecar is reset if page size changes.
+*/
+static void
+vcksumStore(VCksumInfo *pInfo, int pageSize, uint32_t pgno, uint32_t cksum)
+{
+    unsigned char aEntry[VCKSUM_ENTRY_SIZE];
+    vcksumPut4Big(aEntry, cksum);
+    sqlite3_mutex_enter(pInfo->mutex);
+    if (vcksumSidecarOpen(pInfo) &&
+        (pInfo->pageSize == pageSize ||
+         vcksumSidecarReset(pInfo, pageSize))) {
+        vcksumPut4Big(aEntry + 4, pInfo->generation);
+        if (pwrite(pInfo->fd, aEntry, sizeof(aEntry),
+                   VCKSUM_HEADER_SIZE +
+                       (off_t)(pgno - 1) * VCKSUM_ENTRY_SIZE) !=
+            sizeof(aEntry)) {
+            /* The stale checksum would be reported as a mismatch */
+            pInfo->pageSize = 0;
+            sqlite3_log(SQLITE_IOERR, "vfscksum: cannot store page %u of %s",
+                        pgno, pInfo->zFilename);
+        }
+    }
+    sqlite3_mutex_leave(pInfo->mutex);
+}
+
+/*
+** Record the mismatch and return the error code for the read.
+*/
+static int vcksumMismatch(VCksumFile *p, uint32_t pgno, uint32_t iFrame)
+{
+    VCksumInfo *pInfo = p->pInfo;
+    VCksumStat *pStat = &pInfo->stat;
+    int i, fail;
+
+    sqlite3_mutex_enter(pInfo->mutex);
+    if (iFrame) {
+        pStat->mismatchedFrames++;
+    } else {
+        pStat->mismatchedPages++;
+    }
+    for (i = 0; i < pStat->nCorruptedPages; i++) {
+        if (pStat->corruptedPages[i] == pgno)
+            break;
+    }
+    if (i == pStat->nCorruptedPages &&
+        pStat->nCorruptedPages < VCKSUM_MAX_CORRUPTED_PAGES) {
+        pStat->corruptedPages[pStat->nCorruptedPages++] = pgno;
+    }
+    fail = pInfo->verify >= (iFrame ? VCKSUM_VERIFY_FRAMES : VCKSUM_VERIFY_ALL);
+    sqlite3_mutex_leave(pInfo->mutex);
+
+    if (iFrame) {
+        sqlite3_log(SQLITE_CORRUPT,
+                    "vfscksum: checksum mismatch on frame %u (page %u) of %s-wal",
+                    iFrame, pgno, pInfo->zFilename);
+    } else {
+        sqlite3_log(SQLITE_CORRUPT,
+                    "vfscksum: checksum mismatch on page %u of %s", pgno,
+                    pInfo->zFilename);
+    }
+    return fail ? SQLITE_CORRUPT : SQLITE_OK;
+}
+
+/*
+** Verify a page read from the main database file.
+*/
+static int vcksumVerifyPage(VCksumFile *p,
+                            const unsigned char *zBuf,
+                            int iAmt,
+                            sqlite3_int64 iOfst)
+{
+    uint32_t pgno, expected;
+    if (!vcksumIsPage(iAmt, iOfst))
+        return SQLITE_OK;
+    pgno = (uint32_t)(iOfst / iAmt) + 1;
+    expected = vcksumLoad(p->pInfo, iAmt, pgno);
+    if (expected == 0)
+        return SQLITE_OK;
+    if (vcksumPage(zBuf, iAmt) != expected)
+        return vcksumMismatch(p, pgno, 0);
+    sqlite3_mutex_enter(p->pInfo->mutex);
+    p->pInfo->stat.verifiedPages++;
+    sqlite3_mutex_leave(p->pInfo->mutex);
+    return SQLITE_OK;
+}
+
+/*
+** Verify a page read from a WAL frame.  The checksum of a frame is chained
+** from the one of the previous frame, or the WAL header for the first frame.
+*/
+static int vcksumVerifyFrame(VCksumFile *p,
+                             const unsigned char *zBuf,
+                             int iAmt,
+                             sqlite3_int64 iOfst)
+{
+    unsigned char aFrameHdr[VCKSUM_WAL_FRAME_HEADER_SIZE];
+    unsigned char aPrev[8];
+    sqlite3_int64 szFrame, iPrevOfst;
+    uint32_t iFrame, s[2];
+    int rc;
+
+    if (iOfst == 0 && iAmt >= 4) {
+        /* Magic of WAL header, whose lowest bit is the byte order */
+        p->walBigEndian = zBuf[3] & 1;
+        return SQLITE_OK;
+    }
+    if (!vcksumIsPage(iAmt, 0))
+        return SQLITE_OK;
+    szFrame = iAmt + VCKSUM_WAL_FRAME_HEADER_SIZE;
+    iOfst -= VCKSUM_WAL_HEADER_SIZE + VCKSUM_WAL_FRAME_HEADER_SIZE;
+    if (iOfst < 0 || iOfst % szFrame != 0)
+        return SQLITE_OK;
+    iFrame = (uint32_t)(iOfst / szFrame) + 1;
+    iOfst += VCKSUM_WAL_HEADER_SIZE;
+
+    if (p->walBigEndian < 0) {
+        rc = p->pReal->pMethods->xRead(p->pReal, aPrev, 4, 0);
+        if (rc != SQLITE_OK)
+            return rc;
+        p->walBigEndian = aPrev[3] & 1;
+    }
+    rc = p->pReal->pMethods->xRead(p->pReal, aFrameHdr, sizeof(aFrameHdr),
+                                   iOfst);
+    if (rc != SQLITE_OK)
+        return rc;
+    iPrevOfst = iFrame == 1 ? VCKSUM_WAL_HEADER_SIZE - 8 : iOfst - szFrame + 16;
+    rc = p->pReal->pMethods->xRead(p->pReal, aPrev, sizeof(aPrev), iPrevOfst);
+    if (rc != SQLITE_OK)
+        return rc;
+
+    s[0] = vcksumGet4Big(aPrev);
+    s[1] = vcksumGet4Big(aPrev + 4);
+    vcksumAccumulate(p->walBigEndian, aFrameHdr, 8, s);
+    vcksumAccumulate(p->walBigEndian, zBuf, iAmt, s);
+    if (s[0] != vcksumGet4Big(aFrameHdr + 16) ||
+        s[1] != vcksumGet4Big(aFrameHdr + 20)) {
+        return vcksumMismatch(p, vcksumGet4Big(aFrameHdr), iFrame);
+    }
+    sqlite3_mutex_enter(p->pInfo->mutex);
+    p->pInfo->stat.verifiedPages++;
+    sqlite3_mutex_leave(p->pInfo->mutex);
+    return SQLITE_OK;
+}
+
+/*
+** Close an vcksum-file.
+*/
+static int vcksumClose(sqlite3_file *pFile)
+{
+    int rc = SQLITE_OK;
+    VCksumFile *p = (VCksumFile *) pFile;
+    if (p->pReal->pMethods) {
+        rc = p->pReal->pMethods->xClose(p->pReal);
+    }
+    vcksumInfoClose(p->pInfo);
+    p->pInfo = 0;
+    return rc;
+}
+
+/*
+** Read data from an vcksum-file.
+*/
+static int
+vcksumRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite_int64 iOfst)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    int rc = p->pReal->pMethods->xRead(p->pReal, zBuf, iAmt, iOfst);
+    if (rc != SQLITE_OK || !p->pInfo)
+        return rc;
+    if (p->isWal)
+        return vcksumVerifyFrame(p, zBuf, iAmt, iOfst);
+    return vcksumVerifyPage(p, zBuf, iAmt, iOfst);
+}
+
+/*
+** Write data to an vcksum-file.
+*/
+static int
+vcksumWrite(sqlite3_file *pFile, const void *z, int iAmt, sqlite_int64 iOfst)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    VCksumInfo *pInfo = p->pInfo;
+    int rc = p->pReal->pMethods->xWrite(p->pReal, z, iAmt, iOfst);
+    if (rc != SQLITE_OK || !pInfo)
+        return rc;
+    if (p->isWal) {
+        if (iOfst == 0 && iAmt >= 4)
+            p->walBigEndian = ((const unsigned char *) z)[3] & 1;
+    } else if (vcksumIsPage(iAmt, iOfst)) {
+        vcksumStore(pInfo, iAmt, (uint32_t)(iOfst / iAmt) + 1,
+                    vcksumPage(z, iAmt));
+    } else {
+        /* Partial write makes the checksums of covered pages unknown */
+        int pageSize;
+        sqlite3_int64 i;
+        sqlite3_mutex_enter(pInfo->mutex);
+        pageSize = pInfo->pageSize;
+        sqlite3_mutex_leave(pInfo->mutex);
+        for (i = pageSize ? iOfst / pageSize : 0;
+             pageSize && i <= (iOfst + iAmt - 1) / pageSize; i++) {
+            vcksumStore(pInfo, pageSize, (uint32_t) i + 1, 0);
+        }
+    }
+    return rc;
+}
+
+/*
+** Truncate an vcksum-file.
+*/
+static int vcksumTruncate(sqlite3_file *pFile, sqlite_int64 size)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    VCksumInfo *pInfo = p->pInfo;
+    int rc = p->pReal->pMethods->xTruncate(p->pReal, size);
+    if (rc != SQLITE_OK || !pInfo || p->isWal)
+        return rc;
+    sqlite3_mutex_enter(pInfo->mutex);
+    if (pInfo->fd >= 0 && pInfo->pageSize > 0) {
+        sqlite3_int64 nPage = (size + pInfo->pageSize - 1) / pInfo->pageSize;
+        if (ftruncate(pInfo->fd,
+                      VCKSUM_HEADER_SIZE + (off_t) nPage * VCKSUM_ENTRY_SIZE) !=
+            0) {
+            pInfo->pageSize = 0;
+        }
+    }
+    sqlite3_mutex_leave(pInfo->mutex);
+    return rc;
+}
+
+/*
+** Sync an vcksum-file.  Sidecar is synced along with the main database
+** file, after which the entries of current generation are known to agree
+** with their pages on disk.
+*/
+static int vcksumSync(sqlite3_file *pFile, int flags)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    VCksumInfo *pInfo = p->pInfo;
+    unsigned char aGeneration[4];
+    int rc = p->pReal->pMethods->xSync(p->pReal, flags);
+    if (rc != SQLITE_OK || !pInfo || p->isWal)
+        return rc;
+    sqlite3_mutex_enter(pInfo->mutex);
+    if (pInfo->fd >= 0 && pInfo->pageSize > 0 && fdatasync(pInfo->fd) == 0) {
+        /* It's synced along with the next one. Entries are treated as
+        ** unknown until then, which is never wrong. */
+        vcksumPut4Big(aGeneration, pInfo->generation);
+        if (pwrite(pInfo->fd, aGeneration, sizeof(aGeneration), 12) ==
+            sizeof(aGeneration)) {
+            pInfo->generation++;
+        }
+    }
+    sqlite3_mutex_leave(pInfo->mutex);
+    return rc;
+}
+
+/*
+** Return the current file-size of an vcksum-file.
+*/
+static int vcksumFileSize(sqlite3_file *pFile, sqlite_int64 *pSize)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xFileSize(p->pReal, pSize);
+}
+
+/*
+** Lock an vcksum-file.
+*/
+static int vcksumLock(sqlite3_file *pFile, int eLock)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xLock(p->pReal, eLock);
+}
+
+/*
+** Unlock an vcksum-file.
+*/
+static int vcksumUnlock(sqlite3_file *pFile, int eLock)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xUnlock(p->pReal, eLock);
+}
+
+/*
+** Check if another file-handle holds a RESERVED lock on an vcksum-file.
+*/
+static int vcksumCheckReservedLock(sqlite3_file *pFile, int *pResOut)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xCheckReservedLock(p->pReal, pResOut);
+}
+
+/*
+** File control method. For custom operations on an vcksum-file.
+*/
+static int vcksumFileControl(sqlite3_file *pFile, int op, void *pArg)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    int rc;
+    if (op == SQLITE_FCNTL_VFSCKSUM_STAT ||
+        op == SQLITE_FCNTL_VFSCKSUM_VERIFY) {
+        if (!p->pInfo || p->isWal)
+            return SQLITE_NOTFOUND;
+        sqlite3_mutex_enter(p->pInfo->mutex);
+        if (op == SQLITE_FCNTL_VFSCKSUM_STAT) {
+            memcpy(pArg, &p->pInfo->stat, sizeof(VCksumStat));
+            ((VCksumStat *) pArg)->verify = p->pInfo->verify;
+        } else {
+            p->pInfo->verify = *(int *) pArg;
+        }
+        sqlite3_mutex_leave(p->pInfo->mutex);
+        return SQLITE_OK;
+    }
+    rc = p->pReal->pMethods->xFileControl(p->pReal, op, pArg);
+    if (op == SQLITE_FCNTL_VFSNAME && rc == SQLITE_OK) {
+        *(char **) pArg = sqlite3_mprintf("cksum/%z", *(char **) pArg);
+    }
+    return rc;
+}
+
+/*
+** Return the sector-size in bytes for an vcksum-file.
+*/
+static int vcksumSectorSize(sqlite3_file *pFile)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xSectorSize(p->pReal);
+}
+
+/*
+** Return the device characteristic flags supported by an vcksum-file.
+*/
+static int vcksumDeviceCharacteristics(sqlite3_file *pFile)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xDeviceCharacteristics(p->pReal);
+}
+
+static int vcksumShmMap(sqlite3_file *pFile,
+                        int iRegion,
+                        int szRegion,
+                        int bExtend,
+                        void volatile **pp)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xShmMap(p->pReal, iRegion, szRegion, bExtend,
+                                       pp);
+}
+
+static int vcksumShmLock(sqlite3_file *pFile, int offset, int n, int flags)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xShmLock(p->pReal, offset, n, flags);
+}
+
+static void vcksumShmBarrier(sqlite3_file *pFile)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    p->pReal->pMethods->xShmBarrier(p->pReal);
+}
+
+static int vcksumShmUnmap(sqlite3_file *pFile, int deleteFlag)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xShmUnmap(p->pReal, deleteFlag);
+}
+
+/*
+** Memory-mapped pages would bypass verification, so that SQLite is told
+** to fall back to xRead for the main database file.
+*/
+static int
+vcksumFetch(sqlite3_file *pFile, sqlite3_int64 iOff, int nAmt, void **pp)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    if (p->pInfo && !p->isWal) {
+        *pp = 0;
+        return SQLITE_OK;
+    }
+    return p->pReal->pMethods->xFetch(p->pReal, iOff, nAmt, pp);
+}
+
+static int vcksumUnfetch(sqlite3_file *pFile, sqlite3_int64 iOff, void *pp)
+{
+    VCksumFile *p = (VCksumFile *) pFile;
+    return p->pReal->pMethods->xUnfetch(p->pReal, iOff, pp);
+}
+
+/*
+** Open an vcksum file handle.
+*/
+static int vcksumOpen(sqlite3_vfs *pVfs,
+                      const char *zName,
+                      sqlite3_file *pFile,
+                      int flags,
+                      int *pOutFlags)
+{
+    int rc;
+    VCksumFile *p = (VCksumFile *) pFile;
+
+    p->pReal = (sqlite3_file *) &p[1];
+    p->pInfo = 0;
+    p->isWal = (flags & SQLITE_OPEN_WAL) != 0;
+    p->walBigEndian = -1;
+    if (zName && (flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_WAL)) != 0) {
+        p->pInfo = vcksumInfoOpen(zName, p->isWal);
+    }
+    rc = REALVFS(pVfs)->xOpen(REALVFS(pVfs), zName, p->pReal, flags, pOutFlags);
+    if (rc == SQLITE_OK) {
+        vcksum_io_methods.iVersion = p->pReal->pMethods->iVersion;
+        pFile->pMethods = &vcksum_io_methods;
+    } else {
+        vcksumInfoClose(p->pInfo);
+        p->pInfo = 0;
+    }
+    return rc;
+}
+
+/*
+** Delete the file located at zPath. If the dirSync argument is true,
+** ensure the file-system modifications are synced to disk before
+** returning.
+*/
+static int vcksumDelete(sqlite3_vfs *pVfs, const char *zPath, int dirSync)
+{
+    return REALVFS(pVfs)->xDelete(REALVFS(pVfs), zPath, dirSync);
+}
+
+/*
+** Test for access permissions. Return true if the requested permission
+** is available, or false otherwise.
+*/
+static int
+vcksumAccess(sqlite3_vfs *pVfs, const char *zPath, int flags, int *pResOut)
+{
+    return REALVFS(pVfs)->xAccess(REALVFS(pVfs), zPath, flags, pResOut);
+}
+
+/*
+** Populate buffer zOut with the full canonical pathname corresponding
+** to the pathname in zPath. zOut is guaranteed to point to a buffer
+** of at least (INST_MAX_PATHNAME+1) bytes.
+*/
+static int
+vcksumFullPathname(sqlite3_vfs *pVfs, const char *zPath, int nOut, char *zOut)
+{
+    return REALVFS(pVfs)->xFullPathname(REALVFS(pVfs), zPath, nOut, zOut);
+}
+
+/*
+** Open the dynamic library located at zPath and return a handle.
+*/
+static void *vcksumDlOpen(sqlite3_vfs *pVfs, const char *zPath)
+{
+    return REALVFS(pVfs)->xDlOpen(REALVFS(pVfs), zPath);
+}
+
+/*
+** Populate the buffer zErrMsg (size nByte bytes) with a human readable
+** utf-8 string describing the most recent error encountered associated
+** with dynamic libraries.
+*/
+static void vcksumDlError(sqlite3_vfs *pVfs, int nByte, char *zErrMsg)
+{
+    REALVFS(pVfs)->xDlError(REALVFS(pVfs), nByte, zErrMsg);
+}
+
+/*
+** Return a pointer to the symbol zSymbol in the dynamic library pHandle.
+*/
+static void (*vcksumDlSym(sqlite3_vfs *pVfs, void *p, const char *zSym))(void)
+{
+    return REALVFS(pVfs)->xDlSym(REALVFS(pVfs), p, zSym);
+}
+
+/*
+** Close the dynamic library handle pHandle.
+*/
+static void vcksumDlClose(sqlite3_vfs *pVfs, void *pHandle)
+{
+    REALVFS(pVfs)->xDlClose(REALVFS(pVfs), pHandle);
+}
+
+/*
+** Populate the buffer pointed to by zBufOut with nByte bytes of
+** random data.
+*/
+static int vcksumRandomness(sqlite3_vfs *pVfs, int nByte, char *zBufOut)
+{
+    return REALVFS(pVfs)->xRandomness(REALVFS(pVfs), nByte, zBufOut);
+}
+
+/*
+** Sleep for nMicro microseconds. Return the number of microseconds
+** actually slept.
+*/
+static int vcksumSleep(sqlite3_vfs *pVfs, int nMicro)
+{
+    return REALVFS(pVfs)->xSleep(REALVFS(pVfs), nMicro);
+}
+
+/*
+** Return the current time as a Julian Day number in *pTimeOut.
+*/
+static int vcksumCurrentTime(sqlite3_vfs *pVfs, double *pTimeOut)
+{
+    return REALVFS(pVfs)->xCurrentTime(REALVFS(pVfs), pTimeOut);
+}
+
+static int vcksumGetLastError(sqlite3_vfs *pVfs, int a, char *b)
+{
+    return REALVFS(pVfs)->xGetLastError(REALVFS(pVfs), a, b);
+}
+
+static int vcksumCurrentTimeInt64(sqlite3_vfs *pVfs, sqlite3_int64 *p)
+{
+    return REALVFS(pVfs)->xCurrentTimeInt64(REALVFS(pVfs), p);
+}
+
+static int vcksumSetSystemCall(sqlite3_vfs *pVfs,
+                               const char *zName,
+                               sqlite3_syscall_ptr pSyscall)
+{
+    return REALVFS(pVfs)->xSetSystemCall(REALVFS(pVfs), zName, pSyscall);
+}
+
+static sqlite3_syscall_ptr vcksumGetSystemCall(sqlite3_vfs *pVfs,
+                                               const char *zName)
+{
+    return REALVFS(pVfs)->xGetSystemCall(REALVFS(pVfs), zName);
+}
+
+static const char *vcksumNextSystemCall(sqlite3_vfs *pVfs, const char *zName)
+{
+    return REALVFS(pVfs)->xNextSystemCall(REALVFS(pVfs), zName);
+}
+
+/*
+** Register vfscksum.  It's not made the default VFS.
+*/
+int sqlite3_register_vfscksum(const char *zArg)
+{
+    vcksum_vfs.pVfs = sqlite3_vfs_find(0);
+    vcksum_vfs.base.iVersion = vcksum_vfs.pVfs->iVersion;
+    vcksum_vfs.base.szOsFile = sizeof(VCksumFile) + vcksum_vfs.pVfs->szOsFile;
+    return sqlite3_vfs_register(&vcksum_vfs.base, 0);
+}
+
+static int vcksumFileControlChecked(sqlite3 *db,
+                                    const char *dbName,
+                                    int op,
+                                    void *pArg)
+{
+    sqlite3_vfs *vfs;
+    int rc = sqlite3_file_control(db, dbName, SQLITE_FCNTL_VFS_POINTER, &vfs);
+    if (rc != SQLITE_OK)
+        return rc;
+    else if (!vfs->zName || strcmp(vfs->zName, "vfscksum") != 0)
+        return SQLITE_NOTFOUND;
+    return sqlite3_file_control(db, dbName, op, pArg);
+}
+
+int vcksumGetStats(sqlite3 *db, const char *dbName, VCksumStat *stats)
+{
+    return vcksumFileControlChecked(db, dbName, SQLITE_FCNTL_VFSCKSUM_STAT,
+                                    stats);
+}
+
+int vcksumSetVerify(sqlite3 *db, const char *dbName, int verify)
+{
+    return vcksumFileControlChecked(db, dbName, SQLITE_FCNTL_VFSCKSUM_VERIFY,
+                                    &verify);
+}
@@ -0,0 +1,64 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WCDB_VFSCKSUM_H__
+#define __WCDB_VFSCKSUM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sqlite3.h>
+#include <stdint.h>
+
+#define SQLITE_FCNTL_VFSCKSUM_STAT 10002
+#define SQLITE_FCNTL_VFSCKSUM_VERIFY 10003
+
+#define VCKSUM_MAX_CORRUPTED_PAGES 16
+
+/* Levels of verification */
+#define VCKSUM_VERIFY_OFF 0    /* Mismatches are only recorded */
+#define VCKSUM_VERIFY_FRAMES 1 /* Reads of mismatched WAL frames fail. Default */
+#define VCKSUM_VERIFY_ALL 2    /* Reads of mismatched pages fail as well */
+
+typedef struct VCksumStat {
+    int64_t verifiedPages;
+    int64_t mismatchedPages;
+    int64_t mismatchedFrames;
+    /* Checksums dropped on open, since they were not synced along with
+    ** the pages, e.g. before a crash */
+    int64_t unknownPages;
+    int verify;
+    /* Distinct page numbers that failed verification, the earliest first */
+    int nCorruptedPages;
+    uint32_t corruptedPages[VCKSUM_MAX_CORRUPTED_PAGES];
+} VCksumStat;
+
+int sqlite3_register_vfscksum(const char *zArg);
+int vcksumGetStats(sqlite3 *db, const char *dbName, VCksumStat *stats);
+/* Mismatches are always recorded, but reported as SQLITE_CORRUPT
+** according to the level of verification. */
+int vcksumSetVerify(sqlite3 *db, const char *dbName, int verify);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
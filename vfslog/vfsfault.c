@@ -0,0 +1,959 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+** This file contains the implementation of an SQLite vfs wrapper for
+** testing, which injects I/O faults into the operations matched by the
+** rules added with vfaultAddRule(), e.g. SQLITE_IOERR on reading a range
+** of the WAL file, or SQLITE_FULL with a torn write on the 3rd write to
+** the main database file.
+**
+** It also simulates power loss.  Before each write or truncation, the
+** content it overwrites is saved, and the saved contents are dropped once
+** the file is synced.  On power loss, the unsynced writes are rolled back
+** sector by sector, newest first, except the sectors kept by chance, and
+** the opened files turn unusable as if the process were killed.
+**
+** Chances are drawn from a generator reset by vfaultSeed(), so that a
+** single-threaded scenario is replayed exactly with the same seed.  Each
+** injection is logged with its error code through sqlite3_log().
+**
+** Memory-mapped I/O is disabled for files opened through this vfs, since
+** it would bypass the injection.
+*/
+
+#include "sqlite3.h"
+#include <string.h>
+
+#include "vfsfault.h"
+
+#define VFAULT_SECTOR_SIZE 512
+
+/*
+** Forward declaration of objects used by this utility
+*/
+typedef struct VFaultVfs VFaultVfs;
+typedef struct VFaultFile VFaultFile;
+typedef struct VFaultUndo VFaultUndo;
+typedef struct VFaultRuleEntry VFaultRuleEntry;
+
+struct VFaultVfs {
+    sqlite3_vfs base;  /* VFS methods */
+    sqlite3_vfs *pVfs; /* Parent VFS */
+};
+
+/* Content overwritten by an unsynced write or truncation */
+struct VFaultUndo {
+    VFaultUndo *pNext;    /* Older one */
+    sqlite3_int64 iOfst;  /* Offset of the write */
+    int nAmt;             /* Bytes written */
+    int nOld;             /* Bytes saved.  Less than nAmt beyond old EOF */
+    unsigned char aOld[]; /* Saved content */
+};
+
+struct VFaultFile {
+    sqlite3_file base;    /* IO methods */
+    sqlite3_file *pReal;  /* Underlying file handle */
+    VFaultFile *pNext;    /* Next in the list of opened files */
+    VFaultFile **ppPrev;  /* Pointer to this in the list */
+    const char *zName;    /* Name of file.  NULL for temporary file */
+    int type;             /* One of VFAULT_FILE_* */
+    int crashed;          /* True after power loss */
+    sqlite3_int64 szSync; /* Size at the last sync */
+    VFaultUndo *pUndo;    /* Unsynced writes, newest first */
+};
+
+struct VFaultRuleEntry {
+    VFaultRuleEntry *pNext;
+    int id;
+    VFaultRule rule;
+    int64_t nMatched;
+    int64_t nInjected;
+};
+
+/*
+** Global states.  Protected by SQLITE_MUTEX_STATIC_VFS2.
+*/
+static struct {
+    VFaultRuleEntry *pRules;
+    int nextId;
+    uint64_t rng;
+    int crashKeep;
+    VFaultFile *pFiles;
+    VFaultStat stat;
+} vfault_global = {0, 1, 0x2545F4914F6CDD1DULL, 0, 0, {0, 0, 0}};
+
+#define REALVFS(p) (((VFaultVfs *) (p))->pVfs)
+#define VFAULT_MUTEX() sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS2)
+
+/*
+** Methods for VFaultFile
+*/
+static int vfaultClose(sqlite3_file *);
+static int vfaultRead(sqlite3_file *, void *, int iAmt, sqlite3_int64 iOfst);
+static int
+vfaultWrite(sqlite3_file *, const void *, int iAmt, sqlite3_int64 iOfst);
+static int vfaultTruncate(sqlite3_file *, sqlite3_int64 size);
+static int vfaultSync(sqlite3_file *, int flags);
+static int vfaultFileSize(sqlite3_file *, sqlite3_int64 *pSize);
+static int vfaultLock(sqlite3_file *, int);
+static int vfaultUnlock(sqlite3_file *, int);
+static int vfaultCheckReservedLock(sqlite3_file *, int *pResOut);
+static int vfaultFileControl(sqlite3_file *, int op, void *pArg);
+static int vfaultSectorSize(sqlite3_file *);
+static int vfaultDeviceCharacteristics(sqlite3_file *);
+static int vfaultShmMap(sqlite3_file *, int, int, int, void volatile **);
+static int vfaultShmLock(sqlite3_file *, int, int, int);
+static void vfaultShmBarrier(sqlite3_file *);
+static int vfaultShmUnmap(sqlite3_file *, int);
+static int vfaultFetch(sqlite3_file *, sqlite3_int64, int, void **);
+static int vfaultUnfetch(sqlite3_file *, sqlite3_int64, void *);
+
+/*
+** Methods for VFaultVfs
+*/
+static int vfaultOpen(sqlite3_vfs *, const char *, sqlite3_file *, int, int *);
+static int vfaultDelete(sqlite3_vfs *, const char *zName, int syncDir);
+static int vfaultAccess(sqlite3_vfs *, const char *zName, int flags, int *);
+static int
+vfaultFullPathname(sqlite3_vfs *, const char *zName, int, char *zOut);
+static void *vfaultDlOpen(sqlite3_vfs *, const char *zFilename);
+static void vfaultDlError(sqlite3_vfs *, int nByte, char *zErrMsg);
+static void (*vfaultDlSym(sqlite3_vfs *pVfs, void *p, const char *zSym))(void);
+static void vfaultDlClose(sqlite3_vfs *, void *);
+static int vfaultRandomness(sqlite3_vfs *, int nByte, char *zOut);
+static int vfaultSleep(sqlite3_vfs *, int microseconds);
+static int vfaultCurrentTime(sqlite3_vfs *, double *);
+static int vfaultGetLastError(sqlite3_vfs *, int, char *);
+static int vfaultCurrentTimeInt64(sqlite3_vfs *, sqlite3_int64 *);
+static int
+vfaultSetSystemCall(sqlite3_vfs *, const char *, sqlite3_syscall_ptr);
+static sqlite3_syscall_ptr vfaultGetSystemCall(sqlite3_vfs *, const char *);
+static const char *vfaultNextSystemCall(sqlite3_vfs *, const char *);
+
+static VFaultVfs vfault_vfs = {{
+                                   3,          /* iVersion */
+                                   0,          /* szOsFile */
+                                   1024,       /* mxPathname */
+                                   0,          /* pNext */
+                                   "vfsfault", /* zName */
+                                   0,          /* pAppData */
+                                   vfaultOpen,             /* xOpen */
+                                   vfaultDelete,           /* xDelete */
+                                   vfaultAccess,           /* xAccess */
+                                   vfaultFullPathname,     /* xFullPathname */
+                                   vfaultDlOpen,           /* xDlOpen */
+                                   vfaultDlError,          /* xDlError */
+                                   vfaultDlSym,            /* xDlSym */
+                                   vfaultDlClose,          /* xDlClose */
+                                   vfaultRandomness,       /* xRandomness */
+                                   vfaultSleep,            /* xSleep */
+                                   vfaultCurrentTime,      /* xCurrentTime */
+                                   vfaultGetLastError,     /* xGetLastError */
+                                   vfaultCurrentTimeInt64, /* xCurrentTimeInt64 */
+                                   vfaultSetSystemCall,    /* xSetSystemCall */
+                                   vfaultGetSystemCall,    /* xGetSystemCall */
+                                   vfaultNextSystemCall,   /* xNextSystemCall */
+                               },
+                               0};
+
+static sqlite3_io_methods vfault_io_methods = {
+    3,                           /* iVersion */
+    vfaultClose,                 /* xClose */
+    vfaultRead,                  /* xRead */
+    vfaultWrite,                 /* xWrite */
+    vfaultTruncate,              /* xTruncate */
+    vfaultSync,                  /* xSync */
+    vfaultFileSize,              /* xFileSize */
+    vfaultLock,                  /* xLock */
+    vfaultUnlock,                /* xUnlock */
+    vfaultCheckReservedLock,     /* xCheckReservedLock */
+    vfaultFileControl,           /* xFileControl */
+    vfaultSectorSize,            /* xSectorSize */
+    vfaultDeviceCharacteristics, /* xDeviceCharacteristics */
+    vfaultShmMap,                /* xShmMap */
+    vfaultShmLock,               /* xShmLock */
+    vfaultShmBarrier,            /* xShmBarrier */
+    vfaultShmUnmap,              /* xShmUnmap */
+    vfaultFetch,                 /* xFetch */
+    vfaultUnfetch,               /* xUnfetch */
+};
+
+/*
+** xorshift64*.  Must be called with the global mutex held.
+*/
+static uint32_t vfaultRandomLocked(void)
+{
+    uint64_t x = vfault_global.rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    vfault_global.rng = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static const char *vfaultOpName(int op)
+{
+    switch (op) {
+        case VFAULT_OP_OPEN:
+            return "open";
+        case VFAULT_OP_READ:
+            return "read";
+        case VFAULT_OP_WRITE:
+            return "write";
+        case VFAULT_OP_TRUNCATE:
+            return "truncate";
+        case VFAULT_OP_SYNC:
+            return "sync";
+        case VFAULT_OP_LOCK:
+            return "lock";
+        default:
+            return "unknown";
+    }
+}
+
+/*
+** Match the operation against the rules.  Return the error code to inject,
+** or SQLITE_OK to pass it through.  For writes, *pnShort is set to the
+** bytes to write before failing.
+*/
+static int vfaultCheck(const char *zName,
+                       int type,
+                       int op,
+                       sqlite3_int64 iOfst,
+                       int iAmt,
+                       int *pnShort,
+                       int *pCrash)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    VFaultRuleEntry *pEntry;
+    int rc = SQLITE_OK;
+    int nName = zName ? (int) strlen(zName) : 0;
+
+    *pnShort = -1;
+    *pCrash = 0;
+    sqlite3_mutex_enter(pMutex);
+    for (pEntry = vfault_global.pRules; pEntry; pEntry = pEntry->pNext) {
+        const VFaultRule *r = &pEntry->rule;
+        if (!(r->ops & op) || !(r->files & type))
+            continue;
+        if (r->zSuffix) {
+            int nSuffix = (int) strlen(r->zSuffix);
+            if (nName < nSuffix ||
+                strcmp(zName + nName - nSuffix, r->zSuffix) != 0)
+                continue;
+        }
+        if (iOfst >= 0 &&
+            (iOfst + (iAmt > 0 ? iAmt : 1) <= r->iOfstMin ||
+             (r->iOfstMax > 0 && iOfst >= r->iOfstMax)))
+            continue;
+
+        vfault_global.stat.matched++;
+        if (++pEntry->nMatched <= r->nSkip)
+            continue;
+        if (r->nInject >= 0 && pEntry->nInjected >= r->nInject)
+            continue;
+        if (r->permille > 0 &&
+            (int) (vfaultRandomLocked() % 1000) >= r->permille)
+            continue;
+
+        pEntry->nInjected++;
+        vfault_global.stat.injected++;
+        rc = r->errorCode != SQLITE_OK ? r->errorCode : SQLITE_IOERR;
+        *pnShort = r->nShortWrite;
+        *pCrash = r->crash;
+        break;
+    }
+    sqlite3_mutex_leave(pMutex);
+
+    if (rc != SQLITE_OK) {
+        sqlite3_log(rc, "vfsfault: injected %s%s of %d bytes at %lld of %s",
+                    vfaultOpName(op), *pCrash ? " with power loss" : "", iAmt,
+                    iOfst, zName ? zName : "temporary file");
+    }
+    return rc;
+}
+
+/*
+** Drop the saved contents once the file is synced.
+*/
+static void vfaultUndoClear(VFaultFile *p)
+{
+    while (p->pUndo) {
+        VFaultUndo *pUndo = p->pUndo;
+        p->pUndo = pUndo->pNext;
+        sqlite3_free(pUndo);
+    }
+}
+
+/*
+** Save the content to be overwritten by writing iAmt bytes at iOfst.
+** Must be called with the global mutex held.
+*/
+static int vfaultUndoSave(VFaultFile *p, sqlite3_int64 iOfst, int iAmt)
+{
+    sqlite3_int64 size;
+    VFaultUndo *pUndo;
+    int nOld;
+    int rc = p->pReal->pMethods->xFileSize(p->pReal, &size);
+    if (rc != SQLITE_OK)
+        return rc;
+    nOld = size <= iOfst ? 0 : size - iOfst < iAmt ? (int) (size - iOfst)
+                                                   : iAmt;
+    pUndo = (VFaultUndo *) sqlite3_malloc(sizeof(VFaultUndo) + nOld);
+    if (!pUndo)
+        return SQLITE_NOMEM;
+    pUndo->iOfst = iOfst;
+    pUndo->nAmt = iAmt;
+    pUndo->nOld = nOld;
+    if (nOld > 0) {
+        rc = p->pReal->pMethods->xRead(p->pReal, pUndo->aOld, nOld, iOfst);
+        if (rc != SQLITE_OK) {
+            sqlite3_free(pUndo);
+            return rc;
+        }
+    }
+    pUndo->pNext = p->pUndo;
+    p->pUndo = pUndo;
+    return SQLITE_OK;
+}
+
+/*
+** Roll back the unsynced writes of a file, except the sectors kept by
+** chance.  Must be called with the global mutex held.
+*/
+static void vfaultRevertLocked(VFaultFile *p, int keepPermille)
+{
+    sqlite3_int64 *aKept = 0;
+    int nKept = 0, nAlloc = 0, i;
+    sqlite3_int64 size = p->szSync;
+    VFaultUndo *pUndo;
+
+    for (pUndo = p->pUndo; pUndo; pUndo = pUndo->pNext) {
+        sqlite3_int64 iSector = pUndo->iOfst / VFAULT_SECTOR_SIZE;
+        sqlite3_int64 iEnd = pUndo->iOfst + pUndo->nAmt;
+        for (; iSector * VFAULT_SECTOR_SIZE < iEnd; iSector++) {
+            sqlite3_int64 iFrom = iSector * VFAULT_SECTOR_SIZE;
+            sqlite3_int64 iTo = iFrom + VFAULT_SECTOR_SIZE;
+            int kept = 0;
+            for (i = 0; i < nKept && !kept; i++)
+                kept = aKept[i] == iSector;
+            if (kept)
+                continue; /* Newer content survives */
+
+            if (keepPermille > 0 &&
+                (int) (vfaultRandomLocked() % 1000) < keepPermille) {
+                if (nKept == nAlloc) {
+                    sqlite3_int64 *aNew = (sqlite3_int64 *) sqlite3_realloc(
+                        aKept, (nAlloc * 2 + 16) * sizeof(sqlite3_int64));
+                    if (!aNew)
+                        continue;
+                    aKept = aNew;
+                    nAlloc = nAlloc * 2 + 16;
+                }
+                aKept[nKept++] = iSector;
+                if (iEnd > size)
+                    size = iTo < iEnd ? iTo : iEnd;
+                continue;
+            }
+
+            if (iFrom < pUndo->iOfst)
+                iFrom = pUndo->iOfst;
+            if (iTo > pUndo->iOfst + pUndo->nOld)
+                iTo = pUndo->iOfst + pUndo->nOld;
+            if (iFrom < iTo) {
+                p->pReal->pMethods->xWrite(
+                    p->pReal, pUndo->aOld + (iFrom - pUndo->iOfst),
+                    (int) (iTo - iFrom), iFrom);
+            }
+        }
+    }
+    sqlite3_free(aKept);
+
+    if (p->pUndo && size >= 0)
+        p->pReal->pMethods->xTruncate(p->pReal, size);
+    vfaultUndoClear(p);
+    /* What is reverted is durable, while the process is "killed" */
+    p->pReal->pMethods->xSync(p->pReal, SQLITE_SYNC_NORMAL);
+    p->crashed = 1;
+}
+
+static void vfaultCrashLocked(int keepPermille)
+{
+    VFaultFile *p;
+    for (p = vfault_global.pFiles; p; p = p->pNext) {
+        if (!p->crashed)
+            vfaultRevertLocked(p, keepPermille);
+    }
+    vfault_global.stat.crashes++;
+}
+
+/*
+** Close an vfault-file.
+*/
+static int vfaultClose(sqlite3_file *pFile)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(pMutex);
+    *p->ppPrev = p->pNext;
+    if (p->pNext)
+        p->pNext->ppPrev = p->ppPrev;
+    vfaultUndoClear(p);
+    sqlite3_mutex_leave(pMutex);
+
+    if (p->pReal->pMethods) {
+        rc = p->pReal->pMethods->xClose(p->pReal);
+    }
+    return rc;
+}
+
+/*
+** Read data from an vfault-file.
+*/
+static int
+vfaultRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite_int64 iOfst)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    int nShort, crash;
+    int rc;
+    if (p->crashed)
+        return SQLITE_IOERR_READ;
+    rc = vfaultCheck(p->zName, p->type, VFAULT_OP_READ, iOfst, iAmt, &nShort,
+                     &crash);
+    if (rc == SQLITE_OK)
+        return p->pReal->pMethods->xRead(p->pReal, zBuf, iAmt, iOfst);
+    if (crash)
+        vfaultCrash(vfault_global.crashKeep);
+    return rc;
+}
+
+/*
+** Write data to an vfault-file.
+*/
+static int
+vfaultWrite(sqlite3_file *pFile, const void *z, int iAmt, sqlite_int64 iOfst)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    int nShort, crash;
+    int rc, rcInjected;
+
+    if (p->crashed)
+        return SQLITE_IOERR_WRITE;
+    rcInjected = vfaultCheck(p->zName, p->type, VFAULT_OP_WRITE, iOfst, iAmt,
+                             &nShort, &crash);
+    if (rcInjected != SQLITE_OK) {
+        if (nShort > iAmt)
+            nShort = iAmt;
+        if (nShort <= 0) {
+            if (crash)
+                vfaultCrash(vfault_global.crashKeep);
+            return rcInjected;
+        }
+        iAmt = nShort; /* Torn write */
+    }
+
+    sqlite3_mutex_enter(pMutex);
+    rc = vfaultUndoSave(p, iOfst, iAmt);
+    sqlite3_mutex_leave(pMutex);
+    if (rc == SQLITE_OK)
+        rc = p->pReal->pMethods->xWrite(p->pReal, z, iAmt, iOfst);
+
+    if (rcInjected != SQLITE_OK) {
+        if (crash)
+            vfaultCrash(vfault_global.crashKeep);
+        return rcInjected;
+    }
+    return rc;
+}
+
+/*
+** Truncate an vfault-file.
+*/
+static int vfaultTruncate(sqlite3_file *pFile, sqlite_int64 size)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_int64 current;
+    int nShort, crash;
+    int rc;
+
+    if (p->crashed)
+        return SQLITE_IOERR_TRUNCATE;
+    rc = vfaultCheck(p->zName, p->type, VFAULT_OP_TRUNCATE, size, 0, &nShort,
+                     &crash);
+    if (rc != SQLITE_OK) {
+        if (crash)
+            vfaultCrash(vfault_global.crashKeep);
+        return rc;
+    }
+
+    rc = p->pReal->pMethods->xFileSize(p->pReal, &current);
+    if (rc == SQLITE_OK && current > size) {
+        sqlite3_mutex_enter(pMutex);
+        rc = vfaultUndoSave(p, size, (int) (current - size));
+        sqlite3_mutex_leave(pMutex);
+    }
+    if (rc == SQLITE_OK)
+        rc = p->pReal->pMethods->xTruncate(p->pReal, size);
+    return rc;
+}
+
+/*
+** Sync an vfault-file.
+*/
+static int vfaultSync(sqlite3_file *pFile, int flags)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    int nShort, crash;
+    int rc;
+
+    if (p->crashed)
+        return SQLITE_IOERR_FSYNC;
+    rc = vfaultCheck(p->zName, p->type, VFAULT_OP_SYNC, -1, 0, &nShort,
+                     &crash);
+    if (rc != SQLITE_OK) {
+        if (crash)
+            vfaultCrash(vfault_global.crashKeep);
+        return rc;
+    }
+
+    rc = p->pReal->pMethods->xSync(p->pReal, flags);
+    if (rc == SQLITE_OK) {
+        sqlite3_mutex_enter(pMutex);
+        vfaultUndoClear(p);
+        if (p->pReal->pMethods->xFileSize(p->pReal, &p->szSync) != SQLITE_OK)
+            p->szSync = -1;
+        sqlite3_mutex_leave(pMutex);
+    }
+    return rc;
+}
+
+/*
+** Return the current file-size of an vfault-file.
+*/
+static int vfaultFileSize(sqlite3_file *pFile, sqlite_int64 *pSize)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    if (p->crashed)
+        return SQLITE_IOERR_FSTAT;
+    return p->pReal->pMethods->xFileSize(p->pReal, pSize);
+}
+
+/*
+** Lock an vfault-file.
+*/
+static int vfaultLock(sqlite3_file *pFile, int eLock)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    int nShort, crash;
+    int rc;
+
+    if (p->crashed)
+        return SQLITE_IOERR_LOCK;
+    rc = vfaultCheck(p->zName, p->type, VFAULT_OP_LOCK, -1, 0, &nShort,
+                     &crash);
+    if (rc != SQLITE_OK) {
+        if (crash)
+            vfaultCrash(vfault_global.crashKeep);
+        return rc;
+    }
+    return p->pReal->pMethods->xLock(p->pReal, eLock);
+}
+
+/*
+** Unlock an vfault-file.  Locks are released even after power loss.
+*/
+static int vfaultUnlock(sqlite3_file *pFile, int eLock)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xUnlock(p->pReal, eLock);
+}
+
+/*
+** Check if another file-handle holds a RESERVED lock on an vfault-file.
+*/
+static int vfaultCheckReservedLock(sqlite3_file *pFile, int *pResOut)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xCheckReservedLock(p->pReal, pResOut);
+}
+
+/*
+** File control method. For custom operations on an vfault-file.
+*/
+static int vfaultFileControl(sqlite3_file *pFile, int op, void *pArg)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    int rc = p->pReal->pMethods->xFileControl(p->pReal, op, pArg);
+    if (op == SQLITE_FCNTL_VFSNAME && rc == SQLITE_OK) {
+        *(char **) pArg = sqlite3_mprintf("fault/%z", *(char **) pArg);
+    }
+    return rc;
+}
+
+/*
+** Return the sector-size in bytes for an vfault-file.
+*/
+static int vfaultSectorSize(sqlite3_file *pFile)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xSectorSize(p->pReal);
+}
+
+/*
+** Return the device characteristic flags supported by an vfault-file.
+** Power loss may tear writes, so no atomic or safe-append guarantee is
+** claimed.
+*/
+static int vfaultDeviceCharacteristics(sqlite3_file *pFile)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    int flags = p->pReal->pMethods->xDeviceCharacteristics(p->pReal);
+    return flags & ~(SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_ATOMIC512 |
+                     SQLITE_IOCAP_ATOMIC1K | SQLITE_IOCAP_ATOMIC2K |
+                     SQLITE_IOCAP_ATOMIC4K | SQLITE_IOCAP_ATOMIC8K |
+                     SQLITE_IOCAP_ATOMIC16K | SQLITE_IOCAP_ATOMIC32K |
+                     SQLITE_IOCAP_ATOMIC64K | SQLITE_IOCAP_SAFE_APPEND |
+                     SQLITE_IOCAP_SEQUENTIAL |
+                     SQLITE_IOCAP_POWERSAFE_OVERWRITE |
+                     SQLITE_IOCAP_BATCH_ATOMIC);
+}
+
+static int vfaultShmMap(sqlite3_file *pFile,
+                        int iRegion,
+                        int szRegion,
+                        int bExtend,
+                        void volatile **pp)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xShmMap(p->pReal, iRegion, szRegion, bExtend,
+                                       pp);
+}
+
+static int vfaultShmLock(sqlite3_file *pFile, int offset, int n, int flags)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xShmLock(p->pReal, offset, n, flags);
+}
+
+static void vfaultShmBarrier(sqlite3_file *pFile)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    p->pReal->pMethods->xShmBarrier(p->pReal);
+}
+
+static int vfaultShmUnmap(sqlite3_file *pFile, int deleteFlag)
+{
+    VFaultFile *p = (VFaultFile *) pFile;
+    return p->pReal->pMethods->xShmUnmap(p->pReal, deleteFlag);
+}
+
+/*
+** Memory-mapped pages would bypass the injection, so that SQLite is told
+** to fall back to xRead.
+*/
+static int
+vfaultFetch(sqlite3_file *pFile, sqlite3_int64 iOff, int nAmt, void **pp)
+{
+    *pp = 0;
+    return SQLITE_OK;
+}
+
+static int vfaultUnfetch(sqlite3_file *pFile, sqlite3_int64 iOff, void *pp)
+{
+    return SQLITE_OK;
+}
+
+/*
+** Open an vfault file handle.
+*/
+static int vfaultOpen(sqlite3_vfs *pVfs,
+                      const char *zName,
+                      sqlite3_file *pFile,
+                      int flags,
+                      int *pOutFlags)
+{
+    int rc;
+    int nShort, crash;
+    VFaultFile *p = (VFaultFile *) pFile;
+    sqlite3_mutex *pMutex;
+
+    p->pReal = (sqlite3_file *) &p[1];
+    p->zName = zName;
+    p->crashed = 0;
+    p->pUndo = 0;
+    p->szSync = 0;
+    if (flags & SQLITE_OPEN_MAIN_DB)
+        p->type = VFAULT_FILE_MAIN_DB;
+    else if (flags & SQLITE_OPEN_MAIN_JOURNAL)
+        p->type = VFAULT_FILE_JOURNAL;
+    else if (flags & SQLITE_OPEN_WAL)
+        p->type = VFAULT_FILE_WAL;
+    else
+        p->type = VFAULT_FILE_OTHER;
+
+    rc = vfaultCheck(zName, p->type, VFAULT_OP_OPEN, -1, 0, &nShort, &crash);
+    if (rc != SQLITE_OK) {
+        if (crash)
+            vfaultCrash(vfault_global.crashKeep);
+        return rc;
+    }
+
+    rc = REALVFS(pVfs)->xOpen(REALVFS(pVfs), zName, p->pReal, flags, pOutFlags);
+    if (rc != SQLITE_OK)
+        return rc;
+    vfault_io_methods.iVersion = p->pReal->pMethods->iVersion;
+    pFile->pMethods = &vfault_io_methods;
+    if (p->pReal->pMethods->xFileSize(p->pReal, &p->szSync) != SQLITE_OK)
+        p->szSync = -1;
+
+    pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    p->pNext = vfault_global.pFiles;
+    p->ppPrev = &vfault_global.pFiles;
+    if (p->pNext)
+        p->pNext->ppPrev = &p->pNext;
+    vfault_global.pFiles = p;
+    sqlite3_mutex_leave(pMutex);
+    return SQLITE_OK;
+}
+
+/*
+** Delete the file located at zPath. If the dirSync argument is true,
+** ensure the file-system modifications are synced to disk before
+** returning.
+*/
+static int vfaultDelete(sqlite3_vfs *pVfs, const char *zPath, int dirSync)
+{
+    return REALVFS(pVfs)->xDelete(REALVFS(pVfs), zPath, dirSync);
+}
+
+/*
+** Test for access permissions. Return true if the requested permission
+** is available, or false otherwise.
+*/
+static int
+vfaultAccess(sqlite3_vfs *pVfs, const char *zPath, int flags, int *pResOut)
+{
+    return REALVFS(pVfs)->xAccess(REALVFS(pVfs), zPath, flags, pResOut);
+}
+
+/*
+** Populate buffer zOut with the full canonical pathname corresponding
+** to the pathname in zPath. zOut is guaranteed to point to a buffer
+** of at least (INST_MAX_PATHNAME+1) bytes.
+*/
+static int
+vfaultFullPathname(sqlite3_vfs *pVfs, const char *zPath, int nOut, char *zOut)
+{
+    return REALVFS(pVfs)->xFullPathname(REALVFS(pVfs), zPath, nOut, zOut);
+}
+
+/*
+** Open the dynamic library located at zPath and return a handle.
+*/
+static void *vfaultDlOpen(sqlite3_vfs *pVfs, const char *zPath)
+{
+    return REALVFS(pVfs)->xDlOpen(REALVFS(pVfs), zPath);
+}
+
+/*
+** Populate the buffer zErrMsg (size nByte bytes) with a human readable
+** utf-8 string describing the most recent error encountered associated
+** with dynamic libraries.
+*/
+static void vfaultDlError(sqlite3_vfs *pVfs, int nByte, char *zErrMsg)
+{
+    REALVFS(pVfs)->xDlError(REALVFS(pVfs), nByte, zErrMsg);
+}
+
+/*
+** Return a pointer to the symbol zSymbol in the dynamic library pHandle.
+*/
+static void (*vfaultDlSym(sqlite3_vfs *pVfs, void *p, const char *zSym))(void)
+{
+    return REALVFS(pVfs)->xDlSym(REALVFS(pVfs), p, zSym);
+}
+
+/*
+** Close the dynamic library handle pHandle.
+*/
+static void vfaultDlClose(sqlite3_vfs *pVfs, void *pHandle)
+{
+    REALVFS(pVfs)->xDlClose(REALVFS(pVfs), pHandle);
+}
+
+/*
+** Populate the buffer pointed to by zBufOut with nByte bytes of
+** random data.
+*/
+static int vfaultRandomness(sqlite3_vfs *pVfs, int nByte, char *zBufOut)
+{
+    return REALVFS(pVfs)->xRandomness(REALVFS(pVfs), nByte, zBufOut);
+}
+
+/*
+** Sleep for nMicro microseconds. Return the number of microseconds
+** actually slept.
+*/
+static int vfaultSleep(sqlite3_vfs *pVfs, int nMicro)
+{
+    return REALVFS(pVfs)->xSleep(REALVFS(pVfs), nMicro);
+}
+
+/*
+** Return the current time as a Julian Day number in *pTimeOut.
+*/
+static int vfaultCurrentTime(sqlite3_vfs *pVfs, double *pTimeOut)
+{
+    return REALVFS(pVfs)->xCurrentTime(REALVFS(pVfs), pTimeOut);
+}
+
+static int vfaultGetLastError(sqlite3_vfs *pVfs, int a, char *b)
+{
+    return REALVFS(pVfs)->xGetLastError(REALVFS(pVfs), a, b);
+}
+
+static int vfaultCurrentTimeInt64(sqlite3_vfs *pVfs, sqlite3_int64 *p)
+{
+    return REALVFS(pVfs)->xCurrentTimeInt64(REALVFS(pVfs), p);
+}
+
+static int vfaultSetSystemCall(sqlite3_vfs *pVfs,
+                               const char *zName,
+                               sqlite3_syscall_ptr pFunc)
+{
+    return REALVFS(pVfs)->xSetSystemCall(REALVFS(pVfs), zName, pFunc);
+}
+
+static sqlite3_syscall_ptr vfaultGetSystemCall(sqlite3_vfs *pVfs,
+                                               const char *zName)
+{
+    return REALVFS(pVfs)->xGetSystemCall(REALVFS(pVfs), zName);
+}
+
+static const char *vfaultNextSystemCall(sqlite3_vfs *pVfs, const char *zName)
+{
+    return REALVFS(pVfs)->xNextSystemCall(REALVFS(pVfs), zName);
+}
+
+int sqlite3_register_vfsfault(const char *zArg)
+{
+    vfault_vfs.pVfs = sqlite3_vfs_find(0);
+    vfault_vfs.base.iVersion = vfault_vfs.pVfs->iVersion;
+    vfault_vfs.base.szOsFile = sizeof(VFaultFile) + vfault_vfs.pVfs->szOsFile;
+    return sqlite3_vfs_register(&vfault_vfs.base, 0);
+}
+
+int vfaultAddRule(const VFaultRule *rule)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    VFaultRuleEntry **ppEntry;
+    int nSuffix = rule->zSuffix ? (int) strlen(rule->zSuffix) + 1 : 0;
+    VFaultRuleEntry *pEntry =
+        (VFaultRuleEntry *) sqlite3_malloc(sizeof(VFaultRuleEntry) + nSuffix);
+    if (!pEntry)
+        return -1;
+    pEntry->pNext = 0;
+    pEntry->rule = *rule;
+    pEntry->nMatched = 0;
+    pEntry->nInjected = 0;
+    if (rule->zSuffix) {
+        memcpy(&pEntry[1], rule->zSuffix, nSuffix);
+        pEntry->rule.zSuffix = (const char *) &pEntry[1];
+    }
+
+    sqlite3_mutex_enter(pMutex);
+    pEntry->id = vfault_global.nextId++;
+    for (ppEntry = &vfault_global.pRules; *ppEntry;
+         ppEntry = &(*ppEntry)->pNext)
+        ;
+    *ppEntry = pEntry;
+    sqlite3_mutex_leave(pMutex);
+    return pEntry->id;
+}
+
+void vfaultRemoveRule(int id)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    VFaultRuleEntry **ppEntry;
+    sqlite3_mutex_enter(pMutex);
+    for (ppEntry = &vfault_global.pRules; *ppEntry;
+         ppEntry = &(*ppEntry)->pNext) {
+        if ((*ppEntry)->id == id) {
+            VFaultRuleEntry *pEntry = *ppEntry;
+            *ppEntry = pEntry->pNext;
+            sqlite3_free(pEntry);
+            break;
+        }
+    }
+    sqlite3_mutex_leave(pMutex);
+}
+
+void vfaultClearRules(void)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    while (vfault_global.pRules) {
+        VFaultRuleEntry *pEntry = vfault_global.pRules;
+        vfault_global.pRules = pEntry->pNext;
+        sqlite3_free(pEntry);
+    }
+    sqlite3_mutex_leave(pMutex);
+}
+
+void vfaultSeed(uint64_t seed)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    /* xorshift never leaves zero */
+    vfault_global.rng = seed ? seed : 0x2545F4914F6CDD1DULL;
+    sqlite3_mutex_leave(pMutex);
+}
+
+void vfaultCrash(int keepPermille)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    vfaultCrashLocked(keepPermille);
+    sqlite3_mutex_leave(pMutex);
+    sqlite3_log(SQLITE_IOERR, "vfsfault: power loss");
+}
+
+void vfaultSetCrashKeep(int keepPermille)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    vfault_global.crashKeep = keepPermille;
+    sqlite3_mutex_leave(pMutex);
+}
+
+void vfaultGetStats(VFaultStat *stats)
+{
+    sqlite3_mutex *pMutex = VFAULT_MUTEX();
+    sqlite3_mutex_enter(pMutex);
+    memcpy(stats, &vfault_global.stat, sizeof(VFaultStat));
+    sqlite3_mutex_leave(pMutex);
+}
@@ -0,0 +1,101 @@
+/*
+ * Tencent is pleased to support the open source community by making
+ * WCDB available.
+ *
+ * Copyright (C) 2017 THL A29 Limited, a Tencent company.
+ * All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use
+ * this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *       https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WCDB_VFSFAULT_H__
+#define __WCDB_VFSFAULT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sqlite3.h>
+#include <stdint.h>
+
+/* Operations to inject faults into */
+#define VFAULT_OP_OPEN 0x01
+#define VFAULT_OP_READ 0x02
+#define VFAULT_OP_WRITE 0x04
+#define VFAULT_OP_TRUNCATE 0x08
+#define VFAULT_OP_SYNC 0x10
+#define VFAULT_OP_LOCK 0x20
+#define VFAULT_OP_ALL 0x3F
+
+/* Files to inject faults into */
+#define VFAULT_FILE_MAIN_DB 0x01
+#define VFAULT_FILE_JOURNAL 0x02
+#define VFAULT_FILE_WAL 0x04
+#define VFAULT_FILE_OTHER 0x08
+#define VFAULT_FILE_ALL 0x0F
+
+typedef struct VFaultRule {
+    int ops;   /* Mask of VFAULT_OP_* */
+    int files; /* Mask of VFAULT_FILE_* */
+    /* File name should end with it, or NULL for any file */
+    const char *zSuffix;
+    /* Byte range of file to match, which is [iOfstMin, iOfstMax).
+    ** iOfstMax <= 0 for unbounded. Operations without offset, e.g. sync,
+    ** always match. */
+    sqlite3_int64 iOfstMin;
+    sqlite3_int64 iOfstMax;
+    int nSkip;     /* Matched operations passed through before injecting */
+    int nInject;   /* Number of faults to inject.  < 0 for unlimited */
+    int permille;  /* Chance of injecting into each matched operation,
+                   ** drawn from the seeded generator.  <= 0 for always */
+    int errorCode; /* Error returned, e.g. SQLITE_IOERR_WRITE, SQLITE_FULL */
+    /* Bytes written before a write fails, which makes a torn write.
+    ** < 0 to write nothing. */
+    int nShortWrite;
+    /* Simulate power loss once injected.  See vfaultCrash(). */
+    int crash;
+} VFaultRule;
+
+typedef struct VFaultStat {
+    int64_t matched;  /* Operations matched by any rule */
+    int64_t injected; /* Faults injected */
+    int64_t crashes;  /* Power losses simulated */
+} VFaultStat;
+
+int sqlite3_register_vfsfault(const char *zArg);
+
+/* Return the id of the added rule, or -1 on OOM. Rules are evaluated in
+** the order added and the first injecting rule wins. */
+int vfaultAddRule(const VFaultRule *rule);
+void vfaultRemoveRule(int id);
+void vfaultClearRules(void);
+
+/* Reset the generator deciding the chances and the sectors kept on power
+** loss, so that a scenario can be replayed by its seed. */
+void vfaultSeed(uint64_t seed);
+
+/* Simulate power loss.  Writes since the last sync of each opened file
+** are lost, except the 512-byte sectors kept by keepPermille chance, and
+** all further operations on opened files fail with SQLITE_IOERR as if the
+** process were killed.  Files opened afterwards work as usual. */
+void vfaultCrash(int keepPermille);
+/* Chance of sectors kept by power loss triggered by rules */
+void vfaultSetCrashKeep(int keepPermille);
+
+void vfaultGetStats(VFaultStat *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif